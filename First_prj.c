@@ -4,10 +4,16 @@
 #include "pico/cyw43_arch.h"
 #include "lwip/ip4_addr.h"
 
+#include "config_store.h"
 #include "debug.h"
+#include "delay_line.h"
+#include "log_ring.h"
 #include "web_server.h"
+#include "sim_batch.h"
 #include "sim_state.h"
 #include "sim_worker.h"
+#include "sweep.h"
+#include "udp_channel.h"
 #include "wifi_manager.h"
 #include "mdns_manager.h"
 
@@ -15,12 +21,22 @@
 #define WIFI_SSID     "WiFi"
 #define WIFI_PASSWORD "12345678"
 
+#define SWEEP_CORE0_SLICE_US 5000 // longest background sweep slice per main-loop pass
+#define HTTP_JOB_SLICE_US 5000 // longest /api/simulate or /api/autotune slice per main-loop pass
+#define LOG_DRAIN_PER_PASS 16 // deferred log lines printed per main-loop pass
+
 /* Initialize hardware, connect to Wi-Fi, start services, then run the LED loop. */
 int main(void) {
     stdio_init_all();
     sleep_ms(1500);
 
     sim_state_init();
+    int restored = config_store_restore();
+    LOGF("Config %s in %u us\n", restored ? "restored from flash" : "defaults kept",
+         (unsigned)config_store_get_stats().restore_us);
+    delay_pool_init();
+    sim_batch_init();
+    sweep_init();
 
     if (cyw43_arch_init()) {
         ERRF("CYW43 init failed\n");
@@ -37,18 +53,22 @@ int main(void) {
         return 1;
     }
     LOGF("HTTP server started\n");
+    if (udp_channel_start()) {
+        LOGF("UDP channel on port %d\n", UDP_CHANNEL_PORT);
+    } else {
+        ERRF("UDP channel failed to start\n");
+    }
 
     sim_worker_start();
 
     absolute_time_t next_blink = make_timeout_time_ms(200);
     bool led_state = false;
+    static sweep_worker_t sweep;
+    sweep_worker_init(&sweep, 0);
     while (true) {
-        int led_manual;
-        int blink_ms;
-        critical_section_enter_blocking(&g_sim.lock);
-        led_manual = g_sim.cfg.running ? 1 : 0;
-        blink_ms = g_sim.cfg.running ? 200 : 0;
-        critical_section_exit(&g_sim.lock);
+        int running = sim_state_get_config().running;
+        int led_manual = running ? 1 : 0;
+        int blink_ms = running ? 200 : 0;
 
         if (blink_ms > 0) {
             if (absolute_time_diff_us(get_absolute_time(), next_blink) <= 0) {
@@ -60,6 +80,13 @@ int main(void) {
             cyw43_arch_gpio_put(CYW43_WL_GPIO_LED_PIN, led_manual ? 1 : 0);
         }
 
-        sleep_ms(10);
+        wifi_poll();
+        log_ring_drain(LOG_DRAIN_PER_PASS);
+        config_store_poll();
+
+        /* Offline HTTP jobs and background sweep work in slices short enough for the LED and Wi-Fi polling. */
+        int busy = web_server_poll(time_us_64() + HTTP_JOB_SLICE_US);
+        if (sweep_work(&sweep, time_us_64() + SWEEP_CORE0_SLICE_US)) busy = 1;
+        if (!busy) sleep_ms(10);
     }
 }
@@ -0,0 +1,317 @@
+#include <math.h>
+#include <string.h>
+
+#include "pico/time.h"
+
+#include "autotune.h"
+#include "sim_loop.h"
+
+#define AUTOTUNE_SETTLE_TOL 1e-3 // relative output change between checks that counts as steady
+#define AUTOTUNE_SETTLE_CHECKS 3 // consecutive steady checks before the step test stops
+#define AUTOTUNE_PI 3.14159265358979
+
+/** Fill req with the defaults (relay, Ziegler-Nichols PID). */
+void autotune_default_request(autotune_request_t *req) {
+    memset(req, 0, sizeof(*req));
+    req->method = AUTOTUNE_RELAY;
+    req->rule = AUTOTUNE_RULE_ZN;
+}
+
+/** Put the plant at rest with zero input. */
+static void autotune_plant_reset(autotune_plant_t *p) {
+    memset(p->x, 0, sizeof(p->x));
+    delay_line_reset(&p->delay);
+    delay_line_set(&p->delay, p->dead_ms, p->dt_us);
+}
+
+/** Set up the open-loop pipeline for cfg; returns 0 if the actuator is disabled. */
+static int autotune_plant_init(autotune_plant_t *p, const sim_config_t *cfg) {
+    int dt_us = sim_loop_dt_us(cfg);
+    p->dt = dt_us / 1e6;
+    p->act_min = cfg->act_min;
+    p->act_max = cfg->act_max;
+    if (!actuator_limits(cfg->act_inject, cfg->act_absorb, &p->act_min, &p->act_max)) return 0;
+    sim_loop_plant_discretize(&p->ss, &cfg->plant, (float)p->dt, &p->work);
+    p->dead_ms = cfg->plant.dead_time_ms;
+    p->dt_us = dt_us;
+    autotune_plant_reset(p);
+    return 1;
+}
+
+static float autotune_clamp(const autotune_plant_t *p, float u) {
+    if (u < p->act_min) return p->act_min;
+    if (u > p->act_max) return p->act_max;
+    return u;
+}
+
+/** One tick with actuator input u (clamped to the limits); returns y. */
+static float autotune_plant_step(autotune_plant_t *p, float u) {
+    float u_delayed = delay_line_step(&p->delay, autotune_clamp(p, u));
+    return plant_ss_step(&p->ss, p->x, u_delayed);
+}
+
+/** Store gains given as kp, Ti, Td in the sim_loop PID form. */
+static void autotune_set_gains(pid_params_t *pid, double kp, double ti, double td, int pi_only) {
+    pid->kp = (float)kp;
+    pid->ki = (ti > 0.0) ? (float)(kp / ti) : 0.0f;
+    pid->kd = pi_only ? 0.0f : (float)(kp * td);
+}
+
+/** Tuning rule on the relay result (ultimate gain and period). */
+static int autotune_rule_relay(const autotune_request_t *req, autotune_result_t *out) {
+    double ku = out->ku;
+    double pu = out->pu;
+    switch (req->rule) {
+    case AUTOTUNE_RULE_ZN:
+        if (req->pi_only) autotune_set_gains(&out->pid, 0.45 * ku, pu / 1.2, 0.0, 1);
+        else autotune_set_gains(&out->pid, 0.6 * ku, pu / 2.0, pu / 8.0, 0);
+        return 1;
+    case AUTOTUNE_RULE_TYREUS_LUYBEN:
+        if (req->pi_only) autotune_set_gains(&out->pid, 0.31 * ku, 2.2 * pu, 0.0, 1);
+        else autotune_set_gains(&out->pid, 0.45 * ku, 2.2 * pu, pu / 6.3, 0);
+        return 1;
+    default:
+        out->error = "rule needs method=step";
+        return 0;
+    }
+}
+
+/** Tuning rule on the first order plus dead time fit. */
+static int autotune_rule_step(const autotune_request_t *req, autotune_result_t *out) {
+    double k = out->k;
+    double t = out->t;
+    double l = out->l;
+    double r = l / t;
+    switch (req->rule) {
+    case AUTOTUNE_RULE_ZN:
+        if (req->pi_only) autotune_set_gains(&out->pid, 0.9 * t / (k * l), 3.33 * l, 0.0, 1);
+        else autotune_set_gains(&out->pid, 1.2 * t / (k * l), 2.0 * l, 0.5 * l, 0);
+        return 1;
+    case AUTOTUNE_RULE_COHEN_COON:
+        if (req->pi_only) {
+            autotune_set_gains(&out->pid, (t / (k * l)) * (0.9 + r / 12.0),
+                               l * (30.0 + 3.0 * r) / (9.0 + 20.0 * r), 0.0, 1);
+        } else {
+            autotune_set_gains(&out->pid, (t / (k * l)) * (4.0 / 3.0 + r / 4.0),
+                               l * (32.0 + 6.0 * r) / (13.0 + 8.0 * r), 4.0 * l / (11.0 + 2.0 * r), 0);
+        }
+        return 1;
+    case AUTOTUNE_RULE_SIMC: {
+        /* tau_c = L; SIMC gives a PI controller for a first-order fit. */
+        double tau_c = l;
+        double ti = 4.0 * (tau_c + l);
+        autotune_set_gains(&out->pid, t / (k * (tau_c + l)), (t < ti) ? t : ti, 0.0, 1);
+        return 1;
+    }
+    default:
+        out->error = "rule needs method=relay";
+        return 0;
+    }
+}
+
+/** End the identification; the pooled dead-time storage is returned. */
+static void autotune_finish(autotune_t *at, int ok) {
+    delay_line_reset(&at->plant.delay);
+    at->res.ok = ok;
+    at->phase = AUTOTUNE_PHASE_DONE;
+}
+
+static void autotune_fail(autotune_t *at, const char *error) {
+    at->res.error = error;
+    autotune_finish(at, 0);
+}
+
+/**
+ * Relay with hysteresis around the setpoint. The bias is the steady-state
+ * input for r from the step test, so the oscillation is symmetric; if the
+ * relay would hit the actuator limits there, it runs around the nearest
+ * operating point that leaves room for it (Ku and Pu of a linear plant do
+ * not depend on it).
+ */
+static void autotune_relay_begin(autotune_t *at) {
+    autotune_plant_t *p = &at->plant;
+    float d = at->req.relay_amplitude > 0.0f ? at->req.relay_amplitude : 0.2f * (p->act_max - p->act_min);
+    if (2.0f * d > p->act_max - p->act_min) d = 0.5f * (p->act_max - p->act_min);
+    if (d <= 0.0f) {
+        autotune_fail(at, "no relay amplitude inside the actuator limits");
+        return;
+    }
+    float u0 = at->setpoint / at->res.k;
+    if (u0 < p->act_min + d) u0 = p->act_min + d;
+    if (u0 > p->act_max - d) u0 = p->act_max - d;
+    at->d = d;
+    at->u = u0;
+    at->r = u0 * at->res.k;
+    at->eps = at->req.hysteresis > 0.0f ? at->req.hysteresis : 0.005f * fmaxf(fabsf(at->r), 1.0f);
+    at->rises = 0;
+    at->y_min = at->y_max = 0.0;
+    at->high = at->r > 0.0f;
+    at->i = 0;
+    autotune_plant_reset(p);
+    at->phase = AUTOTUNE_PHASE_RELAY;
+}
+
+/** The relay experiment ended: ultimate gain and period, then the gains. */
+static void autotune_relay_end(autotune_t *at) {
+    at->res.ticks += at->i;
+    if (at->rises < AUTOTUNE_RELAY_SKIP + AUTOTUNE_RELAY_PERIODS + 1) {
+        autotune_fail(at, "no sustained relay oscillation");
+        return;
+    }
+    double a = 0.5 * (at->y_max - at->y_min);
+    if (a <= at->eps) {
+        autotune_fail(at, "relay oscillation within the hysteresis");
+        return;
+    }
+    at->res.amplitude = (float)a;
+    at->res.pu = (float)((at->rise_t[at->rises - 1] - at->rise_t[AUTOTUNE_RELAY_SKIP]) / AUTOTUNE_RELAY_PERIODS);
+    at->res.ku = (float)(4.0 * at->d / (AUTOTUNE_PI * sqrt(a * a - (double)at->eps * at->eps)));
+    autotune_finish(at, autotune_rule_relay(&at->req, &at->res));
+}
+
+static void autotune_relay_tick(autotune_t *at) {
+    float y = autotune_plant_step(&at->plant, at->high ? at->u + at->d : at->u - at->d);
+    at->i++;
+    float e = at->r - y;
+    if (at->high && e < -at->eps) {
+        at->high = 0;
+    } else if (!at->high && e > at->eps) {
+        at->high = 1;
+        at->rise_t[at->rises++] = at->i * at->plant.dt;
+        if (at->rises == AUTOTUNE_RELAY_SKIP + 1) at->y_min = at->y_max = y;
+    }
+    if (at->rises > AUTOTUNE_RELAY_SKIP) {
+        if (y < at->y_min) at->y_min = y;
+        if (y > at->y_max) at->y_max = y;
+    }
+    if (at->rises == AUTOTUNE_RELAY_SKIP + AUTOTUNE_RELAY_PERIODS + 1 || at->i == AUTOTUNE_MAX_TICKS) {
+        autotune_relay_end(at);
+    }
+}
+
+/** The second step run ended: first order plus dead time fit (Smith's two-point method). */
+static void autotune_fit_end(autotune_t *at) {
+    double dt = at->plant.dt;
+    at->res.ticks += at->i;
+    if (at->t63 < 0.0) {
+        autotune_fail(at, "step response did not reach 63 %");
+        return;
+    }
+    at->res.t = (float)(1.5 * (at->t63 - at->t28));
+    at->res.l = (float)(at->t63 - at->res.t);
+    if (at->res.l < dt) at->res.l = (float)dt; // the tick itself delays by about one step
+    if (at->res.t < dt) at->res.t = (float)dt;
+    if (at->req.method == AUTOTUNE_RELAY) {
+        autotune_relay_begin(at);
+    } else {
+        autotune_finish(at, autotune_rule_step(&at->req, &at->res));
+    }
+}
+
+static void autotune_fit_tick(autotune_t *at) {
+    double dt = at->plant.dt;
+    double progress = autotune_plant_step(&at->plant, at->u) / at->y_ss;
+    at->i++;
+    double t = at->i * dt;
+    /* Interpolate the crossing inside the tick. */
+    if (at->t28 < 0.0 && progress >= 0.283) at->t28 = t - dt * (progress - 0.283) / (progress - at->prev);
+    if (at->t63 < 0.0 && progress >= 0.632) at->t63 = t - dt * (progress - 0.632) / (progress - at->prev);
+    at->prev = progress;
+    if (at->t63 >= 0.0 || at->i == AUTOTUNE_MAX_TICKS) autotune_fit_end(at);
+}
+
+/** The first step run reached its steady state: static gain, then the timed run from rest. */
+static void autotune_settle_end(autotune_t *at) {
+    at->res.ticks += at->i;
+    if (fabs(at->y) < 1e-6) {
+        autotune_fail(at, "plant does not respond to the step");
+        return;
+    }
+    at->res.k = (float)(at->y / at->u);
+    at->y_ss = at->y;
+    at->t28 = at->t63 = -1.0;
+    at->prev = 0.0;
+    at->i = 0;
+    autotune_plant_reset(&at->plant);
+    at->phase = AUTOTUNE_PHASE_FIT;
+}
+
+static void autotune_settle_tick(autotune_t *at) {
+    if (at->i == AUTOTUNE_MAX_TICKS) {
+        at->res.ticks += at->i;
+        autotune_fail(at, "no steady state in the step test");
+        return;
+    }
+    at->y = autotune_plant_step(&at->plant, at->u);
+    at->i++;
+    if (at->i == at->next_check) {
+        /* Compare over 5 % of the elapsed time so the test scales with the plant. */
+        at->calm = (fabs(at->y - at->y_check) <= AUTOTUNE_SETTLE_TOL * fabs(at->y)) ? at->calm + 1 : 0;
+        at->y_check = at->y;
+        uint32_t interval = at->i / 20;
+        at->next_check = at->i + (interval > at->min_interval ? interval : at->min_interval);
+    }
+    if (at->calm >= AUTOTUNE_SETTLE_CHECKS) autotune_settle_end(at);
+}
+
+/**
+ * Start with the open-loop step from rest. The first run finds the steady
+ * state (static gain), the second the crossing times of the fit.
+ */
+void autotune_start(autotune_t *at, const sim_config_t *cfg, const autotune_request_t *req) {
+    memset(at, 0, sizeof(*at));
+    at->req = *req;
+    at->setpoint = cfg->use_master_setpoint ? cfg->master_setpoint : cfg->setpoint;
+    autotune_plant_t *p = &at->plant;
+    if (!autotune_plant_init(p, cfg)) {
+        at->res.error = "actuator disabled";
+        at->phase = AUTOTUNE_PHASE_DONE;
+        return;
+    }
+    if (p->delay.limited) {
+        /* Gains for a shorter dead time than configured would be wrong without a sign. */
+        autotune_fail(at, "dead time exceeds the delay storage");
+        return;
+    }
+
+    float u_step = req->step_size;
+    if (u_step == 0.0f) u_step = 0.5f * (p->act_max > 0.0f ? p->act_max : p->act_min);
+    at->u = autotune_clamp(p, u_step);
+    if (at->u == 0.0f) {
+        autotune_fail(at, "actuator limits allow no step");
+        return;
+    }
+    at->min_interval = (uint32_t)ceil(1.0 / p->dt); // checks at least 1 s apart
+    at->next_check = at->min_interval;
+    at->phase = AUTOTUNE_PHASE_SETTLE;
+}
+
+/** Run up to max_ticks of the experiments; non-zero once finished. */
+int autotune_advance(autotune_t *at, uint32_t max_ticks) {
+    uint64_t start_us = time_us_64();
+    for (uint32_t n = 0; n < max_ticks && at->phase != AUTOTUNE_PHASE_DONE; n++) {
+        switch (at->phase) {
+        case AUTOTUNE_PHASE_SETTLE:
+            autotune_settle_tick(at);
+            break;
+        case AUTOTUNE_PHASE_FIT:
+            autotune_fit_tick(at);
+            break;
+        default:
+            autotune_relay_tick(at);
+            break;
+        }
+    }
+    at->res.elapsed_us += (uint32_t)(time_us_64() - start_us);
+    return at->phase == AUTOTUNE_PHASE_DONE;
+}
+
+/** Identify the configured plant offline and derive PID gains. */
+int autotune_run(const sim_config_t *cfg, const autotune_request_t *req, autotune_result_t *out) {
+    static autotune_t at;
+    autotune_start(&at, cfg, req);
+    while (!autotune_advance(&at, AUTOTUNE_MAX_TICKS)) {
+    }
+    *out = at.res;
+    return out->ok;
+}
@@ -0,0 +1,116 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "sim_loop.h"
+#include "sim_state.h"
+
+#define AUTOTUNE_MAX_TICKS 60000 // per experiment
+#define AUTOTUNE_RELAY_SKIP 2 // relay periods left out while the oscillation builds up
+#define AUTOTUNE_RELAY_PERIODS 4 // relay periods averaged for Ku and Pu
+
+typedef enum {
+    AUTOTUNE_RELAY = 0, // relay feedback (Astrom-Hagglund): ultimate gain and period
+    AUTOTUNE_STEP = 1 // open-loop step: first order plus dead time fit
+} autotune_method_t;
+
+typedef enum {
+    AUTOTUNE_RULE_ZN = 0, // Ziegler-Nichols (closed-loop for relay, reaction curve for step)
+    AUTOTUNE_RULE_TYREUS_LUYBEN = 1, // relay only
+    AUTOTUNE_RULE_COHEN_COON = 2, // step only
+    AUTOTUNE_RULE_SIMC = 3 // step only; Skogestad PI with tau_c = L
+} autotune_rule_t;
+
+typedef struct {
+    autotune_method_t method;
+    autotune_rule_t rule;
+    int pi_only; // flag: derive kd = 0
+    float relay_amplitude; // relay step d around the bias; 0 = 20 % of the actuator span
+    float hysteresis; // relay switching band on the error; 0 = 0.5 % of the setpoint
+    float step_size; // open-loop input step; 0 = half the actuator limit
+} autotune_request_t;
+
+typedef struct {
+    int ok; // flag: gains were derived
+    const char *error; // reason when ok is 0
+    float k; // static gain (step test; relay runs use it for the bias)
+    float t; // time constant of the first order plus dead time fit
+    float l; // dead time of the fit
+    float ku; // ultimate gain (relay)
+    float pu; // ultimate period in seconds (relay)
+    float amplitude; // output oscillation amplitude (relay)
+    pid_params_t pid; // derived gains in the sim_loop PID form
+    uint32_t ticks; // simulated ticks over all experiments
+    uint32_t elapsed_us; // time spent running the experiments
+} autotune_result_t;
+
+/* Open-loop pipeline without the PID: actuator limits -> dead time -> plant. */
+typedef struct {
+    plant_ss_t ss;
+    plant_work_t work;
+    float x[PLANT_MAX_ORDER];
+    delay_line_t delay;
+    int dead_ms;
+    int dt_us;
+    float act_min;
+    float act_max;
+    double dt;
+} autotune_plant_t;
+
+typedef enum {
+    AUTOTUNE_PHASE_SETTLE = 0, // step test, first run: wait for the steady state
+    AUTOTUNE_PHASE_FIT = 1, // step test, second run: 28.3 % and 63.2 % crossings
+    AUTOTUNE_PHASE_RELAY = 2,
+    AUTOTUNE_PHASE_DONE = 3
+} autotune_phase_t;
+
+/* One identification in progress; advanced in slices by autotune_advance(). */
+typedef struct {
+    autotune_plant_t plant;
+    autotune_request_t req;
+    autotune_result_t res;
+    autotune_phase_t phase;
+    float setpoint; // active setpoint of cfg, the relay test runs around it
+    float u; // step size, then the relay bias
+    float d; // relay amplitude
+    float eps; // relay hysteresis
+    float r; // relay setpoint
+    uint32_t i; // ticks into the current experiment
+    uint32_t min_interval; // settle: fewest ticks between steady-state checks
+    uint32_t next_check;
+    int calm; // settle: consecutive steady checks
+    int high; // relay: input above the bias
+    int rises;
+    double y;
+    double y_check; // settle: y at the last check
+    double y_ss; // fit: steady-state output of the first run
+    double t28;
+    double t63;
+    double prev; // fit: progress of the previous tick
+    double y_min; // relay: output range once the oscillation built up
+    double y_max;
+    double rise_t[AUTOTUNE_RELAY_SKIP + AUTOTUNE_RELAY_PERIODS + 1];
+} autotune_t;
+
+/** Fill req with the defaults (relay, Ziegler-Nichols PID). */
+void autotune_default_request(autotune_request_t *req);
+
+/**
+ * Start identifying the plant of cfg as autotune_run() does; the
+ * experiments then run in slices of autotune_advance().
+ */
+void autotune_start(autotune_t *at, const sim_config_t *cfg, const autotune_request_t *req);
+
+/**
+ * Run up to max_ticks of the experiments. Returns non-zero once the result
+ * is in at->res; the pooled dead-time storage is returned then.
+ */
+int autotune_advance(autotune_t *at, uint32_t max_ticks);
+
+/**
+ * Identify the plant of cfg in accelerated simulation (plant, dead time and
+ * actuator limits of cfg, started at rest at the time step of cfg) and
+ * derive PID gains with req->rule. The live loop is not touched; apply the
+ * result with sim_state_set_pid(). Returns out->ok.
+ */
+int autotune_run(const sim_config_t *cfg, const autotune_request_t *req, autotune_result_t *out);
@@ -0,0 +1,62 @@
+# Turn the web UI sources into gzip-compressed const arrays for flash.
+#
+# Usage: cmake -DASSET_DIR=<ui dir> -DOUTPUT=<web_assets.c> -P embed_web_assets.cmake
+#
+# Each source is first joined into a single line (newlines and leading
+# indentation removed), so use only /* */ comments in the JS. The ETag is
+# derived from the joined content, so it only changes when the UI does.
+
+cmake_minimum_required(VERSION 3.19)
+
+# file | URL path | content type | C symbol
+set(WEB_ASSETS
+        "index.html|/|text/html|index_html"
+        "app.js|/app.js|application/javascript|app_js"
+)
+
+get_filename_component(OUT_DIR ${OUTPUT} DIRECTORY)
+set(WORK_DIR ${OUT_DIR}/web_assets)
+file(MAKE_DIRECTORY ${WORK_DIR})
+
+set(ARRAYS "")
+set(TABLE "")
+set(COUNT 0)
+
+foreach(ASSET IN LISTS WEB_ASSETS)
+    string(REPLACE "|" ";" FIELDS "${ASSET}")
+    list(GET FIELDS 0 FILE_NAME)
+    list(GET FIELDS 1 URL_PATH)
+    list(GET FIELDS 2 CONTENT_TYPE)
+    list(GET FIELDS 3 SYMBOL)
+
+    file(READ ${ASSET_DIR}/${FILE_NAME} CONTENT)
+    string(REGEX REPLACE "\r?\n[ \t]*" "" CONTENT "${CONTENT}")
+    string(SHA1 HASH "${CONTENT}")
+    string(SUBSTRING ${HASH} 0 16 ETAG)
+
+    set(JOINED ${WORK_DIR}/${FILE_NAME})
+    file(WRITE ${JOINED} "${CONTENT}")
+    file(REMOVE ${JOINED}.gz)
+    file(ARCHIVE_CREATE OUTPUT ${JOINED}.gz PATHS ${JOINED}
+         FORMAT raw COMPRESSION GZip COMPRESSION_LEVEL 9)
+
+    file(READ ${JOINED}.gz HEX HEX)
+    string(LENGTH "${HEX}" HEX_LEN)
+    math(EXPR GZ_LEN "${HEX_LEN} / 2")
+    string(REGEX REPLACE "([0-9a-f][0-9a-f])" "0x\\1," BYTES "${HEX}")
+    string(REGEX REPLACE "((0x[0-9a-f][0-9a-f],){16})" "\\1\n    " BYTES "${BYTES}")
+
+    string(APPEND ARRAYS "/* ${FILE_NAME}: ${GZ_LEN} bytes gzip */\n")
+    string(APPEND ARRAYS "static const uint8_t k_${SYMBOL}_gz[] = {\n    ${BYTES}\n};\n\n")
+    string(APPEND TABLE "    {\"${URL_PATH}\", \"${CONTENT_TYPE}\", \"\\\"${ETAG}\\\"\", k_${SYMBOL}_gz, sizeof(k_${SYMBOL}_gz)},\n")
+    math(EXPR COUNT "${COUNT} + 1")
+endforeach()
+
+file(WRITE ${OUTPUT}.tmp
+"/* Generated by cmake/embed_web_assets.cmake from ui/ - do not edit. */\n\n"
+"#include \"web_assets.h\"\n\n"
+"${ARRAYS}"
+"const web_asset_t g_web_assets[] = {\n${TABLE}};\n\n"
+"const size_t g_web_asset_count = ${COUNT};\n")
+file(COPY_FILE ${OUTPUT}.tmp ${OUTPUT} ONLY_IF_DIFFERENT)
+file(REMOVE ${OUTPUT}.tmp)
@@ -0,0 +1,267 @@
+#include <stddef.h>
+#include <string.h>
+
+#include "hardware/flash.h"
+#include "pico/flash.h"
+#include "pico/time.h"
+
+#include "config_store.h"
+#include "debug.h"
+
+#define CONFIG_STORE_MAGIC 0x47464350u // "PCFG"
+#define CONFIG_STORE_VERSION 1 // bump whenever the layout of sim_config_t changes
+#define CONFIG_STORE_BYTES (CONFIG_STORE_SECTORS * FLASH_SECTOR_SIZE)
+#define CONFIG_STORE_OFFSET (PICO_FLASH_SIZE_BYTES - CONFIG_STORE_BYTES)
+#define CONFIG_SLOTS_PER_SECTOR ((int)(FLASH_SECTOR_SIZE / FLASH_PAGE_SIZE))
+#define CONFIG_SLOTS (CONFIG_STORE_SECTORS * CONFIG_SLOTS_PER_SECTOR)
+#define CONFIG_FLASH_TIMEOUT_MS 100 // wait for core1 to park before giving up on a write
+
+/* One record per flash page; an erased page reads as all 0xFF. */
+typedef struct {
+    uint32_t magic;
+    uint32_t seq; // higher is newer, never 0
+    uint16_t version;
+    uint16_t size; // sizeof(sim_config_t) when written
+    uint32_t crc; // CRC-32 of seq, version, size and cfg
+    sim_config_t cfg; // running and master_setpoint are always stored as 0
+} config_record_t;
+
+_Static_assert(sizeof(config_record_t) <= FLASH_PAGE_SIZE, "a config record must fit one flash page");
+_Static_assert(CONFIG_STORE_SECTORS >= 2, "the newest record must survive the next sector erase");
+
+/*
+ * Log-structured store: records are appended slot by slot through the
+ * reserved sectors and wrap around, so every sector is erased once per
+ * lap. A sector is erased just before its first slot is written, always
+ * a different sector than the one holding the newest record, so a reset
+ * mid-write leaves that record intact.
+ */
+typedef struct {
+    config_store_stats_t stats;
+    int next_slot; // slot the next record goes to
+    uint32_t seen_seq; // g_sim.cfg_seq when the config was last compared
+    sim_config_t saved; // configuration of the newest record, or the boot defaults
+    sim_config_t pending; // changed configuration waiting to settle
+    int dirty; // pending differs from saved
+    uint32_t changed_ms; // time of the last change to pending
+    uint32_t written_ms; // time of the last write attempt
+} config_store_t;
+
+typedef struct {
+    uint32_t offset; // flash offset of the target page
+    int erase; // erase its sector first
+    const uint8_t *page;
+} config_flash_op_t;
+
+static config_store_t g_store;
+
+/** Milliseconds since boot. */
+static uint32_t config_now_ms(void) {
+    return (uint32_t)(time_us_64() / 1000u);
+}
+
+/** CRC-32 (IEEE 802.3, reflected) of len bytes, continuing from crc (0 to start). */
+static uint32_t config_crc32(uint32_t crc, const void *data, size_t len) {
+    static const uint32_t table[16] = {
+        0x00000000u, 0x1DB71064u, 0x3B6E20C8u, 0x26D930ACu, 0x76DC4190u, 0x6B6B51F4u, 0x4DB26158u, 0x5005713Cu,
+        0xEDB88320u, 0xF00F9344u, 0xD6D6A3E8u, 0xCB61B38Cu, 0x9B64C2B0u, 0x86D3D2D4u, 0xA00AE278u, 0xBDBDF21Cu,
+    };
+    const uint8_t *p = data;
+    crc = ~crc;
+    while (len--) {
+        crc = table[(crc ^ *p) & 0x0Fu] ^ (crc >> 4);
+        crc = table[(crc ^ (*p >> 4)) & 0x0Fu] ^ (crc >> 4);
+        p++;
+    }
+    return ~crc;
+}
+
+/** CRC of a record, excluding the magic and the crc field itself. */
+static uint32_t config_record_crc(const config_record_t *rec) {
+    uint32_t crc = config_crc32(0, &rec->seq, offsetof(config_record_t, crc) - offsetof(config_record_t, seq));
+    return config_crc32(crc, &rec->cfg, sizeof(rec->cfg));
+}
+
+/** Flash offset of a slot. */
+static uint32_t config_slot_offset(int slot) {
+    return CONFIG_STORE_OFFSET + (uint32_t)slot * FLASH_PAGE_SIZE;
+}
+
+/** Memory-mapped (XIP) view of a slot. */
+static const config_record_t *config_slot(int slot) {
+    return (const config_record_t *)(XIP_BASE + config_slot_offset(slot));
+}
+
+/** Header checks only; cheap enough for every slot at boot. */
+static int config_header_valid(const config_record_t *rec) {
+    return rec->magic == CONFIG_STORE_MAGIC && rec->seq != 0 && rec->seq != 0xFFFFFFFFu &&
+           rec->version == CONFIG_STORE_VERSION && rec->size == sizeof(sim_config_t);
+}
+
+/** Reject configurations core1 could not run, should a record pass the CRC anyway. */
+static int config_sane(const sim_config_t *cfg) {
+    return cfg->dt_us >= SIM_DT_MIN_US && cfg->dt_us <= SIM_DT_MAX_US &&
+           (unsigned)cfg->plant.model <= PLANT_TRANSFER_FUNCTION && cfg->plant.tf_order >= 1 &&
+           cfg->plant.tf_order <= PLANT_MAX_ORDER && (unsigned)cfg->numeric <= SIM_NUMERIC_FIXED;
+}
+
+/** Return non-zero if every byte of a slot is erased. */
+static int config_slot_erased(int slot) {
+    const uint8_t *p = (const uint8_t *)config_slot(slot);
+    for (size_t i = 0; i < sizeof(config_record_t); i++) {
+        if (p[i] != 0xFFu) return 0;
+    }
+    return 1;
+}
+
+/** Erase and program with core1 parked and interrupts masked (flash is not readable meanwhile). */
+static void config_flash_op(void *param) {
+    const config_flash_op_t *op = param;
+    if (op->erase) flash_range_erase(op->offset & ~(FLASH_SECTOR_SIZE - 1u), FLASH_SECTOR_SIZE);
+    flash_range_program(op->offset, op->page, FLASH_PAGE_SIZE);
+}
+
+/** Append cfg as the newest record; returns 1 if it reads back intact. */
+static int config_store_write(const sim_config_t *cfg) {
+    static uint8_t page[FLASH_PAGE_SIZE];
+    config_record_t rec;
+    memset(&rec, 0, sizeof(rec));
+    rec.magic = CONFIG_STORE_MAGIC;
+    rec.seq = g_store.stats.seq + 1u;
+    rec.version = CONFIG_STORE_VERSION;
+    rec.size = sizeof(sim_config_t);
+    rec.cfg = *cfg;
+    rec.crc = config_record_crc(&rec);
+    memset(page, 0xFF, sizeof(page));
+    memcpy(page, &rec, sizeof(rec));
+
+    /* A slot that is not blank (torn write, foreign data) skips to the next sector. */
+    int slot = g_store.next_slot;
+    int erase = slot % CONFIG_SLOTS_PER_SECTOR == 0;
+    if (!erase && !config_slot_erased(slot)) {
+        slot = (slot / CONFIG_SLOTS_PER_SECTOR + 1) * CONFIG_SLOTS_PER_SECTOR % CONFIG_SLOTS;
+        erase = 1;
+    }
+
+    config_flash_op_t op = {config_slot_offset(slot), erase, page};
+    uint64_t t0 = time_us_64();
+    int rc = flash_safe_execute(config_flash_op, &op, CONFIG_FLASH_TIMEOUT_MS);
+    g_store.stats.write_us = (uint32_t)(time_us_64() - t0);
+    if (rc != PICO_OK) {
+        g_store.stats.failures++;
+        LOGW("CFG flash write failed (%d)\n", rc);
+        return 0;
+    }
+    if (erase) g_store.stats.erases++;
+    g_store.next_slot = (slot + 1) % CONFIG_SLOTS;
+    g_store.stats.seq = rec.seq; // consumed even if the record turns out bad
+
+    if (memcmp(config_slot(slot), &rec, sizeof(rec)) != 0) {
+        g_store.stats.failures++;
+        LOGW("CFG record %u did not verify in slot %d\n", (unsigned)rec.seq, slot);
+        return 0;
+    }
+    g_store.stats.writes++;
+    DLOGI("CFG saved record %u to slot %d in %u us\n", (unsigned)rec.seq, slot, (unsigned)g_store.stats.write_us);
+    return 1;
+}
+
+/** Load the newest intact record into g_sim.cfg (before core1 starts). */
+int config_store_restore(void) {
+    uint64_t t0 = time_us_64();
+    sim_config_t cfg = sim_state_get_config();
+    int newest = -1;
+    int restored = -1;
+
+    /* Only the newest plausible record is CRC-checked; older ones are fallbacks for a torn write. */
+    uint32_t below = 0xFFFFFFFFu;
+    for (;;) {
+        int best = -1;
+        for (int slot = 0; slot < CONFIG_SLOTS; slot++) {
+            const config_record_t *rec = config_slot(slot);
+            if (!config_header_valid(rec) || rec->seq >= below) continue;
+            if (best < 0 || rec->seq > config_slot(best)->seq) best = slot;
+        }
+        if (best < 0) break;
+        if (newest < 0) newest = best;
+        const config_record_t *rec = config_slot(best);
+        if (rec->crc == config_record_crc(rec) && config_sane(&rec->cfg)) {
+            restored = best;
+            break;
+        }
+        below = rec->seq;
+    }
+
+    memset(&g_store, 0, sizeof(g_store));
+    if (newest >= 0) {
+        /* Keep numbering past every record, even a corrupt one, so no seq is ever reused. */
+        g_store.stats.seq = config_slot(newest)->seq;
+        g_store.next_slot = (newest + 1) % CONFIG_SLOTS;
+    }
+    if (restored >= 0) {
+        int running = cfg.running;
+        float master_setpoint = cfg.master_setpoint;
+        cfg = config_slot(restored)->cfg;
+        cfg.running = running;
+        cfg.master_setpoint = master_setpoint;
+        sim_state_config_begin();
+        g_sim.cfg = cfg;
+        sim_state_config_end();
+    }
+    g_store.saved = cfg;
+    g_store.saved.running = 0;
+    g_store.saved.master_setpoint = 0.0f;
+    g_store.pending = g_store.saved;
+    g_store.seen_seq = g_sim.cfg_seq;
+    g_store.stats.restored = restored >= 0 ? config_slot(restored)->seq : 0;
+    g_store.stats.restore_us = (uint32_t)(time_us_64() - t0);
+    return restored >= 0;
+}
+
+/** Fold a configuration change into the pending record. */
+static void config_store_track(uint32_t now_ms) {
+    uint32_t seq = g_sim.cfg_seq;
+    if (seq != g_store.seen_seq && !(seq & 1u)) {
+        g_store.seen_seq = seq;
+        sim_config_t cfg = sim_state_get_config();
+        cfg.running = 0; // run/stop is an operator action, not a setting worth a flash write
+        cfg.master_setpoint = 0.0f; // an external master may drive it at loop rate
+        if (memcmp(&cfg, &g_store.pending, sizeof(cfg)) != 0) {
+            if (g_store.dirty) g_store.stats.coalesced++;
+            g_store.pending = cfg;
+            g_store.changed_ms = now_ms;
+        }
+        g_store.dirty = memcmp(&cfg, &g_store.saved, sizeof(cfg)) != 0;
+    }
+}
+
+/** Write the pending configuration; it stays pending if the write fails. */
+static int config_store_commit(uint32_t now_ms) {
+    g_store.written_ms = now_ms ? now_ms : 1u;
+    if (!config_store_write(&g_store.pending)) return 0;
+    g_store.saved = g_store.pending;
+    g_store.dirty = 0;
+    return 1;
+}
+
+/** Track config changes and write the settled configuration, rate limited (core0). */
+void config_store_poll(void) {
+    uint32_t now_ms = config_now_ms();
+    config_store_track(now_ms);
+    if (!g_store.dirty || now_ms - g_store.changed_ms < CONFIG_STORE_SETTLE_MS) return;
+    if (g_store.written_ms != 0 && now_ms - g_store.written_ms < CONFIG_STORE_MIN_INTERVAL_MS) return;
+
+    config_store_commit(now_ms);
+}
+
+/** Write an unsaved change now, ignoring the settle time and rate limit. */
+int config_store_flush(void) {
+    uint32_t now_ms = config_now_ms();
+    config_store_track(now_ms);
+    return g_store.dirty ? config_store_commit(now_ms) : 1;
+}
+
+/** Read the store counters. */
+config_store_stats_t config_store_get_stats(void) {
+    return g_store.stats;
+}
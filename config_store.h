@@ -0,0 +1,48 @@
+#pragma once
+
+/*
+ * Persistence of sim_config_t across reboots in a reserved flash region.
+ * A write parks core1 for a page program (about 1 ms) and, once per 16
+ * records, a sector erase (tens of ms), so writes are coalesced and rate
+ * limited.
+ */
+
+#include <stdint.h>
+
+#include "sim_state.h"
+
+#define CONFIG_STORE_SECTORS 4 // 4 KB flash sectors reserved at the end of flash for the config log
+#define CONFIG_STORE_SETTLE_MS 2000 // a change is written once the config was unchanged this long
+#define CONFIG_STORE_MIN_INTERVAL_MS 30000 // shortest time between two flash writes
+
+typedef struct {
+    uint32_t seq; // sequence number of the newest record, 0 if none
+    uint32_t writes; // records written since boot
+    uint32_t erases; // sectors erased since boot
+    uint32_t coalesced; // config changes folded into a later write
+    uint32_t failures; // writes that did not read back intact
+    uint32_t restore_us; // boot time spent in config_store_restore()
+    uint32_t write_us; // duration of the last write, erase included
+    uint32_t restored; // sequence number of the record restored at boot, 0 if the defaults were kept
+} config_store_stats_t;
+
+/**
+ * Load the newest intact record into g_sim.cfg. Call after sim_state_init()
+ * and before core1 starts; returns 1 if a record was restored.
+ */
+int config_store_restore(void);
+
+/**
+ * Append the configuration to the log once it changed and settled, at most
+ * every CONFIG_STORE_MIN_INTERVAL_MS (core0 main loop).
+ */
+void config_store_poll(void);
+
+/**
+ * Write an unsaved change now, ignoring the settle time and rate limit
+ * (e.g. before a planned reset). Returns 0 if the write failed.
+ */
+int config_store_flush(void);
+
+/** Read the store counters. */
+config_store_stats_t config_store_get_stats(void);
@@ -2,6 +2,8 @@
 
 #include <stdio.h>
 
+#include "log_ring.h"
+
 // Debug levels: 0=off, 1=error, 2=warn, 3=info, 4=debug
 // #define DEBUG_LEVEL 4
 
@@ -12,7 +14,14 @@
 #define LOGE(...) do { if (DEBUG_LEVEL >= 1) printf(__VA_ARGS__); } while (0)
 #define LOGW(...) do { if (DEBUG_LEVEL >= 2) printf(__VA_ARGS__); } while (0)
 #define LOGI(...) do { if (DEBUG_LEVEL >= 3) printf(__VA_ARGS__); } while (0)
-#define LOGD(...) do { if (DEBUG_LEVEL >= 4) printf(__VA_ARGS__); } while (0)
+
+// Deferred variants for hot paths (core1 ticks, lwIP callbacks): the format
+// string and raw arguments go to a per-core ring, and core0 prints them from
+// its main loop via log_ring_drain(). At most LOG_MAX_ARGS arguments.
+// Debug output only comes from such paths, so LOGD is always deferred.
+#define DLOGW(...) do { if (DEBUG_LEVEL >= 2) LOG_RING(__VA_ARGS__); } while (0)
+#define DLOGI(...) do { if (DEBUG_LEVEL >= 3) LOG_RING(__VA_ARGS__); } while (0)
+#define LOGD(...) do { if (DEBUG_LEVEL >= 4) LOG_RING(__VA_ARGS__); } while (0)
 
 #define ERRF(...) LOGE(__VA_ARGS__)
 #define LOGF(...) LOGI(__VA_ARGS__)
@@ -0,0 +1,218 @@
+#include <string.h>
+
+#include "pico/sync.h"
+
+#include "debug.h"
+#include "delay_line.h"
+
+static delay_sample_t g_delay_pool[DELAY_POOL_BLOCKS][DELAY_BLOCK];
+static uint64_t g_delay_pool_free = (DELAY_POOL_BLOCKS < 64) ? (1ull << DELAY_POOL_BLOCKS) - 1u : ~0ull; // bit b: pool block b is free
+static int g_delay_pool_used;
+static int g_delay_pool_live; // pool blocks held by live lines, out of DELAY_POOL_RESERVE
+static critical_section_t g_delay_pool_lock; // lines on both cores share the pool
+
+_Static_assert(DELAY_POOL_BLOCKS <= 64, "pool bitmap is 64 bits");
+_Static_assert(DELAY_POOL_BLOCKS >= DELAY_POOL_RESERVE, "pool must hold the live reserve");
+
+/** Initialize the pool lock (before core1 starts). */
+void delay_pool_init(void) {
+    critical_section_init(&g_delay_pool_lock);
+}
+
+/** Pool blocks in use. */
+int delay_pool_used(void) {
+    return g_delay_pool_used;
+}
+
+/** Sample at ring position i. */
+static inline delay_sample_t *delay_at(delay_line_t *d, int i) {
+    int b = i >> DELAY_BLOCK_SHIFT;
+    return b ? &g_delay_pool[d->block[b]][i & (DELAY_BLOCK - 1)] : &d->head[i];
+}
+
+static void delay_reverse(delay_line_t *d, int lo, int hi) {
+    for (; lo < hi; lo++, hi--) {
+        delay_sample_t *a = delay_at(d, lo);
+        delay_sample_t *b = delay_at(d, hi);
+        delay_sample_t t = *a;
+        *a = *b;
+        *b = t;
+    }
+}
+
+/** Return pool blocks of d until it holds keep blocks (pool lock held). */
+static void delay_pool_return(delay_line_t *d, int keep) {
+    while (d->blocks > keep) {
+        g_delay_pool_free |= 1ull << d->block[--d->blocks];
+        g_delay_pool_used--;
+        if (d->live) g_delay_pool_live--;
+    }
+}
+
+/**
+ * Change the line to want blocks (fewer if the pool runs dry). The ring is
+ * first rotated so the oldest sample sits at position 0; growing keeps all
+ * of it and pads the older end with the oldest sample, shrinking keeps the
+ * newest samples.
+ */
+static void delay_line_resize(delay_line_t *d, int want) {
+    int cap = d->blocks * DELAY_BLOCK;
+    if (d->idx > 0) {
+        delay_reverse(d, 0, d->idx - 1);
+        delay_reverse(d, d->idx, cap - 1);
+        delay_reverse(d, 0, cap - 1);
+    }
+
+    if (want > d->blocks) {
+        critical_section_enter_blocking(&g_delay_pool_lock);
+        /* Offline lines leave the part of the reserve the live lines have not taken yet. */
+        int reserve = DELAY_POOL_RESERVE - g_delay_pool_live;
+        int avail = DELAY_POOL_BLOCKS - g_delay_pool_used - ((d->live || reserve < 0) ? 0 : reserve);
+        for (int b = 0; b < DELAY_POOL_BLOCKS && d->blocks < want && avail > 0; b++) {
+            if (g_delay_pool_free & (1ull << b)) {
+                g_delay_pool_free &= ~(1ull << b);
+                g_delay_pool_used++;
+                if (d->live) g_delay_pool_live++;
+                avail--;
+                d->block[d->blocks++] = (uint8_t)b;
+            }
+        }
+        critical_section_exit(&g_delay_pool_lock);
+
+        int new_cap = d->blocks * DELAY_BLOCK;
+        delay_sample_t oldest = *delay_at(d, 0);
+        for (int i = cap; i < new_cap; i++) {
+            *delay_at(d, i) = oldest;
+        }
+        d->idx = (new_cap > cap) ? cap : 0;
+    } else if (want < d->blocks) {
+        int new_cap = want * DELAY_BLOCK;
+        for (int i = 0; i < new_cap; i++) {
+            *delay_at(d, i) = *delay_at(d, cap - new_cap + i);
+        }
+        critical_section_enter_blocking(&g_delay_pool_lock);
+        delay_pool_return(d, want);
+        critical_section_exit(&g_delay_pool_lock);
+        d->idx = 0;
+    } else {
+        d->idx = 0;
+    }
+}
+
+/** Clear the line and return its pool blocks; the live flag is kept. */
+void delay_line_reset(delay_line_t *d) {
+    if (d->blocks > 1) {
+        critical_section_enter_blocking(&g_delay_pool_lock);
+        delay_pool_return(d, 1);
+        critical_section_exit(&g_delay_pool_lock);
+    }
+    memset(d->head, 0, sizeof(d->head));
+    d->blocks = 1;
+    d->idx = 0;
+    d->len = 0;
+    d->frac = 0.0f;
+    d->frac_q = 0;
+    d->dead_ms = -1;
+    d->dt_us = 0;
+    d->limited = 0;
+}
+
+/** Set the delay, resizing the line when it changed; returns the whole ticks. */
+int delay_line_set(delay_line_t *d, int dead_ms, int dt_us) {
+    if (dead_ms == d->dead_ms && dt_us == d->dt_us) return d->len;
+
+    int delay_us = (dead_ms > 0) ? dead_ms * 1000 : 0;
+    int len = delay_us / dt_us;
+    int rem = delay_us % dt_us;
+    int samples = len + (rem ? 2 : 1); // write position plus the oldest tap
+    int want = (samples + DELAY_BLOCK - 1) / DELAY_BLOCK;
+    if (want > DELAY_MAX_BLOCKS) want = DELAY_MAX_BLOCKS;
+    if (want != d->blocks) delay_line_resize(d, want);
+
+    int cap = d->blocks * DELAY_BLOCK;
+    d->limited = samples > cap;
+    if (d->limited) {
+        len = cap - 1;
+        rem = 0;
+        DLOGW("Dead time %d ms limited to %d us (delay storage full)\n", dead_ms, len * dt_us);
+    }
+    d->len = len;
+    d->frac = (float)rem / (float)dt_us;
+    d->frac_q = fix_from_float(d->frac);
+    d->dead_ms = dead_ms;
+    d->dt_us = dt_us;
+    return len;
+}
+
+/** Delay the line applies, in milliseconds. */
+float delay_line_dead_ms(const delay_line_t *d) {
+    return ((float)d->len + d->frac) * (float)d->dt_us / 1000.0f;
+}
+
+/** Longest dead time a line of DELAY_MAX_BLOCKS holds at a dt_us time step, in milliseconds. */
+float delay_line_max_ms(int dt_us) {
+    return (float)(DELAY_MAX_BLOCKS * DELAY_BLOCK - 1) * (float)dt_us / 1000.0f;
+}
+
+/** Return the pool blocks; the next set resizes again. */
+void delay_line_release(delay_line_t *d) {
+    if (d->blocks > 1) delay_line_resize(d, 1);
+    d->dead_ms = -1;
+}
+
+/** Read position of the whole-tick tap, after the write at d->idx. */
+static inline int delay_tap(const delay_line_t *d, int cap) {
+    int r = d->idx - d->len;
+    return (r < 0) ? r + cap : r;
+}
+
+/** Push this tick's input and read the delayed, interpolated value. */
+float delay_line_step(delay_line_t *d, float u) {
+    int cap = d->blocks * DELAY_BLOCK;
+    delay_at(d, d->idx)->f = u;
+    int r = delay_tap(d, cap);
+    float y = delay_at(d, r)->f;
+    if (d->frac > 0.0f) {
+        float older = delay_at(d, r ? r - 1 : cap - 1)->f;
+        y += d->frac * (older - y);
+    }
+    d->idx = (d->idx + 1 == cap) ? 0 : d->idx + 1;
+    return y;
+}
+
+/** delay_line_step() on fixed-point samples. */
+fix_t delay_line_step_fix(delay_line_t *d, fix_t u) {
+    int cap = d->blocks * DELAY_BLOCK;
+    delay_at(d, d->idx)->q = u;
+    int r = delay_tap(d, cap);
+    fix_t y = delay_at(d, r)->q;
+    if (d->frac_q) {
+        int64_t diff = (int64_t)delay_at(d, r ? r - 1 : cap - 1)->q - y;
+        y = fix_sat(y + ((diff * d->frac_q) >> FIX_FRAC_BITS));
+    }
+    d->idx = (d->idx + 1 == cap) ? 0 : d->idx + 1;
+    return y;
+}
+
+/** Convert the stored samples for the fixed-point backend. */
+void delay_line_to_fix(delay_line_t *d) {
+    int cap = d->blocks * DELAY_BLOCK;
+    for (int i = 0; i < cap; i++) {
+        delay_sample_t *s = delay_at(d, i);
+        s->q = fix_from_float(s->f);
+    }
+}
+
+/** Convert the stored samples for the float backend. */
+void delay_line_to_float(delay_line_t *d) {
+    int cap = d->blocks * DELAY_BLOCK;
+    for (int i = 0; i < cap; i++) {
+        delay_sample_t *s = delay_at(d, i);
+        s->f = fix_to_float(s->q);
+    }
+}
+
+/** RAM the line uses, its pool blocks included. */
+size_t delay_line_bytes(const delay_line_t *d) {
+    return sizeof(*d) + (size_t)(d->blocks - 1) * DELAY_BLOCK * sizeof(delay_sample_t);
+}
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "fixed.h"
+
+#define DELAY_BLOCK_SHIFT 8
+#define DELAY_BLOCK (1 << DELAY_BLOCK_SHIFT) // samples per block; the first block is embedded in the line
+#define DELAY_MAX_DEAD_MS 2560 // longest dead time (the SIM_PARAM_DEAD limit)
+#define DELAY_MAX_BLOCKS ((DELAY_MAX_DEAD_MS + 2 + DELAY_BLOCK - 1) / DELAY_BLOCK) // at dt = 1 ms; shorter steps hold delay_line_max_ms()
+#define DELAY_POOL_RESERVE (DELAY_MAX_BLOCKS - 1) // pool blocks only live lines may take
+#define DELAY_POOL_OFFLINE 4 // offline lines at once: two sweep workers, the HTTP job, replay
+#ifndef DELAY_POOL_BLOCKS
+#define DELAY_POOL_BLOCKS ((1 + DELAY_POOL_OFFLINE) * DELAY_POOL_RESERVE) // shared blocks for lines longer than DELAY_BLOCK
+#endif
+
+/* One stored actuator value; the backend that owns the line decides the view. */
+typedef union {
+    float f;
+    fix_t q;
+} delay_sample_t;
+
+/*
+ * Dead-time ring buffer with a fractional delay. Storage beyond the embedded
+ * block comes from a static pool when the delay changes, never per tick.
+ * The delay dead_ms / dt_us ticks is split into whole ticks and a fraction
+ * that is linearly interpolated between two taps.
+ */
+typedef struct {
+    delay_sample_t head[DELAY_BLOCK];
+    uint8_t block[DELAY_MAX_BLOCKS]; // pool index of block b (b >= 1)
+    int blocks; // blocks held, including the embedded one
+    int idx; // next write position
+    int len; // whole ticks of delay
+    float frac; // fraction of a tick, 0 <= frac < 1
+    fix_t frac_q; // frac for the fixed-point backend
+    int dead_ms; // delay the line is sized for, -1 to resize on the next set
+    int dt_us; // time step the line is sized for
+    int live; // flag: may take the pool blocks reserved for the live loop
+    int limited; // flag: the storage held is shorter than dead_ms, the delay is cut
+} delay_line_t;
+
+/** Initialize the pool lock (before core1 starts). */
+void delay_pool_init(void);
+
+/** Pool blocks in use. */
+int delay_pool_used(void);
+
+/** Clear the line and return its pool blocks; the live flag is kept. */
+void delay_line_reset(delay_line_t *d);
+
+/**
+ * Set the delay to dead_ms at a dt_us time step, resizing the line if the
+ * delay changed. History is kept across a resize. If the pool runs out, or
+ * the delay needs more than DELAY_MAX_BLOCKS, the delay is limited to the
+ * storage held and d->limited is set. Returns the whole ticks of delay.
+ */
+int delay_line_set(delay_line_t *d, int dead_ms, int dt_us);
+
+/** Delay the line applies, in milliseconds; below dead_ms if it is limited. */
+float delay_line_dead_ms(const delay_line_t *d);
+
+/** Longest dead time, in milliseconds, a line of DELAY_MAX_BLOCKS holds at a dt_us time step. */
+float delay_line_max_ms(int dt_us);
+
+/** Return the pool blocks (history is truncated); the next set resizes again. */
+void delay_line_release(delay_line_t *d);
+
+/** Push this tick's input and read the delayed, interpolated value. */
+float delay_line_step(delay_line_t *d, float u);
+
+/** delay_line_step() on fixed-point samples. */
+fix_t delay_line_step_fix(delay_line_t *d, fix_t u);
+
+/** Convert the stored samples for the other backend. */
+void delay_line_to_fix(delay_line_t *d);
+void delay_line_to_float(delay_line_t *d);
+
+/** RAM the line uses, its pool blocks included. */
+size_t delay_line_bytes(const delay_line_t *d);
@@ -0,0 +1,42 @@
+#include <math.h>
+
+#include "fixed.h"
+
+#define FIX_COEF_BITS 30
+#define FIX_COEF_MAX_SHIFT 62
+
+/** Convert with rounding; out-of-range values saturate. */
+fix_t fix_from_float(float f) {
+    float s = f * (float)FIX_ONE;
+    if (s >= 2147483647.0f) return FIX_MAX;
+    if (s <= -2147483648.0f) return FIX_MIN;
+    return (fix_t)(s + (s >= 0.0f ? 0.5f : -0.5f));
+}
+
+/** Convert an accumulator back to float (state hand-over between backends). */
+float fix_acc_to_float(fix_acc_t a) {
+    return (float)((double)a / (double)((int64_t)FIX_ONE << FIX_ACC_EXTRA_BITS));
+}
+
+/** Convert a float accumulator value, saturating. */
+fix_acc_t fix_acc_from_float(float f) {
+    double s = (double)f * (double)((int64_t)FIX_ONE << FIX_ACC_EXTRA_BITS);
+    if (s >= (double)FIX_ACC_MAX) return FIX_ACC_MAX;
+    if (s <= (double)FIX_ACC_MIN) return FIX_ACC_MIN;
+    return (fix_acc_t)llround(s);
+}
+
+/** Block-scale a coefficient, keeping 30 significant bits. */
+fix_coef_t fix_coef_from_float(float c) {
+    fix_coef_t k = {0, 0};
+    if (c == 0.0f || !isfinite(c)) return k;
+
+    int e;
+    float f = frexpf(c, &e); // c = f * 2^e, 0.5 <= |f| < 1
+    int shift = FIX_COEF_BITS - e;
+    if (shift > FIX_COEF_MAX_SHIFT) return k; // below the smallest representable step
+    if (shift < -FIX_COEF_BITS) shift = -FIX_COEF_BITS; // saturates in fix_coef_mul_acc
+    k.m = (int32_t)lroundf(ldexpf(f, FIX_COEF_BITS));
+    k.shift = shift;
+    return k;
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <stdint.h>
+
+/*
+ * Fixed-point arithmetic for the integer simulation backend (the RP2040 has
+ * no FPU). Values are signed Q(31-FIX_FRAC_BITS).FIX_FRAC_BITS; state that
+ * integrates small increments is kept as a 64-bit accumulator with
+ * FIX_ACC_EXTRA_BITS more fraction bits, so per-tick rounding does not build
+ * up a dead band. Coefficients are block scaled (m * 2^-shift) because their
+ * magnitudes span 1e-5 (wn^2 * dt) to 1e4 (kd / dt). Every operation
+ * saturates instead of wrapping. Right shifts of negative values rely on the
+ * compiler's arithmetic shift (GCC on ARM and x86).
+ */
+
+#ifndef FIX_FRAC_BITS
+#define FIX_FRAC_BITS 16
+#endif
+#define FIX_ACC_EXTRA_BITS 16
+
+typedef int32_t fix_t; // Q(31-FIX_FRAC_BITS).FIX_FRAC_BITS value
+typedef int64_t fix_acc_t; // fix_t with FIX_ACC_EXTRA_BITS more fraction bits
+
+typedef struct {
+    int32_t m; // mantissa, |m| < 2^31
+    int shift; // value = m * 2^-shift
+} fix_coef_t;
+
+#define FIX_ONE ((fix_t)1 << FIX_FRAC_BITS)
+#define FIX_MAX INT32_MAX
+#define FIX_MIN INT32_MIN
+#define FIX_ACC_MAX ((fix_acc_t)FIX_MAX << FIX_ACC_EXTRA_BITS)
+#define FIX_ACC_MIN ((fix_acc_t)FIX_MIN * ((fix_acc_t)1 << FIX_ACC_EXTRA_BITS))
+
+/** Clamp a 64-bit intermediate into the fix_t range. */
+static inline fix_t fix_sat(int64_t v) {
+    if (v > FIX_MAX) return FIX_MAX;
+    if (v < FIX_MIN) return FIX_MIN;
+    return (fix_t)v;
+}
+
+static inline fix_t fix_add(fix_t a, fix_t b) {
+    return fix_sat((int64_t)a + b);
+}
+
+static inline fix_t fix_sub(fix_t a, fix_t b) {
+    return fix_sat((int64_t)a - b);
+}
+
+static inline fix_t fix_clamp(fix_t v, fix_t lo, fix_t hi) {
+    if (v < lo) return lo;
+    if (v > hi) return hi;
+    return v;
+}
+
+/** Clamp an accumulator to the range that still converts to fix_t. */
+static inline fix_acc_t fix_acc_sat(fix_acc_t a) {
+    if (a > FIX_ACC_MAX) return FIX_ACC_MAX;
+    if (a < FIX_ACC_MIN) return FIX_ACC_MIN;
+    return a;
+}
+
+/** Add two saturated accumulators (their sum cannot overflow int64). */
+static inline fix_acc_t fix_acc_add(fix_acc_t a, fix_acc_t b) {
+    return fix_acc_sat(a + b);
+}
+
+static inline fix_acc_t fix_to_acc(fix_t x) {
+    return (fix_acc_t)x * ((fix_acc_t)1 << FIX_ACC_EXTRA_BITS);
+}
+
+/** Round an accumulator to fix_t. */
+static inline fix_t fix_from_acc(fix_acc_t a) {
+    return fix_sat((a + ((fix_acc_t)1 << (FIX_ACC_EXTRA_BITS - 1))) >> FIX_ACC_EXTRA_BITS);
+}
+
+/** x * c with the accumulator's precision, saturated. */
+static inline fix_acc_t fix_coef_mul_acc(fix_t x, fix_coef_t c) {
+    int64_t p = (int64_t)x * c.m; // |p| < 2^62
+    int s = c.shift - FIX_ACC_EXTRA_BITS;
+    if (s >= 0) {
+        return fix_acc_sat(p >> s);
+    }
+    if (p > (FIX_ACC_MAX >> -s)) return FIX_ACC_MAX;
+    if (p < (FIX_ACC_MIN >> -s)) return FIX_ACC_MIN;
+    return p * ((int64_t)1 << -s);
+}
+
+/** x * c rounded to fix_t, saturated. */
+static inline fix_t fix_coef_mul(fix_t x, fix_coef_t c) {
+    return fix_from_acc(fix_coef_mul_acc(x, c));
+}
+
+static inline float fix_to_float(fix_t x) {
+    return (float)x * (1.0f / (float)FIX_ONE);
+}
+
+/** Convert with rounding; out-of-range values saturate. */
+fix_t fix_from_float(float f);
+
+/** Convert an accumulator back to float (state hand-over between backends). */
+float fix_acc_to_float(fix_acc_t a);
+
+/** Convert a float accumulator value, saturating. */
+fix_acc_t fix_acc_from_float(float f);
+
+/** Block-scale a coefficient, keeping 30 significant bits. */
+fix_coef_t fix_coef_from_float(float c);
@@ -0,0 +1,131 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "pico/time.h"
+
+#include "sim_batch.h"
+#include "delay_line.h"
+#include "sim_loop.h"
+#include "sim_state.h"
+
+#define BENCH_DEFAULT_TICKS 200000L
+#define BENCH_ROUNDS 3
+#define TICK_BUDGET_NS 1000000.0 // 1 ms tick
+
+/** Instance i of the benchmark fleet: mixed models, gains and dead times. */
+static sim_batch_config_t fleet_config(int i) {
+    sim_batch_config_t c = sim_batch_get_config(i);
+    c.enabled = 1;
+    c.setpoint = 50.0f + (float)(i % 5) * 10.0f;
+    c.pid.kp = 1.0f + 0.1f * (float)(i % 7);
+    c.pid.ki = 0.2f + 0.05f * (float)(i % 3);
+    c.pid.kd = 0.05f;
+    c.model = (i & 1) ? PLANT_SECOND_ORDER : PLANT_FIRST_ORDER;
+    c.method = (i & 2) ? PLANT_METHOD_ZOH : PLANT_METHOD_EULER;
+    c.dead_time_ms = (i % 4) * 20;
+    return c;
+}
+
+/** sim_config_t equivalent of fleet_config(i) for the single-loop engine. */
+static sim_config_t loop_config(const sim_config_t *base, int i) {
+    sim_batch_config_t c = fleet_config(i);
+    sim_config_t cfg = *base;
+    cfg.setpoint = c.setpoint;
+    cfg.pid = c.pid;
+    cfg.plant.model = c.model;
+    cfg.plant.method = c.method;
+    cfg.plant.dead_time_ms = c.dead_time_ms;
+    return cfg;
+}
+
+/** sim_batch_step() with n enabled instances; best ns/tick. */
+static double bench_batch(const sim_config_t *cfg, int n, long ticks, float *checksum) {
+    static sim_batch_t batch;
+    for (int i = 0; i < SIM_BATCH_MAX; i++) {
+        sim_batch_config_t c = fleet_config(i);
+        c.enabled = i < n;
+        sim_batch_set_config(i, &c);
+    }
+
+    double best_ns = 0.0;
+    for (int round = 0; round < BENCH_ROUNDS; round++) {
+        sim_batch_reset(&batch);
+        sim_batch_step(&batch, cfg); // picks up the configuration outside the timed loop
+
+        uint64_t t0 = time_us_64();
+        for (long t = 0; t < ticks; t++) {
+            sim_batch_step(&batch, cfg);
+        }
+        uint64_t t1 = time_us_64();
+
+        for (int i = 0; i < n; i++) {
+            *checksum += batch.x0[i];
+        }
+        double ns = (double)(t1 - t0) * 1000.0 / (double)ticks;
+        if (round == 0 || ns < best_ns) best_ns = ns;
+    }
+    return best_ns;
+}
+
+/** n separate sim_loop_t pipelines stepped one after another; best ns/tick. */
+static double bench_loops(const sim_config_t *base, int n, long ticks, float *checksum) {
+    static sim_loop_t loops[SIM_BATCH_MAX];
+    static sim_config_t cfgs[SIM_BATCH_MAX];
+    static sim_runtime_t rts[SIM_BATCH_MAX];
+
+    double best_ns = 0.0;
+    for (int round = 0; round < BENCH_ROUNDS; round++) {
+        for (int i = 0; i < n; i++) {
+            cfgs[i] = loop_config(base, i);
+            rts[i] = g_sim.rt;
+            sim_loop_reset(&loops[i], &cfgs[i]);
+            sim_loop_step(&loops[i], &cfgs[i], &rts[i]);
+        }
+
+        uint64_t t0 = time_us_64();
+        for (long t = 0; t < ticks; t++) {
+            for (int i = 0; i < n; i++) {
+                sim_loop_step(&loops[i], &cfgs[i], &rts[i]);
+            }
+        }
+        uint64_t t1 = time_us_64();
+
+        for (int i = 0; i < n; i++) {
+            *checksum += rts[i].output;
+        }
+        double ns = (double)(t1 - t0) * 1000.0 / (double)ticks;
+        if (round == 0 || ns < best_ns) best_ns = ns;
+    }
+    return best_ns;
+}
+
+int main(int argc, char **argv) {
+    long ticks = (argc > 1) ? atol(argv[1]) : BENCH_DEFAULT_TICKS;
+    if (ticks <= 0) ticks = BENCH_DEFAULT_TICKS;
+
+    sim_state_init();
+    delay_pool_init();
+    sim_batch_init();
+    sim_config_t cfg = g_sim.cfg;
+    cfg.dt_us = 1000;
+    cfg.running = 1;
+    cfg.numeric = SIM_NUMERIC_FLOAT;
+
+    float checksum = 0.0f;
+    printf("%ld ticks x %d rounds, dt_us=1000 (best round), SIM_BATCH_MAX=%d\n", ticks, BENCH_ROUNDS,
+           SIM_BATCH_MAX);
+    printf("loops  batch ns/tick  ns/loop   sim_loop ns/tick  ns/loop\n");
+    double batch_per_loop = 0.0;
+    for (int n = 1; n <= SIM_BATCH_MAX; n *= 2) {
+        double batch_ns = bench_batch(&cfg, n, ticks, &checksum);
+        double loops_ns = bench_loops(&cfg, n, ticks, &checksum);
+        printf("%5d  %13.1f  %7.2f   %16.1f  %7.2f\n", n, batch_ns, batch_ns / n, loops_ns, loops_ns / n);
+        batch_per_loop = batch_ns / n;
+    }
+
+    /* The tick also runs the main loop, telemetry and the publish; this is the kernel alone. */
+    printf("\nloops per 1 ms tick at %.2f ns/loop: %.0f (kernel only; the firmware reports step_us in /api/batch)\n",
+           batch_per_loop, TICK_BUDGET_NS / batch_per_loop);
+    printf("checksum %.3f\n", checksum);
+    return 0;
+}
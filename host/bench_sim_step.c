@@ -0,0 +1,675 @@
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hardware/flash.h"
+#include "pico/time.h"
+
+#include "autotune.h"
+#include "config_store.h"
+#include "delay_line.h"
+#include "log_ring.h"
+#include "pid.h"
+#include "plant.h"
+#include "profile.h"
+#include "sim_loop.h"
+#include "sim_record.h"
+#include "sim_run.h"
+#include "sim_state.h"
+#include "sweep.h"
+
+#define BENCH_DEFAULT_TICKS 5000000L
+#define BENCH_ROUNDS 3
+#define ERROR_RUN_S 120
+#define DISC_RUN_S 10
+
+static const struct {
+    plant_model_t model;
+    const char *name;
+} k_models[] = {
+    {PLANT_FIRST_ORDER, "PLANT_FIRST_ORDER"},
+    {PLANT_SECOND_ORDER, "PLANT_SECOND_ORDER"},
+};
+
+/* sim_loop_step() also runs the default transfer function, 2 / (2s + 1)^3. */
+static const struct {
+    plant_model_t model;
+    const char *name;
+} k_loop_models[] = {
+    {PLANT_FIRST_ORDER, "PLANT_FIRST_ORDER"},
+    {PLANT_SECOND_ORDER, "PLANT_SECOND_ORDER"},
+    {PLANT_TRANSFER_FUNCTION, "PLANT_TF (n=3)"},
+};
+
+static const struct {
+    sim_numeric_t numeric;
+    const char *name;
+} k_backends[] = {
+    {SIM_NUMERIC_FLOAT, "float"},
+    {SIM_NUMERIC_FIXED, "fixed"},
+};
+
+#define COUNT(a) (sizeof(a) / sizeof((a)[0]))
+
+/** Run the live-loop pipeline for the given model and backend and return the best ns/tick. */
+static double bench_model(plant_model_t model, sim_numeric_t numeric, long ticks, float *checksum) {
+    static sim_loop_t loop;
+    double best_ns = 0.0;
+
+    for (int round = 0; round < BENCH_ROUNDS; round++) {
+        sim_config_t cfg = g_sim.cfg;
+        cfg.plant.model = model;
+        cfg.numeric = numeric;
+        cfg.dt_us = 1000;
+        cfg.running = 1;
+        sim_runtime_t rt = g_sim.rt;
+        sim_loop_reset(&loop, &cfg);
+
+        uint64_t t0 = time_us_64();
+        for (long i = 0; i < ticks; i++) {
+            sim_loop_step(&loop, &cfg, &rt);
+        }
+        uint64_t t1 = time_us_64();
+
+        *checksum += rt.output;
+        double ns = (double)(t1 - t0) * 1000.0 / (double)ticks;
+        if (round == 0 || ns < best_ns) best_ns = ns;
+    }
+    return best_ns;
+}
+
+typedef enum {
+    KERNEL_FLOAT_DIRECT = 0, // plant_*_step(): Euler, coefficients derived every call
+    KERNEL_FLOAT_CACHED = 1, // plant_ss_step() with precomputed coefficients
+    KERNEL_FIXED = 2 // fixed-point PID and discrete plant
+} kernel_t;
+
+static const char *const k_kernel_names[] = {"float direct", "float cached", "fixed cached"};
+
+/** pid_step() + plant step alone, without the loop plumbing; best ns/tick. */
+static double bench_kernel(plant_model_t model, kernel_t kernel, long ticks, float *checksum) {
+    const sim_config_t *cfg = &g_sim.cfg;
+    const float dt = 0.001f;
+    first_order_params_t p1 = {cfg->plant.gain, cfg->plant.tau};
+    second_order_params_t p2 = {cfg->plant.wn, cfg->plant.zeta, cfg->plant.gain};
+    plant_ss_t d;
+    if (model == PLANT_FIRST_ORDER) {
+        plant_first_order_discretize(&d, &p1, dt, PLANT_METHOD_EULER);
+    } else {
+        plant_second_order_discretize(&d, &p2, dt, PLANT_METHOD_EULER);
+    }
+    double best_ns = 0.0;
+
+    for (int round = 0; round < BENCH_ROUNDS; round++) {
+        uint64_t t0 = time_us_64();
+        if (kernel != KERNEL_FIXED) {
+            pid_t pid;
+            pid_init(&pid, cfg->pid.kp, cfg->pid.ki, cfg->pid.kd, -100.0f, 100.0f);
+            second_order_state_t s = {0.0f, 0.0f};
+            float x[PLANT_MAX_ORDER] = {0};
+            float y = 0.0f;
+            for (long i = 0; i < ticks; i++) {
+                float u = pid_step(&pid, cfg->setpoint - y, dt);
+                if (kernel == KERNEL_FLOAT_DIRECT) {
+                    y = (model == PLANT_FIRST_ORDER) ? plant_first_order_step(y, u, &p1, dt)
+                                                     : plant_second_order_step(&s, u, &p2, dt);
+                } else {
+                    y = plant_ss_step(&d, x, u);
+                }
+            }
+            *checksum += y;
+        } else {
+            pid_fix_t pid;
+            pid_fix_init(&pid, cfg->pid.kp, cfg->pid.ki, cfg->pid.kd, dt, -100.0f, 100.0f);
+            static plant_ss_fix_t f;
+            plant_ss_fix_init(&f, &d);
+            fix_acc_t x[PLANT_MAX_ORDER] = {0};
+            fix_t setpoint = fix_from_float(cfg->setpoint);
+            fix_t y = 0;
+            for (long i = 0; i < ticks; i++) {
+                fix_t u = pid_fix_step(&pid, fix_sub(setpoint, y));
+                y = plant_ss_step_fix(&f, x, u);
+            }
+            *checksum += fix_to_float(y);
+        }
+        uint64_t t1 = time_us_64();
+
+        double ns = (double)(t1 - t0) * 1000.0 / (double)ticks;
+        if (round == 0 || ns < best_ns) best_ns = ns;
+    }
+    return best_ns;
+}
+
+typedef struct {
+    double integrator, prev_error, x1, x2, y;
+} ref_state_t;
+
+/** Double-precision PID + Euler plant, the reference for both backends. */
+static double ref_step(ref_state_t *r, const sim_config_t *cfg, plant_model_t model, double dt) {
+    double e = cfg->setpoint - r->y;
+    r->integrator += e * dt;
+    double u = cfg->pid.kp * e + cfg->pid.ki * r->integrator + cfg->pid.kd * (e - r->prev_error) / dt;
+    r->prev_error = e;
+    if (u > cfg->act_max) u = cfg->act_max;
+    if (u < cfg->act_min) u = cfg->act_min;
+    if (model == PLANT_FIRST_ORDER) {
+        r->y += (-r->y + cfg->plant.gain * u) / cfg->plant.tau * dt;
+    } else {
+        double wn = cfg->plant.wn, zeta = cfg->plant.zeta;
+        double dx2 = cfg->plant.gain * wn * wn * u - 2.0 * zeta * wn * r->x2 - wn * wn * r->x1;
+        r->x1 += r->x2 * dt;
+        r->x2 += dx2 * dt;
+        r->y = r->x1;
+    }
+    return r->y;
+}
+
+/** Closed-loop step response (Euler plant) on the float and fixed backends against the double reference. */
+static void compare_error(plant_model_t model, const char *name, int dt_ms) {
+    const sim_config_t *cfg = &g_sim.cfg;
+    const float dt = dt_ms / 1000.0f;
+    first_order_params_t p1 = {cfg->plant.gain, cfg->plant.tau};
+    second_order_params_t p2 = {cfg->plant.wn, cfg->plant.zeta, cfg->plant.gain};
+
+    pid_t pid;
+    pid_init(&pid, cfg->pid.kp, cfg->pid.ki, cfg->pid.kd, cfg->act_min, cfg->act_max);
+    second_order_state_t s = {0.0f, 0.0f};
+    float y = 0.0f;
+
+    pid_fix_t pid_x;
+    pid_fix_init(&pid_x, cfg->pid.kp, cfg->pid.ki, cfg->pid.kd, dt, cfg->act_min, cfg->act_max);
+    plant_ss_t d;
+    if (model == PLANT_FIRST_ORDER) {
+        plant_first_order_discretize(&d, &p1, dt, PLANT_METHOD_EULER);
+    } else {
+        plant_second_order_discretize(&d, &p2, dt, PLANT_METHOD_EULER);
+    }
+    static plant_ss_fix_t f;
+    plant_ss_fix_init(&f, &d);
+    fix_acc_t x_x[PLANT_MAX_ORDER] = {0};
+    fix_t y_x = 0;
+    fix_t setpoint_x = fix_from_float(cfg->setpoint);
+
+    ref_state_t ref = {0};
+    long ticks = ERROR_RUN_S * 1000L / dt_ms;
+    double max_f = 0.0, max_x = 0.0, sq_f = 0.0, sq_x = 0.0;
+    for (long i = 0; i < ticks; i++) {
+        double yr = ref_step(&ref, cfg, model, dt);
+
+        float u = pid_step(&pid, cfg->setpoint - y, dt);
+        y = (model == PLANT_FIRST_ORDER) ? plant_first_order_step(y, u, &p1, dt)
+                                         : plant_second_order_step(&s, u, &p2, dt);
+
+        fix_t u_x = pid_fix_step(&pid_x, fix_sub(setpoint_x, y_x));
+        y_x = plant_ss_step_fix(&f, x_x, u_x);
+
+        double ef = fabs((double)y - yr);
+        double ex = fabs((double)fix_to_float(y_x) - yr);
+        if (ef > max_f) max_f = ef;
+        if (ex > max_x) max_x = ex;
+        sq_f += ef * ef;
+        sq_x += ex * ex;
+    }
+    printf("%-20s %5d %12.3g %12.3g %12.3g %12.3g\n", name, dt_ms,
+           max_f, sqrt(sq_f / (double)ticks), max_x, sqrt(sq_x / (double)ticks));
+}
+
+/** Unit-step response of the continuous plant at time t. */
+static double exact_step(plant_model_t model, const first_order_params_t *p1,
+                         const second_order_params_t *p2, double t) {
+    if (model == PLANT_FIRST_ORDER) {
+        return p1->gain * (1.0 - exp(-t / p1->tau));
+    }
+    double wn = p2->wn, z = p2->zeta;
+    double wd = wn * sqrt(1.0 - z * z); // underdamped test plant
+    return p2->gain * (1.0 - exp(-z * wn * t) * (cos(wd * t) + z / sqrt(1.0 - z * z) * sin(wd * t)));
+}
+
+/**
+ * Open-loop unit step: worst deviation from the continuous response at the
+ * sample instants. PLANT_TRANSFER_FUNCTION runs the second-order test plant
+ * through the generic transfer-function path.
+ */
+static void compare_discretization(plant_model_t model, const char *name, plant_method_t method, int dt_ms) {
+    static plant_work_t work;
+    first_order_params_t p1 = {2.0f, 0.5f};
+    second_order_params_t p2 = {5.0f, 0.3f, 2.0f};
+    float dt = dt_ms / 1000.0f;
+    plant_ss_t d;
+    if (model == PLANT_FIRST_ORDER) {
+        plant_first_order_discretize(&d, &p1, dt, method);
+    } else if (model == PLANT_SECOND_ORDER) {
+        plant_second_order_discretize(&d, &p2, dt, method);
+    } else {
+        float wn2 = p2.wn * p2.wn;
+        float num[3] = {0.0f, 0.0f, p2.gain * wn2};
+        float den[3] = {1.0f, 2.0f * p2.zeta * p2.wn, wn2};
+        plant_tf_discretize(&d, num, den, 2, dt, method, &work);
+        model = PLANT_SECOND_ORDER;
+    }
+
+    float x[PLANT_MAX_ORDER] = {0};
+    float y = 0.0f;
+    double max_err = 0.0;
+    long ticks = DISC_RUN_S * 1000L / dt_ms;
+    for (long i = 1; i <= ticks; i++) {
+        y = plant_ss_step(&d, x, 1.0f);
+        double err = fabs((double)y - exact_step(model, &p1, &p2, (double)i * dt));
+        if (!(err <= max_err)) max_err = err; // also catches NaN from a diverged run
+    }
+    printf("%-20s %-6s %6d %12.3g\n", name, method == PLANT_METHOD_ZOH ? "zoh" : "euler", dt_ms, max_err);
+}
+
+/** plant_ss_step() alone for an n-state transfer function 1 / (s + 1)^n; best ns/tick. */
+static double bench_order(int n, long ticks, float *checksum) {
+    static plant_work_t work;
+    float num[PLANT_MAX_ORDER + 1] = {0};
+    float den[PLANT_MAX_ORDER + 1] = {0};
+    num[n] = 1.0f;
+    /* binomial coefficients of (s + 1)^n */
+    den[0] = 1.0f;
+    for (int k = 1; k <= n; k++) {
+        for (int i = k; i > 0; i--) den[i] += den[i - 1];
+    }
+    plant_ss_t ss;
+    plant_tf_discretize(&ss, num, den, n, 0.001f, PLANT_METHOD_ZOH, &work);
+
+    double best_ns = 0.0;
+    for (int round = 0; round < BENCH_ROUNDS; round++) {
+        float x[PLANT_MAX_ORDER] = {0};
+        float y = 0.0f;
+        uint64_t t0 = time_us_64();
+        for (long i = 0; i < ticks; i++) {
+            y = plant_ss_step(&ss, x, (i & 1024) ? 1.0f : 0.0f);
+        }
+        uint64_t t1 = time_us_64();
+        *checksum += y;
+        double ns = (double)(t1 - t0) * 1000.0 / (double)ticks;
+        if (round == 0 || ns < best_ns) best_ns = ns;
+    }
+    return best_ns;
+}
+
+/* Dead times for the delay-line rows: whole ticks, pool-backed and fractional. */
+static const struct {
+    int dead_ms;
+    int dt_us;
+} k_delays[] = {
+    {0, 1000}, {255, 1000}, {2560, 1000}, {2555, 10000}, {37, 10000}, {500, 250}, {37, 250},
+};
+
+/**
+ * delay_line_step() alone; best ns/tick. The input is a 0.5 Hz sine, so the
+ * error against the exact delayed sine shows the interpolation error.
+ */
+static double bench_delay(int dead_ms, int dt_us, long ticks, size_t *bytes, double *max_err, float *checksum) {
+    static delay_line_t line;
+    const double w = 2.0 * 3.14159265358979 * 0.5;
+    const double dt = dt_us / 1e6;
+    double best_ns = 0.0;
+    for (int round = 0; round < BENCH_ROUNDS; round++) {
+        delay_line_reset(&line);
+        delay_line_set(&line, dead_ms, dt_us);
+        float y = 0.0f;
+        uint64_t t0 = time_us_64();
+        for (long i = 0; i < ticks; i++) {
+            y = delay_line_step(&line, (float)sin(w * i * dt));
+        }
+        uint64_t t1 = time_us_64();
+        *checksum += y;
+        double ns = (double)(t1 - t0) * 1000.0 / (double)ticks;
+        if (round == 0 || ns < best_ns) best_ns = ns;
+    }
+
+    *max_err = 0.0;
+    delay_line_reset(&line);
+    delay_line_set(&line, dead_ms, dt_us);
+    long skip = dead_ms * 1000L / dt_us + 2;
+    for (long i = 0; i < skip + 4000; i++) {
+        double y = delay_line_step(&line, (float)sin(w * i * dt));
+        double err = fabs(y - sin(w * (i * dt - dead_ms / 1000.0)));
+        if (i >= skip && err > *max_err) *max_err = err;
+    }
+    *bytes = delay_line_bytes(&line);
+    delay_line_reset(&line);
+    return best_ns;
+}
+
+/**
+ * Cost of the per-tick debug line: recording it in the log ring (the
+ * logging core) and formatting it later with log_ring_pop() (core0 idle
+ * time), against formatting it in place with snprintf(). best ns/call.
+ */
+static void bench_log(long calls, float *checksum) {
+    static char line[128];
+    sim_runtime_t rt = g_sim.rt;
+    double ring_ns = 0.0, pop_ns = 0.0, fmt_ns = 0.0;
+    for (int round = 0; round < BENCH_ROUNDS; round++) {
+        uint64_t write_us = 0, pop_us = 0;
+        for (long i = 0; i < calls; i += LOG_RING_SIZE) {
+            uint64_t t0 = time_us_64();
+            for (int k = 0; k < LOG_RING_SIZE; k++) {
+                rt.output += 0.001f;
+                LOG_RING("SIM step: sp=%.2f u=%.3f u1=%.3f y=%.2f\n", rt.setpoint, rt.control, rt.actuator, rt.output);
+            }
+            uint64_t t1 = time_us_64();
+            while (log_ring_pop(line, sizeof(line))) *checksum += (float)line[20];
+            pop_us += time_us_64() - t1;
+            write_us += t1 - t0;
+        }
+        double ns = (double)write_us * 1000.0 / (double)calls;
+        if (round == 0 || ns < ring_ns) ring_ns = ns;
+        ns = (double)pop_us * 1000.0 / (double)calls;
+        if (round == 0 || ns < pop_ns) pop_ns = ns;
+
+        uint64_t t0 = time_us_64();
+        for (long i = 0; i < calls; i++) {
+            rt.output += 0.001f;
+            snprintf(line, sizeof(line), "SIM step: sp=%.2f u=%.3f u1=%.3f y=%.2f\n", rt.setpoint, rt.control,
+                     rt.actuator, rt.output);
+            *checksum += (float)line[20];
+        }
+        ns = (double)(time_us_64() - t0) * 1000.0 / (double)calls;
+        if (round == 0 || ns < fmt_ns) fmt_ns = ns;
+    }
+    printf("log_ring_write %8.2f ns/call   log_ring_pop %8.2f ns/call   snprintf %8.2f ns/call   dropped %u\n",
+           ring_ns, pop_ns, fmt_ns, (unsigned)log_ring_dropped());
+}
+
+/** Mean cost of config_store_restore() in us. */
+static double bench_restore(int calls) {
+    uint64_t t0 = time_us_64();
+    for (int i = 0; i < calls; i++) config_store_restore();
+    return (double)(time_us_64() - t0) / (double)calls;
+}
+
+/**
+ * Boot restore of the flash config store against the number of records
+ * written since the flash was blank, and the fallback to the previous
+ * record when the newest one is torn.
+ */
+static void bench_config_store(int calls) {
+    static const int k_saves[] = {0, 1, 16, 64, 200};
+    const uint32_t base = PICO_FLASH_SIZE_BYTES - CONFIG_STORE_SECTORS * FLASH_SECTOR_SIZE;
+    const int slots = CONFIG_STORE_SECTORS * (int)(FLASH_SECTOR_SIZE / FLASH_PAGE_SIZE);
+    memset(host_flash + base, 0, CONFIG_STORE_SECTORS * FLASH_SECTOR_SIZE); // never erased
+    config_store_restore();
+
+    printf("%8s %8s %8s %10s %12s\n", "saves", "erases", "failures", "restored", "restore us");
+    int saved = 0;
+    uint32_t erases = 0, failures = 0;
+    for (size_t i = 0; i < COUNT(k_saves); i++) {
+        for (; saved < k_saves[i]; saved++) {
+            sim_state_set_setpoint(100.0f + (float)saved);
+            config_store_flush();
+        }
+        config_store_stats_t before = config_store_get_stats();
+        erases += before.erases;
+        failures += before.failures;
+        double us = bench_restore(calls);
+        printf("%8d %8u %8u %10u %12.3f\n", saved, (unsigned)erases, (unsigned)failures,
+               (unsigned)config_store_get_stats().restored, us);
+    }
+
+    /* Clear bits in the newest record's payload, as an interrupted program would. */
+    static const uint8_t zero[1] = {0};
+    flash_range_program(base + (uint32_t)((saved - 1) % slots) * FLASH_PAGE_SIZE + 32u, zero, sizeof(zero));
+    double us = bench_restore(calls);
+    config_store_stats_t st = config_store_get_stats();
+    printf("torn newest record: restored %u (setpoint %.0f), next seq %u, %.3f us\n", (unsigned)st.restored,
+           (double)g_sim.cfg.setpoint, (unsigned)st.seq + 1u, us);
+}
+
+/**
+ * profile_tick() cost per segment kind over ticks ticks at dt_us=1000, and
+ * the largest deviation of a 0.5 Hz sine from the double-precision value.
+ */
+static void bench_profile(long ticks, float *checksum) {
+    sim_config_t cfg = g_sim.cfg;
+    cfg.running = 1;
+    cfg.dt_us = 1000;
+    const double duration_s = (double)ticks * 1e-3 + 1.0;
+    for (int kind = PROFILE_HOLD; kind <= PROFILE_PRBS; kind++) {
+        profile_t p = {.count = 1};
+        p.seg[0] = (profile_segment_t){(profile_kind_t)kind, (float)duration_s, 50.0f, 10.0f, 0.5f};
+        if (kind == PROFILE_STAIRS) p.seg[0].b = 0.5f;
+        if (kind == PROFILE_PRBS) p.seg[0].c = 0.05f;
+        profile_init();
+        profile_load(&p);
+        double max_err = 0.0;
+        float sp = 0.0f;
+        uint64_t t0 = time_us_64();
+        for (long i = 0; i < ticks; i++) {
+            profile_tick(&cfg, 0, &sp);
+            *checksum += sp;
+        }
+        double ns = (double)(time_us_64() - t0) * 1000.0 / (double)ticks;
+        if (kind == PROFILE_SINE) {
+            profile_init();
+            profile_load(&p);
+            for (long i = 0; i < ticks; i++) {
+                profile_tick(&cfg, 0, &sp);
+                double ref = 50.0 + 10.0 * sin(2.0 * 3.14159265358979 * 0.5 * (double)i * 1e-3);
+                if (fabs(sp - ref) > max_err) max_err = fabs(sp - ref);
+            }
+        }
+        printf("%-8s %8.2f ns/tick", profile_kind_name((profile_kind_t)kind), ns);
+        if (kind == PROFILE_SINE) printf("   max |err| %.2e over %.0f s", max_err, (double)ticks * 1e-3);
+        printf("\n");
+    }
+    profile_init();
+
+    /* The naive alternative: sinf() of a float phase accumulated tick by tick. */
+    volatile float phase = 0.0f;
+    uint64_t t0 = time_us_64();
+    for (long i = 0; i < ticks; i++) {
+        *checksum += 50.0f + 10.0f * sinf(phase);
+        phase += (float)(2.0 * 3.14159265358979 * 0.5e-3);
+    }
+    double ns = (double)(time_us_64() - t0) * 1000.0 / (double)ticks;
+    double max_err = 0.0;
+    phase = 0.0f;
+    for (long i = 0; i < ticks; i++) {
+        double ref = 50.0 + 10.0 * sin(2.0 * 3.14159265358979 * 0.5 * (double)i * 1e-3);
+        double err = fabs(50.0f + 10.0f * sinf(phase) - ref);
+        if (err > max_err) max_err = err;
+        phase += (float)(2.0 * 3.14159265358979 * 0.5e-3);
+    }
+    printf("%-8s %8.2f ns/tick   max |err| %.2e (sinf of an accumulated phase, for comparison)\n", "sinf", ns,
+           max_err);
+}
+
+/** One core1 tick with the recorder hooks, as in sim_worker.c. */
+static void record_tick(sim_loop_t *loop, const sim_config_t *cfg, sim_runtime_t *rt, int reset) {
+    if (reset) sim_loop_reset(loop, cfg);
+    sim_record_tick_begin(loop, cfg, rt, reset);
+    sim_loop_step(loop, cfg, rt);
+    sim_record_tick_end(rt);
+}
+
+/**
+ * Record a session with setpoint and gain changes and a reset on a second
+ * order plant with dead time, then replay it in 1 ms slices as core1 would
+ * in its idle time and check that it reproduces bit for bit.
+ */
+static void bench_record(long ticks) {
+    static sim_loop_t loop;
+    sim_config_t cfg = g_sim.cfg;
+    cfg.running = 1;
+    cfg.plant.model = PLANT_SECOND_ORDER;
+    cfg.plant.dead_time_ms = 200;
+    sim_runtime_t rt = g_sim.rt;
+    sim_loop_reset(&loop, &cfg);
+    sim_record_init();
+    sim_record_start(SIM_RECORD_DEFAULT_EVERY);
+
+    uint64_t t0 = time_us_64();
+    for (long i = 0; i < ticks; i++) {
+        if (i % 1000 == 500) cfg.setpoint += 5.0f;
+        if (i % 3000 == 1500) cfg.pid.kp *= 1.1f;
+        record_tick(&loop, &cfg, &rt, i == ticks / 2);
+    }
+    sim_record_stop();
+    record_tick(&loop, &cfg, &rt, 0);
+    double record_us = (double)(time_us_64() - t0);
+    sim_loop_release(&loop);
+
+    sim_record_status_t st;
+    sim_record_get_status(&st);
+    printf("recorded %u ticks, %u/%u entries, %u bytes%s, %.2f ns/tick with the hooks\n", (unsigned)st.ticks,
+           (unsigned)st.entries, (unsigned)st.capacity, (unsigned)st.bytes, st.full ? " (full)" : "",
+           record_us * 1000.0 / (double)(ticks + 1));
+
+    sim_replay_start();
+    while (sim_replay_work(time_us_64() + 1000)) {
+    }
+    sim_record_get_status(&st);
+    printf("replay %s after %u ticks in %.3f ms (%.0f ticks/s)", st.replay == SIM_REPLAY_MATCH ? "match" : "MISMATCH",
+           (unsigned)st.replay_tick, st.replay_us / 1000.0,
+           st.replay_tick * 1e6 / (st.replay_us ? st.replay_us : 1));
+    if (st.replay != SIM_REPLAY_MATCH) printf(" at tick %u", (unsigned)st.mismatch_tick);
+    printf("\n");
+}
+
+int main(int argc, char **argv) {
+    long ticks = (argc > 1) ? atol(argv[1]) : BENCH_DEFAULT_TICKS;
+    if (ticks <= 0) ticks = BENCH_DEFAULT_TICKS;
+
+    sim_state_init();
+    delay_pool_init();
+
+    float checksum = 0.0f;
+    printf("sim_loop_step: %ld ticks x %d rounds, dt_us=1000 (best round)\n", ticks, BENCH_ROUNDS);
+    for (size_t i = 0; i < COUNT(k_loop_models); i++) {
+        for (size_t b = 0; b < COUNT(k_backends); b++) {
+            double ns = bench_model(k_loop_models[i].model, k_backends[b].numeric, ticks, &checksum);
+            printf("%-20s %-6s %8.2f ns/tick %12.0f ticks/s\n",
+                   k_loop_models[i].name, k_backends[b].name, ns, 1e9 / ns);
+        }
+    }
+
+    printf("\nsim_run_step_response: 60 s offline run at dt_ms=10, default gains\n");
+    printf("%-20s %-6s %8s %7s %7s %8s %8s %9s %9s\n",
+           "model", "", "wall ms", "rise s", "os %", "settle s", "ss err", "IAE", "peak u1");
+    for (size_t i = 0; i < COUNT(k_loop_models); i++) {
+        for (size_t b = 0; b < COUNT(k_backends); b++) {
+            sim_config_t cfg = g_sim.cfg;
+            cfg.plant.model = k_loop_models[i].model;
+            cfg.numeric = k_backends[b].numeric;
+            sim_run_metrics_t m;
+            sim_run_step_response(&cfg, 60.0f, SIM_RUN_DEFAULT_BAND, &m);
+            printf("%-20s %-6s %8.3f %7.2f %7.2f %8.2f %8.4f %9.2f %9.2f\n",
+                   k_loop_models[i].name, k_backends[b].name, m.elapsed_us / 1000.0, m.rise_time,
+                   m.overshoot, m.settling_time, m.ss_error, m.iae, m.peak_actuator);
+        }
+    }
+
+    printf("\nautotune_run: ZN PID at dt_ms=10, dead time 500 ms\n");
+    printf("%-20s %-6s %8s %8s %9s %9s %9s\n", "model", "method", "wall ms", "ticks", "kp", "ki", "kd");
+    for (size_t i = 0; i < COUNT(k_loop_models); i++) {
+        for (int method = AUTOTUNE_RELAY; method <= AUTOTUNE_STEP; method++) {
+            sim_config_t cfg = g_sim.cfg;
+            cfg.plant.model = k_loop_models[i].model;
+            cfg.plant.dead_time_ms = 500;
+            autotune_request_t req;
+            autotune_default_request(&req);
+            req.method = (autotune_method_t)method;
+            autotune_result_t res;
+            if (!autotune_run(&cfg, &req, &res)) {
+                printf("%-20s %-6s failed: %s\n", k_loop_models[i].name, method ? "step" : "relay", res.error);
+                continue;
+            }
+            printf("%-20s %-6s %8.3f %8u %9.3f %9.3f %9.3f\n", k_loop_models[i].name,
+                   method ? "step" : "relay", res.elapsed_us / 1000.0, (unsigned)res.ticks,
+                   res.pid.kp, res.pid.ki, res.pid.kd);
+        }
+    }
+
+    printf("\nsweep: 8x8x4 grid, 30 s per point, one worker in 1 ms slices\n");
+    printf("%-20s %8s %9s %9s %9s %9s %9s\n", "model", "wall ms", "points/s", "kp", "ki", "kd", "cost");
+    sweep_init();
+    for (size_t i = 0; i < COUNT(k_loop_models); i++) {
+        sim_config_t cfg = g_sim.cfg;
+        cfg.plant.model = k_loop_models[i].model;
+        sweep_spec_t spec = {
+            .kp = {0.5f, 8.0f, 8}, .ki = {0.0f, 2.0f, 8}, .kd = {0.0f, 0.5f, 4},
+            .duration_s = SWEEP_DEFAULT_DURATION_S, .overshoot_weight = 1.0f,
+        };
+        sweep_worker_t w;
+        sweep_worker_init(&w, 0);
+        sweep_start(&spec, &cfg);
+        while (sweep_work(&w, time_us_64() + 1000)) {
+        }
+        sweep_status_t st = sweep_get_status();
+        printf("%-20s %8.3f %9.0f %9.3f %9.3f %9.3f %9.2f\n", k_loop_models[i].name,
+               st.elapsed_us / 1000.0, st.done * 1e6 / (st.elapsed_us ? st.elapsed_us : 1),
+               st.best_pid.kp, st.best_pid.ki, st.best_pid.kd, st.best_result.cost);
+    }
+
+    printf("\ndelay_line_step: dead time ring with linear fractional delay, pool %d x %d B blocks\n",
+           DELAY_POOL_BLOCKS, (int)(DELAY_BLOCK * sizeof(delay_sample_t)));
+    printf("%8s %6s %8s %8s %10s\n", "dead ms", "dt us", "ns/tick", "bytes", "sine err");
+    for (size_t i = 0; i < COUNT(k_delays); i++) {
+        size_t bytes;
+        double err;
+        double ns = bench_delay(k_delays[i].dead_ms, k_delays[i].dt_us, ticks, &bytes, &err, &checksum);
+        printf("%8d %6d %8.2f %8u %10.2e\n", k_delays[i].dead_ms, k_delays[i].dt_us, ns, (unsigned)bytes, err);
+    }
+
+    printf("\ndebug line \"SIM step\" with four floats, per call on the logging core\n");
+    bench_log(ticks / 10, &checksum);
+
+    printf("\npid_step + plant step only\n");
+    for (size_t i = 0; i < COUNT(k_models); i++) {
+        for (int k = KERNEL_FLOAT_DIRECT; k <= KERNEL_FIXED; k++) {
+            double ns = bench_kernel(k_models[i].model, (kernel_t)k, ticks, &checksum);
+            printf("%-20s %-12s %8.2f ns/tick\n", k_models[i].name, k_kernel_names[k], ns);
+        }
+    }
+
+    printf("\nplant_ss_step only, transfer function 1/(s+1)^n\n");
+    for (int n = 1; n <= PLANT_MAX_ORDER; n++) {
+        printf("n=%d %8.2f ns/tick\n", n, bench_order(n, ticks, &checksum));
+    }
+
+    printf("\nerror of y against a double-precision reference, %d s step response, fixed = Q%d.%d\n",
+           ERROR_RUN_S, 31 - FIX_FRAC_BITS, FIX_FRAC_BITS);
+    printf("%-20s %5s %12s %12s %12s %12s\n", "model", "dt_ms", "float max", "float rms", "fixed max", "fixed rms");
+    static const int dts[] = {1, 10, 100};
+    for (size_t i = 0; i < COUNT(k_models); i++) {
+        for (size_t d = 0; d < COUNT(dts); d++) {
+            compare_error(k_models[i].model, k_models[i].name, dts[d]);
+        }
+    }
+
+    printf("\nopen-loop unit step vs the continuous response, %d s (tau=0.5; wn=5, zeta=0.3)\n", DISC_RUN_S);
+    printf("%-20s %-6s %6s %12s\n", "model", "method", "dt_ms", "max |dy|");
+    static const int disc_dts[] = {1, 10, 100, 400};
+    static const struct {
+        plant_model_t model;
+        const char *name;
+    } disc_models[] = {
+        {PLANT_FIRST_ORDER, "PLANT_FIRST_ORDER"},
+        {PLANT_SECOND_ORDER, "PLANT_SECOND_ORDER"},
+        {PLANT_TRANSFER_FUNCTION, "TF (second order)"},
+    };
+    for (size_t i = 0; i < COUNT(disc_models); i++) {
+        for (int m = PLANT_METHOD_EULER; m <= PLANT_METHOD_ZOH; m++) {
+            for (size_t d = 0; d < COUNT(disc_dts); d++) {
+                compare_discretization(disc_models[i].model, disc_models[i].name, (plant_method_t)m, disc_dts[d]);
+            }
+        }
+    }
+    int restores = 1000;
+    printf("\nconfig_store_restore: boot scan of the %d-sector flash config log, mean of %d calls\n",
+           CONFIG_STORE_SECTORS, restores);
+    bench_config_store(restores);
+    printf("\nprofile_tick: one segment per kind, %ld ticks at dt_us=1000\n", ticks);
+    bench_profile(ticks, &checksum);
+    long record_ticks = 20000;
+    printf("\nsim_record: %ld live ticks at dt_ms=10 recorded, then replayed in core1 idle slices\n", record_ticks);
+    bench_record(record_ticks);
+    printf("checksum %.3f\n", checksum);
+    return 0;
+}
@@ -0,0 +1,17 @@
+// Host stand-in for the flash chip: a RAM image with NOR erase/program semantics.
+
+#include <string.h>
+
+#include "hardware/flash.h"
+
+uint8_t host_flash[PICO_FLASH_SIZE_BYTES];
+
+void flash_range_erase(uint32_t flash_offs, size_t count) {
+    memset(host_flash + flash_offs, 0xFF, count);
+}
+
+void flash_range_program(uint32_t flash_offs, const uint8_t *data, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        host_flash[flash_offs + i] &= data[i];
+    }
+}
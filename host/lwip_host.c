@@ -0,0 +1,474 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "lwip/stats.h"
+#include "lwip/timeouts.h"
+
+#include "lwip_host.h"
+
+#define HOST_MAX_PCBS 8
+#define HOST_MAX_SEGS 64
+#define HOST_MAX_TIMERS 32
+#define HOST_CAPTURE_SIZE (256 * 1024)
+#define HOST_MAX_UDP_PCBS 4
+#define HOST_MAX_DATAGRAMS 256 // sent datagrams waiting for lwip_host_udp_take()
+#define HOST_DATAGRAM_SIZE 1472 // UDP payload of a 1500-byte MTU
+
+typedef struct {
+    u16_t len;
+    u16_t pbufs;
+    int oversize; // last pbuf is a copied pbuf with room up to the MSS
+} host_seg_t;
+
+struct tcp_pcb {
+    int in_use;
+    int listening;
+    int closed;
+    int aborted; // closed with tcp_abort (RST)
+    void *arg;
+    tcp_accept_fn accept;
+    tcp_recv_fn recv;
+    tcp_sent_fn sent;
+    tcp_poll_fn poll;
+    tcp_err_fn errf;
+    u16_t snd_buf;
+    u16_t snd_queuelen;
+    uint32_t fault_every; // fail every n-th tcp_write with ERR_MEM, 0 = never
+    uint32_t fault_count;
+    host_seg_t unsent[HOST_MAX_SEGS];
+    int unsent_count;
+    size_t inflight_bytes;
+    u16_t inflight_pbufs;
+    uint8_t *capture;
+    size_t capture_len;
+    lwip_host_stats_t stats;
+};
+
+typedef struct {
+    sys_timeout_handler handler;
+    void *arg;
+    uint32_t due_ms;
+} host_timer_t;
+
+struct udp_pcb {
+    int in_use;
+    u16_t port;
+    udp_recv_fn recv;
+    void *arg;
+};
+
+typedef struct {
+    ip_addr_t addr;
+    u16_t port;
+    u16_t len;
+    uint8_t data[HOST_DATAGRAM_SIZE];
+} host_datagram_t;
+
+static struct tcp_pcb g_pcbs[HOST_MAX_PCBS];
+static struct tcp_pcb *g_listener;
+static host_timer_t g_timers[HOST_MAX_TIMERS];
+static uint32_t g_now_ms;
+static struct udp_pcb g_udp_pcbs[HOST_MAX_UDP_PCBS];
+static host_datagram_t g_datagrams[HOST_MAX_DATAGRAMS];
+static int g_datagram_head;
+static int g_datagram_count;
+
+/* Pool statistics; only the pcb pool is tracked, the others report their size. */
+static struct stats_mem g_memp_tcp_pcb = {.avail = MEMP_NUM_TCP_PCB};
+static struct stats_mem g_memp_tcp_seg = {.avail = MEMP_NUM_TCP_SEG};
+static struct stats_mem g_memp_pbuf_pool = {.avail = PBUF_POOL_SIZE};
+struct stats_ lwip_stats = {
+    .mem = {.avail = MEM_SIZE},
+    .memp = {
+        [MEMP_TCP_PCB] = &g_memp_tcp_pcb,
+        [MEMP_TCP_SEG] = &g_memp_tcp_seg,
+        [MEMP_PBUF_POOL] = &g_memp_pbuf_pool,
+    },
+};
+
+static struct tcp_pcb *pcb_alloc(void) {
+    for (int i = 0; i < HOST_MAX_PCBS; i++) {
+        struct tcp_pcb *pcb = &g_pcbs[i];
+        if (!pcb->in_use) {
+            uint8_t *capture = pcb->capture;
+            memset(pcb, 0, sizeof(*pcb));
+            pcb->capture = capture ? capture : malloc(HOST_CAPTURE_SIZE);
+            pcb->in_use = 1;
+            pcb->snd_buf = TCP_SND_BUF;
+            g_memp_tcp_pcb.used++;
+            if (g_memp_tcp_pcb.used > g_memp_tcp_pcb.max) g_memp_tcp_pcb.max = g_memp_tcp_pcb.used;
+            return pcb;
+        }
+    }
+    return NULL;
+}
+
+/* ---- pbufs ---- */
+
+struct pbuf *pbuf_alloc(pbuf_layer layer, u16_t length, pbuf_type type) {
+    (void)layer;
+    (void)type;
+    struct pbuf *p = malloc(sizeof(struct pbuf) + length);
+    if (!p) return NULL;
+    p->next = NULL;
+    p->payload = p + 1;
+    p->tot_len = length;
+    p->len = length;
+    return p;
+}
+
+u8_t pbuf_free(struct pbuf *p) {
+    free(p);
+    return 1;
+}
+
+u16_t pbuf_copy_partial(const struct pbuf *p, void *dataptr, u16_t len, u16_t offset) {
+    if (offset >= p->len) return 0;
+    u16_t n = p->len - offset;
+    if (n > len) n = len;
+    memcpy(dataptr, (const uint8_t *)p->payload + offset, n);
+    return n;
+}
+
+err_t pbuf_take(struct pbuf *p, const void *dataptr, u16_t len) {
+    if (len > p->len) return ERR_ARG;
+    memcpy(p->payload, dataptr, len);
+    return ERR_OK;
+}
+
+/* ---- timers ---- */
+
+void sys_timeout(u32_t msecs, sys_timeout_handler handler, void *arg) {
+    for (int i = 0; i < HOST_MAX_TIMERS; i++) {
+        if (!g_timers[i].handler) {
+            g_timers[i].handler = handler;
+            g_timers[i].arg = arg;
+            g_timers[i].due_ms = g_now_ms + msecs;
+            return;
+        }
+    }
+    abort(); // MEMP_NUM_SYS_TIMEOUT exhausted
+}
+
+void sys_untimeout(sys_timeout_handler handler, void *arg) {
+    for (int i = 0; i < HOST_MAX_TIMERS; i++) {
+        if (g_timers[i].handler == handler && g_timers[i].arg == arg) {
+            g_timers[i].handler = NULL;
+            return;
+        }
+    }
+}
+
+void lwip_host_advance_ms(uint32_t ms) {
+    uint32_t end = g_now_ms + ms;
+    while (g_now_ms != end) {
+        g_now_ms++;
+        for (int i = 0; i < HOST_MAX_TIMERS; i++) {
+            host_timer_t t = g_timers[i];
+            if (t.handler && (int32_t)(g_now_ms - t.due_ms) >= 0) {
+                g_timers[i].handler = NULL;
+                t.handler(t.arg);
+            }
+        }
+    }
+}
+
+/* ---- raw TCP API ---- */
+
+struct tcp_pcb *tcp_new_ip_type(u8_t type) {
+    (void)type;
+    return pcb_alloc();
+}
+
+err_t tcp_bind(struct tcp_pcb *pcb, const ip_addr_t *ipaddr, u16_t port) {
+    (void)pcb;
+    (void)ipaddr;
+    (void)port;
+    return ERR_OK;
+}
+
+struct tcp_pcb *tcp_listen_with_backlog(struct tcp_pcb *pcb, u8_t backlog) {
+    (void)backlog;
+    pcb->listening = 1;
+    g_listener = pcb;
+    return pcb;
+}
+
+void tcp_accept(struct tcp_pcb *pcb, tcp_accept_fn accept) {
+    pcb->accept = accept;
+}
+
+void tcp_arg(struct tcp_pcb *pcb, void *arg) {
+    pcb->arg = arg;
+}
+
+void tcp_recv(struct tcp_pcb *pcb, tcp_recv_fn recv) {
+    pcb->recv = recv;
+}
+
+void tcp_sent(struct tcp_pcb *pcb, tcp_sent_fn sent) {
+    pcb->sent = sent;
+}
+
+void tcp_err(struct tcp_pcb *pcb, tcp_err_fn err) {
+    pcb->errf = err;
+}
+
+void tcp_poll(struct tcp_pcb *pcb, tcp_poll_fn poll, u8_t interval) {
+    (void)interval;
+    pcb->poll = poll;
+}
+
+u16_t tcp_sndbuf(const struct tcp_pcb *pcb) {
+    return pcb->snd_buf;
+}
+
+u16_t tcp_sndqueuelen(const struct tcp_pcb *pcb) {
+    return pcb->snd_queuelen;
+}
+
+u16_t tcp_mss(const struct tcp_pcb *pcb) {
+    (void)pcb;
+    return TCP_MSS;
+}
+
+/*
+ * Queue data like lwIP's tcp_write(): fill the last unsent segment up to the
+ * MSS (copied data goes into the oversized pbuf, referenced data chains a new
+ * pbuf), then start new MSS-sized segments. Each new segment costs one pbuf,
+ * or two (header + ROM pbuf) for referenced data.
+ */
+err_t tcp_write(struct tcp_pcb *pcb, const void *dataptr, u16_t len, u8_t apiflags) {
+    int copy = (apiflags & TCP_WRITE_FLAG_COPY) != 0;
+    if (pcb->closed || len == 0) return pcb->closed ? ERR_CLSD : ERR_OK;
+
+    u16_t pbufs = 0;
+    size_t remaining = len;
+    host_seg_t *last = pcb->unsent_count ? &pcb->unsent[pcb->unsent_count - 1] : NULL;
+    size_t merge = 0;
+    if (last && last->len < TCP_MSS) {
+        merge = TCP_MSS - last->len;
+        if (merge > remaining) merge = remaining;
+        if (!(copy && last->oversize)) pbufs++;
+        remaining -= merge;
+    }
+    size_t new_segs = (remaining + TCP_MSS - 1) / TCP_MSS;
+    pbufs += (u16_t)(new_segs * (copy ? 1 : 2));
+
+    int fault = pcb->fault_every && ++pcb->fault_count % pcb->fault_every == 0;
+    if (fault || len > pcb->snd_buf || pcb->snd_queuelen + pbufs > TCP_SND_QUEUELEN ||
+        pcb->unsent_count + new_segs > HOST_MAX_SEGS) {
+        pcb->stats.write_errors++;
+        return ERR_MEM;
+    }
+
+    if (merge) {
+        last->len += (u16_t)merge;
+        last->pbufs += (copy && last->oversize) ? 0 : 1;
+        last->oversize = copy;
+    }
+    while (remaining) {
+        host_seg_t *seg = &pcb->unsent[pcb->unsent_count++];
+        seg->len = (u16_t)(remaining > TCP_MSS ? TCP_MSS : remaining);
+        seg->pbufs = copy ? 1 : 2;
+        seg->oversize = copy;
+        remaining -= seg->len;
+    }
+
+    if (pcb->capture_len + len <= HOST_CAPTURE_SIZE) {
+        memcpy(pcb->capture + pcb->capture_len, dataptr, len);
+        pcb->capture_len += len;
+    }
+    pcb->snd_buf -= len;
+    pcb->snd_queuelen += pbufs;
+    pcb->stats.writes++;
+    return ERR_OK;
+}
+
+err_t tcp_output(struct tcp_pcb *pcb) {
+    if (pcb->unsent_count == 0) return ERR_OK;
+    for (int i = 0; i < pcb->unsent_count; i++) {
+        pcb->inflight_bytes += pcb->unsent[i].len;
+        pcb->inflight_pbufs += pcb->unsent[i].pbufs;
+        pcb->stats.bytes += pcb->unsent[i].len;
+    }
+    pcb->stats.segments += (uint32_t)pcb->unsent_count;
+    pcb->stats.outputs++;
+    pcb->unsent_count = 0;
+    return ERR_OK;
+}
+
+void tcp_recved(struct tcp_pcb *pcb, u16_t len) {
+    (void)pcb;
+    (void)len;
+}
+
+err_t tcp_close(struct tcp_pcb *pcb) {
+    pcb->closed = 1;
+    if (pcb->listening) {
+        pcb->in_use = 0;
+        g_memp_tcp_pcb.used--;
+    }
+    return ERR_OK;
+}
+
+void tcp_abort(struct tcp_pcb *pcb) {
+    pcb->closed = 1;
+    pcb->aborted = 1;
+    pcb->unsent_count = 0;
+    pcb->inflight_bytes = 0;
+    if (pcb->errf) pcb->errf(pcb->arg, ERR_ABRT);
+}
+
+/* ---- peer side ---- */
+
+struct tcp_pcb *lwip_host_connect(void) {
+    struct tcp_pcb *pcb = pcb_alloc();
+    if (!pcb || !g_listener || !g_listener->accept) return NULL;
+    g_listener->accept(g_listener->arg, pcb, ERR_OK);
+    return pcb;
+}
+
+err_t lwip_host_deliver(struct tcp_pcb *pcb, const void *data, size_t len) {
+    struct pbuf *p = pbuf_alloc(PBUF_RAW, (u16_t)len, PBUF_POOL);
+    memcpy(p->payload, data, len);
+    err_t ret = pcb->recv ? pcb->recv(pcb->arg, pcb, p, ERR_OK) : ERR_OK;
+    if (ret != ERR_ABRT) tcp_output(pcb); // tcp_input flushes after callbacks
+    return ret;
+}
+
+void lwip_host_peer_close(struct tcp_pcb *pcb) {
+    if (pcb->recv && !pcb->closed) pcb->recv(pcb->arg, pcb, NULL, ERR_OK);
+}
+
+void lwip_host_set_write_fault(struct tcp_pcb *pcb, uint32_t every) {
+    pcb->fault_every = every;
+    pcb->fault_count = 0;
+}
+
+void lwip_host_peer_reset(struct tcp_pcb *pcb) {
+    pcb->closed = 1;
+    pcb->unsent_count = 0;
+    pcb->inflight_bytes = 0;
+    if (pcb->errf) pcb->errf(pcb->arg, ERR_RST);
+}
+
+size_t lwip_host_ack(struct tcp_pcb *pcb) {
+    size_t acked = pcb->inflight_bytes;
+    if (acked == 0) return 0;
+    pcb->snd_buf += (u16_t)acked;
+    pcb->snd_queuelen -= pcb->inflight_pbufs;
+    pcb->inflight_bytes = 0;
+    pcb->inflight_pbufs = 0;
+    pcb->stats.round_trips++;
+    if (pcb->sent) {
+        err_t ret = pcb->sent(pcb->arg, pcb, (u16_t)acked);
+        if (ret == ERR_ABRT) return acked;
+    }
+    tcp_output(pcb);
+    return acked;
+}
+
+void lwip_host_poll(struct tcp_pcb *pcb) {
+    if (pcb->poll && !pcb->closed) pcb->poll(pcb->arg, pcb);
+}
+
+int lwip_host_is_closed(const struct tcp_pcb *pcb) {
+    return pcb->closed;
+}
+
+int lwip_host_is_aborted(const struct tcp_pcb *pcb) {
+    return pcb->aborted;
+}
+
+size_t lwip_host_pending(const struct tcp_pcb *pcb) {
+    size_t n = pcb->inflight_bytes;
+    for (int i = 0; i < pcb->unsent_count; i++) n += pcb->unsent[i].len;
+    return n;
+}
+
+const uint8_t *lwip_host_output(const struct tcp_pcb *pcb, size_t *len) {
+    *len = pcb->capture_len;
+    return pcb->capture;
+}
+
+void lwip_host_clear_output(struct tcp_pcb *pcb) {
+    pcb->capture_len = 0;
+}
+
+const lwip_host_stats_t *lwip_host_stats(const struct tcp_pcb *pcb) {
+    return &pcb->stats;
+}
+
+void lwip_host_release(struct tcp_pcb *pcb) {
+    pcb->in_use = 0;
+    g_memp_tcp_pcb.used--;
+}
+
+/* ---- UDP ---- */
+
+struct udp_pcb *udp_new_ip_type(u8_t type) {
+    (void)type;
+    for (int i = 0; i < HOST_MAX_UDP_PCBS; i++) {
+        if (!g_udp_pcbs[i].in_use) {
+            memset(&g_udp_pcbs[i], 0, sizeof(g_udp_pcbs[i]));
+            g_udp_pcbs[i].in_use = 1;
+            return &g_udp_pcbs[i];
+        }
+    }
+    return NULL;
+}
+
+err_t udp_bind(struct udp_pcb *pcb, const ip_addr_t *ipaddr, u16_t port) {
+    (void)ipaddr;
+    for (int i = 0; i < HOST_MAX_UDP_PCBS; i++) {
+        if (&g_udp_pcbs[i] != pcb && g_udp_pcbs[i].in_use && g_udp_pcbs[i].port == port) return ERR_USE;
+    }
+    pcb->port = port;
+    return ERR_OK;
+}
+
+void udp_recv(struct udp_pcb *pcb, udp_recv_fn recv, void *recv_arg) {
+    pcb->recv = recv;
+    pcb->arg = recv_arg;
+}
+
+err_t udp_sendto(struct udp_pcb *pcb, struct pbuf *p, const ip_addr_t *dst_ip, u16_t dst_port) {
+    (void)pcb;
+    if (p->tot_len > HOST_DATAGRAM_SIZE) return ERR_VAL;
+    if (g_datagram_count == HOST_MAX_DATAGRAMS) return ERR_MEM;
+    host_datagram_t *d = &g_datagrams[(g_datagram_head + g_datagram_count) % HOST_MAX_DATAGRAMS];
+    d->addr = *dst_ip;
+    d->port = dst_port;
+    d->len = pbuf_copy_partial(p, d->data, p->tot_len, 0);
+    g_datagram_count++;
+    return ERR_OK;
+}
+
+void udp_remove(struct udp_pcb *pcb) {
+    pcb->in_use = 0;
+}
+
+int lwip_host_udp_deliver(u16_t port, const ip_addr_t *from, u16_t from_port, const void *data, size_t len) {
+    for (int i = 0; i < HOST_MAX_UDP_PCBS; i++) {
+        struct udp_pcb *pcb = &g_udp_pcbs[i];
+        if (!pcb->in_use || pcb->port != port || !pcb->recv) continue;
+        struct pbuf *p = pbuf_alloc(PBUF_TRANSPORT, (u16_t)len, PBUF_POOL);
+        memcpy(p->payload, data, len);
+        pcb->recv(pcb->arg, pcb, p, from, from_port);
+        return 1;
+    }
+    return 0;
+}
+
+size_t lwip_host_udp_take(void *out, size_t max, ip_addr_t *to, u16_t *to_port) {
+    if (g_datagram_count == 0) return 0;
+    const host_datagram_t *d = &g_datagrams[g_datagram_head];
+    size_t n = d->len < max ? d->len : max;
+    memcpy(out, d->data, n);
+    if (to) *to = d->addr;
+    if (to_port) *to_port = d->port;
+    g_datagram_head = (g_datagram_head + 1) % HOST_MAX_DATAGRAMS;
+    g_datagram_count--;
+    return n;
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+// Test driver for the host lwIP stand-in (host/shims/lwip). It plays the
+// remote peer: opens connections, delivers request bytes, acknowledges
+// whatever the firmware queued and records the segments it produced.
+// UDP datagrams are delivered to the bound pcb and queued on the way out.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "lwip/tcp.h"
+#include "lwip/udp.h"
+
+typedef struct {
+    uint32_t writes; // tcp_write calls accepted
+    uint32_t write_errors; // tcp_write calls rejected (ERR_MEM)
+    uint32_t segments; // TCP segments put on the wire
+    uint32_t outputs; // tcp_output calls that sent at least one segment
+    uint32_t round_trips; // lwip_host_ack calls that acknowledged data
+    uint32_t bytes; // payload bytes sent
+} lwip_host_stats_t;
+
+/** Open a client connection to the listening pcb (runs the accept callback). */
+struct tcp_pcb *lwip_host_connect(void);
+
+/** Deliver bytes from the peer: runs the recv callback, then flushes like tcp_input. */
+err_t lwip_host_deliver(struct tcp_pcb *pcb, const void *data, size_t len);
+
+/** Peer closes its side: recv callback with a NULL pbuf. */
+void lwip_host_peer_close(struct tcp_pcb *pcb);
+
+/** Fail every n-th tcp_write on this connection with ERR_MEM (0 turns it off), as a full pbuf pool would. */
+void lwip_host_set_write_fault(struct tcp_pcb *pcb, uint32_t every);
+
+/** Peer resets the connection: lwIP frees the pcb and runs the err callback. */
+void lwip_host_peer_reset(struct tcp_pcb *pcb);
+
+/** Acknowledge everything in flight (one round trip); returns the bytes acked. */
+size_t lwip_host_ack(struct tcp_pcb *pcb);
+
+/** Run the pcb's tcp_poll callback once. */
+void lwip_host_poll(struct tcp_pcb *pcb);
+
+/** Advance the stand-in clock and fire due sys_timeout handlers. */
+void lwip_host_advance_ms(uint32_t ms);
+
+/** Non-zero once the firmware closed or aborted the connection. */
+int lwip_host_is_closed(const struct tcp_pcb *pcb);
+
+/** Non-zero if the firmware aborted the connection (RST) rather than closing it. */
+int lwip_host_is_aborted(const struct tcp_pcb *pcb);
+
+/** Bytes queued or in flight but not yet acknowledged. */
+size_t lwip_host_pending(const struct tcp_pcb *pcb);
+
+/** Everything the firmware sent on this connection so far. */
+const uint8_t *lwip_host_output(const struct tcp_pcb *pcb, size_t *len);
+
+/** Discard the captured output (keeps the connection). */
+void lwip_host_clear_output(struct tcp_pcb *pcb);
+
+/** Counters for this connection. */
+const lwip_host_stats_t *lwip_host_stats(const struct tcp_pcb *pcb);
+
+/** Release a connection slot of the stand-in. */
+void lwip_host_release(struct tcp_pcb *pcb);
+
+/** Deliver a datagram from from:from_port to the pcb bound to port; 0 if none is bound. */
+int lwip_host_udp_deliver(u16_t port, const ip_addr_t *from, u16_t from_port, const void *data, size_t len);
+
+/** Take the oldest datagram the firmware sent (up to max bytes); 0 if none is queued. */
+size_t lwip_host_udp_take(void *out, size_t max, ip_addr_t *to, u16_t *to_port);
@@ -0,0 +1,24 @@
+#pragma once
+
+// Host stand-in for hardware/flash.h: the flash chip is a RAM image
+// (host/flash_host.c) mapped at XIP_BASE. It starts zeroed, not erased.
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define FLASH_PAGE_SIZE (1u << 8)
+#define FLASH_SECTOR_SIZE (1u << 12)
+
+#ifndef PICO_FLASH_SIZE_BYTES
+#define PICO_FLASH_SIZE_BYTES (2 * 1024 * 1024)
+#endif
+
+extern uint8_t host_flash[PICO_FLASH_SIZE_BYTES];
+
+#define XIP_BASE ((uintptr_t)host_flash)
+
+/** Set count bytes at flash_offs to 0xFF (whole sectors). */
+void flash_range_erase(uint32_t flash_offs, size_t count);
+
+/** Program count bytes at flash_offs; like NOR flash, bits can only be cleared. */
+void flash_range_program(uint32_t flash_offs, const uint8_t *data, size_t count);
@@ -0,0 +1,25 @@
+#pragma once
+
+// Host stand-in for the Pico SDK memory barrier and interrupt masking helpers.
+
+#include <stdatomic.h>
+#include <stdint.h>
+
+static inline void __dmb(void) {
+    atomic_thread_fence(memory_order_seq_cst);
+}
+
+static inline void __compiler_memory_barrier(void) {
+    atomic_signal_fence(memory_order_seq_cst);
+}
+
+static inline void tight_loop_contents(void) {
+}
+
+static inline uint32_t save_and_disable_interrupts(void) {
+    return 0;
+}
+
+static inline void restore_interrupts(uint32_t status) {
+    (void)status;
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+// Host stand-in for the lwIP types used by the firmware sources.
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef uint8_t u8_t;
+typedef uint16_t u16_t;
+typedef uint32_t u32_t;
+typedef int8_t s8_t;
+typedef int16_t s16_t;
+typedef int32_t s32_t;
+
+typedef s8_t err_t;
+
+#define ERR_OK 0
+#define ERR_MEM -1
+#define ERR_BUF -2
+#define ERR_VAL -6
+#define ERR_USE -8
+#define ERR_ARG -16
+#define ERR_ABRT -13
+#define ERR_RST -14
+#define ERR_CLSD -15
+
+#define LWIP_UNUSED_ARG(x) (void)(x)
+
+typedef struct {
+    u32_t addr;
+} ip_addr_t;
+
+#define IPADDR_TYPE_ANY 46U
@@ -0,0 +1,7 @@
+#pragma once
+
+// Host stand-in for lwIP's ip_addr.h: IPv4 addresses only.
+
+#include "lwip/err.h"
+
+#define ip_addr_cmp(addr1, addr2) ((addr1)->addr == (addr2)->addr)
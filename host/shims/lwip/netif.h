@@ -0,0 +1,5 @@
+#pragma once
+
+// Host stand-in for lwIP's netif.h: the firmware headers only pass pointers.
+
+struct netif;
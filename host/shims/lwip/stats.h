@@ -0,0 +1,29 @@
+#pragma once
+
+// Host stand-in for lwIP's statistics: the heap and the memp pools the
+// firmware reports. lwip_stats is defined in host/lwip_host.c.
+
+#include "lwip/err.h"
+#include "lwipopts.h"
+
+typedef enum {
+    MEMP_TCP_PCB,
+    MEMP_TCP_SEG,
+    MEMP_PBUF_POOL,
+    MEMP_MAX
+} memp_t;
+
+struct stats_mem {
+    u16_t err;
+    u16_t avail;
+    u16_t used;
+    u16_t max;
+    u16_t illegal;
+};
+
+struct stats_ {
+    struct stats_mem mem;
+    struct stats_mem *memp[MEMP_MAX];
+};
+
+extern struct stats_ lwip_stats;
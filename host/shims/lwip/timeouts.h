@@ -0,0 +1,10 @@
+#pragma once
+
+// Host stand-in for lwIP timers; fired by lwip_host_advance_ms().
+
+#include "lwip/err.h"
+
+typedef void (*sys_timeout_handler)(void *arg);
+
+void sys_timeout(u32_t msecs, sys_timeout_handler handler, void *arg);
+void sys_untimeout(sys_timeout_handler handler, void *arg);
@@ -0,0 +1,11 @@
+#pragma once
+
+// Host stand-in for the CYW43 arch layer: lwIP calls run on the caller's thread.
+
+#include "pico/stdlib.h"
+
+static inline void cyw43_arch_lwip_begin(void) {
+}
+
+static inline void cyw43_arch_lwip_end(void) {
+}
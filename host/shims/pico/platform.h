@@ -0,0 +1,7 @@
+#pragma once
+
+// Host stand-in for pico/platform.h: the host build runs everything on "core 0".
+
+static inline unsigned int get_core_num(void) {
+    return 0;
+}
@@ -0,0 +1,10 @@
+#pragma once
+
+// Host stand-in for pico/stdlib.h.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "pico/sync.h"
+#include "pico/time.h"
@@ -0,0 +1,22 @@
+#pragma once
+
+// Host stand-in for the Pico SDK sync primitives used by the simulation core.
+// The host build is single-threaded, so the critical section only tracks nesting.
+
+#include "hardware/sync.h"
+
+typedef struct {
+    int depth;
+} critical_section_t;
+
+static inline void critical_section_init(critical_section_t *crit_sec) {
+    crit_sec->depth = 0;
+}
+
+static inline void critical_section_enter_blocking(critical_section_t *crit_sec) {
+    crit_sec->depth++;
+}
+
+static inline void critical_section_exit(critical_section_t *crit_sec) {
+    crit_sec->depth--;
+}
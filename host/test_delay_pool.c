@@ -0,0 +1,81 @@
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "delay_line.h"
+#include "sim_run.h"
+#include "sim_state.h"
+
+#define LONG_DEAD_MS 2560
+
+/** Step response of cfg; reports the dead time the run applied. */
+static int run_offline(const char *name, const sim_config_t *cfg, sim_run_metrics_t *m) {
+    if (!sim_run_step_response(cfg, 20.0f, SIM_RUN_DEFAULT_BAND, m)) return 0;
+    printf("%-28s dead %7.1f ms limited=%d iae %.4g (pool %d/%d)\n", name, (double)m->dead_ms,
+           m->dead_limited, (double)m->iae, delay_pool_used(), DELAY_POOL_BLOCKS);
+    return 1;
+}
+
+int main(void) {
+    delay_pool_init();
+    sim_state_init();
+    sim_config_t cfg = sim_state_get_config();
+    cfg.dt_us = 1000;
+    cfg.plant.dead_time_ms = LONG_DEAD_MS;
+
+    sim_run_metrics_t alone;
+    if (!run_offline("offline alone", &cfg, &alone)) return 1;
+
+    /* The live line holds its share of the reserve; offline lines must not count it twice. */
+    static delay_line_t live;
+    live.live = 1;
+    delay_line_reset(&live);
+    delay_line_set(&live, LONG_DEAD_MS, 1000);
+    static delay_line_t offline[DELAY_POOL_OFFLINE - 1];
+    for (int i = 0; i < DELAY_POOL_OFFLINE - 1; i++) {
+        delay_line_reset(&offline[i]);
+        delay_line_set(&offline[i], LONG_DEAD_MS, 1000);
+        if (offline[i].limited) {
+            fprintf(stderr, "offline line %d limited next to the live line\n", i);
+            return 1;
+        }
+    }
+    if (live.limited) return 1;
+
+    sim_run_metrics_t shared;
+    if (!run_offline("next to live + 3 offline", &cfg, &shared)) return 1;
+    if (shared.dead_limited || fabsf(shared.dead_ms - LONG_DEAD_MS) > 0.01f || shared.iae != alone.iae) {
+        fprintf(stderr, "offline run differs from the run alone\n");
+        return 1;
+    }
+
+    /* One line more than the pool is sized for: the cut must show in the metrics. */
+    static delay_line_t extra;
+    delay_line_reset(&extra);
+    delay_line_set(&extra, LONG_DEAD_MS, 1000);
+    sim_run_metrics_t starved;
+    if (!run_offline("pool exhausted", &cfg, &starved)) return 1;
+    if (!starved.dead_limited || starved.dead_ms >= LONG_DEAD_MS) {
+        fprintf(stderr, "truncated run not reported\n");
+        return 1;
+    }
+    delay_line_reset(&extra);
+
+    /* The reserve is kept for the live line even when offline lines ask first. */
+    delay_line_reset(&live);
+    delay_line_set(&live, LONG_DEAD_MS, 1000);
+    if (live.limited) {
+        fprintf(stderr, "live line lost its reserve\n");
+        return 1;
+    }
+
+    /* Below dt = 1 ms the line is capped at DELAY_MAX_BLOCKS, also reported. */
+    cfg.dt_us = 100;
+    sim_run_metrics_t fine;
+    if (!run_offline("dt 100 us", &cfg, &fine)) return 1;
+    if (!fine.dead_limited || fabsf(fine.dead_ms - delay_line_max_ms(100)) > 0.01f) {
+        fprintf(stderr, "dead time at dt 100 us not reported as limited\n");
+        return 1;
+    }
+    return 0;
+}
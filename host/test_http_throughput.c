@@ -0,0 +1,743 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pico/time.h"
+
+#include "lwip_host.h"
+#include "sim_batch.h"
+#include "sim_loop.h"
+#include "sim_params.h"
+#include "sim_record.h"
+#include "sim_state.h"
+#include "telemetry.h"
+#include "web_server.h"
+#include "websocket.h"
+
+#define DEFAULT_ITERATIONS 200
+#define MODEL_RTT_MS 10.0
+#define METRICS_BODY_SIZE 8192 // HTTP_BODY_SIZE: /metrics must not depend on fitting into it
+#define WS_MSG_SAMPLES 0x01 // binary telemetry message type sent on /ws
+#define JOB_SLICE_US 0 // web_server_poll() slice: one chunk of ticks per call, however fast the host
+
+typedef struct {
+    const char *name;
+    const char *path;
+} route_t;
+
+typedef struct {
+    double bytes;
+    double segments;
+    double round_trips;
+    double writes;
+    double write_errors;
+    double cpu_ns;
+} route_result_t;
+
+/**
+ * Count the complete 200 responses at the start of the captured bytes.
+ * Returns -1 if anything other than whole responses follows them.
+ */
+static int count_responses(const uint8_t *out, size_t len) {
+    int count = 0;
+    size_t pos = 0;
+    while (pos < len) {
+        const char *hdr_end = NULL;
+        for (size_t i = pos; i + 3 < len; i++) {
+            if (memcmp(out + i, "\r\n\r\n", 4) == 0) {
+                hdr_end = (const char *)out + i + 4;
+                break;
+            }
+        }
+        if (!hdr_end) return -1;
+        char hdr[512];
+        size_t hdr_len = (size_t)(hdr_end - (const char *)out) - pos;
+        if (hdr_len >= sizeof(hdr)) return -1;
+        memcpy(hdr, out + pos, hdr_len);
+        hdr[hdr_len] = '\0';
+        if (strncmp(hdr, "HTTP/1.1 200", 12) != 0) return -1;
+        const char *cl = strstr(hdr, "Content-Length: ");
+        if (!cl) return -1;
+        pos += hdr_len + (size_t)atol(cl + 16);
+        if (pos > len) return -1;
+        count++;
+    }
+    return count;
+}
+
+/** Offset of the first occurrence of str in the captured bytes, or -1. */
+static long find_text(const uint8_t *out, size_t len, const char *str) {
+    size_t n = strlen(str);
+    for (size_t i = 0; i + n <= len; i++) {
+        if (memcmp(out + i, str, n) == 0) return (long)i;
+    }
+    return -1;
+}
+
+/** Acknowledge until nothing is left in flight. */
+static void drain(struct tcp_pcb *pcb) {
+    while (lwip_host_pending(pcb) > 0) {
+        if (lwip_host_ack(pcb) == 0) break;
+    }
+}
+
+static void add_stats(route_result_t *res, const lwip_host_stats_t *st) {
+    res->bytes += st->bytes;
+    res->segments += st->segments;
+    res->round_trips += st->round_trips;
+    res->writes += st->writes;
+    res->write_errors += st->write_errors;
+}
+
+static void average(route_result_t *res, int n) {
+    res->bytes /= n;
+    res->segments /= n;
+    res->round_trips /= n;
+    res->writes /= n;
+    res->write_errors /= n;
+    res->cpu_ns /= n;
+}
+
+static int format_request(char *out, size_t out_len, const char *path, int close) {
+    return snprintf(out, out_len,
+        "GET %s HTTP/1.1\r\nHost: pico-w.local\r\nAccept-Encoding: gzip\r\n%s\r\n",
+        path, close ? "Connection: close\r\n" : "");
+}
+
+/** Request a route on a new connection each time ("Connection: close"). */
+static int run_route(const route_t *route, int iterations, route_result_t *res) {
+    char req[256];
+    int req_len = format_request(req, sizeof(req), route->path, 1);
+    memset(res, 0, sizeof(*res));
+
+    for (int i = 0; i < iterations; i++) {
+        struct tcp_pcb *pcb = lwip_host_connect();
+        if (!pcb) return 0;
+
+        uint64_t t0 = time_us_64();
+        lwip_host_deliver(pcb, req, (size_t)req_len);
+        drain(pcb);
+        uint64_t t1 = time_us_64();
+
+        size_t out_len;
+        const uint8_t *out = lwip_host_output(pcb, &out_len);
+        if (!lwip_host_is_closed(pcb) || count_responses(out, out_len) != 1) {
+            fprintf(stderr, "%s: incomplete response (%zu bytes, closed=%d)\n",
+                    route->name, out_len, lwip_host_is_closed(pcb));
+            return 0;
+        }
+        add_stats(res, lwip_host_stats(pcb));
+        res->cpu_ns += (double)(t1 - t0) * 1000.0;
+        lwip_host_release(pcb);
+    }
+    average(res, iterations);
+    return 1;
+}
+
+/** Request a route repeatedly on one keep-alive connection. */
+static int run_route_keep_alive(const route_t *route, int iterations, route_result_t *res) {
+    char req[256];
+    int req_len = format_request(req, sizeof(req), route->path, 0);
+    memset(res, 0, sizeof(*res));
+
+    struct tcp_pcb *pcb = lwip_host_connect();
+    if (!pcb) return 0;
+    for (int i = 0; i < iterations; i++) {
+        uint64_t t0 = time_us_64();
+        lwip_host_deliver(pcb, req, (size_t)req_len);
+        drain(pcb);
+        uint64_t t1 = time_us_64();
+
+        size_t out_len;
+        const uint8_t *out = lwip_host_output(pcb, &out_len);
+        if (lwip_host_is_closed(pcb) || count_responses(out, out_len) != 1) {
+            fprintf(stderr, "%s: keep-alive request %d failed (%zu bytes, closed=%d)\n",
+                    route->name, i, out_len, lwip_host_is_closed(pcb));
+            return 0;
+        }
+        lwip_host_clear_output(pcb);
+        res->cpu_ns += (double)(t1 - t0) * 1000.0;
+    }
+    add_stats(res, lwip_host_stats(pcb));
+    average(res, iterations);
+
+    lwip_host_peer_close(pcb);
+    if (!lwip_host_is_closed(pcb)) {
+        fprintf(stderr, "%s: connection left open after peer close\n", route->name);
+        return 0;
+    }
+    lwip_host_release(pcb);
+    return 1;
+}
+
+/**
+ * Send every route in one segment on one connection, the last with
+ * "Connection: close", and check the responses come back in order.
+ */
+static int run_pipeline(const route_t *routes, size_t count) {
+    char req[2048];
+    size_t req_len = 0;
+    for (size_t i = 0; i < count; i++) {
+        req_len += (size_t)format_request(req + req_len, sizeof(req) - req_len,
+                                          routes[i].path, i + 1 == count);
+    }
+
+    struct tcp_pcb *pcb = lwip_host_connect();
+    if (!pcb) return 0;
+    lwip_host_deliver(pcb, req, req_len);
+    drain(pcb);
+
+    size_t out_len;
+    const uint8_t *out = lwip_host_output(pcb, &out_len);
+    int n = count_responses(out, out_len);
+    const lwip_host_stats_t *st = lwip_host_stats(pcb);
+    printf("pipeline: %zu requests in one segment -> %d responses, %u bytes, %u segs, %u rtts, closed=%d\n",
+           count, n, (unsigned)st->bytes, (unsigned)st->segments, (unsigned)st->round_trips,
+           lwip_host_is_closed(pcb));
+    if (n != (int)count || !lwip_host_is_closed(pcb)) return 0;
+
+    /* Responses must follow request order: the JS asset sits between the page and the JSON routes. */
+    long js = find_text(out, out_len, "application/javascript");
+    long json = find_text(out, out_len, "application/json");
+    if (js < 0 || json < 0 || js > json) return 0;
+    lwip_host_release(pcb);
+    return 1;
+}
+
+/** An idle keep-alive connection must be closed by the tcp_poll timer. */
+static int run_idle_timeout(void) {
+    char req[256];
+    int req_len = format_request(req, sizeof(req), "/api/state", 0);
+    struct tcp_pcb *pcb = lwip_host_connect();
+    if (!pcb) return 0;
+    lwip_host_deliver(pcb, req, (size_t)req_len);
+    drain(pcb);
+    int polls = 0;
+    while (!lwip_host_is_closed(pcb) && polls < 100) {
+        lwip_host_poll(pcb);
+        polls++;
+    }
+    printf("idle keep-alive connection closed after %d polls\n", polls);
+    if (!lwip_host_is_closed(pcb)) return 0;
+    lwip_host_release(pcb);
+    return 1;
+}
+
+/**
+ * Decode the chunked body of the single response in out into body.
+ * Returns the body length, or -1 if the framing is broken or incomplete.
+ */
+static long dechunk(const uint8_t *out, size_t len, char *body, size_t body_size, size_t *header_len) {
+    long hdr_end = find_text(out, len, "\r\n\r\n");
+    if (hdr_end < 0) return -1;
+    size_t pos = (size_t)hdr_end + 4;
+    *header_len = pos;
+    size_t n = 0;
+    for (;;) {
+        char line[16];
+        size_t i = 0;
+        while (pos + i < len && out[pos + i] != '\r' && i + 1 < sizeof(line)) {
+            line[i] = (char)out[pos + i];
+            i++;
+        }
+        line[i] = '\0';
+        pos += i + 2;
+        size_t chunk = strtoul(line, NULL, 16);
+        if (pos + chunk + 2 > len) return -1;
+        if (chunk == 0) return (pos + 2 == len) ? (long)n : -1;
+        if (n + chunk >= body_size) return -1;
+        memcpy(body + n, out + pos, chunk);
+        n += chunk;
+        body[n] = '\0';
+        pos += chunk;
+        if (memcmp(out + pos, "\r\n", 2) != 0) return -1;
+        pos += 2;
+    }
+}
+
+/**
+ * /metrics is generated part by part into one response slot: check the
+ * chunked framing, that the connection stays usable for the next request
+ * and that the per-route counters include the requests made so far.
+ */
+static int run_metrics(void) {
+    static char body[64 * 1024];
+    char req[512];
+    int req_len = format_request(req, sizeof(req), "/metrics", 0);
+    req_len += format_request(req + req_len, sizeof(req) - (size_t)req_len, "/api/state", 0);
+
+    struct tcp_pcb *pcb = lwip_host_connect();
+    if (!pcb) return 0;
+    lwip_host_deliver(pcb, req, (size_t)req_len);
+    drain(pcb);
+
+    size_t out_len;
+    const uint8_t *out = lwip_host_output(pcb, &out_len);
+    long state = find_text(out, out_len, "HTTP/1.1 200 OK\r\nContent-Type: application/json");
+    size_t header_len = 0;
+    long n = (state > 0) ? dechunk(out, (size_t)state, body, sizeof(body), &header_len) : -1;
+    const lwip_host_stats_t *st = lwip_host_stats(pcb);
+    printf("metrics: %ld bytes in %u segs, %u rtts, keep-alive=%d\n", n, (unsigned)st->segments,
+           (unsigned)st->round_trips, !lwip_host_is_closed(pcb));
+    if (n <= 0 || lwip_host_is_closed(pcb)) return 0;
+    if (!strstr((const char *)out, "Transfer-Encoding: chunked") || (size_t)n <= METRICS_BODY_SIZE) return 0;
+
+    static const char *const expect[] = {
+        "pico_http_requests_total{route=\"/api/state\"} ",
+        "pico_http_sent_bytes_total ",
+        "pico_lwip_pool{pool=\"pbuf_pool\",kind=\"size\"} ",
+        "pico_wifi_info{mode=\"sta\"} 1",
+        "pico_tick_compute_seconds_bucket{le=\"+Inf\"} ",
+        "pico_tick_latency_seconds_count ",
+    };
+    for (size_t i = 0; i < sizeof(expect) / sizeof(expect[0]); i++) {
+        if (!strstr(body, expect[i])) {
+            fprintf(stderr, "metrics: missing %s\n", expect[i]);
+            return 0;
+        }
+    }
+    const char *state_count = strstr(body, expect[0]) + strlen(expect[0]);
+    if (atol(state_count) < 1) return 0;
+
+    lwip_host_peer_close(pcb);
+    lwip_host_release(pcb);
+    return 1;
+}
+
+/**
+ * Check that out holds only whole SSE events after the stream header;
+ * returns the number of events or -1 on a fragment.
+ */
+static int count_sse_events(const uint8_t *out, size_t len) {
+    long body = find_text(out, len, "\r\n\r\nretry: 1000\n\n");
+    if (body < 0) return -1;
+    size_t pos = (size_t)body + 17;
+    int events = 0;
+    while (pos < len) {
+        const char *p = (const char *)out + pos;
+        size_t head;
+        if (len - pos > 20 && memcmp(p, "event: state\ndata: {", 20) == 0) {
+            head = 19;
+        } else if (len - pos > 22 && memcmp(p, "event: samples\ndata: {", 22) == 0) {
+            head = 21;
+        } else {
+            return -1;
+        }
+        long end = find_text(out + pos + head, len - pos - head, "\n");
+        if (end < 0 || pos + head + (size_t)end + 2 > len || out[pos + head + (size_t)end - 1] != '}' ||
+            out[pos + head + (size_t)end + 1] != '\n') {
+            return -1;
+        }
+        pos += head + (size_t)end + 2;
+        events++;
+    }
+    return events;
+}
+
+/**
+ * Check that out holds only whole server frames after the 101 response:
+ * state JSON as text, samples as binary; returns the frame count or -1.
+ */
+static int count_ws_frames(const uint8_t *out, size_t len) {
+    long body = find_text(out, len, "\r\n\r\n");
+    if (body < 0 || strncmp((const char *)out, "HTTP/1.1 101", 12) != 0) return -1;
+    size_t pos = (size_t)body + 4;
+    int frames = 0;
+    while (pos < len) {
+        if (len - pos < 2) return -1;
+        size_t head = 2, n = out[pos + 1];
+        if (n == 126) {
+            if (len - pos < 4) return -1;
+            n = (size_t)out[pos + 2] << 8 | out[pos + 3];
+            head = 4;
+        }
+        if (n == 0 || pos + head + n > len) return -1;
+        const uint8_t *payload = out + pos + head;
+        if (out[pos] == (0x80 | WS_OP_TEXT)) {
+            if (payload[0] != '{' || payload[n - 1] != '}') return -1;
+        } else if (out[pos] != (0x80 | WS_OP_BINARY) || payload[0] != WS_MSG_SAMPLES || n != 6u + 20u * payload[1]) {
+            return -1;
+        }
+        pos += head + n;
+        frames++;
+    }
+    return frames;
+}
+
+/**
+ * Push telemetry at 1 kHz to a stream client on a link acknowledged only
+ * every ack_ms, with every fault_every-th tcp_write failing with ERR_MEM:
+ * whatever is lost, the client must only ever see whole events or frames.
+ */
+static int run_stream_faults(int ws, uint32_t ack_ms, uint32_t fault_every) {
+    static const char sse_req[] = "GET /api/stream?period=20 HTTP/1.1\r\nHost: pico-w.local\r\n\r\n";
+    static const char ws_req[] = "GET /ws?period=20 HTTP/1.1\r\nHost: pico-w.local\r\nUpgrade: websocket\r\n"
+                                 "Connection: Upgrade\r\nSec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n"
+                                 "Sec-WebSocket-Version: 13\r\n\r\n";
+    struct tcp_pcb *pcb = lwip_host_connect();
+    if (!pcb) return 0;
+    if (ws) {
+        lwip_host_deliver(pcb, ws_req, sizeof(ws_req) - 1);
+    } else {
+        lwip_host_deliver(pcb, sse_req, sizeof(sse_req) - 1);
+    }
+    lwip_host_set_write_fault(pcb, fault_every);
+
+    sim_runtime_t rt = sim_state_get_runtime();
+    for (uint32_t ms = 1; ms <= 3000; ms++) {
+        rt.time_s += 0.001f;
+        telemetry_push(&rt);
+        lwip_host_advance_ms(1);
+        if (ms % ack_ms == 0) lwip_host_ack(pcb);
+    }
+    drain(pcb);
+
+    size_t out_len;
+    const uint8_t *out = lwip_host_output(pcb, &out_len);
+    int n = ws ? count_ws_frames(out, out_len) : count_sse_events(out, out_len);
+    const lwip_host_stats_t *st = lwip_host_stats(pcb);
+    printf("%s, ack every %3u ms, ERR_MEM every %u writes: %d whole %s, %u bytes, %u writes, %u failed\n",
+           ws ? "ws " : "sse", (unsigned)ack_ms, (unsigned)fault_every, n, ws ? "frames" : "events",
+           (unsigned)st->bytes, (unsigned)st->writes, (unsigned)st->write_errors);
+    lwip_host_peer_close(pcb);
+    lwip_host_release(pcb);
+    return n > 0;
+}
+
+/** Build a masked client frame carrying one parameter record; returns its length. */
+static size_t ws_param_frame(uint8_t *out, int fin, uint8_t opcode, sim_param_t id, float value) {
+    static const uint8_t mask[4] = {0x12, 0x34, 0x56, 0x78};
+    uint8_t payload[5];
+    payload[0] = (uint8_t)id;
+    memcpy(payload + 1, &value, sizeof(value));
+    out[0] = (uint8_t)((fin ? 0x80 : 0) | opcode);
+    out[1] = 0x80 | sizeof(payload);
+    memcpy(out + 2, mask, sizeof(mask));
+    for (size_t i = 0; i < sizeof(payload); i++) out[6 + i] = payload[i] ^ mask[i & 3];
+    return 6 + sizeof(payload);
+}
+
+/**
+ * A fragmented parameter message must close the WebSocket with 1003
+ * instead of applying its first fragment; a whole one is applied.
+ */
+static int run_ws_fragments(void) {
+    static const char req[] = "GET /ws?period=0 HTTP/1.1\r\nHost: pico-w.local\r\nUpgrade: websocket\r\n"
+                              "Connection: Upgrade\r\nSec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n"
+                              "Sec-WebSocket-Version: 13\r\n\r\n";
+    static const uint8_t close_unsupported[] = {0x80 | WS_OP_CLOSE, 2, WS_CLOSE_UNSUPPORTED >> 8,
+                                                WS_CLOSE_UNSUPPORTED & 0xFF, 0};
+    uint8_t frame[16];
+    struct tcp_pcb *pcb = lwip_host_connect();
+    if (!pcb) return 0;
+    lwip_host_deliver(pcb, req, sizeof(req) - 1);
+    lwip_host_deliver(pcb, frame, ws_param_frame(frame, 1, WS_OP_BINARY, SIM_PARAM_SETPOINT, 42.0f));
+    float whole = sim_state_get_config().setpoint;
+
+    lwip_host_deliver(pcb, frame, ws_param_frame(frame, 0, WS_OP_BINARY, SIM_PARAM_SETPOINT, 7.0f));
+    int closed = lwip_host_is_closed(pcb);
+    if (!closed) lwip_host_deliver(pcb, frame, ws_param_frame(frame, 1, WS_OP_CONT, SIM_PARAM_KP, 9.0f));
+    float after = sim_state_get_config().setpoint;
+    drain(pcb);
+    size_t out_len;
+    const uint8_t *out = lwip_host_output(pcb, &out_len);
+    int status = find_text(out, out_len, (const char *)close_unsupported) >= 0;
+    printf("ws fragments: whole message setpoint=%.1f, after fragment %.1f, closed=%d with 1003=%d\n", whole, after,
+           closed, status);
+    lwip_host_release(pcb);
+    return whole == 42.0f && after == 42.0f && closed && status;
+}
+
+/**
+ * A connection reset in the middle of PUT /api/record.bin must end the
+ * upload, or the recorder refuses recordings and uploads until reboot.
+ */
+static int run_upload_reset(void) {
+    static const char req[] = "PUT /api/record.bin HTTP/1.1\r\nHost: pico-w.local\r\nContent-Length: 1000\r\n\r\n";
+    uint8_t part[100];
+    memset(part, 0, sizeof(part));
+
+    struct tcp_pcb *pcb = lwip_host_connect();
+    if (!pcb) return 0;
+    lwip_host_deliver(pcb, req, sizeof(req) - 1);
+    lwip_host_deliver(pcb, part, sizeof(part));
+    sim_record_status_t st;
+    sim_record_get_status(&st);
+    int uploading = st.state == SIM_RECORD_UPLOADING;
+    lwip_host_peer_reset(pcb);
+    sim_record_get_status(&st);
+    printf("upload reset mid-body: recorder %s -> %s\n", uploading ? "uploading" : "idle",
+           st.state == SIM_RECORD_UPLOADING ? "uploading" : "released");
+    lwip_host_release(pcb);
+    if (!uploading || st.state == SIM_RECORD_UPLOADING) return 0;
+    if (!sim_record_start(SIM_RECORD_DEFAULT_EVERY)) return 0;
+    sim_record_stop();
+    return 1;
+}
+
+/** Run the offline job from "main loop" slices until it is answered; returns the polls used. */
+static int run_job_slices(void) {
+    int slices = 0;
+    while (web_server_poll(time_us_64() + JOB_SLICE_US)) slices++;
+    return slices + 1;
+}
+
+/**
+ * /api/simulate and /api/autotune run outside the lwIP callbacks: the
+ * handler only queues the job, the answer follows from web_server_poll().
+ * A second job is refused while one runs and a connection reset while
+ * waiting leaves nothing behind.
+ */
+static int run_offline_jobs(void) {
+    char req[512];
+    int n = format_request(req, sizeof(req), "/api/simulate?duration=20", 0);
+    n += format_request(req + n, sizeof(req) - (size_t)n, "/api/state", 0);
+    struct tcp_pcb *pcb = lwip_host_connect();
+    if (!pcb) return 0;
+    uint64_t t0 = time_us_64();
+    lwip_host_deliver(pcb, req, (size_t)n);
+    uint64_t t1 = time_us_64();
+    size_t out_len;
+    lwip_host_output(pcb, &out_len);
+    if (out_len != 0) return 0;
+
+    /* Idle polls must not close a connection waiting for its job. */
+    for (int i = 0; i < 100; i++) lwip_host_poll(pcb);
+    if (lwip_host_is_closed(pcb)) return 0;
+
+    char other[256];
+    int other_len = format_request(other, sizeof(other), "/api/autotune", 1);
+    struct tcp_pcb *busy = lwip_host_connect();
+    if (!busy) return 0;
+    lwip_host_deliver(busy, other, (size_t)other_len);
+    drain(busy);
+    const uint8_t *out = lwip_host_output(busy, &out_len);
+    int refused = find_text(out, out_len, "503") >= 0;
+    lwip_host_release(busy);
+
+    int slices = run_job_slices();
+    drain(pcb);
+    out = lwip_host_output(pcb, &out_len);
+    sim_config_t cfg = sim_state_get_config();
+    char ticks[32];
+    snprintf(ticks, sizeof(ticks), "\"ticks\":%u,", (unsigned)(20000000 / sim_loop_dt_us(&cfg)));
+    int answered = count_responses(out, out_len) == 2 && find_text(out, out_len, ticks) >= 0;
+    printf("offline simulate: handler %u us, answered after %d polls, second job %s\n",
+           (unsigned)(t1 - t0), slices, refused ? "refused" : "accepted");
+    lwip_host_release(pcb);
+    if (!refused || !answered) return 0;
+
+    /* Reset while waiting: the job runs out unanswered and the next one is accepted. */
+    n = format_request(req, sizeof(req), "/api/simulate?duration=20", 0);
+    pcb = lwip_host_connect();
+    if (!pcb) return 0;
+    lwip_host_deliver(pcb, req, (size_t)n);
+    web_server_poll(time_us_64() + JOB_SLICE_US);
+    lwip_host_peer_reset(pcb);
+    run_job_slices();
+    lwip_host_release(pcb);
+
+    n = format_request(req, sizeof(req), "/api/autotune?duration=20", 1);
+    pcb = lwip_host_connect();
+    if (!pcb) return 0;
+    lwip_host_deliver(pcb, req, (size_t)n);
+    slices = run_job_slices();
+    drain(pcb);
+    out = lwip_host_output(pcb, &out_len);
+    answered = lwip_host_is_closed(pcb) && count_responses(out, out_len) == 1 && find_text(out, out_len, "\"ok\":1") >= 0;
+    printf("offline autotune: answered after %d polls\n", slices);
+    lwip_host_release(pcb);
+    return answered;
+}
+
+/** One core1 tick with the recorder hooks, as in sim_worker.c. */
+static void record_tick(sim_loop_t *loop, const sim_config_t *cfg, sim_runtime_t *rt) {
+    sim_record_tick_begin(loop, cfg, rt, 0);
+    sim_loop_step(loop, cfg, rt);
+    sim_record_tick_end(rt);
+}
+
+/**
+ * A new recording started mid-download must abort the /api/record.bin
+ * connection, not end a Content-Length body short with a clean close.
+ */
+static int run_record_replaced(void) {
+    static sim_loop_t loop;
+    sim_config_t cfg = sim_state_get_config();
+    sim_runtime_t rt = sim_state_get_runtime();
+    sim_loop_reset(&loop, &cfg);
+    if (!sim_record_start(1)) return 0;
+    for (int i = 0; i < 3000; i++) record_tick(&loop, &cfg, &rt);
+    sim_record_stop();
+    record_tick(&loop, &cfg, &rt);
+    sim_record_status_t st;
+    sim_record_get_status(&st);
+    if (st.state != SIM_RECORD_DONE || st.bytes <= 2 * TCP_SND_BUF) return 0;
+
+    char req[256];
+    int n = format_request(req, sizeof(req), "/api/record.bin", 0);
+    struct tcp_pcb *pcb = lwip_host_connect();
+    if (!pcb) return 0;
+    lwip_host_deliver(pcb, req, (size_t)n);
+    /* core1 starts the next recording while the first flight is on the wire. */
+    if (!sim_record_start(1)) return 0;
+    record_tick(&loop, &cfg, &rt);
+    drain(pcb);
+    for (int i = 0; i < 3 && !lwip_host_is_closed(pcb); i++) lwip_host_poll(pcb);
+
+    size_t out_len;
+    const uint8_t *out = lwip_host_output(pcb, &out_len);
+    long head = find_text(out, out_len, "\r\n\r\n");
+    size_t body = (head < 0) ? 0 : out_len - (size_t)head - 4;
+    int aborted = lwip_host_is_aborted(pcb);
+    printf("record.bin replaced mid-download: %zu of %u body bytes, %s\n", body, (unsigned)st.bytes,
+           aborted ? "aborted" : lwip_host_is_closed(pcb) ? "closed" : "open");
+    lwip_host_release(pcb);
+    sim_record_stop();
+    record_tick(&loop, &cfg, &rt);
+    return aborted && body < st.bytes;
+}
+
+/** JSON body of one request on a new connection; 0 if it did not come back whole. */
+static int get_body(const char *path, char *body, size_t body_size) {
+    char req[256];
+    int n = format_request(req, sizeof(req), path, 1);
+    struct tcp_pcb *pcb = lwip_host_connect();
+    if (!pcb) return 0;
+    lwip_host_deliver(pcb, req, (size_t)n);
+    drain(pcb);
+    size_t out_len;
+    const uint8_t *out = lwip_host_output(pcb, &out_len);
+    long head = find_text(out, out_len, "\r\n\r\n");
+    int ok = head >= 0 && count_responses(out, out_len) == 1 && out_len - (size_t)head - 4 < body_size;
+    if (ok) {
+        memcpy(body, out + head + 4, out_len - (size_t)head - 4);
+        body[out_len - (size_t)head - 4] = '\0';
+    }
+    lwip_host_release(pcb);
+    return ok;
+}
+
+/** /api/state reports the dead time the live line applies when a short dt cuts it. */
+static int run_dead_eff(void) {
+    static char body[4096];
+    sim_config_t cfg = sim_state_get_config();
+    char restore[64];
+    snprintf(restore, sizeof(restore), "/api/set?dt_us=%d&dead=%d", cfg.dt_us, cfg.plant.dead_time_ms);
+    if (!get_body("/api/set?dt_us=100&dead=2560", body, sizeof(body))) return 0;
+    int cut = strstr(body, "\"dead\":2560,\"dead_eff\":281.5,") != NULL;
+    if (!get_body("/api/set?dt_us=1000", body, sizeof(body))) return 0;
+    int full = strstr(body, "\"dead\":2560,\"dead_eff\":2560.0,") != NULL;
+    if (!get_body(restore, body, sizeof(body))) return 0;
+    printf("dead_eff at dt 100 us: %s, at dt 1 ms: %s\n", cut ? "281.5 ms" : "wrong", full ? "2560 ms" : "wrong");
+    return cut && full;
+}
+
+/** /api/batch reports the dead time an instance runs with when its ring cuts it. */
+static int run_batch_dead_eff(void) {
+    static char body[4096];
+    char want[64];
+    sim_config_t cfg = sim_state_get_config();
+    snprintf(want, sizeof(want), "\"dead\":2560,\"dead_eff\":%.1f,",
+             (double)sim_batch_dead_ms(2560, sim_loop_dt_us(&cfg)));
+    if (!get_body("/api/batch/set?id=0&en=1&dead=2560", body, sizeof(body))) return 0;
+    if (!get_body("/api/batch?id=0", body, sizeof(body))) return 0;
+    int cut = strstr(body, want) != NULL && strstr(body, "\"limited\":1,") != NULL;
+    if (!get_body("/api/batch/set?id=0&en=0&dead=0", body, sizeof(body))) return 0;
+    printf("batch instance at 2560 ms: %s\n", cut ? want : "cut not reported");
+    return cut;
+}
+
+int main(int argc, char **argv) {
+    int iterations = (argc > 1) ? atoi(argv[1]) : DEFAULT_ITERATIONS;
+    if (iterations <= 0) iterations = DEFAULT_ITERATIONS;
+
+    sim_state_init();
+    telemetry_init();
+    sim_record_init();
+    sim_batch_init();
+    sim_runtime_t rt = sim_state_get_runtime();
+    for (int i = 0; i < TELEMETRY_RING_SIZE; i++) {
+        rt.time_s += 0.001f;
+        telemetry_push(&rt);
+    }
+
+    if (!start_http_server()) {
+        fprintf(stderr, "start_http_server failed\n");
+        return 1;
+    }
+
+    static const route_t routes[] = {
+        {"page", "/"},
+        {"app.js", "/app.js"},
+        {"state", "/api/state"},
+        {"history", "/api/history?since=0"},
+    };
+
+    printf("HTTP send path, %d requests per route, TCP_MSS=%d TCP_SND_BUF=%d TCP_SND_QUEUELEN=%d\n",
+           iterations, TCP_MSS, TCP_SND_BUF, TCP_SND_QUEUELEN);
+    printf("%-8s %8s %6s %6s %7s %6s %10s %14s %14s\n",
+           "route", "bytes", "segs", "rtts", "writes", "ERR_MEM", "cpu ns", "cpu bytes/s", "link bytes/s*");
+    for (size_t i = 0; i < sizeof(routes) / sizeof(routes[0]); i++) {
+        route_result_t r;
+        if (!run_route(&routes[i], iterations, &r)) return 1;
+        printf("%-8s %8.0f %6.1f %6.1f %7.1f %6.1f %10.0f %14.0f %14.0f\n",
+               routes[i].name, r.bytes, r.segments, r.round_trips, r.writes, r.write_errors,
+               r.cpu_ns, r.bytes * 1e9 / r.cpu_ns, r.bytes / (r.round_trips * MODEL_RTT_MS / 1000.0));
+    }
+    printf("* link bytes/s assumes one %.0f ms round trip per acknowledged flight\n", MODEL_RTT_MS);
+
+    printf("\nkeep-alive, %d requests on one connection per route\n", iterations);
+    printf("%-8s %8s %6s %6s %7s %6s %10s\n", "route", "bytes", "segs", "rtts", "writes", "ERR_MEM", "cpu ns");
+    for (size_t i = 0; i < sizeof(routes) / sizeof(routes[0]); i++) {
+        route_result_t r;
+        if (!run_route_keep_alive(&routes[i], iterations, &r)) return 1;
+        printf("%-8s %8.0f %6.1f %6.1f %7.1f %6.1f %10.0f\n",
+               routes[i].name, r.bytes, r.segments, r.round_trips, r.writes, r.write_errors, r.cpu_ns);
+    }
+
+    if (!run_pipeline(routes, sizeof(routes) / sizeof(routes[0]))) {
+        fprintf(stderr, "pipelined responses missing or out of order\n");
+        return 1;
+    }
+    if (!run_idle_timeout()) {
+        fprintf(stderr, "idle connection not closed\n");
+        return 1;
+    }
+    if (!run_metrics()) {
+        fprintf(stderr, "/metrics response malformed\n");
+        return 1;
+    }
+    for (int ws = 0; ws <= 1; ws++) {
+        if (!run_stream_faults(ws, 20, 0) || !run_stream_faults(ws, 250, 0) || !run_stream_faults(ws, 20, 2) ||
+            !run_stream_faults(ws, 20, 3)) {
+            fprintf(stderr, "%s stream carries a partial event or frame\n", ws ? "WebSocket" : "SSE");
+            return 1;
+        }
+    }
+    if (!run_ws_fragments()) {
+        fprintf(stderr, "fragmented WebSocket message applied or not refused\n");
+        return 1;
+    }
+    if (!run_upload_reset()) {
+        fprintf(stderr, "upload left the recorder busy after a connection reset\n");
+        return 1;
+    }
+    if (!run_record_replaced()) {
+        fprintf(stderr, "recording replaced mid-download not aborted\n");
+        return 1;
+    }
+    if (!run_dead_eff()) {
+        fprintf(stderr, "/api/state does not report the cut dead time\n");
+        return 1;
+    }
+    if (!run_batch_dead_eff()) {
+        fprintf(stderr, "/api/batch does not report the cut dead time\n");
+        return 1;
+    }
+    if (!run_offline_jobs()) {
+        fprintf(stderr, "offline job answered in the lwIP callback, not at all or twice\n");
+        return 1;
+    }
+    return 0;
+}
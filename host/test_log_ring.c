@@ -0,0 +1,43 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "log_ring.h"
+
+/** Pop one entry and compare it with the expected line. */
+static int expect_line(const char *want) {
+    char line[192];
+    if (!log_ring_pop(line, sizeof(line))) {
+        fprintf(stderr, "no entry, expected \"%s\"\n", want);
+        return 0;
+    }
+    printf("%s", line);
+    if (strcmp(line, want) != 0) {
+        fprintf(stderr, "expected \"%s\"\n", want);
+        return 0;
+    }
+    return 1;
+}
+
+int main(void) {
+    /* Each string keeps a terminator inside the entry's LOG_TEXT_SIZE bytes. */
+    static const char long1[] = "first string longer than the text buffer";
+    static const char long2[] = "second string, also too long";
+    char want[128];
+
+    LOG_RING("a=%s b=%s n=%d\n", long1, long2, 7);
+    snprintf(want, sizeof(want), "a=%.*s b= n=7\n", LOG_TEXT_SIZE - 1, long1);
+    if (!expect_line(want)) return 1;
+
+    LOG_RING("a=%s b=%s c=%s\n", "0123456789", long2, "x");
+    snprintf(want, sizeof(want), "a=0123456789 b=%.*s c=\n", LOG_TEXT_SIZE - 12, long2);
+    if (!expect_line(want)) return 1;
+
+    LOG_RING("%s|%s|%s|%s\n", "ab", "", "cd", (const char *)NULL);
+    if (!expect_line("ab||cd|(null)\n")) return 1;
+
+    if (log_ring_pop(want, sizeof(want))) {
+        fprintf(stderr, "unexpected extra entry\n");
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,84 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "pico/time.h"
+
+#include "delay_line.h"
+#include "sim_params.h"
+#include "sim_run.h"
+#include "sim_state.h"
+#include "sweep.h"
+
+#define SLICE_US 300 // the core1 margin sweep_work() runs in
+
+/** Order-8 transfer function 1 / (s + 1)^8. */
+static int set_order8(sim_config_t *cfg) {
+    static const float num[] = {1.0f};
+    static const float den[] = {1.0f, 8.0f, 28.0f, 56.0f, 70.0f, 56.0f, 28.0f, 8.0f, 1.0f};
+    return sim_param_set_tf(cfg, num, 1, den, 9);
+}
+
+/** Run a whole job on one worker in SLICE_US slices; returns the largest overrun of a slice. */
+static uint32_t run_job(const sweep_spec_t *spec, const sim_config_t *cfg, sweep_status_t *st) {
+    static sweep_worker_t w;
+    sweep_worker_init(&w, 0);
+    if (!sweep_start(spec, cfg)) return UINT32_MAX;
+    uint32_t worst = 0;
+    for (;;) {
+        uint64_t deadline = time_us_64() + SLICE_US;
+        int more = sweep_work(&w, deadline);
+        uint64_t now = time_us_64();
+        if (now > deadline && (uint32_t)(now - deadline) > worst) worst = (uint32_t)(now - deadline);
+        if (!more) break;
+    }
+    *st = sweep_get_status();
+    return worst;
+}
+
+int main(void) {
+    delay_pool_init();
+    sim_state_init();
+    sweep_init();
+    sim_config_t cfg = sim_state_get_config();
+    if (!set_order8(&cfg)) return 1;
+
+    /* A restart with other gains keeps the discrete plant; another plant drops it. */
+    static sim_run_t run;
+    sim_run_start(&run, &cfg, 1.0f, SIM_RUN_DEFAULT_BAND);
+    sim_run_advance(&run, run.ticks);
+    cfg.pid.kp += 1.0f;
+    sim_run_start(&run, &cfg, 1.0f, SIM_RUN_DEFAULT_BAND);
+    int kept = run.loop.plant_valid;
+    sim_config_t other = cfg;
+    other.plant.tf_den[8] = 2.0f;
+    sim_run_start(&run, &other, 1.0f, SIM_RUN_DEFAULT_BAND);
+    int dropped = !run.loop.plant_valid;
+    sim_run_advance(&run, run.ticks);
+    printf("discrete plant kept across gains: %d, dropped for another plant: %d\n", kept, dropped);
+    if (!kept || !dropped) return 1;
+
+    sweep_spec_t spec = {
+        .kp = {0.5f, 4.0f, 4}, .ki = {0.0f, 1.0f, 4}, .kd = {0.0f, 0.5f, 2},
+        .duration_s = 5.0f, .overshoot_weight = 1.0f,
+    };
+    sweep_status_t st;
+    cfg.plant.dead_time_ms = 500;
+    uint32_t worst = run_job(&spec, &cfg, &st);
+    printf("order-8 sweep: %d points, best %d, limited %d, worst slice overrun %u us\n", st.done, st.best,
+           st.limited, (unsigned)worst);
+    if (st.state != SWEEP_DONE || st.best < 0 || st.limited != 0) return 1;
+
+    /* At dt 100 us the storage holds less than 2560 ms: no point may become best. */
+    cfg.dt_us = 100;
+    cfg.plant.dead_time_ms = 2560;
+    spec.duration_s = 1.0f;
+    run_job(&spec, &cfg, &st);
+    printf("cut dead time sweep: %d points, best %d, limited %d\n", st.done, st.best, st.limited);
+    if (st.state != SWEEP_DONE || st.best != -1 || st.limited != st.total) return 1;
+
+    int idx[1];
+    sweep_result_t res[1];
+    int next;
+    if (sweep_read_results(0, idx, res, 1, &next) != 1 || !res[0].dead_limited) return 1;
+    return 0;
+}
@@ -0,0 +1,249 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pico/time.h"
+
+#include "delay_line.h"
+#include "lwip_host.h"
+#include "sim_loop.h"
+#include "sim_state.h"
+#include "telemetry.h"
+#include "udp_channel.h"
+
+#define DEFAULT_TICKS 20000
+#define SETPOINT_EVERY 10 // ticks between master setpoints
+#define DROP_SETPOINT_EVERY 7 // every 7th setpoint packet is lost on the way in
+#define REPLAY_EVERY 11 // every 11th setpoint is followed by a late duplicate of the previous one
+#define DROP_SAMPLES_EVERY 13 // every 13th sample packet is lost on the way out
+#define RENEW_EVERY 1000 // ticks between subscription renewals
+#define MASTER_PORT 6000
+#define SUBSCRIBER_PORT 6001
+
+static const ip_addr_t k_master = {0x0201A8C0u}; // 192.168.1.2
+static const ip_addr_t k_subscriber = {0x0301A8C0u}; // 192.168.1.3
+
+/* core1 stand-in: the live pipeline stepped once per simulated millisecond. */
+static sim_loop_t g_loop;
+static sim_config_t g_cfg;
+static sim_runtime_t g_rt;
+
+typedef struct {
+    uint32_t packets; // sample packets received
+    uint32_t samples;
+    uint32_t taken; // sample packets the device sent, lost ones included
+    uint32_t dropped; // sample packets dropped on the way to the subscriber
+    uint32_t gaps; // packets missing by the subscriber's seq check
+    uint32_t last_seq;
+    uint32_t last_first;
+    uint32_t ack; // newest setpoint acknowledged
+    int bad; // flag: a packet broke the format or the setpoint did not reach the samples
+} subscriber_t;
+
+static float setpoint_of(uint32_t seq) {
+    return 10.0f + (float)(seq % 50u);
+}
+
+static void header(udp_msg_header_t *h, udp_msg_type_t type, uint32_t seq) {
+    h->magic = UDP_CHANNEL_MAGIC;
+    h->version = UDP_CHANNEL_VERSION;
+    h->type = (uint8_t)type;
+    h->seq = seq;
+}
+
+static void send_setpoint(uint32_t seq) {
+    udp_setpoint_msg_t m;
+    header(&m.hdr, UDP_MSG_SETPOINT, seq);
+    m.setpoint = setpoint_of(seq);
+    m.flags = UDP_SETPOINT_USE_MASTER;
+    lwip_host_udp_deliver(UDP_CHANNEL_PORT, &k_master, MASTER_PORT, &m, sizeof(m));
+}
+
+static void send_subscribe(uint16_t decimation, uint16_t batch) {
+    static uint32_t seq;
+    udp_subscribe_msg_t m;
+    header(&m.hdr, UDP_MSG_SUBSCRIBE, ++seq);
+    m.decimation = decimation;
+    m.batch = batch;
+    lwip_host_udp_deliver(UDP_CHANNEL_PORT, &k_subscriber, SUBSCRIBER_PORT, &m, sizeof(m));
+}
+
+/** One core1 tick as in sim_worker.c, then one millisecond of lwIP timers. */
+static void tick(void) {
+    sim_state_try_get_config(&g_cfg);
+    sim_loop_step(&g_loop, &g_cfg, &g_rt);
+    sim_state_publish_runtime(&g_rt);
+    telemetry_push(&g_rt);
+    lwip_host_advance_ms(1);
+}
+
+/**
+ * Take the datagrams sent to the subscriber, dropping every
+ * DROP_SAMPLES_EVERY-th, and check the packets that arrive.
+ */
+static void receive(subscriber_t *s, uint16_t decimation, uint16_t batch) {
+    static uint8_t buf[1500];
+    ip_addr_t to;
+    u16_t port;
+    size_t len;
+    while ((len = lwip_host_udp_take(buf, sizeof(buf), &to, &port)) > 0) {
+        if (++s->taken % DROP_SAMPLES_EVERY == 0) {
+            s->dropped++;
+            continue;
+        }
+        udp_samples_msg_t m;
+        memcpy(&m, buf, sizeof(m));
+        if (port != SUBSCRIBER_PORT || to.addr != k_subscriber.addr || m.hdr.magic != UDP_CHANNEL_MAGIC ||
+            m.hdr.type != UDP_MSG_SAMPLES || m.decimation != decimation || m.count != batch ||
+            len != sizeof(m) + m.count * sizeof(udp_sample_t)) {
+            s->bad = 1;
+            continue;
+        }
+        uint32_t missing = s->packets ? m.hdr.seq - s->last_seq - 1u : 0;
+        if (s->packets && m.first != s->last_first + (missing + 1u) * batch * decimation) s->bad = 1;
+        s->gaps += missing;
+        s->last_seq = m.hdr.seq;
+        s->last_first = m.first;
+        s->packets++;
+        s->samples += m.count;
+        s->ack = m.ack;
+        /* The setpoint was applied before the tick, so its samples already follow it. */
+        udp_sample_t last;
+        memcpy(&last, buf + sizeof(m) + (m.count - 1u) * sizeof(udp_sample_t), sizeof(last));
+        if (m.ack && last.setpoint != setpoint_of(m.ack)) s->bad = 1;
+    }
+}
+
+int main(int argc, char **argv) {
+    long ticks = (argc > 1) ? atol(argv[1]) : DEFAULT_TICKS;
+    if (ticks <= 0) ticks = DEFAULT_TICKS;
+
+    sim_state_init();
+    delay_pool_init();
+    telemetry_init();
+    sim_state_config_begin();
+    g_sim.cfg.running = 1;
+    g_sim.cfg.dt_us = 1000;
+    sim_state_config_end();
+    g_cfg = sim_state_get_config();
+    g_rt = sim_state_get_runtime();
+    sim_loop_reset(&g_loop, &g_cfg);
+
+    if (!udp_channel_start()) {
+        fprintf(stderr, "udp_channel_start failed\n");
+        return 1;
+    }
+
+    /* Master setpoints at loop rate against a subscriber streaming every tick. */
+    subscriber_t sub;
+    memset(&sub, 0, sizeof(sub));
+    send_subscribe(1, 1);
+    uint32_t sent = 0, dropped = 0, replays = 0;
+    uint32_t rtt_ticks_max = 0;
+    double rtt_ticks_sum = 0.0, rtt_us_sum = 0.0, rtt_us_max = 0.0;
+    uint32_t rtts = 0;
+    for (long t = 0; t < ticks; t++) {
+        if (t % RENEW_EVERY == RENEW_EVERY - 1) send_subscribe(1, 1);
+        if (t % SETPOINT_EVERY != 0) {
+            tick();
+            receive(&sub, 1, 1);
+            continue;
+        }
+        uint32_t seq = ++sent;
+        if (seq % DROP_SETPOINT_EVERY == 0 && t + SETPOINT_EVERY < ticks) {
+            dropped++;
+            tick();
+            receive(&sub, 1, 1);
+            continue;
+        }
+        uint64_t t0 = time_us_64();
+        send_setpoint(seq);
+        if (seq % REPLAY_EVERY == 0) {
+            send_setpoint(seq - 1u);
+            replays++;
+        }
+        uint32_t n = 0;
+        while (sub.ack != seq && n < SETPOINT_EVERY) {
+            tick();
+            receive(&sub, 1, 1);
+            n++;
+        }
+        double us = (double)(time_us_64() - t0);
+        if (sub.ack == seq) {
+            rtts++;
+            rtt_ticks_sum += n;
+            rtt_us_sum += us;
+            if (n > rtt_ticks_max) rtt_ticks_max = n;
+            if (us > rtt_us_max) rtt_us_max = us;
+        }
+        t += n - 1;
+    }
+    udp_channel_stats_t st = udp_channel_get_stats();
+
+    printf("UDP channel, %ld ticks at dt_us=1000, setpoint every %d ticks, decimation 1, batch 1\n", ticks,
+           SETPOINT_EVERY);
+    printf("setpoints: sent %u, lost %u (device counted %u), duplicates %u (device counted %u stale), applied %u\n",
+           (unsigned)sent, (unsigned)dropped, (unsigned)st.lost, (unsigned)replays, (unsigned)st.stale,
+           (unsigned)st.setpoints);
+    printf("round trip to the first sample with the new setpoint: mean %.2f ticks, max %u ticks, "
+           "host cpu mean %.1f us, max %.1f us (%u of %u acknowledged)\n",
+           rtts ? rtt_ticks_sum / rtts : 0.0, (unsigned)rtt_ticks_max, rtts ? rtt_us_sum / rtts : 0.0, rtt_us_max,
+           (unsigned)rtts, (unsigned)(sent - dropped));
+    printf("samples: %u packets sent, %u dropped, %u detected missing by seq, %u received\n",
+           (unsigned)sub.taken, (unsigned)sub.dropped, (unsigned)sub.gaps, (unsigned)sub.packets);
+    /* A round trip is one tick, or two when the packet carrying the acknowledgement was dropped. */
+    if (sub.bad || st.lost != dropped || st.stale != replays || st.setpoints != sent - dropped ||
+        rtts != sent - dropped || rtt_ticks_max > 2 || st.tx_errors != 0) {
+        fprintf(stderr, "setpoint stream: sequence accounting or latency wrong\n");
+        return 1;
+    }
+    /* A dropped packet is only noticed once a later one arrives. */
+    uint32_t trailing = (sub.taken % DROP_SAMPLES_EVERY == 0) ? 1u : 0u;
+    if (sub.gaps + trailing != sub.dropped || sub.packets + sub.dropped != sub.taken || st.tx_packets != sub.taken) {
+        fprintf(stderr, "sample stream: loss not detected from the packet seq\n");
+        return 1;
+    }
+
+    /* Decimated, batched stream: 8 samples of every 10th tick per packet. */
+    memset(&sub, 0, sizeof(sub));
+    send_subscribe(10, 8);
+    for (int t = 0; t < 1600; t++) {
+        tick();
+        receive(&sub, 10, 8);
+    }
+    printf("decimation 10, batch 8: %u packets, %u samples in 1600 ticks\n", (unsigned)sub.packets + sub.dropped,
+           (unsigned)sub.samples);
+    if (sub.bad || sub.packets + sub.dropped != 20) {
+        fprintf(stderr, "decimated stream malformed\n");
+        return 1;
+    }
+
+    /* Malformed datagrams are counted and ignored. */
+    uint32_t malformed = udp_channel_get_stats().rx_malformed;
+    lwip_host_udp_deliver(UDP_CHANNEL_PORT, &k_master, MASTER_PORT, "hello", 5);
+    udp_setpoint_msg_t bad;
+    header(&bad.hdr, UDP_MSG_SETPOINT, sent + 1u);
+    bad.hdr.version = UDP_CHANNEL_VERSION + 1;
+    lwip_host_udp_deliver(UDP_CHANNEL_PORT, &k_master, MASTER_PORT, &bad, sizeof(bad));
+    if (udp_channel_get_stats().rx_malformed != malformed + 2) {
+        fprintf(stderr, "malformed datagrams not rejected\n");
+        return 1;
+    }
+
+    /* Without renewals the subscription lapses and the stream stops. */
+    for (int t = 0; t < UDP_CHANNEL_LEASE_MS + 10; t++) {
+        tick();
+        receive(&sub, 10, 8);
+    }
+    uint32_t after = sub.taken;
+    for (int t = 0; t < 100; t++) {
+        tick();
+        receive(&sub, 10, 8);
+    }
+    printf("lease: subscriber dropped after %d ms without renewal\n", UDP_CHANNEL_LEASE_MS);
+    if (udp_channel_get_stats().subscribed || sub.taken != after) {
+        fprintf(stderr, "subscription did not expire\n");
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,15 @@
+// Host stand-in for the Wi-Fi manager: a station link without an RSSI reading.
+
+#include "wifi_manager.h"
+
+wifi_mode_t wifi_get_mode(void) {
+    return WIFI_MODE_STA;
+}
+
+void wifi_poll(void) {
+}
+
+int wifi_get_rssi(int32_t *rssi) {
+    (void)rssi;
+    return 0;
+}
@@ -0,0 +1,184 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "hardware/sync.h"
+#include "pico/platform.h"
+#include "pico/time.h"
+
+#include "log_ring.h"
+
+#define LOG_RING_MASK (LOG_RING_SIZE - 1u)
+
+typedef struct {
+    const char *fmt; // message ID; read only when printing
+    uint32_t time_us; // orders the entries of both cores when printing
+    uint8_t nargs;
+    uint16_t types; // 2 bits per argument (log_arg_type_t)
+    uint32_t arg[LOG_MAX_ARGS];
+    char text[LOG_TEXT_SIZE]; // copied string arguments, NUL-separated
+} log_entry_t;
+
+/*
+ * One single-producer ring per core, so the cores never contend. On a
+ * core the writers are the thread and its IRQ handlers (lwIP callbacks
+ * run from an IRQ on core0), so a write masks interrupts for the copy.
+ * core0 is the only reader.
+ */
+typedef struct {
+    volatile uint32_t head; // written by the owning core
+    volatile uint32_t tail; // written by the reader
+    volatile uint32_t dropped;
+    log_entry_t entry[LOG_RING_SIZE];
+} log_ring_t;
+
+static log_ring_t g_log[2];
+static uint32_t g_log_dropped_reported;
+
+/** Append one entry to the calling core's ring; a full ring drops it. */
+void log_ring_write(const char *fmt, const log_arg_t *args, int nargs) {
+    log_ring_t *ring = &g_log[get_core_num() & 1u];
+    if (nargs > LOG_MAX_ARGS) nargs = LOG_MAX_ARGS;
+
+    uint32_t irq = save_and_disable_interrupts();
+    uint32_t head = ring->head;
+    if (head - ring->tail >= LOG_RING_SIZE) {
+        ring->dropped++;
+        restore_interrupts(irq);
+        return;
+    }
+    log_entry_t *e = &ring->entry[head & LOG_RING_MASK];
+    e->fmt = fmt;
+    e->time_us = time_us_32();
+    e->nargs = (uint8_t)nargs;
+    e->types = 0;
+    size_t text = 0;
+    for (int i = 0; i < nargs; i++) {
+        e->types |= (uint16_t)(args[i].type << (2 * i));
+        if (args[i].type == LOG_ARG_STR) {
+            /* Strings may live in a buffer that is reused right after the call. */
+            /* Once the buffer is full, later strings share its final NUL and print empty. */
+            e->arg[i] = (uint32_t)text;
+            const char *s = args[i].v.s ? args[i].v.s : "(null)";
+            while (*s && text + 1 < sizeof(e->text)) e->text[text++] = *s++;
+            e->text[text] = '\0';
+            if (text + 1 < sizeof(e->text)) text++;
+        } else {
+            e->arg[i] = args[i].v.u;
+        }
+    }
+    __dmb();
+    ring->head = head + 1u;
+    restore_interrupts(irq);
+}
+
+/**
+ * Copy one conversion spec from *fmt into spec, without length modifiers
+ * (arguments are stored as 32 bits) or '*' widths; returns its conversion.
+ */
+static char log_parse_spec(const char **fmt, char *spec, size_t spec_len) {
+    const char *p = *fmt; // at the '%'
+    size_t n = 0;
+    spec[n++] = *p++;
+    while (*p && !strchr("diouxXcsfFeEgGaAp%", *p)) {
+        if (!strchr("hlLqjzt*", *p) && n + 2 < spec_len) spec[n++] = *p;
+        p++;
+    }
+    char conv = *p;
+    if (conv) {
+        spec[n++] = conv;
+        p++;
+    }
+    spec[n] = '\0';
+    *fmt = p;
+    return conv;
+}
+
+/** Print one conversion of an argument at out; returns the characters written. */
+static size_t log_format_arg(char *out, size_t out_len, const char *spec, char conv, const log_entry_t *e, int i) {
+    log_arg_type_t type = (log_arg_type_t)((e->types >> (2 * i)) & 3u);
+    uint32_t raw = e->arg[i];
+    float f;
+    memcpy(&f, &raw, sizeof(f));
+    int n;
+    switch (conv) {
+    case 's':
+        n = snprintf(out, out_len, spec, type == LOG_ARG_STR && raw < sizeof(e->text) ? e->text + raw : "?");
+        break;
+    case 'f': case 'F': case 'e': case 'E': case 'g': case 'G': case 'a': case 'A':
+        n = snprintf(out, out_len, spec, type == LOG_ARG_FLOAT ? (double)f : (double)(int32_t)raw);
+        break;
+    case 'p':
+        n = snprintf(out, out_len, spec, (void *)(uintptr_t)raw);
+        break;
+    case 'd': case 'i': case 'c':
+        n = snprintf(out, out_len, spec, type == LOG_ARG_FLOAT ? (int)f : (int)(int32_t)raw);
+        break;
+    default:
+        n = snprintf(out, out_len, spec, type == LOG_ARG_FLOAT ? (unsigned)f : (unsigned)raw);
+        break;
+    }
+    if (n < 0) return 0;
+    return ((size_t)n < out_len) ? (size_t)n : out_len - 1;
+}
+
+/** Expand an entry's format string with its stored arguments. */
+static void log_format(char *out, size_t out_len, const log_entry_t *e) {
+    const char *p = e->fmt;
+    size_t pos = 0;
+    int arg = 0;
+    while (*p && pos + 1 < out_len) {
+        if (*p != '%') {
+            out[pos++] = *p++;
+            continue;
+        }
+        char spec[16];
+        char conv = log_parse_spec(&p, spec, sizeof(spec));
+        if (conv == '%') {
+            out[pos++] = '%';
+        } else if (conv && arg < e->nargs) {
+            pos += log_format_arg(out + pos, out_len - pos, spec, conv, e, arg++);
+        }
+    }
+    out[pos] = '\0';
+}
+
+/** Remove the oldest pending entry of both cores and format it into line; 0 if none is pending. */
+int log_ring_pop(char *line, size_t line_len) {
+    log_ring_t *next = NULL;
+    for (int c = 0; c < 2; c++) {
+        log_ring_t *ring = &g_log[c];
+        if (ring->tail == ring->head) continue;
+        __dmb();
+        const log_entry_t *e = &ring->entry[ring->tail & LOG_RING_MASK];
+        if (!next || (int32_t)(e->time_us - next->entry[next->tail & LOG_RING_MASK].time_us) < 0) next = ring;
+    }
+    if (!next) return 0;
+
+    log_entry_t e = next->entry[next->tail & LOG_RING_MASK];
+    __dmb();
+    next->tail = next->tail + 1u;
+    log_format(line, line_len, &e);
+    return 1;
+}
+
+/** Format and print up to max pending entries, oldest first. */
+int log_ring_drain(int max) {
+    static char line[192];
+    int printed = 0;
+
+    uint32_t dropped = log_ring_dropped();
+    if (dropped != g_log_dropped_reported) {
+        printf("LOG dropped %u entries\n", (unsigned)(dropped - g_log_dropped_reported));
+        g_log_dropped_reported = dropped;
+    }
+    while (printed < max && log_ring_pop(line, sizeof(line))) {
+        fputs(line, stdout);
+        printed++;
+    }
+    return printed;
+}
+
+/** Entries dropped on a full ring since boot. */
+uint32_t log_ring_dropped(void) {
+    return g_log[0].dropped + g_log[1].dropped;
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Entries per core; must be a power of two.
+#define LOG_RING_SIZE 64
+#define LOG_MAX_ARGS 6
+#define LOG_TEXT_SIZE 24 // bytes of %s arguments copied per entry (NUL-separated, truncated)
+
+typedef enum {
+    LOG_ARG_INT = 0,
+    LOG_ARG_FLOAT = 1,
+    LOG_ARG_STR = 2
+} log_arg_type_t;
+
+/* One raw argument: 32 bits of an integer or float, or a string pointer copied by log_ring_write(). */
+typedef struct {
+    union {
+        uint32_t u;
+        float f;
+        const char *s;
+    } v;
+    log_arg_type_t type;
+} log_arg_t;
+
+static inline log_arg_t log_arg_int(long long v) {
+    log_arg_t a = {.v.u = (uint32_t)v, .type = LOG_ARG_INT};
+    return a;
+}
+
+static inline log_arg_t log_arg_float(float v) {
+    log_arg_t a = {.v.f = v, .type = LOG_ARG_FLOAT};
+    return a;
+}
+
+static inline log_arg_t log_arg_double(double v) {
+    return log_arg_float((float)v);
+}
+
+static inline log_arg_t log_arg_str(const char *v) {
+    log_arg_t a = {.v.s = v, .type = LOG_ARG_STR};
+    return a;
+}
+
+static inline log_arg_t log_arg_ptr(const void *v) {
+    return log_arg_int((long long)(uintptr_t)v);
+}
+
+/* Capture an argument by its static type; floats are never converted to text here. */
+#define LOG_ARG(x) _Generic((x), \
+    float: log_arg_float, \
+    double: log_arg_double, \
+    char *: log_arg_str, \
+    const char *: log_arg_str, \
+    void *: log_arg_ptr, \
+    const void *: log_arg_ptr, \
+    default: log_arg_int)(x)
+
+#define LOG_RING_CAT_(a, b) a##b
+#define LOG_RING_CAT(a, b) LOG_RING_CAT_(a, b)
+#define LOG_RING_NARGS_(fmt, a1, a2, a3, a4, a5, a6, n, ...) n
+#define LOG_RING_NARGS(...) LOG_RING_NARGS_(__VA_ARGS__, 6, 5, 4, 3, 2, 1, 0, ~)
+
+#define LOG_RING_0(fmt) log_ring_write(fmt, NULL, 0)
+#define LOG_RING_1(fmt, a) log_ring_write(fmt, (const log_arg_t[]){LOG_ARG(a)}, 1)
+#define LOG_RING_2(fmt, a, b) log_ring_write(fmt, (const log_arg_t[]){LOG_ARG(a), LOG_ARG(b)}, 2)
+#define LOG_RING_3(fmt, a, b, c) \
+    log_ring_write(fmt, (const log_arg_t[]){LOG_ARG(a), LOG_ARG(b), LOG_ARG(c)}, 3)
+#define LOG_RING_4(fmt, a, b, c, d) \
+    log_ring_write(fmt, (const log_arg_t[]){LOG_ARG(a), LOG_ARG(b), LOG_ARG(c), LOG_ARG(d)}, 4)
+#define LOG_RING_5(fmt, a, b, c, d, e) \
+    log_ring_write(fmt, (const log_arg_t[]){LOG_ARG(a), LOG_ARG(b), LOG_ARG(c), LOG_ARG(d), LOG_ARG(e)}, 5)
+#define LOG_RING_6(fmt, a, b, c, d, e, f) \
+    log_ring_write(fmt, \
+                   (const log_arg_t[]){LOG_ARG(a), LOG_ARG(b), LOG_ARG(c), LOG_ARG(d), LOG_ARG(e), LOG_ARG(f)}, 6)
+
+/**
+ * Record a printf-style message without formatting it: LOG_RING(fmt, ...)
+ * with up to LOG_MAX_ARGS arguments. fmt must be a string literal; its
+ * address is the message ID and it is only read when the entry is printed.
+ * Integer arguments are kept as 32 bits (length modifiers are ignored).
+ */
+#define LOG_RING(...) LOG_RING_CAT(LOG_RING_, LOG_RING_NARGS(__VA_ARGS__))(__VA_ARGS__)
+
+/**
+ * Append one entry to the calling core's ring (any core, thread or IRQ;
+ * never blocks). A full ring drops the entry and counts it.
+ */
+void log_ring_write(const char *fmt, const log_arg_t *args, int nargs);
+
+/** Remove the oldest pending entry of both cores and format it into line; 0 if none is pending (core0). */
+int log_ring_pop(char *line, size_t line_len);
+
+/** Format and print up to max pending entries, oldest first (core0 idle time). */
+int log_ring_drain(int max);
+
+/** Entries dropped on a full ring since boot. */
+uint32_t log_ring_dropped(void);
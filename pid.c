@@ -33,3 +33,43 @@ float pid_step(pid_t *pid, float error, float dt) {
     pid->prev_error = error;
     return out;
 }
+
+/** Initialize the fixed-point PID; gains and dt are converted once, here and in pid_fix_set_gains(). */
+void pid_fix_init(pid_fix_t *pid, float kp, float ki, float kd, float dt, float out_min, float out_max) {
+    pid_fix_set_gains(pid, kp, ki, kd, dt);
+    pid_fix_reset(pid);
+    pid->out_min = fix_from_float(out_min);
+    pid->out_max = fix_from_float(out_max);
+}
+
+/** Recompute the coefficients after a gain or time-step change (keeps the state). */
+void pid_fix_set_gains(pid_fix_t *pid, float kp, float ki, float kd, float dt) {
+    pid->kp = fix_coef_from_float(kp);
+    pid->ki = fix_coef_from_float(ki);
+    pid->kd_dt = fix_coef_from_float(dt > 0.0f ? kd / dt : 0.0f); // Avoid div by zero
+    pid->dt = fix_coef_from_float(dt);
+}
+
+/** Reset internal PID state (integrator and previous error). */
+void pid_fix_reset(pid_fix_t *pid) {
+    pid->integrator = 0;
+    pid->prev_error = 0;
+}
+
+/** Fixed-point pid_step() for the time step given to pid_fix_set_gains(). */
+fix_t pid_fix_step(pid_fix_t *pid, fix_t error) {
+    pid->integrator = fix_acc_add(pid->integrator, fix_coef_mul_acc(error, pid->dt));
+
+    fix_acc_t out = fix_coef_mul_acc(error, pid->kp);
+    out = fix_acc_add(out, fix_coef_mul_acc(fix_from_acc(pid->integrator), pid->ki));
+    out = fix_acc_add(out, fix_coef_mul_acc(fix_sub(error, pid->prev_error), pid->kd_dt));
+    fix_t y = fix_from_acc(out);
+
+    /* Clamp only when limits are enabled (min <= max). */
+    if (pid->out_min <= pid->out_max) {
+        y = fix_clamp(y, pid->out_min, pid->out_max);
+    }
+
+    pid->prev_error = error;
+    return y;
+}
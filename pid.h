@@ -1,5 +1,7 @@
 #pragma once
 
+#include "fixed.h"
+
 typedef struct {
     float kp;
     float ki;
@@ -18,3 +20,26 @@ void pid_reset(pid_t *pid);
 
 /** Compute PID output for the given error and time step. */
 float pid_step(pid_t *pid, float error, float dt);
+
+typedef struct {
+    fix_coef_t kp;
+    fix_coef_t ki;
+    fix_coef_t kd_dt; // kd / dt
+    fix_coef_t dt;
+    fix_acc_t integrator; // sum of error * dt
+    fix_t prev_error;
+    fix_t out_min;
+    fix_t out_max;
+} pid_fix_t;
+
+/** Initialize the fixed-point PID; gains and dt are converted once, here and in pid_fix_set_gains(). */
+void pid_fix_init(pid_fix_t *pid, float kp, float ki, float kd, float dt, float out_min, float out_max);
+
+/** Recompute the coefficients after a gain or time-step change (keeps the state). */
+void pid_fix_set_gains(pid_fix_t *pid, float kp, float ki, float kd, float dt);
+
+/** Reset internal PID state (integrator and previous error). */
+void pid_fix_reset(pid_fix_t *pid);
+
+/** Fixed-point pid_step() for the time step given to pid_fix_set_gains(). */
+fix_t pid_fix_step(pid_fix_t *pid, fix_t error);
@@ -1,3 +1,6 @@
+#include <math.h>
+#include <string.h>
+
 #include "plant.h"
 
 /** Step a first-order plant using Euler integration. */
@@ -28,3 +31,256 @@ float plant_second_order_step(second_order_state_t *s, float u, const second_ord
     s->state2 = x2;
     return x1;
 }
+
+/** Reset ss to an n-state model with all coefficients zero. */
+static void plant_ss_clear(plant_ss_t *ss, int n) {
+    memset(ss, 0, sizeof(*ss));
+    ss->n = n;
+}
+
+/** Discretize K / (tau s + 1); the state is the output. */
+void plant_first_order_discretize(plant_ss_t *ss, const first_order_params_t *p, float dt,
+                                  plant_method_t method) {
+    double tau = (p->tau < 0.001f) ? 0.001f : p->tau;
+    /* y += a * y + b * u with a = Ad - 1 and b = K * (1 - Ad) */
+    double a = (method == PLANT_METHOD_ZOH) ? expm1(-(double)dt / tau) : -(double)dt / tau;
+    plant_ss_clear(ss, 1);
+    ss->y_is_x0 = 1;
+    ss->a[0][0] = (float)a;
+    ss->b[0] = (float)(-(double)p->gain * a);
+    ss->c[0] = 1.0f;
+}
+
+/** Discretize K wn^2 / (s^2 + 2 zeta wn s + wn^2); states are the output and its derivative. */
+void plant_second_order_discretize(plant_ss_t *ss, const second_order_params_t *p, float dt,
+                                   plant_method_t method) {
+    double wn = p->wn;
+    if (wn < 0.001) wn = 0.001;
+    double zeta = p->zeta;
+    if (zeta < 0.0) zeta = 0.0;
+    double t = dt;
+
+    /* Continuous model: x' = A x + B u, A = [0 1; -wn^2 -2 zeta wn], B = [0; K wn^2]. */
+    double a21 = -wn * wn;
+    double a22 = -2.0 * zeta * wn;
+    double b2 = p->gain * wn * wn;
+
+    double m11, m12, m21, m22;
+    if (method == PLANT_METHOD_ZOH) {
+        /*
+         * exp(A t) = e^(s t) * (c I + g (A - s I)) with s = -zeta wn and
+         * c, g = cos/sin, 1/1 t or cosh/sinh over the damped frequency.
+         */
+        double s = -zeta * wn;
+        double disc = (zeta * zeta - 1.0) * wn * wn;
+        double c, g;
+        if (disc < -1e-12) {
+            double w = sqrt(-disc);
+            c = cos(w * t);
+            g = sin(w * t) / w;
+        } else if (disc > 1e-12) {
+            double w = sqrt(disc);
+            c = cosh(w * t);
+            g = sinh(w * t) / w;
+        } else {
+            c = 1.0;
+            g = t;
+        }
+        double e = exp(s * t);
+        m11 = e * (c - g * s) - 1.0;
+        m12 = e * g;
+        m21 = e * g * a21;
+        m22 = e * (c + g * (a22 - s)) - 1.0;
+    } else {
+        m11 = 0.0;
+        m12 = t;
+        m21 = a21 * t;
+        m22 = a22 * t;
+    }
+
+    plant_ss_clear(ss, 2);
+    ss->y_is_x0 = 1;
+    ss->a[0][0] = (float)m11;
+    ss->a[0][1] = (float)m12;
+    ss->a[1][0] = (float)m21;
+    ss->a[1][1] = (float)m22;
+    if (method == PLANT_METHOD_ZOH) {
+        /* Bd = A^-1 (Ad - I) B; only B's second entry is non-zero and det(A) = wn^2. */
+        double det = wn * wn;
+        ss->b[0] = (float)((a22 * m12 - m22) * b2 / det);
+        ss->b[1] = (float)((-a21 * m12) * b2 / det);
+    } else {
+        ss->b[1] = (float)(b2 * t);
+    }
+    ss->c[0] = 1.0f;
+}
+
+/** out = x * y for m x m matrices (out must not alias x or y). */
+static void mat_mul(int m, double out[][PLANT_MAX_ORDER + 1], double x[][PLANT_MAX_ORDER + 1],
+                    double y[][PLANT_MAX_ORDER + 1]) {
+    for (int i = 0; i < m; i++) {
+        for (int j = 0; j < m; j++) {
+            double acc = 0.0;
+            for (int k = 0; k < m; k++) {
+                acc += x[i][k] * y[k][j];
+            }
+            out[i][j] = acc;
+        }
+    }
+}
+
+/**
+ * work->m = exp(work->m) - I by scaling and squaring a Taylor series,
+ * without forming exp(m) so small entries of Ad - I stay accurate.
+ */
+static void mat_expm1(int m, plant_work_t *w) {
+    double norm = 0.0;
+    for (int j = 0; j < m; j++) {
+        double col = 0.0;
+        for (int i = 0; i < m; i++) col += fabs(w->m[i][j]);
+        if (col > norm) norm = col;
+    }
+    int squarings = 0;
+    while (norm > 0.5 && squarings < 40) {
+        norm *= 0.5;
+        squarings++;
+    }
+    double scale = ldexp(1.0, -squarings);
+    for (int i = 0; i < m; i++) {
+        for (int j = 0; j < m; j++) w->m[i][j] *= scale;
+    }
+
+    /* expm1(X) = X (I + X/2 (I + X/3 (... (I + X/12)))) */
+    const int terms = 12;
+    for (int i = 0; i < m; i++) {
+        for (int j = 0; j < m; j++) w->t[i][j] = (i == j) ? 1.0 : 0.0;
+    }
+    for (int k = terms; k >= 2; k--) {
+        mat_mul(m, w->p, w->m, w->t);
+        for (int i = 0; i < m; i++) {
+            for (int j = 0; j < m; j++) w->t[i][j] = w->p[i][j] / k + ((i == j) ? 1.0 : 0.0);
+        }
+    }
+    mat_mul(m, w->p, w->m, w->t);
+
+    /* expm1(2X) = E (E + 2 I) */
+    for (int s = 0; s < squarings; s++) {
+        for (int i = 0; i < m; i++) {
+            for (int j = 0; j < m; j++) w->t[i][j] = w->p[i][j] + ((i == j) ? 2.0 : 0.0);
+        }
+        mat_mul(m, w->m, w->p, w->t);
+        memcpy(w->p, w->m, sizeof(w->p));
+    }
+    memcpy(w->m, w->p, sizeof(w->m));
+}
+
+/**
+ * Discretize num(s) / den(s) given highest power first, with den of degree
+ * n (1..PLANT_MAX_ORDER, den[0] != 0) and num of degree <= n padded to n + 1
+ * entries. Uses the controllable canonical form. Returns 0 on invalid input.
+ */
+int plant_tf_discretize(plant_ss_t *ss, const float *num, const float *den, int n, float dt,
+                        plant_method_t method, plant_work_t *work) {
+    if (n < 1 || n > PLANT_MAX_ORDER || den[0] == 0.0f || !(dt > 0.0f)) return 0;
+
+    /* Monic den: s^n + a1 s^(n-1) + ... + an; num: b0 s^n + ... + bn. */
+    double a[PLANT_MAX_ORDER + 1];
+    double b[PLANT_MAX_ORDER + 1];
+    for (int i = 0; i <= n; i++) {
+        a[i] = (double)den[i] / den[0];
+        b[i] = (double)num[i] / den[0];
+    }
+
+    /*
+     * Controllable canonical form: x' = A x + B u with A the companion
+     * matrix of den, B = e_n, C_i = b_(n-i) - a_(n-i) b0, D = b0. Augment
+     * [A B; 0 0] * dt so one expm1 yields both Ad - I and Bd.
+     */
+    int m = n + 1;
+    memset(work->m, 0, sizeof(work->m));
+    for (int i = 0; i + 1 < n; i++) {
+        work->m[i][i + 1] = dt;
+    }
+    for (int j = 0; j < n; j++) {
+        work->m[n - 1][j] = -a[n - j] * dt;
+    }
+    work->m[n - 1][n] = dt;
+
+    plant_ss_clear(ss, n);
+    if (method == PLANT_METHOD_ZOH) {
+        mat_expm1(m, work);
+    }
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j < n; j++) {
+            ss->a[i][j] = (float)work->m[i][j];
+        }
+        ss->b[i] = (float)work->m[i][n];
+        ss->c[i] = (float)(b[n - i] - a[n - i] * b[0]);
+    }
+    ss->d = (float)b[0];
+    return 1;
+}
+
+/** Advance the plant one tick and return its output. */
+float plant_ss_step(const plant_ss_t *ss, float *x, float u) {
+    const int n = ss->n;
+    float dx[PLANT_MAX_ORDER];
+    for (int i = 0; i < n; i++) {
+        const float *row = ss->a[i];
+        float acc = ss->b[i] * u;
+        for (int j = 0; j < n; j++) {
+            acc += row[j] * x[j];
+        }
+        dx[i] = acc;
+    }
+    for (int i = 0; i < n; i++) {
+        x[i] += dx[i];
+    }
+    if (ss->y_is_x0) {
+        return x[0];
+    }
+    float y = ss->d * u;
+    for (int i = 0; i < n; i++) {
+        y += ss->c[i] * x[i];
+    }
+    return y;
+}
+
+/** Convert a discretized plant for the fixed-point backend. */
+void plant_ss_fix_init(plant_ss_fix_t *f, const plant_ss_t *ss) {
+    f->n = ss->n;
+    f->y_is_x0 = ss->y_is_x0;
+    for (int i = 0; i < PLANT_MAX_ORDER; i++) {
+        for (int j = 0; j < PLANT_MAX_ORDER; j++) {
+            f->a[i][j] = fix_coef_from_float(ss->a[i][j]);
+        }
+        f->b[i] = fix_coef_from_float(ss->b[i]);
+        f->c[i] = fix_coef_from_float(ss->c[i]);
+    }
+    f->d = fix_coef_from_float(ss->d);
+}
+
+/** Fixed-point plant_ss_step(); states are kept at accumulator precision. */
+fix_t plant_ss_step_fix(const plant_ss_fix_t *f, fix_acc_t *x, fix_t u) {
+    const int n = f->n;
+    fix_t xs[PLANT_MAX_ORDER];
+    for (int i = 0; i < n; i++) {
+        xs[i] = fix_from_acc(x[i]);
+    }
+    for (int i = 0; i < n; i++) {
+        const fix_coef_t *row = f->a[i];
+        fix_acc_t acc = fix_coef_mul_acc(u, f->b[i]);
+        for (int j = 0; j < n; j++) {
+            acc = fix_acc_add(acc, fix_coef_mul_acc(xs[j], row[j]));
+        }
+        x[i] = fix_acc_add(x[i], acc);
+    }
+    if (f->y_is_x0) {
+        return fix_from_acc(x[0]);
+    }
+    fix_acc_t y = fix_coef_mul_acc(u, f->d);
+    for (int i = 0; i < n; i++) {
+        y = fix_acc_add(y, fix_coef_mul_acc(fix_from_acc(x[i]), f->c[i]));
+    }
+    return fix_from_acc(y);
+}
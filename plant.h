@@ -1,5 +1,7 @@
 #pragma once
 
+#include "fixed.h"
+
 typedef struct {
     float gain;
     float tau;
@@ -21,3 +23,68 @@ float plant_first_order_step(float y, float u, const first_order_params_t *p, fl
 
 /** Step a second-order plant (canonical form) using Euler integration. */
 float plant_second_order_step(second_order_state_t *s, float u, const second_order_params_t *p, float dt);
+
+typedef enum {
+    PLANT_METHOD_EULER = 0, // forward Euler
+    PLANT_METHOD_ZOH = 1 // exact zero-order-hold discretization
+} plant_method_t;
+
+#define PLANT_MAX_ORDER 8
+
+/*
+ * Discrete SISO state-space plant:
+ *   x[k+1] = x[k] + a x[k] + b u[k],  y = c x[k+1] + d u[k]
+ * a holds Ad - I rather than Ad so that tiny per-tick increments keep their
+ * precision. Every model (first order, second order, transfer function) is
+ * discretized into this form once per parameter change and stepped by the
+ * same kernel.
+ */
+typedef struct {
+    int n; // states, 1..PLANT_MAX_ORDER
+    int y_is_x0; // c = [1 0 ...] and d = 0: skip the output product
+    float a[PLANT_MAX_ORDER][PLANT_MAX_ORDER];
+    float b[PLANT_MAX_ORDER];
+    float c[PLANT_MAX_ORDER];
+    float d;
+} plant_ss_t;
+
+/* Scratch space for plant_tf_discretize() (the augmented matrix exponential). */
+typedef struct {
+    double m[PLANT_MAX_ORDER + 1][PLANT_MAX_ORDER + 1];
+    double t[PLANT_MAX_ORDER + 1][PLANT_MAX_ORDER + 1];
+    double p[PLANT_MAX_ORDER + 1][PLANT_MAX_ORDER + 1];
+} plant_work_t;
+
+/** Discretize K / (tau s + 1); the state is the output. */
+void plant_first_order_discretize(plant_ss_t *ss, const first_order_params_t *p, float dt,
+                                  plant_method_t method);
+
+/** Discretize K wn^2 / (s^2 + 2 zeta wn s + wn^2); states are the output and its derivative. */
+void plant_second_order_discretize(plant_ss_t *ss, const second_order_params_t *p, float dt,
+                                   plant_method_t method);
+
+/**
+ * Discretize num(s) / den(s) given highest power first, with den of degree
+ * n (1..PLANT_MAX_ORDER, den[0] != 0) and num of degree <= n padded to n + 1
+ * entries. Uses the controllable canonical form. Returns 0 on invalid input.
+ */
+int plant_tf_discretize(plant_ss_t *ss, const float *num, const float *den, int n, float dt,
+                        plant_method_t method, plant_work_t *work);
+
+/** Advance the plant one tick and return its output. */
+float plant_ss_step(const plant_ss_t *ss, float *x, float u);
+
+typedef struct {
+    int n;
+    int y_is_x0;
+    fix_coef_t a[PLANT_MAX_ORDER][PLANT_MAX_ORDER];
+    fix_coef_t b[PLANT_MAX_ORDER];
+    fix_coef_t c[PLANT_MAX_ORDER];
+    fix_coef_t d;
+} plant_ss_fix_t;
+
+/** Convert a discretized plant for the fixed-point backend. */
+void plant_ss_fix_init(plant_ss_fix_t *f, const plant_ss_t *ss);
+
+/** Fixed-point plant_ss_step(); states are kept at accumulator precision. */
+fix_t plant_ss_step_fix(const plant_ss_fix_t *f, fix_acc_t *x, fix_t u);
@@ -0,0 +1,295 @@
+#include <math.h>
+#include <string.h>
+
+#include "hardware/sync.h"
+
+#include "profile.h"
+#include "sim_loop.h"
+
+#define PROFILE_MIN_PERIOD_S 0.001f // shortest segment, stair or PRBS bit
+#define PROFILE_MAX_DURATION_S 1e6f
+#define PROFILE_PI 3.14159265358979
+
+static const char *const k_profile_kinds[] = {"hold", "ramp", "sine", "stairs", "prbs"};
+
+/* Profile running on core1; only core1 touches it. */
+typedef struct {
+    profile_t p;
+    profile_state_t state;
+    int seg;
+    uint64_t seg_us; // time into the segment
+    uint64_t dur_us; // length of the segment
+    uint64_t lap_us; // time into the current pass
+    uint32_t laps;
+    float start; // active setpoint when the profile was loaded; the first segment starts here
+    float from; // value at the start of the segment
+    float value; // setpoint of the current tick
+    float slope; // ramp: change per microsecond
+    float level; // stairs, PRBS: current level
+    uint64_t next_us; // stairs, PRBS: time of the next step
+    uint64_t period_us;
+    uint16_t lfsr;
+    float omega; // sine: rad/s
+    float sin; // sine: sin and cos of the phase, advanced by rotation
+    float cos;
+    float rot_sin; // rotation by one tick
+    float rot_cos;
+    int rot_dt_us; // tick the rotation was computed for, 0 if none
+} profile_run_t;
+
+/*
+ * core0 hands a profile over in pending and bumps load_requests; core1
+ * copies it on its next tick and acknowledges, so neither core waits.
+ */
+typedef struct {
+    profile_t pending;
+    profile_t loaded; // last profile accepted by profile_load() (core0)
+    volatile uint32_t load_requests; // incremented by core0
+    volatile uint32_t load_handled; // last load request consumed by core1
+    volatile uint32_t stop_requests;
+    volatile uint32_t stop_handled;
+    volatile uint32_t gen;
+    volatile profile_state_t state; // status, written by core1
+    volatile int segment;
+    volatile uint32_t laps;
+    volatile float elapsed_s;
+    volatile float value;
+} profile_shared_t;
+
+static profile_shared_t g_profile;
+static profile_run_t g_run;
+
+/** Clear the profile engine (before core1 starts). */
+void profile_init(void) {
+    memset(&g_profile, 0, sizeof(g_profile));
+    memset(&g_run, 0, sizeof(g_run));
+    g_profile.state = PROFILE_IDLE;
+    g_run.state = PROFILE_IDLE;
+}
+
+/** Name of a segment kind. */
+const char *profile_kind_name(profile_kind_t kind) {
+    return (unsigned)kind < sizeof(k_profile_kinds) / sizeof(k_profile_kinds[0]) ? k_profile_kinds[kind] : NULL;
+}
+
+/** Segment kind by name. */
+int profile_kind_parse(const char *name, profile_kind_t *out) {
+    for (size_t i = 0; i < sizeof(k_profile_kinds) / sizeof(k_profile_kinds[0]); i++) {
+        if (strcmp(name, k_profile_kinds[i]) == 0) {
+            *out = (profile_kind_t)i;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/** Reject segments core1 could not evaluate in bounded time per tick. */
+static int profile_valid(const profile_t *p) {
+    if (p->count < 1 || p->count > PROFILE_MAX_SEGMENTS) return 0;
+    for (int i = 0; i < p->count; i++) {
+        const profile_segment_t *s = &p->seg[i];
+        if (!profile_kind_name(s->kind) || !isfinite(s->a) || !isfinite(s->b) || !isfinite(s->c)) return 0;
+        if (!(s->duration_s >= PROFILE_MIN_PERIOD_S && s->duration_s <= PROFILE_MAX_DURATION_S)) return 0;
+        if (s->kind == PROFILE_SINE && !(s->c >= 0.0f)) return 0;
+        if (s->kind == PROFILE_STAIRS && !(s->b >= PROFILE_MIN_PERIOD_S)) return 0;
+        if (s->kind == PROFILE_PRBS && !(s->c >= PROFILE_MIN_PERIOD_S)) return 0;
+    }
+    return 1;
+}
+
+/** Hand a profile to core1. */
+int profile_load(const profile_t *p) {
+    if (!profile_valid(p) || g_profile.load_requests != g_profile.load_handled) return 0;
+    g_profile.pending = *p;
+    g_profile.loaded = *p;
+    g_profile.gen++;
+    __dmb();
+    g_profile.load_requests++;
+    return 1;
+}
+
+/** Ask core1 to stop the profile. */
+void profile_stop(void) {
+    g_profile.stop_requests++;
+}
+
+/** Copy of the profile last loaded. */
+profile_t profile_get(void) {
+    return g_profile.loaded;
+}
+
+/** Read the engine status. */
+void profile_get_status(profile_status_t *out) {
+    out->state = g_profile.state;
+    out->gen = g_profile.gen;
+    out->segment = g_profile.segment;
+    out->count = g_profile.loaded.count;
+    out->laps = g_profile.laps;
+    out->elapsed_s = g_profile.elapsed_s;
+    out->value = g_profile.value;
+}
+
+/** Apply the stair steps and PRBS bits that are due within the segment. */
+static void profile_steps(profile_run_t *r, const profile_segment_t *s) {
+    if (s->kind != PROFILE_STAIRS && s->kind != PROFILE_PRBS) return;
+    while (r->next_us <= r->seg_us && r->next_us < r->dur_us) {
+        if (s->kind == PROFILE_STAIRS) {
+            r->level += s->a;
+        } else {
+            /* 16-bit Fibonacci LFSR, taps 16 14 13 11 (maximal length). */
+            uint16_t bit = (uint16_t)((r->lfsr ^ (r->lfsr >> 2) ^ (r->lfsr >> 3) ^ (r->lfsr >> 5)) & 1u);
+            r->lfsr = (uint16_t)((r->lfsr >> 1) | (bit << 15));
+            r->level = (r->lfsr & 1u) ? s->b : s->a;
+        }
+        r->next_us += r->period_us;
+    }
+}
+
+/** Start segment seg at value from, carry_us into it. */
+static void profile_enter(profile_run_t *r, int seg, float from, uint64_t carry_us) {
+    const profile_segment_t *s = &r->p.seg[seg];
+    r->seg = seg;
+    r->from = from;
+    r->seg_us = carry_us;
+    r->dur_us = (uint64_t)((double)s->duration_s * 1e6 + 0.5);
+    switch (s->kind) {
+        case PROFILE_RAMP:
+            r->slope = (s->a - from) / (float)r->dur_us;
+            break;
+        case PROFILE_SINE: {
+            /* The only trig of a sine segment besides a change of tick period. */
+            r->omega = (float)(2.0 * PROFILE_PI) * s->c;
+            float phase = r->omega * (float)carry_us * 1e-6f;
+            r->sin = sinf(phase);
+            r->cos = cosf(phase);
+            r->rot_dt_us = 0;
+            break;
+        }
+        case PROFILE_STAIRS:
+            r->level = from;
+            r->period_us = (uint64_t)((double)s->b * 1e6 + 0.5);
+            r->next_us = 0;
+            break;
+        case PROFILE_PRBS:
+            r->lfsr = PROFILE_PRBS_SEED;
+            r->level = (r->lfsr & 1u) ? s->b : s->a;
+            r->period_us = (uint64_t)((double)s->c * 1e6 + 0.5);
+            r->next_us = r->period_us;
+            break;
+        default:
+            break;
+    }
+    profile_steps(r, s);
+}
+
+/** Setpoint at the current time of the segment. */
+static float profile_value(const profile_run_t *r, const profile_segment_t *s) {
+    switch (s->kind) {
+        case PROFILE_HOLD:
+            return s->a;
+        case PROFILE_RAMP:
+            return r->from + r->slope * (float)r->seg_us;
+        case PROFILE_SINE:
+            return s->a + s->b * r->sin;
+        default:
+            return r->level;
+    }
+}
+
+/** Value at the end of the segment, where the next one continues. */
+static float profile_end_value(const profile_run_t *r, const profile_segment_t *s) {
+    switch (s->kind) {
+        case PROFILE_HOLD:
+        case PROFILE_RAMP:
+            return s->a;
+        case PROFILE_SINE:
+            return s->a + s->b * sinf(r->omega * s->duration_s);
+        default:
+            return r->level;
+    }
+}
+
+/** Advance the sine phase by one tick: a rotation, renormalized against rounding drift. */
+static void profile_rotate(profile_run_t *r, int dt_us) {
+    if (dt_us != r->rot_dt_us) {
+        float w = r->omega * (float)dt_us * 1e-6f;
+        r->rot_sin = sinf(w);
+        r->rot_cos = cosf(w);
+        r->rot_dt_us = dt_us;
+    }
+    float s = r->sin * r->rot_cos + r->cos * r->rot_sin;
+    float c = r->cos * r->rot_cos - r->sin * r->rot_sin;
+    float k = 1.5f - 0.5f * (s * s + c * c);
+    r->sin = s * k;
+    r->cos = c * k;
+}
+
+/** Start over from the first segment at the start value. */
+static void profile_restart(profile_run_t *r) {
+    r->lap_us = 0;
+    r->laps = 0;
+    r->state = PROFILE_RUNNING;
+    profile_enter(r, 0, r->start, 0);
+    r->value = profile_value(r, &r->p.seg[0]);
+}
+
+/** Advance the time by one tick and compute the setpoint of the next one. */
+static void profile_advance(profile_run_t *r, int dt_us) {
+    const profile_segment_t *s = &r->p.seg[r->seg];
+    r->seg_us += (uint64_t)dt_us;
+    r->lap_us += (uint64_t)dt_us;
+    if (s->kind == PROFILE_SINE) profile_rotate(r, dt_us);
+    profile_steps(r, s);
+    while (r->seg_us >= r->dur_us) {
+        uint64_t carry_us = r->seg_us - r->dur_us;
+        float end = profile_end_value(r, s);
+        int next = r->seg + 1;
+        if (next == r->p.count) {
+            if (!r->p.repeat) {
+                r->value = end;
+                r->state = PROFILE_DONE;
+                return;
+            }
+            next = 0;
+            r->laps++;
+            r->lap_us = carry_us;
+        }
+        profile_enter(r, next, end, carry_us);
+        s = &r->p.seg[next];
+    }
+    r->value = profile_value(r, s);
+}
+
+/** Advance the profile by one tick (core1). */
+int profile_tick(const sim_config_t *cfg, int reset, float *setpoint) {
+    profile_run_t *r = &g_run;
+    uint32_t load = g_profile.load_requests;
+    if (load != g_profile.load_handled) {
+        __dmb();
+        r->p = g_profile.pending;
+        __dmb();
+        g_profile.load_handled = load;
+        r->start = cfg->use_master_setpoint ? cfg->master_setpoint : cfg->setpoint;
+        profile_restart(r);
+    } else if (reset && r->state != PROFILE_IDLE) {
+        profile_restart(r);
+    }
+    uint32_t stop = g_profile.stop_requests;
+    if (stop != g_profile.stop_handled) {
+        g_profile.stop_handled = stop;
+        r->state = PROFILE_IDLE;
+        g_profile.state = PROFILE_IDLE;
+    }
+    if (r->state == PROFILE_IDLE) return 0;
+
+    *setpoint = r->value;
+    g_profile.value = r->value;
+    g_profile.segment = r->seg;
+    g_profile.laps = r->laps;
+    g_profile.elapsed_s = (float)r->lap_us * 1e-6f;
+    if (r->state == PROFILE_RUNNING && cfg->running) {
+        profile_advance(r, sim_loop_dt_us(cfg));
+    }
+    g_profile.state = r->state;
+    return 1;
+}
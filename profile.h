@@ -0,0 +1,81 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "sim_state.h"
+
+#define PROFILE_MAX_SEGMENTS 16
+#define PROFILE_PRBS_SEED 0xACE1u // LFSR state at the start of every PRBS segment
+
+/*
+ * Setpoint profile: piecewise segments evaluated by core1 at tick rate.
+ * The parameters a, b, c of a segment depend on its kind.
+ */
+typedef enum {
+    PROFILE_HOLD = 0, // a = value
+    PROFILE_RAMP = 1, // linear from the previous value to a
+    PROFILE_SINE = 2, // a + b * sin(2 pi c t), c in Hz
+    PROFILE_STAIRS = 3, // previous value + a every b seconds (first step at t = 0)
+    PROFILE_PRBS = 4 // a or b, one pseudo-random bit every c seconds
+} profile_kind_t;
+
+typedef struct {
+    profile_kind_t kind;
+    float duration_s;
+    float a;
+    float b;
+    float c;
+} profile_segment_t;
+
+typedef struct {
+    profile_segment_t seg[PROFILE_MAX_SEGMENTS];
+    int count;
+    int repeat; // flag: start over after the last segment instead of holding its final value
+} profile_t;
+
+typedef enum {
+    PROFILE_IDLE = 0,
+    PROFILE_RUNNING = 1,
+    PROFILE_DONE = 2 // the final value is held until profile_stop()
+} profile_state_t;
+
+typedef struct {
+    profile_state_t state;
+    uint32_t gen; // increments with every profile_load()
+    int segment; // segment being evaluated
+    int count;
+    uint32_t laps; // completed passes through the segments
+    float elapsed_s; // time since the start of the profile (or of the lap)
+    float value; // setpoint of the last tick
+} profile_status_t;
+
+/** Clear the profile engine (before core1 starts). */
+void profile_init(void);
+
+/**
+ * Hand p to core1, replacing any running profile from its next tick.
+ * Returns 0 if p is invalid or a previous load is not picked up yet.
+ */
+int profile_load(const profile_t *p);
+
+/** Ask core1 to stop the profile; the configured setpoint takes over again. */
+void profile_stop(void);
+
+/** Copy of the profile last loaded (core0). */
+profile_t profile_get(void);
+
+/** Read the engine status. */
+void profile_get_status(profile_status_t *out);
+
+/** Name of a segment kind, NULL if out of range. */
+const char *profile_kind_name(profile_kind_t kind);
+
+/** Segment kind by name; returns 0 if unknown. */
+int profile_kind_parse(const char *name, profile_kind_t *out);
+
+/**
+ * Advance the profile by one tick of cfg (core1, before sim_loop_step()).
+ * Time only runs while cfg->running; reset restarts it from the first
+ * segment. Returns 1 and the setpoint of this tick if a profile is active.
+ */
+int profile_tick(const sim_config_t *cfg, int reset, float *setpoint);
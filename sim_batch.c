@@ -0,0 +1,317 @@
+#include <string.h>
+
+#include "plant.h"
+#include "sim_batch.h"
+#include "sim_loop.h"
+
+#define SIM_BATCH_INITIAL_OUTPUT 25.0f
+
+/*
+ * Shared with core0 through the same seqlock scheme as g_sim: core0 writes
+ * cfg under lock, core1 writes rt; readers retry while the version is odd
+ * or changed during the copy.
+ */
+typedef struct {
+    critical_section_t lock; // serializes core0 writers of cfg
+    volatile uint32_t cfg_seq;
+    sim_batch_config_t cfg[SIM_BATCH_MAX];
+    volatile uint32_t rt_seq; // written by core1 only
+    sim_batch_runtime_t rt;
+} sim_batch_shared_t;
+
+static sim_batch_shared_t g_batch;
+
+/** Initialize the shared batch configuration; instances start disabled with the main loop's defaults. */
+void sim_batch_init(void) {
+    critical_section_init(&g_batch.lock);
+    sim_batch_config_t c;
+    memset(&c, 0, sizeof(c));
+    c.enabled = 0;
+    c.setpoint = g_sim.cfg.setpoint;
+    c.pid = g_sim.cfg.pid;
+    c.model = (g_sim.cfg.plant.model == PLANT_SECOND_ORDER) ? PLANT_SECOND_ORDER : PLANT_FIRST_ORDER;
+    c.gain = g_sim.cfg.plant.gain;
+    c.tau = g_sim.cfg.plant.tau;
+    c.wn = g_sim.cfg.plant.wn;
+    c.zeta = g_sim.cfg.plant.zeta;
+    c.dead_time_ms = g_sim.cfg.plant.dead_time_ms;
+    c.method = g_sim.cfg.plant.method;
+    c.act_min = g_sim.cfg.act_min;
+    c.act_max = g_sim.cfg.act_max;
+    for (int i = 0; i < SIM_BATCH_MAX; i++) {
+        g_batch.cfg[i] = c;
+    }
+    memset(&g_batch.rt, 0, sizeof(g_batch.rt));
+    g_batch.cfg_seq = 0;
+    g_batch.rt_seq = 0;
+}
+
+/** Read a consistent copy of one instance configuration (core0). */
+sim_batch_config_t sim_batch_get_config(int id) {
+    sim_batch_config_t c;
+    memset(&c, 0, sizeof(c));
+    if (id < 0 || id >= SIM_BATCH_MAX) return c;
+    for (;;) {
+        uint32_t seq = g_batch.cfg_seq;
+        if (!(seq & 1u)) {
+            __dmb();
+            c = g_batch.cfg[id];
+            __dmb();
+            if (g_batch.cfg_seq == seq) return c;
+        }
+        tight_loop_contents();
+    }
+}
+
+/** Replace one instance configuration (core0). */
+void sim_batch_set_config(int id, const sim_batch_config_t *cfg) {
+    if (id < 0 || id >= SIM_BATCH_MAX) return;
+    critical_section_enter_blocking(&g_batch.lock);
+    g_batch.cfg_seq++;
+    __dmb();
+    g_batch.cfg[id] = *cfg;
+    __dmb();
+    g_batch.cfg_seq++;
+    critical_section_exit(&g_batch.lock);
+}
+
+/** Clamp and store one per-instance parameter; 0 if it does not apply to batch instances. */
+int sim_batch_apply_param(sim_batch_config_t *cfg, sim_param_t id, float value) {
+    switch (id) {
+    case SIM_PARAM_MODEL:
+        if ((int)value != PLANT_FIRST_ORDER && (int)value != PLANT_SECOND_ORDER) return 0;
+        break;
+    case SIM_PARAM_SETPOINT:
+    case SIM_PARAM_KP:
+    case SIM_PARAM_KI:
+    case SIM_PARAM_KD:
+    case SIM_PARAM_GAIN:
+    case SIM_PARAM_TAU:
+    case SIM_PARAM_WN:
+    case SIM_PARAM_ZETA:
+    case SIM_PARAM_DEAD:
+    case SIM_PARAM_ACT_MIN:
+    case SIM_PARAM_ACT_MAX:
+    case SIM_PARAM_ZOH:
+        break;
+    default:
+        return 0;
+    }
+
+    /* Go through sim_param_apply() so both paths share one set of limits. */
+    sim_config_t tmp;
+    memset(&tmp, 0, sizeof(tmp));
+    tmp.setpoint = cfg->setpoint;
+    tmp.pid = cfg->pid;
+    tmp.plant.model = cfg->model;
+    tmp.plant.gain = cfg->gain;
+    tmp.plant.tau = cfg->tau;
+    tmp.plant.wn = cfg->wn;
+    tmp.plant.zeta = cfg->zeta;
+    tmp.plant.dead_time_ms = cfg->dead_time_ms;
+    tmp.plant.method = cfg->method;
+    tmp.act_min = cfg->act_min;
+    tmp.act_max = cfg->act_max;
+    sim_param_apply(&tmp, id, value);
+    cfg->setpoint = tmp.setpoint;
+    cfg->pid = tmp.pid;
+    cfg->model = tmp.plant.model;
+    cfg->gain = tmp.plant.gain;
+    cfg->tau = tmp.plant.tau;
+    cfg->wn = tmp.plant.wn;
+    cfg->zeta = tmp.plant.zeta;
+    cfg->dead_time_ms = tmp.plant.dead_time_ms;
+    cfg->method = tmp.plant.method;
+    cfg->act_min = tmp.act_min;
+    cfg->act_max = tmp.act_max;
+    return 1;
+}
+
+/** Whole ticks of dead time the ring holds for dead_ms at a dt_us time step. */
+static int sim_batch_delay_len(int dead_ms, int dt_us) {
+    int delay_len = dead_ms * 1000 / dt_us;
+    if (delay_len < 0) delay_len = 0;
+    if (delay_len >= SIM_BATCH_DELAY) delay_len = SIM_BATCH_DELAY - 1;
+    return delay_len;
+}
+
+/** Dead time an instance runs with; below dead_ms if the ring is too short at dt_us. */
+float sim_batch_dead_ms(int dead_ms, int dt_us) {
+    return (float)sim_batch_delay_len(dead_ms, dt_us) * (float)dt_us / 1000.0f;
+}
+
+/** Read a consistent copy of the latest published batch tick (core0). */
+void sim_batch_get_runtime(sim_batch_runtime_t *out) {
+    for (;;) {
+        uint32_t seq = g_batch.rt_seq;
+        if (!(seq & 1u)) {
+            __dmb();
+            *out = g_batch.rt;
+            __dmb();
+            if (g_batch.rt_seq == seq) return;
+        }
+        tight_loop_contents();
+    }
+}
+
+/** Reset all instances to their initial state (core1). */
+void sim_batch_reset(sim_batch_t *batch) {
+    memset(batch, 0, sizeof(*batch));
+    /* The next sim_batch_step() re-reads the config and restarts every enabled instance. */
+    batch->cfg_valid = 0;
+}
+
+/** Restart instance i at rest with its initial output. */
+static void sim_batch_reset_instance(sim_batch_t *batch, int i, plant_model_t model) {
+    batch->integrator[i] = 0.0f;
+    batch->prev_error[i] = 0.0f;
+    batch->u[i] = 0.0f;
+    batch->u1[i] = 0.0f;
+    batch->x0[i] = (model == PLANT_FIRST_ORDER) ? SIM_BATCH_INITIAL_OUTPUT : 0.0f;
+    batch->x1[i] = 0.0f;
+    for (int k = 0; k < SIM_BATCH_DELAY; k++) {
+        batch->delay_buf[k][i] = 0.0f;
+    }
+}
+
+/**
+ * Recompute the coefficients of instance i from c. A disabled instance
+ * gets all-zero coefficients, so the kernel needs no per-instance branch.
+ */
+static void sim_batch_prepare(sim_batch_t *batch, int i, const sim_batch_config_t *c, int restart) {
+    const sim_batch_config_t *old = &batch->cfg[i];
+    if (c->enabled && (restart || !old->enabled)) {
+        sim_batch_reset_instance(batch, i, c->model);
+    } else if (c->model != old->model) {
+        batch->x1[i] = 0.0f; // both realizations have y = x0
+    }
+
+    batch->setpoint[i] = 0.0f;
+    batch->kp[i] = 0.0f;
+    batch->ki[i] = 0.0f;
+    batch->kd_dt[i] = 0.0f;
+    batch->act_min[i] = 0.0f;
+    batch->act_max[i] = 0.0f;
+    batch->delay_len[i] = 0;
+    batch->a00[i] = 0.0f;
+    batch->a01[i] = 0.0f;
+    batch->a10[i] = 0.0f;
+    batch->a11[i] = 0.0f;
+    batch->b0[i] = 0.0f;
+    batch->b1[i] = 0.0f;
+    batch->cfg[i] = *c;
+    if (!c->enabled) return;
+
+    batch->setpoint[i] = c->setpoint;
+    batch->kp[i] = c->pid.kp;
+    batch->ki[i] = c->pid.ki;
+    batch->kd_dt[i] = c->pid.kd / batch->dt;
+    float act_min = c->act_min;
+    float act_max = c->act_max;
+    actuator_limits(1, 1, &act_min, &act_max);
+    batch->act_min[i] = act_min;
+    batch->act_max[i] = act_max;
+
+    batch->delay_len[i] = sim_batch_delay_len(c->dead_time_ms, batch->dt_us);
+
+    plant_ss_t ss;
+    if (c->model == PLANT_SECOND_ORDER) {
+        second_order_params_t p = {c->wn, c->zeta, c->gain};
+        plant_second_order_discretize(&ss, &p, batch->dt, c->method);
+    } else {
+        first_order_params_t p = {c->gain, c->tau};
+        plant_first_order_discretize(&ss, &p, batch->dt, c->method);
+    }
+    batch->a00[i] = ss.a[0][0];
+    batch->a01[i] = ss.a[0][1];
+    batch->a10[i] = ss.a[1][0];
+    batch->a11[i] = ss.a[1][1];
+    batch->b0[i] = ss.b[0];
+    batch->b1[i] = ss.b[1];
+}
+
+/** Pick up a new shared configuration or time step; keeps the old one while core0 is mid-write. */
+static void sim_batch_sync(sim_batch_t *batch, int dt_us) {
+    static sim_batch_config_t cfg[SIM_BATCH_MAX]; // core1 scratch, too large for its stack
+    int dt_changed = batch->dt_us != dt_us;
+    uint32_t seq = g_batch.cfg_seq;
+    if (batch->cfg_valid && !dt_changed && seq == batch->cfg_seq) return;
+    if (seq & 1u) return;
+    __dmb();
+    memcpy(cfg, g_batch.cfg, sizeof(cfg));
+    __dmb();
+    if (g_batch.cfg_seq != seq) return;
+
+    int restart = !batch->cfg_valid;
+    batch->dt_us = dt_us;
+    batch->dt = dt_us / 1e6f;
+    batch->count = 0;
+    for (int i = 0; i < SIM_BATCH_MAX; i++) {
+        if (restart || dt_changed || memcmp(&cfg[i], &batch->cfg[i], sizeof(cfg[i])) != 0) {
+            sim_batch_prepare(batch, i, &cfg[i], restart);
+        }
+        if (cfg[i].enabled) batch->count = i + 1;
+    }
+    batch->cfg_seq = seq;
+    batch->cfg_valid = 1;
+}
+
+/** Run one PID -> actuator -> dead time -> plant tick for every enabled instance. */
+void sim_batch_step(sim_batch_t *batch, const sim_config_t *cfg) {
+    sim_batch_sync(batch, sim_loop_dt_us(cfg));
+    batch->running = cfg->running;
+
+    const int n = batch->count;
+    const float dt = batch->dt;
+    const float feedback = cfg->allow_sens_signal ? 1.0f : 0.0f;
+    float *row = batch->delay_buf[batch->delay_idx];
+
+    for (int i = 0; i < n; i++) {
+        float u = 0.0f;
+        if (batch->running) {
+            float error = batch->setpoint[i] - feedback * batch->x0[i];
+            batch->integrator[i] += error * dt;
+            u = batch->kp[i] * error + batch->ki[i] * batch->integrator[i] +
+                batch->kd_dt[i] * (error - batch->prev_error[i]);
+            batch->prev_error[i] = error;
+        }
+        float u1 = u;
+        if (u1 < batch->act_min[i]) u1 = batch->act_min[i];
+        if (u1 > batch->act_max[i]) u1 = batch->act_max[i];
+        batch->u[i] = u;
+        batch->u1[i] = u1;
+
+        row[i] = u1;
+        int read_idx = (batch->delay_idx - batch->delay_len[i]) & (SIM_BATCH_DELAY - 1);
+        float u_delayed = batch->delay_buf[read_idx][i];
+
+        float x0 = batch->x0[i];
+        float x1 = batch->x1[i];
+        batch->x0[i] = x0 + batch->a00[i] * x0 + batch->a01[i] * x1 + batch->b0[i] * u_delayed;
+        batch->x1[i] = x1 + batch->a10[i] * x0 + batch->a11[i] * x1 + batch->b1[i] * u_delayed;
+    }
+
+    batch->delay_idx = (batch->delay_idx + 1) & (SIM_BATCH_DELAY - 1);
+    batch->time_s += dt;
+}
+
+/** Publish the last tick; core1 is the only writer so no lock is needed. */
+void sim_batch_publish(sim_batch_t *batch, uint32_t step_us) {
+    if (step_us > batch->step_max_us) batch->step_max_us = step_us;
+
+    g_batch.rt_seq++;
+    __dmb();
+    sim_batch_runtime_t *rt = &g_batch.rt;
+    rt->time_s = (float)batch->time_s;
+    rt->count = batch->count;
+    rt->step_us = step_us;
+    rt->step_max_us = batch->step_max_us;
+    for (int i = 0; i < batch->count; i++) {
+        rt->loop[i].setpoint = batch->running ? batch->setpoint[i] : 0.0f;
+        rt->loop[i].control = batch->u[i];
+        rt->loop[i].actuator = batch->u1[i];
+        rt->loop[i].output = batch->x0[i];
+    }
+    __dmb();
+    g_batch.rt_seq++;
+}
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <stdint.h>
+#include "pico/sync.h"
+
+#include "sim_params.h"
+#include "sim_state.h"
+
+#ifndef SIM_BATCH_MAX
+#define SIM_BATCH_MAX 32 // independent loop instances stepped per tick
+#endif
+#ifndef SIM_BATCH_DELAY
+#define SIM_BATCH_DELAY 128 // dead-time slots per instance; must be a power of two
+#endif
+
+/** Configuration of one batch instance (built-in first/second-order plants only). */
+typedef struct {
+    int enabled; // flag: instance is stepped and reported if non-zero
+    float setpoint;
+    pid_params_t pid;
+    plant_model_t model; // PLANT_FIRST_ORDER or PLANT_SECOND_ORDER
+    float gain;
+    float tau;
+    float wn;
+    float zeta;
+    int dead_time_ms;
+    plant_method_t method;
+    float act_min; // actuator limits; the actuator both injects and absorbs
+    float act_max;
+} sim_batch_config_t;
+
+typedef struct {
+    float setpoint; // r(t)
+    float control; // u(t)
+    float actuator; // u1(t)
+    float output; // y(t)
+} sim_batch_sample_t;
+
+/** Latest batch tick as published by core1. */
+typedef struct {
+    float time_s; // elapsed simulation time of the batch
+    int count; // instances stepped per tick (highest enabled id + 1)
+    uint32_t step_us; // duration of the last sim_batch_step()
+    uint32_t step_max_us; // longest sim_batch_step() since the last reset
+    sim_batch_sample_t loop[SIM_BATCH_MAX];
+} sim_batch_runtime_t;
+
+/*
+ * Core1 state, stored as struct-of-arrays: field[i] belongs to instance i,
+ * so the tick kernel walks each array front to back. Coefficients are
+ * recomputed from cfg only when core0 publishes a new configuration.
+ */
+typedef struct {
+    int count; // instances stepped per tick
+    int running; // cfg.running of the main loop
+    float dt; // time step in seconds
+    int dt_us;
+    double time_s; // double so sub-ms steps keep counting in long runs
+    uint32_t cfg_seq; // shared config version the coefficients belong to
+    int cfg_valid;
+    uint32_t step_max_us;
+
+    /* controller and actuator */
+    float setpoint[SIM_BATCH_MAX];
+    float kp[SIM_BATCH_MAX];
+    float ki[SIM_BATCH_MAX];
+    float kd_dt[SIM_BATCH_MAX]; // kd / dt
+    float integrator[SIM_BATCH_MAX]; // sum of error * dt
+    float prev_error[SIM_BATCH_MAX];
+    float act_min[SIM_BATCH_MAX];
+    float act_max[SIM_BATCH_MAX];
+    float u[SIM_BATCH_MAX];
+    float u1[SIM_BATCH_MAX];
+
+    /* dead time: one row per tick, so the write of a tick is contiguous */
+    int delay_len[SIM_BATCH_MAX];
+    int delay_idx;
+    float delay_buf[SIM_BATCH_DELAY][SIM_BATCH_MAX];
+
+    /* plant: two states in delta form, x += (Ad - I) x + Bd u, y = x0 */
+    float a00[SIM_BATCH_MAX];
+    float a01[SIM_BATCH_MAX];
+    float a10[SIM_BATCH_MAX];
+    float a11[SIM_BATCH_MAX];
+    float b0[SIM_BATCH_MAX];
+    float b1[SIM_BATCH_MAX];
+    float x0[SIM_BATCH_MAX];
+    float x1[SIM_BATCH_MAX];
+
+    sim_batch_config_t cfg[SIM_BATCH_MAX]; // configuration the coefficients were computed from
+} sim_batch_t;
+
+/** Initialize the shared batch configuration (all instances disabled) and its lock. */
+void sim_batch_init(void);
+
+/** Read a consistent copy of one instance configuration (core0). */
+sim_batch_config_t sim_batch_get_config(int id);
+/** Replace one instance configuration (core0); ids out of range are ignored. */
+void sim_batch_set_config(int id, const sim_batch_config_t *cfg);
+
+/**
+ * Clamp and store one parameter in an instance configuration, using the
+ * same limits as sim_param_apply(). Returns 0 for parameters that are not
+ * per-instance (dt, run, actuator modes, ...) or a model other than 0/1.
+ */
+int sim_batch_apply_param(sim_batch_config_t *cfg, sim_param_t id, float value);
+
+/**
+ * Dead time, in milliseconds, an instance configured with dead_ms runs
+ * with at a dt_us time step: whole ticks, at most SIM_BATCH_DELAY - 1.
+ */
+float sim_batch_dead_ms(int dead_ms, int dt_us);
+
+/** Read a consistent copy of the latest published batch tick (core0). */
+void sim_batch_get_runtime(sim_batch_runtime_t *out);
+
+/** Reset all instances to their initial state (core1). */
+void sim_batch_reset(sim_batch_t *batch);
+
+/**
+ * Run one tick of every enabled instance with the time step and run flag
+ * of cfg, picking up a new shared configuration first if there is one.
+ */
+void sim_batch_step(sim_batch_t *batch, const sim_config_t *cfg);
+
+/** Publish the last tick for sim_batch_get_runtime() (core1 only, never blocks). */
+void sim_batch_publish(sim_batch_t *batch, uint32_t step_us);
@@ -0,0 +1,287 @@
+#include <string.h>
+
+#include "sim_loop.h"
+
+#define SIM_INITIAL_OUTPUT 25.0f
+
+/**
+ * Resolve the actuator limits for the inject/absorb mode.
+ * Returns 0 if the actuator is disabled (no effect on the plant).
+ */
+int actuator_limits(int inject, int absorb, float *min_out, float *max_out) {
+    /* Disabled actuator: no effect on plant. */
+    if (!inject && !absorb) {
+        return 0;
+    }
+
+    /* Force limits to be sane. */
+    if (*min_out > *max_out) {
+        float tmp = *min_out;
+        *min_out = *max_out;
+        *max_out = tmp;
+    }
+
+    /* Inject-only: disallow negative output. */
+    if (inject && !absorb) {
+        if (*min_out < 0.0f) *min_out = 0.0f;
+        if (*max_out < 0.0f) *max_out = 0.0f;
+    }
+
+    /* Absorb-only: disallow positive output. */
+    if (!inject && absorb) {
+        if (*max_out > 0.0f) *max_out = 0.0f;
+        if (*min_out > 0.0f) *min_out = 0.0f;
+    }
+    return 1;
+}
+
+/** Map controller output into actuator output based on mode and limits. */
+float actuator_apply(float u, int inject, int absorb, float min_out, float max_out) {
+    if (!actuator_limits(inject, absorb, &min_out, &max_out)) {
+        return 0.0f;
+    }
+    if (u < min_out) return min_out;
+    if (u > max_out) return max_out;
+    return u;
+}
+
+/** Reset the loop pipeline (PID, plant states, dead time) to its initial values. */
+void sim_loop_reset(sim_loop_t *loop, const sim_config_t *cfg) {
+    /* PID is unconstrained; actuator applies the physical limits. */
+    pid_init(&loop->pid, cfg->pid.kp, cfg->pid.ki, cfg->pid.kd, 1.0f, -1.0f); // 1.0f >= -1.0f = No limits
+    memset(loop->x, 0, sizeof(loop->x));
+    if (cfg->plant.model == PLANT_FIRST_ORDER) {
+        loop->x[0] = SIM_INITIAL_OUTPUT; // the first-order state is the output
+    }
+    loop->y = loop->x[0]; // output of the plant at rest, the feedback of the first tick
+    loop->u = 0.0f;
+    loop->u1 = 0.0f;
+    delay_line_reset(&loop->delay);
+    /* The discrete plant depends only on cfg.plant and dt; a restart on the same plant keeps it. */
+    if (loop->plant_valid && (loop->plant_dt_us != sim_loop_dt_us(cfg) ||
+                              memcmp(&loop->plant_key, &cfg->plant, sizeof(cfg->plant)) != 0)) {
+        loop->plant_valid = 0;
+    }
+
+    sim_loop_fix_t *fx = &loop->fix;
+    pid_fix_init(&fx->pid, cfg->pid.kp, cfg->pid.ki, cfg->pid.kd, sim_loop_dt_us(cfg) / 1e6f, 1.0f, -1.0f);
+    for (int i = 0; i < PLANT_MAX_ORDER; i++) {
+        fx->x[i] = fix_acc_from_float(loop->x[i]);
+    }
+    fx->y = fix_from_float(loop->y);
+    fx->cfg_valid = 0;
+    loop->numeric = cfg->numeric;
+}
+
+/** Clamp the configured time step to the supported SIM_DT_MIN_US..SIM_DT_MAX_US range. */
+int sim_loop_dt_us(const sim_config_t *cfg) {
+    int dt_us = cfg->dt_us;
+    if (dt_us < SIM_DT_MIN_US) dt_us = SIM_DT_MIN_US;
+    if (dt_us > SIM_DT_MAX_US) dt_us = SIM_DT_MAX_US;
+    return dt_us;
+}
+
+/** Time step in whole milliseconds (at least 1), for the millisecond API. */
+int sim_loop_dt_ms(const sim_config_t *cfg) {
+    int dt_ms = (sim_loop_dt_us(cfg) + 500) / 1000;
+    return (dt_ms < 1) ? 1 : dt_ms;
+}
+
+/** Return the pooled dead-time storage of a loop that is done (offline runs). */
+void sim_loop_release(sim_loop_t *loop) {
+    delay_line_release(&loop->delay);
+}
+
+/**
+ * Restart the plant at rest with its current output when the state layout
+ * changed (other model or order). All built-in realizations hold only x[0]
+ * at rest, with y = c[0] x[0].
+ */
+static void sim_loop_rebase_plant(sim_loop_t *loop) {
+    float x0 = (loop->plant.c[0] != 0.0f) ? loop->y / loop->plant.c[0] : 0.0f;
+    memset(loop->x, 0, sizeof(loop->x));
+    loop->x[0] = x0;
+    for (int i = 0; i < PLANT_MAX_ORDER; i++) {
+        loop->fix.x[i] = fix_acc_from_float(loop->x[i]);
+    }
+}
+
+/**
+ * Discretize the configured plant model for time step dt. Falls back to a
+ * plant that holds its output (and returns 0) if the transfer function is
+ * invalid; sim_param_set_tf() validates, so this only guards a corrupt config.
+ */
+int sim_loop_plant_discretize(plant_ss_t *ss, const plant_params_t *p, float dt, plant_work_t *work) {
+    int ok = 1;
+    if (p->model == PLANT_FIRST_ORDER) {
+        first_order_params_t fp = {p->gain, p->tau};
+        plant_first_order_discretize(ss, &fp, dt, p->method);
+    } else if (p->model == PLANT_SECOND_ORDER) {
+        second_order_params_t sp = {p->wn, p->zeta, p->gain};
+        plant_second_order_discretize(ss, &sp, dt, p->method);
+    } else {
+        ok = plant_tf_discretize(ss, p->tf_num, p->tf_den, p->tf_order, dt, p->method, work);
+    }
+    if (!ok) {
+        first_order_params_t hold = {0.0f, 1.0f};
+        plant_first_order_discretize(ss, &hold, dt, PLANT_METHOD_EULER);
+    }
+    return ok;
+}
+
+/** Recompute the discrete plant only when cfg.plant or the time step changed. */
+static void sim_loop_discretize(sim_loop_t *loop, const sim_config_t *cfg, int dt_us) {
+    if (loop->plant_valid && loop->plant_dt_us == dt_us &&
+        memcmp(&loop->plant_key, &cfg->plant, sizeof(cfg->plant)) == 0) {
+        return;
+    }
+    int prev_n = loop->plant_valid ? loop->plant.n : 0;
+    sim_loop_plant_discretize(&loop->plant, &cfg->plant, dt_us / 1e6f, &loop->work);
+    if (prev_n && (loop->plant_key.model != cfg->plant.model || loop->plant.n != prev_n)) {
+        sim_loop_rebase_plant(loop);
+    }
+    loop->plant_key = cfg->plant;
+    loop->plant_dt_us = dt_us;
+    loop->plant_valid = 1;
+}
+
+/** Move the pipeline state to the other backend so a switch does not disturb the run. */
+static void sim_loop_hand_over(sim_loop_t *loop, sim_numeric_t numeric) {
+    sim_loop_fix_t *fx = &loop->fix;
+    if (numeric == SIM_NUMERIC_FIXED) {
+        fx->pid.integrator = fix_acc_from_float(loop->pid.integrator);
+        fx->pid.prev_error = fix_from_float(loop->pid.prev_error);
+        for (int i = 0; i < PLANT_MAX_ORDER; i++) {
+            fx->x[i] = fix_acc_from_float(loop->x[i]);
+        }
+        fx->y = fix_from_float(loop->y);
+        delay_line_to_fix(&loop->delay);
+        fx->cfg_valid = 0;
+    } else {
+        loop->pid.integrator = fix_acc_to_float(fx->pid.integrator);
+        loop->pid.prev_error = fix_to_float(fx->pid.prev_error);
+        for (int i = 0; i < PLANT_MAX_ORDER; i++) {
+            loop->x[i] = fix_acc_to_float(fx->x[i]);
+        }
+        delay_line_to_float(&loop->delay);
+    }
+    loop->numeric = numeric;
+}
+
+/**
+ * Convert everything the fixed-point tick needs from cfg. Runs only when
+ * the config changes, so the tick itself does no float math.
+ */
+static void sim_loop_fix_prepare(sim_loop_t *loop, const sim_config_t *cfg) {
+    sim_loop_fix_t *fx = &loop->fix;
+    int dt_us = sim_loop_dt_us(cfg);
+    float dt = dt_us / 1e6f;
+    pid_fix_set_gains(&fx->pid, cfg->pid.kp, cfg->pid.ki, cfg->pid.kd, dt);
+
+    sim_loop_discretize(loop, cfg, dt_us);
+    plant_ss_fix_init(&fx->plant, &loop->plant);
+
+    float active_setpoint = cfg->use_master_setpoint ? cfg->master_setpoint : cfg->setpoint;
+    fx->setpoint = fix_from_float(active_setpoint);
+
+    float act_min = cfg->act_min;
+    float act_max = cfg->act_max;
+    fx->act_enabled = actuator_limits(cfg->act_inject, cfg->act_absorb, &act_min, &act_max);
+    fx->act_min = fix_from_float(act_min);
+    fx->act_max = fix_from_float(act_max);
+
+    fx->cfg_key = *cfg;
+    fx->cfg_valid = 1;
+}
+
+/**
+ * Advance rt->time_s by one step. The sum is kept in double so sub-ms steps
+ * keep counting; a caller that rewinds rt->time_s restarts it from there.
+ */
+static void sim_loop_advance_time(sim_loop_t *loop, sim_runtime_t *rt, int dt_us) {
+    if ((float)loop->time_s != rt->time_s) loop->time_s = rt->time_s;
+    loop->time_s += dt_us * 1e-6;
+    rt->time_s = (float)loop->time_s;
+}
+
+/** sim_loop_step() on the fixed-point backend. */
+static void sim_loop_step_fix(sim_loop_t *loop, const sim_config_t *cfg, sim_runtime_t *rt, int dt_us) {
+    sim_loop_fix_t *fx = &loop->fix;
+    /* A setpoint profile moves the setpoint every tick; that alone needs no full prepare. */
+    if (fx->cfg_valid &&
+        (fx->cfg_key.setpoint != cfg->setpoint || fx->cfg_key.master_setpoint != cfg->master_setpoint)) {
+        fx->cfg_key.setpoint = cfg->setpoint;
+        fx->cfg_key.master_setpoint = cfg->master_setpoint;
+        fx->setpoint = fix_from_float(cfg->use_master_setpoint ? cfg->master_setpoint : cfg->setpoint);
+    }
+    if (!fx->cfg_valid || memcmp(&fx->cfg_key, cfg, sizeof(*cfg)) != 0) {
+        sim_loop_fix_prepare(loop, cfg);
+    }
+
+    fix_t setpoint = cfg->running ? fx->setpoint : 0;
+    fix_t u = 0;
+    if (cfg->running) {
+        fix_t feedback = cfg->allow_sens_signal ? fx->y : 0;
+        u = pid_fix_step(&fx->pid, fix_sub(setpoint, feedback));
+    }
+    fix_t u1 = fx->act_enabled ? fix_clamp(u, fx->act_min, fx->act_max) : 0;
+
+    delay_line_set(&loop->delay, cfg->plant.dead_time_ms, dt_us);
+    fix_t u_delayed = delay_line_step_fix(&loop->delay, u1);
+
+    fix_t y = plant_ss_step_fix(&fx->plant, fx->x, u_delayed);
+    fx->y = y;
+
+    loop->u = fix_to_float(u);
+    loop->u1 = fix_to_float(u1);
+    loop->y = fix_to_float(y);
+
+    sim_loop_advance_time(loop, rt, dt_us);
+    rt->setpoint = fix_to_float(setpoint);
+    rt->control = loop->u;
+    rt->actuator = loop->u1;
+    rt->output = loop->y;
+}
+
+/** Run one PID -> actuator -> dead time -> plant tick and publish the result into rt. */
+void sim_loop_step(sim_loop_t *loop, const sim_config_t *cfg, sim_runtime_t *rt) {
+    int dt_us = sim_loop_dt_us(cfg);
+
+    if (cfg->numeric != loop->numeric) {
+        sim_loop_hand_over(loop, cfg->numeric);
+    }
+    if (loop->numeric == SIM_NUMERIC_FIXED) {
+        sim_loop_step_fix(loop, cfg, rt, dt_us);
+        return;
+    }
+
+    float dt = dt_us / 1e6f;
+
+    loop->pid.kp = cfg->pid.kp;
+    loop->pid.ki = cfg->pid.ki;
+    loop->pid.kd = cfg->pid.kd;
+
+    float active_setpoint = cfg->use_master_setpoint ? cfg->master_setpoint : cfg->setpoint;
+    float setpoint = cfg->running ? active_setpoint : 0.0f;
+    if (cfg->running) {
+        float feedback = cfg->allow_sens_signal ? loop->y : 0.0f;
+        float error = setpoint - feedback;
+        loop->u = pid_step(&loop->pid, error, dt);
+    } else {
+        loop->u = 0.0f;
+    }
+    /* Apply actuator direction and limits based on UI selection. */
+    loop->u1 = actuator_apply(loop->u, cfg->act_inject, cfg->act_absorb, cfg->act_min, cfg->act_max);
+
+    delay_line_set(&loop->delay, cfg->plant.dead_time_ms, dt_us);
+    float u_delayed = delay_line_step(&loop->delay, loop->u1);
+
+    sim_loop_discretize(loop, cfg, dt_us);
+    loop->y = plant_ss_step(&loop->plant, loop->x, u_delayed);
+
+    sim_loop_advance_time(loop, rt, dt_us);
+    rt->setpoint = setpoint;
+    rt->control = loop->u;
+    rt->actuator = loop->u1;
+    rt->output = loop->y;
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include "delay_line.h"
+#include "pid.h"
+#include "plant.h"
+#include "sim_state.h"
+
+/* Fixed-point pipeline state; coefficients follow the config in cfg_key. */
+typedef struct {
+    pid_fix_t pid;
+    plant_ss_fix_t plant; // fixed-point copy of sim_loop_t.plant
+    fix_acc_t x[PLANT_MAX_ORDER]; // plant state
+    fix_t y; // last plant output
+    fix_t setpoint; // active setpoint while running
+    fix_t act_min; // actuator limits after the inject/absorb rules
+    fix_t act_max;
+    int act_enabled;
+    sim_config_t cfg_key; // config the cached values were computed from
+    int cfg_valid;
+} sim_loop_fix_t;
+
+typedef struct {
+    sim_numeric_t numeric; // backend that owns the current state
+    pid_t pid; // controller state
+    float x[PLANT_MAX_ORDER]; // plant state (x[0] is the output of the built-in models)
+    plant_ss_t plant; // discretized plant for plant_key and plant_dt_us
+    plant_params_t plant_key;
+    int plant_dt_us;
+    int plant_valid;
+    plant_work_t work; // scratch for discretizing transfer functions
+    float y; // plant output y(t)
+    float u; // controller output u(t)
+    float u1; // actuator output u1(t)
+    double time_s; // elapsed time; rt->time_s is a float that stalls at long runs with sub-ms steps
+    delay_line_t delay; // dead time of actuator values; holds fix_t samples on the fixed backend
+    sim_loop_fix_t fix; // state of the SIM_NUMERIC_FIXED backend
+} sim_loop_t;
+
+/** Reset the loop pipeline (PID, plant states, dead time) to its initial values. */
+void sim_loop_reset(sim_loop_t *loop, const sim_config_t *cfg);
+
+/** Clamp the configured time step to the supported SIM_DT_MIN_US..SIM_DT_MAX_US range. */
+int sim_loop_dt_us(const sim_config_t *cfg);
+
+/** Time step in whole milliseconds (at least 1), for the millisecond API. */
+int sim_loop_dt_ms(const sim_config_t *cfg);
+
+/** Return the pooled dead-time storage of a loop that is done (offline runs). */
+void sim_loop_release(sim_loop_t *loop);
+
+/**
+ * Discretize the configured plant model for time step dt (in seconds).
+ * Returns 0 if the transfer function is invalid; ss then holds its output.
+ */
+int sim_loop_plant_discretize(plant_ss_t *ss, const plant_params_t *p, float dt, plant_work_t *work);
+
+/**
+ * Resolve the actuator limits for the inject/absorb mode.
+ * Returns 0 if the actuator is disabled (no effect on the plant).
+ */
+int actuator_limits(int inject, int absorb, float *min_out, float *max_out);
+
+/** Map controller output into actuator output based on mode and limits. */
+float actuator_apply(float u, int inject, int absorb, float min_out, float max_out);
+
+/**
+ * Run one PID -> actuator -> dead time -> plant tick and publish the result into rt.
+ * rt->time_s is advanced by the (clamped) time step. cfg->numeric selects the
+ * backend; switching hands the state over without a reset.
+ */
+void sim_loop_step(sim_loop_t *loop, const sim_config_t *cfg, sim_runtime_t *rt);
@@ -0,0 +1,162 @@
+#include <math.h>
+#include <stddef.h>
+#include <string.h>
+
+#include "sim_params.h"
+
+static const char *const k_param_keys[SIM_PARAM_COUNT] = {
+    [SIM_PARAM_SETPOINT] = "setpoint",
+    [SIM_PARAM_KP] = "kp",
+    [SIM_PARAM_KI] = "ki",
+    [SIM_PARAM_KD] = "kd",
+    [SIM_PARAM_DT] = "dt",
+    [SIM_PARAM_MODEL] = "model",
+    [SIM_PARAM_GAIN] = "gain",
+    [SIM_PARAM_TAU] = "tau",
+    [SIM_PARAM_WN] = "wn",
+    [SIM_PARAM_ZETA] = "zeta",
+    [SIM_PARAM_DEAD] = "dead",
+    [SIM_PARAM_ACT_MIN] = "act_min",
+    [SIM_PARAM_ACT_MAX] = "act_max",
+    [SIM_PARAM_ACT_INJECT] = "act_inject",
+    [SIM_PARAM_ACT_ABSORB] = "act_absorb",
+    [SIM_PARAM_USE_MASTER] = "use_master",
+    [SIM_PARAM_ALLOW_SENS] = "allow_sens",
+    [SIM_PARAM_RUN] = "run",
+    [SIM_PARAM_RESET] = "reset",
+    [SIM_PARAM_MASTER_SETPOINT] = "master_setpoint",
+    [SIM_PARAM_FIXED] = "fixed",
+    [SIM_PARAM_ZOH] = "zoh",
+    [SIM_PARAM_DT_US] = "dt_us",
+};
+
+/** Query-string key for a parameter (NULL for unknown ids). */
+const char *sim_param_key(sim_param_t id) {
+    if (id <= SIM_PARAM_NONE || id >= SIM_PARAM_COUNT) return NULL;
+    return k_param_keys[id];
+}
+
+static float clampf(float v, float lo, float hi) {
+    if (v < lo) v = lo;
+    if (v > hi) v = hi;
+    return v;
+}
+
+static int clampi(int v, int lo, int hi) {
+    if (v < lo) v = lo;
+    if (v > hi) v = hi;
+    return v;
+}
+
+/** Clamp and store one parameter value in cfg. */
+int sim_param_apply(sim_config_t *cfg, sim_param_t id, float value) {
+    const float min_gain = 0.0f;
+    const float max_gain = 10.0f;
+    const float min_tau = 0.1f;
+    const float max_tau = 60.0f;
+    const float min_wn = 0.1f;
+    const float max_wn = 10.0f;
+    const float min_zeta = 0.0f;
+    const float max_zeta = 2.0f;
+    const int min_dead = 0;
+    const int max_dead = 2560;
+    const float min_act = -1000.0f;
+    const float max_act = 1000.0f;
+    const int min_dt_us = SIM_DT_MIN_US;
+    const int max_dt_us = SIM_DT_MAX_US;
+
+    int ivalue = (int)value;
+
+    switch (id) {
+    case SIM_PARAM_SETPOINT: cfg->setpoint = value; break;
+    case SIM_PARAM_KP: cfg->pid.kp = value; break;
+    case SIM_PARAM_KI: cfg->pid.ki = value; break;
+    case SIM_PARAM_KD: cfg->pid.kd = value; break;
+    case SIM_PARAM_DT: cfg->dt_us = (int)lroundf(clampf(value * 1000.0f, min_dt_us, max_dt_us)); break; // ms, fractions allowed
+    case SIM_PARAM_MODEL:
+        if (ivalue == PLANT_TRANSFER_FUNCTION) {
+            cfg->plant.model = PLANT_TRANSFER_FUNCTION;
+        } else {
+            cfg->plant.model = (ivalue == 1) ? PLANT_SECOND_ORDER : PLANT_FIRST_ORDER;
+        }
+        break;
+    case SIM_PARAM_GAIN: cfg->plant.gain = clampf(value, min_gain, max_gain); break;
+    case SIM_PARAM_TAU: cfg->plant.tau = clampf(value, min_tau, max_tau); break;
+    case SIM_PARAM_WN: cfg->plant.wn = clampf(value, min_wn, max_wn); break;
+    case SIM_PARAM_ZETA: cfg->plant.zeta = clampf(value, min_zeta, max_zeta); break;
+    case SIM_PARAM_DEAD: cfg->plant.dead_time_ms = clampi(ivalue, min_dead, max_dead); break;
+    case SIM_PARAM_ACT_MIN: cfg->act_min = clampf(value, min_act, max_act); break;
+    case SIM_PARAM_ACT_MAX: cfg->act_max = clampf(value, min_act, max_act); break;
+    case SIM_PARAM_ACT_INJECT: cfg->act_inject = ivalue ? 1 : 0; break;
+    case SIM_PARAM_ACT_ABSORB: cfg->act_absorb = ivalue ? 1 : 0; break;
+    case SIM_PARAM_USE_MASTER: cfg->use_master_setpoint = ivalue ? 1 : 0; break;
+    case SIM_PARAM_ALLOW_SENS: cfg->allow_sens_signal = ivalue ? 1 : 0; break;
+    case SIM_PARAM_RUN: cfg->running = ivalue ? 1 : 0; break;
+    case SIM_PARAM_RESET: return ivalue ? 1 : 0;
+    case SIM_PARAM_MASTER_SETPOINT: cfg->master_setpoint = value; break;
+    case SIM_PARAM_FIXED: cfg->numeric = ivalue ? SIM_NUMERIC_FIXED : SIM_NUMERIC_FLOAT; break;
+    case SIM_PARAM_ZOH: cfg->plant.method = ivalue ? PLANT_METHOD_ZOH : PLANT_METHOD_EULER; break;
+    case SIM_PARAM_DT_US: cfg->dt_us = clampi(ivalue, min_dt_us, max_dt_us); break;
+    default: break;
+    }
+    return 0;
+}
+
+/** Current value of one parameter in cfg (0 for actions such as SIM_PARAM_RESET). */
+float sim_param_get(const sim_config_t *cfg, sim_param_t id) {
+    switch (id) {
+    case SIM_PARAM_SETPOINT: return cfg->setpoint;
+    case SIM_PARAM_KP: return cfg->pid.kp;
+    case SIM_PARAM_KI: return cfg->pid.ki;
+    case SIM_PARAM_KD: return cfg->pid.kd;
+    case SIM_PARAM_DT: return (float)cfg->dt_us / 1000.0f;
+    case SIM_PARAM_MODEL: return (float)cfg->plant.model;
+    case SIM_PARAM_GAIN: return cfg->plant.gain;
+    case SIM_PARAM_TAU: return cfg->plant.tau;
+    case SIM_PARAM_WN: return cfg->plant.wn;
+    case SIM_PARAM_ZETA: return cfg->plant.zeta;
+    case SIM_PARAM_DEAD: return (float)cfg->plant.dead_time_ms;
+    case SIM_PARAM_ACT_MIN: return cfg->act_min;
+    case SIM_PARAM_ACT_MAX: return cfg->act_max;
+    case SIM_PARAM_ACT_INJECT: return (float)cfg->act_inject;
+    case SIM_PARAM_ACT_ABSORB: return (float)cfg->act_absorb;
+    case SIM_PARAM_USE_MASTER: return (float)cfg->use_master_setpoint;
+    case SIM_PARAM_ALLOW_SENS: return (float)cfg->allow_sens_signal;
+    case SIM_PARAM_RUN: return (float)cfg->running;
+    case SIM_PARAM_MASTER_SETPOINT: return cfg->master_setpoint;
+    case SIM_PARAM_FIXED: return (float)cfg->numeric;
+    case SIM_PARAM_ZOH: return (float)cfg->plant.method;
+    case SIM_PARAM_DT_US: return (float)cfg->dt_us;
+    default: return 0.0f;
+    }
+}
+
+/** Store a transfer function num(s) / den(s) in cfg->plant; 0 if rejected. */
+int sim_param_set_tf(sim_config_t *cfg, const float *num, int num_len, const float *den, int den_len) {
+    if (den_len < 2 || den_len > PLANT_MAX_ORDER + 1) return 0;
+    if (num_len < 1 || num_len > den_len) return 0;
+    if (den[0] == 0.0f) return 0;
+    for (int i = 0; i < den_len; i++) {
+        if (!isfinite(den[i])) return 0;
+    }
+    for (int i = 0; i < num_len; i++) {
+        if (!isfinite(num[i])) return 0;
+    }
+
+    int n = den_len - 1;
+    memset(cfg->plant.tf_num, 0, sizeof(cfg->plant.tf_num));
+    memset(cfg->plant.tf_den, 0, sizeof(cfg->plant.tf_den));
+    memcpy(cfg->plant.tf_num + (den_len - num_len), num, (size_t)num_len * sizeof(float));
+    memcpy(cfg->plant.tf_den, den, (size_t)den_len * sizeof(float));
+    cfg->plant.tf_order = n;
+    return 1;
+}
+
+/** Fix up cross-parameter constraints after a batch of sim_param_apply() calls. */
+void sim_param_finish(sim_config_t *cfg) {
+    if (cfg->act_min > cfg->act_max) {
+        float tmp = cfg->act_min;
+        cfg->act_min = cfg->act_max;
+        cfg->act_max = tmp;
+    }
+}
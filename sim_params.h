@@ -0,0 +1,59 @@
+#pragma once
+
+#include "sim_state.h"
+
+/*
+ * Identifiers for every externally settable configuration parameter.
+ * The numeric values are part of the binary protocols (WebSocket, UDP,
+ * recordings), so only append new entries.
+ */
+typedef enum {
+    SIM_PARAM_NONE = 0,
+    SIM_PARAM_SETPOINT = 1,
+    SIM_PARAM_KP = 2,
+    SIM_PARAM_KI = 3,
+    SIM_PARAM_KD = 4,
+    SIM_PARAM_DT = 5,
+    SIM_PARAM_MODEL = 6,
+    SIM_PARAM_GAIN = 7,
+    SIM_PARAM_TAU = 8,
+    SIM_PARAM_WN = 9,
+    SIM_PARAM_ZETA = 10,
+    SIM_PARAM_DEAD = 11,
+    SIM_PARAM_ACT_MIN = 12,
+    SIM_PARAM_ACT_MAX = 13,
+    SIM_PARAM_ACT_INJECT = 14,
+    SIM_PARAM_ACT_ABSORB = 15,
+    SIM_PARAM_USE_MASTER = 16,
+    SIM_PARAM_ALLOW_SENS = 17,
+    SIM_PARAM_RUN = 18,
+    SIM_PARAM_RESET = 19,
+    SIM_PARAM_MASTER_SETPOINT = 20,
+    SIM_PARAM_FIXED = 21,
+    SIM_PARAM_ZOH = 22,
+    SIM_PARAM_DT_US = 23,
+    SIM_PARAM_COUNT
+} sim_param_t;
+
+/** Query-string key for a parameter (NULL for unknown ids). */
+const char *sim_param_key(sim_param_t id);
+
+/**
+ * Clamp and store one parameter value in cfg.
+ * Returns 1 if the parameter requests a loop reset, 0 otherwise.
+ */
+int sim_param_apply(sim_config_t *cfg, sim_param_t id, float value);
+
+/** Current value of one parameter in cfg, as sim_param_apply() takes it (0 for actions). */
+float sim_param_get(const sim_config_t *cfg, sim_param_t id);
+
+/**
+ * Store a transfer function num(s) / den(s) (coefficients highest power
+ * first) in cfg->plant. den needs 2..PLANT_MAX_ORDER + 1 entries and a
+ * non-zero leading one; num may not have more entries than den.
+ * Returns 0 and leaves cfg unchanged if the coefficients are rejected.
+ */
+int sim_param_set_tf(sim_config_t *cfg, const float *num, int num_len, const float *den, int den_len);
+
+/** Fix up cross-parameter constraints after a batch of sim_param_apply() calls. */
+void sim_param_finish(sim_config_t *cfg);
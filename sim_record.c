@@ -0,0 +1,395 @@
+#include <string.h>
+
+#include "hardware/sync.h"
+#include "pico/time.h"
+
+#include "sim_record.h"
+
+#define SIM_RECORD_FNV_BASIS 2166136261u
+#define SIM_RECORD_FNV_PRIME 16777619u
+/* Most entries one tick can add: every scalar parameter, the transfer function, a reset and a sample. */
+#define SIM_RECORD_TICK_ENTRIES (SIM_PARAM_COUNT + 2 * (PLANT_MAX_ORDER + 1) + 3)
+
+/* Parameters compared every tick; SIM_PARAM_DT_US covers SIM_PARAM_DT exactly. */
+static const sim_param_t k_record_params[] = {
+    SIM_PARAM_SETPOINT, SIM_PARAM_KP, SIM_PARAM_KI, SIM_PARAM_KD, SIM_PARAM_DT_US, SIM_PARAM_MODEL,
+    SIM_PARAM_GAIN, SIM_PARAM_TAU, SIM_PARAM_WN, SIM_PARAM_ZETA, SIM_PARAM_DEAD, SIM_PARAM_ACT_MIN,
+    SIM_PARAM_ACT_MAX, SIM_PARAM_ACT_INJECT, SIM_PARAM_ACT_ABSORB, SIM_PARAM_USE_MASTER, SIM_PARAM_ALLOW_SENS,
+    SIM_PARAM_RUN, SIM_PARAM_MASTER_SETPOINT, SIM_PARAM_FIXED, SIM_PARAM_ZOH,
+};
+
+typedef struct {
+    sim_record_header_t header;
+    sim_record_entry_t entry[SIM_RECORD_MAX_ENTRIES];
+} sim_record_image_t;
+
+_Static_assert(sizeof(sim_record_image_t) <= SIM_RECORD_BYTES, "recording image exceeds SIM_RECORD_BYTES");
+
+/* Replay pipeline; lives on core1 while a replay runs. */
+typedef struct {
+    sim_loop_t loop; // private pipeline, independent of the live loop
+    sim_config_t cfg;
+    sim_runtime_t rt;
+    uint32_t tick;
+    uint32_t next; // next entry
+    uint32_t hash;
+    int mismatch; // flag: a sample differed
+    uint64_t start_us;
+} sim_replay_t;
+
+/*
+ * The image is written by one side at a time: core1 while recording,
+ * core0 while uploading, and only read otherwise. core0 requests a
+ * recording, stop or replay by bumping a counter that core1 acknowledges
+ * on its next tick, so core1 never waits on core0.
+ */
+typedef struct {
+    sim_record_image_t image;
+    volatile sim_record_state_t state;
+    volatile uint32_t gen;
+    volatile uint32_t start_requests; // incremented by core0
+    volatile uint32_t start_handled; // last start request consumed by core1
+    volatile uint32_t stop_requests;
+    volatile uint32_t stop_handled;
+    volatile uint32_t replay_requests;
+    volatile uint32_t replay_handled;
+    volatile int full;
+    int every; // sample period of the requested recording
+    sim_config_t prev; // configuration of the previous recorded tick
+    uint32_t count; // entries written by core1 while recording
+    uint32_t ticks;
+    uint32_t hash;
+    size_t upload_len; // image bytes announced by the upload
+    size_t upload_pos;
+    volatile sim_replay_state_t replay;
+    volatile uint32_t replay_tick;
+    volatile uint32_t mismatch_tick;
+    volatile uint32_t replay_us;
+} sim_record_t;
+
+static sim_record_t g_record;
+static sim_replay_t g_replay;
+
+/** Fold the runtime block of one tick into an FNV-1a hash. */
+static uint32_t sim_record_hash(uint32_t hash, const sim_runtime_t *rt) {
+    const uint8_t *p = (const uint8_t *)rt;
+    for (size_t i = 0; i < sizeof(*rt); i++) {
+        hash = (hash ^ p[i]) * SIM_RECORD_FNV_PRIME;
+    }
+    return hash;
+}
+
+/** Non-zero if two floats differ in any bit (-0.0, NaN payloads). */
+static int sim_record_float_differs(float a, float b) {
+    return memcmp(&a, &b, sizeof(a)) != 0;
+}
+
+/** Clear the recorder (before core1 starts). */
+void sim_record_init(void) {
+    memset(&g_record, 0, sizeof(g_record));
+    g_record.state = SIM_RECORD_EMPTY;
+    g_record.replay = SIM_REPLAY_IDLE;
+}
+
+/** Non-zero while core1 has a replay requested or running on the image. */
+static int sim_replay_busy(void) {
+    return g_record.replay_requests != g_record.replay_handled || g_record.replay == SIM_REPLAY_RUNNING;
+}
+
+/** Ask core1 to start a recording on its next tick. */
+int sim_record_start(int every) {
+    if (sim_replay_busy() || g_record.state == SIM_RECORD_UPLOADING) return 0;
+    if (every < 1) every = 1;
+    if (every > SIM_RECORD_MAX_EVERY) every = SIM_RECORD_MAX_EVERY;
+    g_record.every = every;
+    __dmb();
+    g_record.start_requests++;
+    return 1;
+}
+
+/** Ask core1 to end the recording after the current tick. */
+void sim_record_stop(void) {
+    g_record.stop_requests++;
+}
+
+/** Ask core1 to replay the held recording. */
+int sim_replay_start(void) {
+    if (g_record.state != SIM_RECORD_DONE || g_record.start_requests != g_record.start_handled) return 0;
+    g_record.replay_requests++;
+    return 1;
+}
+
+/** Read the recorder and replay status. */
+void sim_record_get_status(sim_record_status_t *out) {
+    memset(out, 0, sizeof(*out));
+    out->state = g_record.state;
+    out->gen = g_record.gen;
+    out->capacity = SIM_RECORD_MAX_ENTRIES;
+    out->full = g_record.full;
+    if (out->state == SIM_RECORD_RECORDING) {
+        out->ticks = g_record.ticks;
+        out->entries = g_record.count;
+        out->every = (uint32_t)g_record.every;
+    } else if (out->state == SIM_RECORD_DONE) {
+        const sim_record_header_t *h = &g_record.image.header;
+        out->ticks = h->ticks;
+        out->entries = h->entries;
+        out->every = h->every;
+    }
+    out->bytes = (uint32_t)(sizeof(sim_record_header_t) + out->entries * sizeof(sim_record_entry_t));
+    out->replay = g_record.replay;
+    out->replay_tick = g_record.replay_tick;
+    out->mismatch_tick = g_record.mismatch_tick;
+    out->replay_us = g_record.replay_us;
+}
+
+/** Non-zero while the complete image of generation gen is held. */
+static int sim_record_holds(uint32_t gen) {
+    return g_record.state == SIM_RECORD_DONE && g_record.gen == gen;
+}
+
+/**
+ * Copy bytes of the held image. core1 leaves SIM_RECORD_DONE before it
+ * overwrites the image for a new recording, so a copy that still sees the
+ * same generation afterwards was not torn.
+ */
+size_t sim_record_read(uint32_t gen, size_t offset, void *out, size_t len) {
+    if (!sim_record_holds(gen)) return SIM_RECORD_GONE;
+    const sim_record_header_t *h = &g_record.image.header;
+    size_t size = sizeof(*h) + h->entries * sizeof(sim_record_entry_t);
+    if (offset >= size) return 0;
+    if (len > size - offset) len = size - offset;
+    memcpy(out, (const uint8_t *)&g_record.image + offset, len);
+    __dmb();
+    return sim_record_holds(gen) ? len : SIM_RECORD_GONE;
+}
+
+/** Start receiving an image of len bytes. */
+int sim_record_upload_begin(size_t len) {
+    if (len < sizeof(sim_record_header_t) || len > sizeof(g_record.image)) return 0;
+    if (sim_replay_busy() || g_record.start_requests != g_record.start_handled) return 0;
+    if (g_record.state == SIM_RECORD_RECORDING || g_record.state == SIM_RECORD_UPLOADING) return 0;
+    g_record.state = SIM_RECORD_UPLOADING;
+    g_record.gen++;
+    g_record.full = 0;
+    g_record.replay = SIM_REPLAY_IDLE;
+    g_record.upload_len = len;
+    g_record.upload_pos = 0;
+    return 1;
+}
+
+/** Append the next bytes of the image being uploaded. */
+void sim_record_upload_write(const void *data, size_t len) {
+    if (g_record.state != SIM_RECORD_UPLOADING) return;
+    if (len > g_record.upload_len - g_record.upload_pos) len = g_record.upload_len - g_record.upload_pos;
+    memcpy((uint8_t *)&g_record.image + g_record.upload_pos, data, len);
+    g_record.upload_pos += len;
+}
+
+/** Validate the uploaded image and hold it as the recording. */
+int sim_record_upload_end(void) {
+    if (g_record.state != SIM_RECORD_UPLOADING) return 0;
+    const sim_record_header_t *h = &g_record.image.header;
+    int ok = g_record.upload_pos == g_record.upload_len && h->magic == SIM_RECORD_MAGIC &&
+             h->version == SIM_RECORD_VERSION && h->cfg_size == sizeof(sim_config_t) &&
+             h->entries <= SIM_RECORD_MAX_ENTRIES && h->ticks <= SIM_RECORD_MAX_TICKS && h->every >= 1 &&
+             g_record.upload_len == sizeof(*h) + h->entries * sizeof(sim_record_entry_t);
+    for (uint32_t i = 0; ok && i < h->entries; i++) {
+        uint32_t tick = g_record.image.entry[i].tick_kind >> 8;
+        ok = tick < h->ticks && (i == 0 || tick >= g_record.image.entry[i - 1].tick_kind >> 8);
+    }
+    g_record.state = ok ? SIM_RECORD_DONE : SIM_RECORD_EMPTY;
+    return ok;
+}
+
+/** Append one entry for the current tick (room was checked at the start of the tick). */
+static void sim_record_put(int kind, float value) {
+    sim_record_entry_t *e = &g_record.image.entry[g_record.count++];
+    e->tick_kind = g_record.ticks << 8 | (uint32_t)kind;
+    e->value = value;
+}
+
+/** Record what changed in cfg since the previous tick. */
+static void sim_record_deltas(const sim_config_t *cfg) {
+    const sim_config_t *prev = &g_record.prev;
+    if (memcmp(cfg, prev, sizeof(*cfg)) == 0) return;
+    for (size_t i = 0; i < sizeof(k_record_params) / sizeof(k_record_params[0]); i++) {
+        float v = sim_param_get(cfg, k_record_params[i]);
+        if (sim_record_float_differs(v, sim_param_get(prev, k_record_params[i]))) {
+            sim_record_put(k_record_params[i], v);
+        }
+    }
+    if (cfg->plant.tf_order != prev->plant.tf_order) {
+        sim_record_put(SIM_RECORD_TF_ORDER, (float)cfg->plant.tf_order);
+    }
+    for (int i = 0; i <= PLANT_MAX_ORDER; i++) {
+        if (sim_record_float_differs(cfg->plant.tf_num[i], prev->plant.tf_num[i])) {
+            sim_record_put(SIM_RECORD_TF_NUM + i, cfg->plant.tf_num[i]);
+        }
+        if (sim_record_float_differs(cfg->plant.tf_den[i], prev->plant.tf_den[i])) {
+            sim_record_put(SIM_RECORD_TF_DEN + i, cfg->plant.tf_den[i]);
+        }
+    }
+    g_record.prev = *cfg;
+}
+
+/** Close the recording: complete the header so core0 may read the image. */
+static void sim_record_finish(int full) {
+    sim_record_header_t *h = &g_record.image.header;
+    h->ticks = g_record.ticks;
+    h->entries = g_record.count;
+    h->hash = g_record.hash;
+    g_record.full = full;
+    __dmb();
+    g_record.state = SIM_RECORD_DONE;
+}
+
+/** Recorder hook before sim_loop_step() (core1). */
+void sim_record_tick_begin(sim_loop_t *loop, const sim_config_t *cfg, const sim_runtime_t *rt, int reset) {
+    uint32_t start = g_record.start_requests;
+    if (start != g_record.start_handled) {
+        g_record.start_handled = start;
+        g_record.count = 0;
+        g_record.ticks = 0;
+        /* Readers of the held image must see it go before it is overwritten. */
+        g_record.state = SIM_RECORD_RECORDING;
+        g_record.gen++;
+        __dmb();
+        sim_loop_reset(loop, cfg);
+
+        sim_record_header_t *h = &g_record.image.header;
+        memset(h, 0, sizeof(*h));
+        h->magic = SIM_RECORD_MAGIC;
+        h->version = SIM_RECORD_VERSION;
+        h->cfg_size = sizeof(sim_config_t);
+        h->every = (uint32_t)g_record.every;
+        h->time_s = loop->time_s;
+        h->cfg = *cfg;
+        h->rt = *rt;
+        g_record.prev = *cfg;
+        g_record.hash = SIM_RECORD_FNV_BASIS;
+        g_record.full = 0;
+        g_record.stop_handled = g_record.stop_requests;
+        g_record.replay = SIM_REPLAY_IDLE;
+        return;
+    }
+    if (g_record.state != SIM_RECORD_RECORDING) return;
+
+    /* Stop before a tick that might not fit, so every recorded tick is complete. */
+    if (SIM_RECORD_MAX_ENTRIES - g_record.count < SIM_RECORD_TICK_ENTRIES || g_record.ticks >= SIM_RECORD_MAX_TICKS) {
+        sim_record_finish(1);
+        return;
+    }
+    sim_record_deltas(cfg);
+    if (reset) sim_record_put(SIM_PARAM_RESET, 1.0f);
+}
+
+/** Recorder hook after sim_loop_step() (core1). */
+void sim_record_tick_end(const sim_runtime_t *rt) {
+    if (g_record.state != SIM_RECORD_RECORDING) return;
+    g_record.hash = sim_record_hash(g_record.hash, rt);
+    if (g_record.ticks % (uint32_t)g_record.every == 0) sim_record_put(SIM_RECORD_SAMPLE, rt->output);
+    g_record.ticks++;
+
+    uint32_t stop = g_record.stop_requests;
+    if (stop != g_record.stop_handled) {
+        g_record.stop_handled = stop;
+        sim_record_finish(0);
+    }
+}
+
+/** Apply one recorded config delta to the replay configuration. */
+static void sim_replay_apply(sim_replay_t *rp, int kind, float value) {
+    if (kind == SIM_PARAM_RESET) {
+        sim_loop_reset(&rp->loop, &rp->cfg);
+    } else if (kind == SIM_RECORD_TF_ORDER) {
+        rp->cfg.plant.tf_order = (int)value;
+    } else if (kind >= SIM_RECORD_TF_NUM && kind <= SIM_RECORD_TF_NUM + PLANT_MAX_ORDER) {
+        rp->cfg.plant.tf_num[kind - SIM_RECORD_TF_NUM] = value;
+    } else if (kind >= SIM_RECORD_TF_DEN && kind <= SIM_RECORD_TF_DEN + PLANT_MAX_ORDER) {
+        rp->cfg.plant.tf_den[kind - SIM_RECORD_TF_DEN] = value;
+    } else {
+        /* Recorded values came through sim_param_apply(), so its clamping leaves them unchanged. */
+        sim_param_apply(&rp->cfg, (sim_param_t)kind, value);
+    }
+}
+
+/** Set the replay pipeline to the state before tick 0. */
+static void sim_replay_begin(sim_replay_t *rp) {
+    const sim_record_header_t *h = &g_record.image.header;
+    sim_loop_release(&rp->loop);
+    rp->cfg = h->cfg;
+    rp->rt = h->rt;
+    sim_loop_reset(&rp->loop, &rp->cfg);
+    rp->loop.time_s = h->time_s;
+    rp->tick = 0;
+    rp->next = 0;
+    rp->hash = SIM_RECORD_FNV_BASIS;
+    rp->mismatch = 0;
+    rp->start_us = time_us_64();
+    g_record.replay_tick = 0;
+    g_record.mismatch_tick = 0;
+    g_record.replay_us = 0;
+    __dmb();
+    g_record.replay = SIM_REPLAY_RUNNING;
+}
+
+/** Replay up to max_ticks; returns non-zero once the recording is done. */
+static int sim_replay_advance(sim_replay_t *rp, uint32_t max_ticks) {
+    const sim_record_header_t *h = &g_record.image.header;
+    const sim_record_entry_t *entry = g_record.image.entry;
+    for (uint32_t n = 0; n < max_ticks && rp->tick < h->ticks; n++) {
+        while (rp->next < h->entries && entry[rp->next].tick_kind >> 8 == rp->tick &&
+               (entry[rp->next].tick_kind & 0xFFu) != SIM_RECORD_SAMPLE) {
+            sim_replay_apply(rp, (int)(entry[rp->next].tick_kind & 0xFFu), entry[rp->next].value);
+            rp->next++;
+        }
+        sim_loop_step(&rp->loop, &rp->cfg, &rp->rt);
+        rp->hash = sim_record_hash(rp->hash, &rp->rt);
+        if (rp->next < h->entries && entry[rp->next].tick_kind == (rp->tick << 8 | SIM_RECORD_SAMPLE)) {
+            if (!rp->mismatch && sim_record_float_differs(entry[rp->next].value, rp->rt.output)) {
+                rp->mismatch = 1;
+                g_record.mismatch_tick = rp->tick;
+            }
+            rp->next++;
+        }
+        rp->tick++;
+    }
+    g_record.replay_tick = rp->tick;
+    g_record.replay_us = (uint32_t)(time_us_64() - rp->start_us);
+    return rp->tick >= h->ticks;
+}
+
+/** Replay the held recording until deadline_us (core1 idle time). */
+int sim_replay_work(uint64_t deadline_us) {
+    sim_replay_t *rp = &g_replay;
+    uint32_t req = g_record.replay_requests;
+    if (req != g_record.replay_handled) {
+        g_record.replay_handled = req;
+        __dmb();
+        if (g_record.state != SIM_RECORD_DONE) return 0;
+        sim_replay_begin(rp);
+    }
+    if (g_record.replay != SIM_REPLAY_RUNNING) return 0;
+
+    uint64_t now = time_us_64();
+    uint32_t slice_us = 0;
+    while (now + slice_us < deadline_us) {
+        int done = sim_replay_advance(rp, SIM_REPLAY_CHUNK_TICKS);
+        uint64_t end = time_us_64();
+        slice_us = (uint32_t)(end - now);
+        now = end;
+        if (done) {
+            /* The hash covers every tick; a difference between samples shows up only there. */
+            if (!rp->mismatch && rp->hash != g_record.image.header.hash) {
+                rp->mismatch = 1;
+                g_record.mismatch_tick = rp->tick;
+            }
+            sim_loop_release(&rp->loop);
+            __dmb();
+            g_record.replay = rp->mismatch ? SIM_REPLAY_MISMATCH : SIM_REPLAY_MATCH;
+            return 0;
+        }
+    }
+    return 1;
+}
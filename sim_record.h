@@ -0,0 +1,134 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "sim_loop.h"
+#include "sim_params.h"
+#include "sim_state.h"
+
+#ifndef SIM_RECORD_BYTES
+#define SIM_RECORD_BYTES (32 * 1024) // recording image: header plus entries
+#endif
+#define SIM_RECORD_MAGIC 0x43455250u // "PREC"
+#define SIM_RECORD_VERSION 1
+#define SIM_RECORD_MAX_TICKS 0xFFFFFFu // tick indices are 24 bits
+#define SIM_RECORD_DEFAULT_EVERY 10 // ticks per telemetry sample
+#define SIM_RECORD_MAX_EVERY 10000
+#define SIM_REPLAY_CHUNK_TICKS 32 // replayed ticks between deadline checks
+
+/*
+ * Entry kinds besides the sim_param_t ids of config deltas (SIM_PARAM_RESET
+ * marks a loop reset). Transfer function coefficients have no parameter id.
+ */
+#define SIM_RECORD_TF_NUM 0x40 // + coefficient index
+#define SIM_RECORD_TF_DEN 0x50 // + coefficient index
+#define SIM_RECORD_TF_ORDER 0x60
+#define SIM_RECORD_SAMPLE 0xFF // telemetry: value is y(t) after the tick
+
+/* One entry: a config delta applied before tick `tick`, or a sample taken after it. */
+typedef struct {
+    uint32_t tick_kind; // tick index << 8 | kind
+    float value;
+} sim_record_entry_t;
+
+/*
+ * Recording image, downloaded and uploaded as is (little endian). Entries
+ * are in tick order; within a tick the deltas come before the sample.
+ */
+typedef struct {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t cfg_size; // sizeof(sim_config_t) of the recording firmware
+    uint32_t ticks; // complete ticks recorded
+    uint32_t entries; // entries following the header
+    uint32_t every; // ticks per telemetry sample
+    uint32_t hash; // FNV-1a of the runtime block after every tick
+    double time_s; // loop time before tick 0 (rt.time_s is its float rounding)
+    sim_config_t cfg; // configuration of tick 0, applied with a loop reset
+    sim_runtime_t rt; // runtime block before tick 0
+} sim_record_header_t;
+
+#define SIM_RECORD_MAX_ENTRIES ((SIM_RECORD_BYTES - sizeof(sim_record_header_t)) / sizeof(sim_record_entry_t))
+
+typedef enum {
+    SIM_RECORD_EMPTY = 0,
+    SIM_RECORD_RECORDING = 1,
+    SIM_RECORD_DONE = 2, // a complete recording (stopped, full or uploaded) is held
+    SIM_RECORD_UPLOADING = 3
+} sim_record_state_t;
+
+typedef enum {
+    SIM_REPLAY_IDLE = 0,
+    SIM_REPLAY_RUNNING = 1,
+    SIM_REPLAY_MATCH = 2, // every sample and the final hash were reproduced bit for bit
+    SIM_REPLAY_MISMATCH = 3
+} sim_replay_state_t;
+
+typedef struct {
+    sim_record_state_t state;
+    uint32_t gen; // changes with every new recording or upload
+    uint32_t ticks;
+    uint32_t entries;
+    uint32_t capacity; // SIM_RECORD_MAX_ENTRIES
+    uint32_t every;
+    uint32_t bytes; // size of the image
+    int full; // flag: the recording stopped because the buffer ran out
+    sim_replay_state_t replay;
+    uint32_t replay_tick; // ticks replayed so far
+    uint32_t mismatch_tick; // first tick whose sample differed, or ticks if only the final hash did
+    uint32_t replay_us; // wall time of the replay so far
+} sim_record_status_t;
+
+/** Clear the recorder (before core1 starts). */
+void sim_record_init(void);
+
+/**
+ * Ask core1 to start a recording with one telemetry sample every `every`
+ * ticks; it begins on the next tick with a loop reset. Returns 0 while a
+ * replay or an upload is using the buffer.
+ */
+int sim_record_start(int every);
+
+/** Ask core1 to end the recording after the current tick. */
+void sim_record_stop(void);
+
+/** Ask core1 to replay the held recording in its idle time. Returns 0 if there is none. */
+int sim_replay_start(void);
+
+/** Read the recorder and replay status. */
+void sim_record_get_status(sim_record_status_t *out);
+
+#define SIM_RECORD_GONE ((size_t)-1) // sim_record_read(): the image of gen is gone or was replaced during the copy
+
+/**
+ * Copy up to len bytes of the held image from offset. Returns 0 past the
+ * end, SIM_RECORD_GONE if the recording is not complete or no longer of
+ * generation gen; out may then hold a torn copy and must be discarded.
+ */
+size_t sim_record_read(uint32_t gen, size_t offset, void *out, size_t len);
+
+/** Start receiving an image of len bytes; 0 if it does not fit or the buffer is busy. */
+int sim_record_upload_begin(size_t len);
+
+/** Append the next bytes of the image being uploaded. */
+void sim_record_upload_write(const void *data, size_t len);
+
+/** Validate the uploaded image; returns 1 if it is held as the new recording. */
+int sim_record_upload_end(void);
+
+/**
+ * Recorder hook before sim_loop_step() (core1): starts a requested
+ * recording, which resets loop, or records the config deltas of this tick.
+ * reset is non-zero if core1 just reset loop for a reset request.
+ */
+void sim_record_tick_begin(sim_loop_t *loop, const sim_config_t *cfg, const sim_runtime_t *rt, int reset);
+
+/** Recorder hook after sim_loop_step() (core1): hash and sample the tick. */
+void sim_record_tick_end(const sim_runtime_t *rt);
+
+/**
+ * Replay the held recording on a private pipeline until deadline_us
+ * (core1 idle time). Returns 0 if no replay is running.
+ */
+int sim_replay_work(uint64_t deadline_us);
@@ -0,0 +1,109 @@
+#include <math.h>
+#include <string.h>
+
+#include "pico/time.h"
+
+#include "sim_run.h"
+
+/** Start an offline run of the live-loop pipeline. */
+int sim_run_start(sim_run_t *run, const sim_config_t *cfg, float duration_s, float band) {
+    if (!(duration_s > 0.0f)) return 0;
+    run->start_us = time_us_64();
+    run->cfg = *cfg;
+    run->cfg.running = 1;
+    run->dt = sim_loop_dt_us(&run->cfg) / 1e6;
+    run->band = (band > 0.0f) ? band : SIM_RUN_DEFAULT_BAND;
+    double ticks = ceil(duration_s / run->dt);
+    run->ticks = (ticks > SIM_RUN_MAX_TICKS) ? SIM_RUN_MAX_TICKS : (uint32_t)ticks;
+    run->tick = 0;
+
+    sim_loop_reset(&run->loop, &run->cfg);
+    memset(&run->rt, 0, sizeof(run->rt));
+    run->rt.output = run->loop.y;
+    run->y0 = run->loop.y;
+    run->r = run->cfg.use_master_setpoint ? run->cfg.master_setpoint : run->cfg.setpoint;
+    run->t10 = -1.0;
+    run->t90 = -1.0;
+    run->peak = 0.0;
+    run->last_outside = 0.0;
+    run->settled = 0;
+    run->iae = 0.0;
+    run->ise = 0.0;
+    run->itae = 0.0;
+    run->peak_u1 = 0.0;
+    run->peak_u = 0.0;
+    run->dead_ms = 0.0f;
+    run->dead_limited = 0;
+    return 1;
+}
+
+/** Advance the run by up to max_ticks; non-zero once all ticks ran. */
+int sim_run_advance(sim_run_t *run, uint32_t max_ticks) {
+    const double dt = run->dt;
+    const double r = run->r;
+    const double step = r - run->y0;
+    uint32_t end = run->tick + max_ticks;
+    if (end > run->ticks || end < run->tick) end = run->ticks;
+
+    for (uint32_t i = run->tick + 1; i <= end; i++) {
+        sim_loop_step(&run->loop, &run->cfg, &run->rt);
+        double t = i * dt;
+        double y = run->rt.output;
+        double e = r - y;
+        run->iae += fabs(e) * dt;
+        run->ise += e * e * dt;
+        run->itae += t * fabs(e) * dt;
+        if (fabs(run->rt.actuator) > run->peak_u1) run->peak_u1 = fabs(run->rt.actuator);
+        if (fabs(run->rt.control) > run->peak_u) run->peak_u = fabs(run->rt.control);
+
+        if (step != 0.0) {
+            double progress = (y - run->y0) / step;
+            if (progress > run->peak) run->peak = progress;
+            if (run->t10 < 0.0 && progress >= 0.1) run->t10 = t;
+            if (run->t90 < 0.0 && progress >= 0.9) run->t90 = t;
+            run->settled = fabs(progress - 1.0) <= run->band;
+        } else {
+            run->settled = fabs(e) <= run->band * fmax(fabs(r), 1.0);
+        }
+        if (!run->settled) run->last_outside = t;
+    }
+    if (end > run->tick) {
+        run->dead_ms = delay_line_dead_ms(&run->loop.delay);
+        if (run->loop.delay.limited) run->dead_limited = 1;
+    }
+    run->tick = end;
+    if (run->tick < run->ticks) return 0;
+    sim_loop_release(&run->loop); // hand pooled dead-time storage back for the next run
+    return 1;
+}
+
+/** Step-response metrics of the ticks run so far. */
+void sim_run_metrics(const sim_run_t *run, sim_run_metrics_t *out) {
+    out->duration_s = (float)(run->tick * run->dt);
+    out->ticks = run->tick;
+    out->y0 = (float)run->y0;
+    out->setpoint = (float)run->r;
+    out->final = run->rt.output;
+    out->rise_time = (run->t10 >= 0.0 && run->t90 >= 0.0) ? (float)(run->t90 - run->t10) : -1.0f;
+    out->overshoot = (run->peak > 1.0) ? (float)((run->peak - 1.0) * 100.0) : 0.0f;
+    out->settling_time = run->settled ? (float)run->last_outside : -1.0f;
+    out->ss_error = (float)(run->r - run->rt.output);
+    out->iae = (float)run->iae;
+    out->ise = (float)run->ise;
+    out->itae = (float)run->itae;
+    out->peak_actuator = (float)run->peak_u1;
+    out->peak_control = (float)run->peak_u;
+    out->dead_ms = run->dead_ms;
+    out->dead_limited = run->dead_limited;
+    out->elapsed_us = (uint32_t)(time_us_64() - run->start_us);
+}
+
+/** Run the live-loop pipeline offline and measure its step response. */
+int sim_run_step_response(const sim_config_t *cfg, float duration_s, float band, sim_run_metrics_t *out) {
+    static sim_run_t run;
+    memset(out, 0, sizeof(*out));
+    if (!sim_run_start(&run, cfg, duration_s, band)) return 0;
+    sim_run_advance(&run, run.ticks);
+    sim_run_metrics(&run, out);
+    return 1;
+}
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "sim_loop.h"
+#include "sim_state.h"
+
+#define SIM_RUN_MAX_TICKS 60000 // upper bound on one offline run (duration / dt); HTTP runs it in main-loop slices
+#define SIM_RUN_DEFAULT_BAND 0.02f // settling band, fraction of the step size
+
+/** Step-response metrics of one offline run. Times are in seconds, -1 if not reached. */
+typedef struct {
+    float duration_s; // simulated time
+    uint32_t ticks;
+    float y0; // plant output at rest before the step
+    float setpoint; // active setpoint r
+    float final; // y at the end of the run
+    float rise_time; // 10 % -> 90 % of the step
+    float overshoot; // peak beyond the setpoint, percent of the step
+    float settling_time; // last entry into the settling band
+    float ss_error; // r - y at the end of the run
+    float iae; // integral of |e| dt
+    float ise; // integral of e^2 dt
+    float itae; // integral of t |e| dt
+    float peak_actuator; // largest |u1|
+    float peak_control; // largest |u|
+    float dead_ms; // dead time the run applied
+    int dead_limited; // flag: the delay storage cut the configured dead time to dead_ms
+    uint32_t elapsed_us; // wall time the run took
+} sim_run_metrics_t;
+
+/* One offline run in progress; advanced in slices by sim_run_advance(). */
+typedef struct {
+    sim_loop_t loop; // private pipeline, independent of the live loop
+    sim_config_t cfg;
+    sim_runtime_t rt;
+    double dt;
+    double band;
+    uint32_t tick;
+    uint32_t ticks;
+    double y0;
+    double r;
+    double t10;
+    double t90;
+    double peak; // largest progress (y - y0) / (r - y0)
+    double last_outside; // end of the last tick outside the settling band
+    int settled;
+    double iae;
+    double ise;
+    double itae;
+    double peak_u1;
+    double peak_u;
+    float dead_ms; // dead time applied so far
+    int dead_limited; // flag: the dead time was cut at some tick
+    uint64_t start_us;
+} sim_run_t;
+
+/**
+ * Start an offline run of the live-loop pipeline (sim_loop_step()) from
+ * its reset state for duration_s with cfg; cfg->running is forced on and
+ * neither the live loop nor g_sim is touched. band is the settling band as
+ * a fraction of the step. Returns 0 if the duration is not positive.
+ */
+int sim_run_start(sim_run_t *run, const sim_config_t *cfg, float duration_s, float band);
+
+/**
+ * Advance the run by up to max_ticks. Returns non-zero once all ticks ran;
+ * the pipeline's pooled dead-time storage is returned then.
+ */
+int sim_run_advance(sim_run_t *run, uint32_t max_ticks);
+
+/** Step-response metrics of the ticks run so far. */
+void sim_run_metrics(const sim_run_t *run, sim_run_metrics_t *out);
+
+/**
+ * Start, run to the end and measure in one call, as fast as the CPU
+ * allows. Uses static state, so call it from one context only (core0).
+ * Returns 0 if the duration is not positive.
+ */
+int sim_run_step_response(const sim_config_t *cfg, float duration_s, float band, sim_run_metrics_t *out);
@@ -1,9 +1,15 @@
 #include <string.h>
 
+#include "pico/time.h"
+
 #include "sim_state.h"
 
+#define SIM_SEQLOCK_TRIES 4
+
 sim_state_t g_sim;
 
+static uint32_t g_lock_enter_us;
+
 /** Initialize shared simulation state with safe defaults. */
 void sim_state_init(void) {
     critical_section_init(&g_sim.lock);
@@ -11,7 +17,7 @@ void sim_state_init(void) {
     g_sim.cfg.master_setpoint = 0.0f;
     g_sim.cfg.use_master_setpoint = 0;
     g_sim.cfg.allow_sens_signal = 1;
-    g_sim.cfg.dt_ms = 10;
+    g_sim.cfg.dt_us = 10000;
     g_sim.cfg.pid.kp = 2.0f;
     g_sim.cfg.pid.ki = 0.5f;
     g_sim.cfg.pid.kd = 0.1f;
@@ -21,96 +27,190 @@ void sim_state_init(void) {
     g_sim.cfg.plant.wn = 1.2f;
     g_sim.cfg.plant.zeta = 0.7f;
     g_sim.cfg.plant.dead_time_ms = 0;
+    g_sim.cfg.plant.method = PLANT_METHOD_EULER;
+    /* Default transfer function: 2 / (2s + 1)^3 */
+    static const float tf_den[] = {8.0f, 12.0f, 6.0f, 1.0f};
+    g_sim.cfg.plant.tf_order = 3;
+    memset(g_sim.cfg.plant.tf_num, 0, sizeof(g_sim.cfg.plant.tf_num));
+    memset(g_sim.cfg.plant.tf_den, 0, sizeof(g_sim.cfg.plant.tf_den));
+    g_sim.cfg.plant.tf_num[3] = 2.0f;
+    memcpy(g_sim.cfg.plant.tf_den, tf_den, sizeof(tf_den));
     g_sim.cfg.act_inject = 1;
     g_sim.cfg.act_absorb = 1;
     g_sim.cfg.act_min = -100.0f;
     g_sim.cfg.act_max = 100.0f;
     g_sim.cfg.running = 0;
+    g_sim.cfg.numeric = SIM_NUMERIC_DEFAULT;
     g_sim.rt.time_s = 0.0f;
     g_sim.rt.setpoint = g_sim.cfg.setpoint;
     g_sim.rt.control = 0.0f;
     g_sim.rt.actuator = 0.0f;
     g_sim.rt.output = 25.0f;
-    g_sim.reset_requested = 0;
+    g_sim.cfg_seq = 0;
+    g_sim.rt_seq = 0;
+    g_sim.reset_requests = 0;
+    g_sim.reset_handled = 0;
+    memset(&g_sim.stats, 0, sizeof(g_sim.stats));
+}
+
+/** Take the writer lock and mark the configuration as being updated. */
+void sim_state_config_begin(void) {
+    critical_section_enter_blocking(&g_sim.lock);
+    g_lock_enter_us = time_us_32();
+    g_sim.cfg_seq++;
+    __dmb();
+}
+
+/** Publish the updated configuration and release the writer lock. */
+void sim_state_config_end(void) {
+    __dmb();
+    g_sim.cfg_seq++;
+    uint32_t held_us = time_us_32() - g_lock_enter_us;
+    if (held_us > g_sim.stats.lock_max_hold_us) g_sim.stats.lock_max_hold_us = held_us;
+    critical_section_exit(&g_sim.lock);
+}
+
+/** Copy cfg once; return 1 if no write overlapped the copy. */
+static int config_read_once(sim_config_t *out) {
+    uint32_t seq = g_sim.cfg_seq;
+    if (seq & 1u) return 0;
+    __dmb();
+    *out = g_sim.cfg;
+    __dmb();
+    return g_sim.cfg_seq == seq;
+}
+
+/** Read a consistent copy of the configuration (core0). */
+sim_config_t sim_state_get_config(void) {
+    sim_config_t cfg;
+    while (!config_read_once(&cfg)) {
+        tight_loop_contents();
+    }
+    return cfg;
+}
+
+/** Try to read a consistent configuration snapshot without waiting (core1). */
+int sim_state_try_get_config(sim_config_t *out) {
+    sim_config_t cfg;
+    for (int i = 0; i < SIM_SEQLOCK_TRIES; i++) {
+        if (config_read_once(&cfg)) {
+            *out = cfg;
+            return 1;
+        }
+        g_sim.stats.cfg_retries++;
+    }
+    g_sim.stats.cfg_stale++;
+    return 0;
+}
+
+/** Publish the runtime block; core1 is the only writer so no lock is needed. */
+void sim_state_publish_runtime(const sim_runtime_t *rt) {
+    g_sim.rt_seq++;
+    __dmb();
+    g_sim.rt = *rt;
+    __dmb();
+    g_sim.rt_seq++;
+}
+
+/** Read a consistent copy of the runtime block. */
+sim_runtime_t sim_state_get_runtime(void) {
+    sim_runtime_t rt;
+    for (;;) {
+        uint32_t seq = g_sim.rt_seq;
+        if (!(seq & 1u)) {
+            __dmb();
+            rt = g_sim.rt;
+            __dmb();
+            if (g_sim.rt_seq == seq) break;
+        }
+        g_sim.stats.rt_retries++;
+        tight_loop_contents();
+    }
+    return rt;
+}
+
+/** Ask core1 to reset the loop state on its next tick. */
+void sim_state_request_reset(void) {
+    critical_section_enter_blocking(&g_sim.lock);
+    g_sim.reset_requests++;
+    critical_section_exit(&g_sim.lock);
+}
+
+/** Return non-zero if a reset was requested and not yet consumed by core1. */
+int sim_state_reset_pending(void) {
+    return g_sim.reset_requests != g_sim.reset_handled;
+}
+
+/** Consume pending reset requests (core1). */
+int sim_state_take_reset(void) {
+    uint32_t requests = g_sim.reset_requests;
+    if (requests == g_sim.reset_handled) return 0;
+    g_sim.reset_handled = requests;
+    return 1;
+}
+
+/** Read the seqlock contention counters. */
+sim_state_stats_t sim_state_get_stats(void) {
+    return g_sim.stats;
 }
 
 /** Set operator (UI) setpoint value. */
 void sim_state_set_setpoint(float setpoint) {
-    critical_section_enter_blocking(&g_sim.lock);
+    sim_state_config_begin();
     g_sim.cfg.setpoint = setpoint;
-    critical_section_exit(&g_sim.lock);
+    sim_state_config_end();
 }
 
 /** Read operator (UI) setpoint value. */
 float sim_state_get_setpoint(void) {
-    float setpoint;
-    critical_section_enter_blocking(&g_sim.lock);
-    setpoint = g_sim.cfg.setpoint;
-    critical_section_exit(&g_sim.lock);
-    return setpoint;
+    return sim_state_get_config().setpoint;
 }
 
 /** Set master setpoint value from external controller. */
 void master_setpoint_set(float m_setpoint) {
-    critical_section_enter_blocking(&g_sim.lock);
+    sim_state_config_begin();
     g_sim.cfg.master_setpoint = m_setpoint;
-    critical_section_exit(&g_sim.lock);
+    sim_state_config_end();
 }
 
 /** Read master setpoint value. */
 float master_setpoint_get(void) {
-    float setpoint;
-    critical_section_enter_blocking(&g_sim.lock);
-    setpoint = g_sim.cfg.master_setpoint;
-    critical_section_exit(&g_sim.lock);
-    return setpoint;
+    return sim_state_get_config().master_setpoint;
 }
 
 /** Select whether the master setpoint drives the control loop. */
 void sim_state_set_use_master_setpoint(int use_master) {
-    critical_section_enter_blocking(&g_sim.lock);
+    sim_state_config_begin();
     g_sim.cfg.use_master_setpoint = use_master ? 1 : 0;
-    critical_section_exit(&g_sim.lock);
+    sim_state_config_end();
 }
 
 /** Read whether master setpoint drives the control loop. */
 int sim_state_get_use_master_setpoint(void) {
-    int use_master;
-    critical_section_enter_blocking(&g_sim.lock);
-    use_master = g_sim.cfg.use_master_setpoint;
-    critical_section_exit(&g_sim.lock);
-    return use_master;
+    return sim_state_get_config().use_master_setpoint;
 }
 
 /** Enable/disable sensor feedback signal in the control loop. */
 void sim_state_set_allow_sens_signal(int allow) {
-    critical_section_enter_blocking(&g_sim.lock);
+    sim_state_config_begin();
     g_sim.cfg.allow_sens_signal = allow ? 1 : 0;
-    critical_section_exit(&g_sim.lock);
+    sim_state_config_end();
 }
 
 /** Read whether sensor feedback is enabled. */
 int sim_state_get_allow_sens_signal(void) {
-    int allow;
-    critical_section_enter_blocking(&g_sim.lock);
-    allow = g_sim.cfg.allow_sens_signal;
-    critical_section_exit(&g_sim.lock);
-    return allow;
+    return sim_state_get_config().allow_sens_signal;
 }
 
 /** Update PID parameters from external controller. */
 void sim_state_set_pid(const pid_params_t *pid) {
     if (!pid) return;
-    critical_section_enter_blocking(&g_sim.lock);
+    sim_state_config_begin();
     g_sim.cfg.pid = *pid;
-    critical_section_exit(&g_sim.lock);
+    sim_state_config_end();
 }
 
 /** Read current PID parameters. */
 pid_params_t sim_state_get_pid(void) {
-    pid_params_t pid;
-    critical_section_enter_blocking(&g_sim.lock);
-    pid = g_sim.cfg.pid;
-    critical_section_exit(&g_sim.lock);
-    return pid;
+    return sim_state_get_config().pid;
 }
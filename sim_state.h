@@ -3,11 +3,26 @@
 #include <stdint.h>
 #include "pico/sync.h"
 
+#include "plant.h"
+
 typedef enum {
     PLANT_FIRST_ORDER = 0,
-    PLANT_SECOND_ORDER = 1
+    PLANT_SECOND_ORDER = 1,
+    PLANT_TRANSFER_FUNCTION = 2 // tf_num / tf_den
 } plant_model_t;
 
+typedef enum {
+    SIM_NUMERIC_FLOAT = 0, // soft-float PID and plants
+    SIM_NUMERIC_FIXED = 1 // fixed-point PID and plants (fixed.h)
+} sim_numeric_t;
+
+#ifndef SIM_NUMERIC_DEFAULT
+#define SIM_NUMERIC_DEFAULT SIM_NUMERIC_FLOAT
+#endif
+
+#define SIM_DT_MIN_US 100 // shortest time step (core1 tick period)
+#define SIM_DT_MAX_US 1000000
+
 typedef struct {
     float kp;
     float ki;
@@ -21,6 +36,10 @@ typedef struct {
     float wn;
     float zeta;
     int dead_time_ms;
+    plant_method_t method; // discretization of the continuous model
+    int tf_order; // degree n of tf_den
+    float tf_num[PLANT_MAX_ORDER + 1]; // numerator, highest power first, padded to n + 1
+    float tf_den[PLANT_MAX_ORDER + 1]; // denominator, highest power first
 } plant_params_t;
 
 typedef struct {
@@ -28,7 +47,7 @@ typedef struct {
     float master_setpoint;
     int use_master_setpoint; // flag: use master setpoint if non-zero
     int allow_sens_signal; // flag: allow sensor feedback if non-zero
-    int dt_ms; // Simulation time step in milliseconds
+    int dt_us; // Simulation time step in microseconds
     pid_params_t pid;
     plant_params_t plant;
     int act_inject; // flag: actuator inject mode if non-zero
@@ -36,6 +55,7 @@ typedef struct {
     float act_min;
     float act_max;
     int running; // flag: simulation running if non-zero
+    sim_numeric_t numeric; // arithmetic backend of the PID and plant
 } sim_config_t;
 
 typedef struct {
@@ -47,16 +67,61 @@ typedef struct {
 } sim_runtime_t;
 
 typedef struct {
-    critical_section_t lock; // iteresting lock for thread-safe access
+    uint32_t cfg_retries; // core1 config snapshots that saw a concurrent write
+    uint32_t cfg_stale; // core1 ticks that kept the previous config snapshot
+    uint32_t rt_retries; // core0 runtime snapshots that saw a concurrent write
+    uint32_t lock_max_hold_us; // longest time a core0 writer held g_sim.lock
+} sim_state_stats_t;
+
+/*
+ * Configuration and runtime data are shared through seqlocks: the writer makes
+ * the version odd while it updates the data, readers copy the data and retry
+ * if the version changed. core1 never takes g_sim.lock; the lock only
+ * serializes core0 writers of cfg (and masks IRQs so they cannot be preempted
+ * mid-update by another core0 reader).
+ */
+typedef struct {
+    critical_section_t lock; // serializes core0 writers of cfg
+    volatile uint32_t cfg_seq; // cfg version, odd while a write is in progress
     sim_config_t cfg; // simulation configuration parameters
+    volatile uint32_t rt_seq; // rt version, written by core1 only
     sim_runtime_t rt; // real-time simulation data
-    int reset_requested; // flag: reset requested by external controller
+    volatile uint32_t reset_requests; // incremented by core0
+    volatile uint32_t reset_handled; // last reset request consumed by core1
+    sim_state_stats_t stats; // seqlock contention counters
 } sim_state_t;
 
 extern sim_state_t g_sim;
 
 /** Initialize shared simulation state and its lock. */
 void sim_state_init(void);
+
+/** Begin a core0 update of g_sim.cfg (takes the writer lock, bumps the version). */
+void sim_state_config_begin(void);
+/** Finish a core0 update of g_sim.cfg started with sim_state_config_begin(). */
+void sim_state_config_end(void);
+/** Read a consistent copy of the configuration (core0, retries until consistent). */
+sim_config_t sim_state_get_config(void);
+/**
+ * Try to read a consistent copy of the configuration without waiting (core1).
+ * Returns 0 and leaves out untouched if a write kept the snapshot inconsistent.
+ */
+int sim_state_try_get_config(sim_config_t *out);
+
+/** Publish the runtime block (core1 only, never blocks). */
+void sim_state_publish_runtime(const sim_runtime_t *rt);
+/** Read a consistent copy of the runtime block. */
+sim_runtime_t sim_state_get_runtime(void);
+
+/** Ask core1 to reset the loop state on its next tick. */
+void sim_state_request_reset(void);
+/** Return non-zero if a reset was requested and not yet consumed by core1. */
+int sim_state_reset_pending(void);
+/** Consume pending reset requests (core1). Returns non-zero if any were pending. */
+int sim_state_take_reset(void);
+
+/** Read the seqlock contention counters. */
+sim_state_stats_t sim_state_get_stats(void);
 /** Set operator (UI) setpoint. */
 void sim_state_set_setpoint(float setpoint);
 /** Get operator (UI) setpoint. */
@@ -0,0 +1,257 @@
+#include <string.h>
+
+#include "pico/sync.h"
+#include "pico/time.h"
+
+#include "sweep.h"
+
+#define SWEEP_CHUNK_US_INIT 500 // assumed slice cost before one was measured
+
+/*
+ * Job state shared by both cores. Workers claim point indices under lock
+ * and evaluate them outside it, so the lock is only held for a few copies.
+ */
+typedef struct {
+    critical_section_t lock;
+    sweep_spec_t spec;
+    sim_config_t cfg; // configuration the points are evaluated against
+    volatile sweep_state_t state;
+    volatile uint32_t job;
+    int total;
+    int next_point; // next unclaimed index
+    int done;
+    int best;
+    int limited;
+    uint32_t core_points[2];
+    uint64_t start_us;
+    uint32_t elapsed_us;
+    uint8_t evaluated[SWEEP_MAX_POINTS];
+    sweep_result_t results[SWEEP_MAX_POINTS];
+} sweep_job_t;
+
+static sweep_job_t g_sweep;
+
+/** Initialize the job state and its lock (before core1 starts). */
+void sweep_init(void) {
+    critical_section_init(&g_sweep.lock);
+    g_sweep.state = SWEEP_IDLE;
+    g_sweep.job = 0;
+    g_sweep.total = 0;
+    g_sweep.best = -1;
+}
+
+/** Uniform [0, 1) from the seed, point and axis, so any core can recompute a random point. */
+static float sweep_unit(uint32_t seed, uint32_t idx, uint32_t axis) {
+    uint32_t x = seed ^ (idx * 0x9E3779B9u) ^ (axis * 0x85EBCA6Bu);
+    x ^= x >> 16;
+    x *= 0x7FEB352Du;
+    x ^= x >> 15;
+    x *= 0x846CA68Bu;
+    x ^= x >> 16;
+    return (float)(x >> 8) * (1.0f / 16777216.0f);
+}
+
+/** Grid coordinate i of n on a range. */
+static float sweep_axis(const sweep_range_t *r, int i) {
+    if (r->n <= 1) return r->min;
+    return r->min + (r->max - r->min) * (float)i / (float)(r->n - 1);
+}
+
+/** Gains of point idx; the grid runs kp fastest, then ki, then kd. */
+static pid_params_t sweep_gains(const sweep_spec_t *spec, int idx) {
+    pid_params_t pid;
+    if (spec->random) {
+        pid.kp = spec->kp.min + (spec->kp.max - spec->kp.min) * sweep_unit(spec->seed, (uint32_t)idx, 0);
+        pid.ki = spec->ki.min + (spec->ki.max - spec->ki.min) * sweep_unit(spec->seed, (uint32_t)idx, 1);
+        pid.kd = spec->kd.min + (spec->kd.max - spec->kd.min) * sweep_unit(spec->seed, (uint32_t)idx, 2);
+    } else {
+        int nkp = spec->kp.n > 0 ? spec->kp.n : 1;
+        int nki = spec->ki.n > 0 ? spec->ki.n : 1;
+        pid.kp = sweep_axis(&spec->kp, idx % nkp);
+        pid.ki = sweep_axis(&spec->ki, (idx / nkp) % nki);
+        pid.kd = sweep_axis(&spec->kd, idx / (nkp * nki));
+    }
+    return pid;
+}
+
+/** Start a job, replacing any running one; returns the number of points (0 if invalid). */
+int sweep_start(const sweep_spec_t *spec, const sim_config_t *cfg) {
+    long total;
+    if (spec->random) {
+        total = spec->count;
+    } else {
+        if (spec->kp.n < 1 || spec->ki.n < 1 || spec->kd.n < 1) return 0;
+        total = (long)spec->kp.n * spec->ki.n * spec->kd.n;
+    }
+    if (total < 1 || total > SWEEP_MAX_POINTS) return 0;
+
+    critical_section_enter_blocking(&g_sweep.lock);
+    g_sweep.spec = *spec;
+    if (!(g_sweep.spec.duration_s > 0.0f)) g_sweep.spec.duration_s = SWEEP_DEFAULT_DURATION_S;
+    g_sweep.cfg = *cfg;
+    g_sweep.job++;
+    g_sweep.state = SWEEP_RUNNING;
+    g_sweep.total = (int)total;
+    g_sweep.next_point = 0;
+    g_sweep.done = 0;
+    g_sweep.best = -1;
+    g_sweep.limited = 0;
+    g_sweep.core_points[0] = 0;
+    g_sweep.core_points[1] = 0;
+    g_sweep.start_us = time_us_64();
+    g_sweep.elapsed_us = 0;
+    memset(g_sweep.evaluated, 0, sizeof(g_sweep.evaluated));
+    critical_section_exit(&g_sweep.lock);
+    return (int)total;
+}
+
+/** Stop the running job. */
+void sweep_stop(void) {
+    critical_section_enter_blocking(&g_sweep.lock);
+    if (g_sweep.state == SWEEP_RUNNING) g_sweep.state = SWEEP_STOPPED;
+    critical_section_exit(&g_sweep.lock);
+}
+
+/** Read the job status. */
+sweep_status_t sweep_get_status(void) {
+    sweep_status_t st;
+    memset(&st, 0, sizeof(st));
+    critical_section_enter_blocking(&g_sweep.lock);
+    st.state = g_sweep.state;
+    st.job = g_sweep.job;
+    st.total = g_sweep.total;
+    st.done = g_sweep.done;
+    st.best = g_sweep.best;
+    st.limited = g_sweep.limited;
+    if (st.best >= 0) {
+        st.best_result = g_sweep.results[st.best];
+        st.best_pid = sweep_gains(&g_sweep.spec, st.best);
+    }
+    st.core_points[0] = g_sweep.core_points[0];
+    st.core_points[1] = g_sweep.core_points[1];
+    st.elapsed_us = (g_sweep.state == SWEEP_RUNNING) ? (uint32_t)(time_us_64() - g_sweep.start_us)
+                                                     : g_sweep.elapsed_us;
+    critical_section_exit(&g_sweep.lock);
+    return st;
+}
+
+/** PID gains of point idx of the current job. */
+pid_params_t sweep_point_gains(int idx) {
+    critical_section_enter_blocking(&g_sweep.lock);
+    pid_params_t pid = sweep_gains(&g_sweep.spec, idx);
+    critical_section_exit(&g_sweep.lock);
+    return pid;
+}
+
+/** Copy evaluated results with index >= since, lowest index first. */
+int sweep_read_results(int since, int *idx, sweep_result_t *out, int max, int *next) {
+    int n = 0;
+    if (since < 0) since = 0;
+    critical_section_enter_blocking(&g_sweep.lock);
+    *next = g_sweep.total;
+    for (int i = since; i < g_sweep.total; i++) {
+        if (n == max) {
+            if (*next > i) *next = i;
+            break;
+        }
+        if (!g_sweep.evaluated[i]) {
+            if (*next == g_sweep.total) *next = i;
+            continue;
+        }
+        idx[n] = i;
+        out[n] = g_sweep.results[i];
+        n++;
+    }
+    critical_section_exit(&g_sweep.lock);
+    return n;
+}
+
+/** Prepare a worker for core 0 or 1. */
+void sweep_worker_init(sweep_worker_t *w, int core) {
+    memset(w, 0, sizeof(*w)); // the run's delay line must start without pool blocks
+    w->point = -1;
+    w->core = core;
+    w->weight = 1.0f;
+    w->chunk_us = SWEEP_CHUNK_US_INIT;
+    w->claim_us = SWEEP_CHUNK_US_INIT;
+}
+
+/**
+ * Claim the next point of the running job, start its run and run its first
+ * tick; 0 if none is left. The run keeps the discrete plant of the previous
+ * point when the plant and dt are the same, which they are within a job.
+ */
+static int sweep_claim(sweep_worker_t *w) {
+    static sweep_spec_t spec[2]; // per core; sim_config_t and the spec are too large for core1's stack
+    static sim_config_t cfg[2];
+    int core = w->core & 1;
+    int point = -1;
+    critical_section_enter_blocking(&g_sweep.lock);
+    if (g_sweep.state == SWEEP_RUNNING && g_sweep.next_point < g_sweep.total) {
+        point = g_sweep.next_point++;
+        w->job = g_sweep.job;
+        spec[core] = g_sweep.spec;
+        cfg[core] = g_sweep.cfg;
+    }
+    critical_section_exit(&g_sweep.lock);
+    if (point < 0) return 0;
+
+    cfg[core].pid = sweep_gains(&spec[core], point);
+    w->weight = spec[core].overshoot_weight;
+    w->point = point;
+    sim_run_start(&w->run, &cfg[core], spec[core].duration_s, SIM_RUN_DEFAULT_BAND);
+    sim_run_advance(&w->run, 1);
+    return 1;
+}
+
+/** Store the finished point of w if its job is still running. */
+static void sweep_store(sweep_worker_t *w) {
+    sim_run_metrics_t m;
+    sim_run_metrics(&w->run, &m);
+    sweep_result_t res = {m.iae + w->weight * m.overshoot, m.iae, m.overshoot, m.dead_limited};
+
+    critical_section_enter_blocking(&g_sweep.lock);
+    if (g_sweep.state == SWEEP_RUNNING && w->job == g_sweep.job) {
+        g_sweep.results[w->point] = res;
+        g_sweep.evaluated[w->point] = 1;
+        g_sweep.done++;
+        g_sweep.core_points[w->core & 1]++;
+        /* A cut dead time is another plant; its cost says nothing about these gains. */
+        if (res.dead_limited) {
+            g_sweep.limited++;
+        } else if (g_sweep.best < 0 || res.cost < g_sweep.results[g_sweep.best].cost) {
+            g_sweep.best = w->point;
+        }
+        g_sweep.elapsed_us = (uint32_t)(time_us_64() - g_sweep.start_us);
+        if (g_sweep.done == g_sweep.total) g_sweep.state = SWEEP_DONE;
+    }
+    critical_section_exit(&g_sweep.lock);
+}
+
+/** Evaluate points of the running job in slices until deadline_us. */
+int sweep_work(sweep_worker_t *w, uint64_t deadline_us) {
+    uint64_t now = time_us_64();
+    for (;;) {
+        if (w->point >= 0 && (g_sweep.state != SWEEP_RUNNING || w->job != g_sweep.job)) {
+            sim_loop_release(&w->run.loop); // stopped or replaced: drop the point
+            w->point = -1;
+        }
+        uint32_t *cost = (w->point < 0) ? &w->claim_us : &w->chunk_us;
+        if (now + *cost >= deadline_us) {
+            /* Let one slow slice (an interrupt, a cache miss) age out so the worker cannot stall. */
+            *cost -= *cost / 8;
+            return w->point >= 0 || g_sweep.state == SWEEP_RUNNING;
+        }
+
+        uint64_t t0 = now;
+        if (w->point < 0) {
+            if (!sweep_claim(w)) return 0;
+        } else if (sim_run_advance(&w->run, SWEEP_CHUNK_TICKS)) {
+            sweep_store(w);
+            w->point = -1;
+        }
+        now = time_us_64();
+        uint32_t took = (uint32_t)(now - t0);
+        *cost = (took > *cost) ? took : *cost - (*cost - took) / 16;
+    }
+}
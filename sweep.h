@@ -0,0 +1,104 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "sim_run.h"
+#include "sim_state.h"
+
+#define SWEEP_MAX_POINTS 512 // PID points per job
+#define SWEEP_CHUNK_TICKS 8 // simulated ticks between deadline checks
+#define SWEEP_DEFAULT_DURATION_S 30.0f
+
+typedef enum {
+    SWEEP_IDLE = 0,
+    SWEEP_RUNNING = 1,
+    SWEEP_DONE = 2,
+    SWEEP_STOPPED = 3
+} sweep_state_t;
+
+typedef struct {
+    float min;
+    float max;
+    int n; // grid points on this axis (1 = min only); ignored by random search
+} sweep_range_t;
+
+typedef struct {
+    sweep_range_t kp;
+    sweep_range_t ki;
+    sweep_range_t kd;
+    int random; // flag: uniform random points instead of the kp x ki x kd grid
+    int count; // random points
+    uint32_t seed; // random search seed
+    float duration_s; // simulated time per point
+    float overshoot_weight; // cost = IAE + weight * overshoot (percent)
+} sweep_spec_t;
+
+typedef struct {
+    float cost;
+    float iae;
+    float overshoot;
+    int dead_limited; // flag: the delay storage cut the dead time; never chosen as best
+} sweep_result_t;
+
+typedef struct {
+    sweep_state_t state;
+    uint32_t job; // increments with every sweep_start()
+    int total; // points in the job
+    int done; // points evaluated
+    int best; // index of the lowest cost so far among full dead-time points, -1 if none
+    int limited; // points evaluated with a cut dead time
+    sweep_result_t best_result;
+    pid_params_t best_pid;
+    uint32_t core_points[2]; // points evaluated by core0 and core1
+    uint32_t elapsed_us; // wall time from start to the last result
+} sweep_status_t;
+
+/* Per-core evaluation state; each core owns one and passes it to sweep_work(). */
+typedef struct {
+    sim_run_t run;
+    uint32_t job; // job of the point in progress
+    int point; // index in progress, -1 if none
+    int core;
+    float weight; // overshoot weight of the job in progress
+    uint32_t chunk_us; // slice cost estimate (peak, decaying); a slice only starts if it fits
+    uint32_t claim_us; // the same for claiming a point and running its first tick
+} sweep_worker_t;
+
+/** Initialize the job state and its lock (before core1 starts). */
+void sweep_init(void);
+
+/**
+ * Start a job over spec against cfg (gains replaced per point), replacing
+ * any running job. Returns the number of points, 0 if spec is invalid.
+ */
+int sweep_start(const sweep_spec_t *spec, const sim_config_t *cfg);
+
+/** Stop the running job; workers drop their point at the next chunk. */
+void sweep_stop(void);
+
+/** Read the job status. */
+sweep_status_t sweep_get_status(void);
+
+/** PID gains of point idx of the current job. */
+pid_params_t sweep_point_gains(int idx);
+
+/**
+ * Copy up to max evaluated results with index >= since, lowest index first.
+ * idx receives their indices. *next is set to the lowest index >= since
+ * that is not evaluated yet (total if none), where a poll can resume.
+ * Returns the number of results copied.
+ */
+int sweep_read_results(int since, int *idx, sweep_result_t *out, int max, int *next);
+
+/** Prepare a worker for core 0 or 1. */
+void sweep_worker_init(sweep_worker_t *w, int core);
+
+/**
+ * Evaluate points of the running job in SWEEP_CHUNK_TICKS slices until
+ * deadline_us (time_us_64()) would be passed. Starting a point (the first
+ * tick sizes the delay line, and discretizes the plant if it differs from
+ * the previous point) is budgeted apart from the chunks. A point in
+ * progress is kept for the next call. Returns 0 if there is no work left
+ * for this worker.
+ */
+int sweep_work(sweep_worker_t *w, uint64_t deadline_us);
@@ -0,0 +1,75 @@
+#include <string.h>
+
+#include "hardware/sync.h"
+
+#include "telemetry.h"
+
+#define TELEMETRY_MASK (TELEMETRY_RING_SIZE - 1u)
+
+/*
+ * Single-producer ring: core1 overwrites the oldest slot and never waits.
+ * Each slot carries its sequence number, written last, so the core0 reader
+ * can detect a slot that was overwritten while it was being copied.
+ */
+static telemetry_sample_t g_ring[TELEMETRY_RING_SIZE];
+static volatile uint32_t g_last_seq;
+
+/** Clear the ring buffer (call before core1 starts). */
+void telemetry_init(void) {
+    memset(g_ring, 0, sizeof(g_ring));
+    g_last_seq = 0;
+}
+
+/** Append one tick of runtime data (core1 only, never blocks). */
+void telemetry_push(const sim_runtime_t *rt) {
+    uint32_t seq = g_last_seq + 1u;
+    telemetry_sample_t *s = &g_ring[seq & TELEMETRY_MASK];
+
+    s->seq = 0;
+    __dmb();
+    s->time_s = rt->time_s;
+    s->setpoint = rt->setpoint;
+    s->control = rt->control;
+    s->actuator = rt->actuator;
+    s->output = rt->output;
+    __dmb();
+    s->seq = seq;
+    __dmb();
+    g_last_seq = seq;
+}
+
+/** Sequence number of the newest sample (0 if none yet). */
+uint32_t telemetry_last_seq(void) {
+    return g_last_seq;
+}
+
+/** Copy up to max samples newer than since, oldest first. */
+size_t telemetry_read_since(uint32_t since, telemetry_sample_t *out, size_t max, uint32_t *dropped) {
+    uint32_t last = g_last_seq;
+    uint32_t lost = 0;
+    size_t n = 0;
+
+    if (last - since > last) since = 0; // client is ahead (device rebooted)
+    uint32_t first = since + 1u;
+    if (last - since > TELEMETRY_RING_SIZE) {
+        first = last - TELEMETRY_RING_SIZE + 1u;
+        lost = first - since - 1u;
+    }
+
+    __dmb();
+    for (uint32_t seq = first; seq != last + 1u && n < max; seq++) {
+        const telemetry_sample_t *s = &g_ring[seq & TELEMETRY_MASK];
+        uint32_t before = s->seq;
+        __dmb();
+        out[n] = *s;
+        __dmb();
+        if (before != seq || s->seq != seq) {
+            lost++; // overwritten by core1 while we were copying
+            continue;
+        }
+        n++;
+    }
+
+    if (dropped) *dropped = lost;
+    return n;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "sim_state.h"
+
+// Number of samples kept in RAM; must be a power of two.
+#define TELEMETRY_RING_SIZE 1024
+
+typedef struct {
+    uint32_t seq; // sample sequence number, starts at 1 (0 = empty slot)
+    float time_s; // t
+    float setpoint; // r(t)
+    float control; // u(t)
+    float actuator; // u1(t)
+    float output; // y(t)
+} telemetry_sample_t;
+
+/** Clear the ring buffer (call before core1 starts). */
+void telemetry_init(void);
+
+/** Append one tick of runtime data (core1 only, never blocks). */
+void telemetry_push(const sim_runtime_t *rt);
+
+/** Sequence number of the newest sample (0 if none yet). */
+uint32_t telemetry_last_seq(void);
+
+/**
+ * Copy up to max samples newer than since, oldest first.
+ * *dropped is set to the number of requested samples already overwritten.
+ * Returns the number of samples copied.
+ */
+size_t telemetry_read_since(uint32_t since, telemetry_sample_t *out, size_t max, uint32_t *dropped);
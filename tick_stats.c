@@ -0,0 +1,111 @@
+#include <string.h>
+
+#include "hardware/sync.h"
+
+#include "tick_stats.h"
+
+/* Seqlocked like g_sim.rt: core1 writes, core0 readers retry on a torn copy. */
+static struct {
+    volatile uint32_t seq; // odd while core1 updates
+    tick_stats_t stats;
+    volatile uint32_t reset_requests; // incremented by core0
+    uint32_t reset_handled; // last reset request applied by core1
+} g_tick;
+
+static void tick_hist_clear(tick_hist_t *h) {
+    memset(h, 0, sizeof(*h));
+    h->min_us = UINT32_MAX;
+}
+
+/** Clear the statistics (call before core1 starts). */
+void tick_stats_init(void) {
+    memset(&g_tick.stats, 0, sizeof(g_tick.stats));
+    tick_hist_clear(&g_tick.stats.compute);
+    tick_hist_clear(&g_tick.stats.latency);
+    g_tick.seq = 0;
+    g_tick.reset_requests = 0;
+    g_tick.reset_handled = 0;
+}
+
+/** Bucket of v: exact below 4, then four buckets per power of two. */
+static int tick_hist_index(uint32_t v) {
+    if (v < 4) return (int)v;
+    int msb = 31 - __builtin_clz(v);
+    int i = 4 + (msb - 2) * 4 + (int)((v >> (msb - 2)) & 3u);
+    return (i < TICK_HIST_BUCKETS) ? i : TICK_HIST_BUCKETS - 1;
+}
+
+/** Lowest value that falls into bucket i. */
+uint32_t tick_hist_bucket_low(int i) {
+    if (i < 4) return (uint32_t)i;
+    int msb = (i - 4) / 4 + 2;
+    return (uint32_t)(4 + (i - 4) % 4) << (msb - 2);
+}
+
+static void tick_hist_add(tick_hist_t *h, uint32_t v) {
+    h->count++;
+    h->sum_us += v;
+    if (v < h->min_us) h->min_us = v;
+    if (v > h->max_us) h->max_us = v;
+    h->bucket[tick_hist_index(v)]++;
+}
+
+/** Record one tick (core1 only, never blocks). */
+void tick_stats_record(uint32_t latency_us, uint32_t compute_us, int overrun, uint32_t skipped, uint32_t period_us) {
+    g_tick.seq++;
+    __dmb();
+    tick_stats_t *s = &g_tick.stats;
+    uint32_t requests = g_tick.reset_requests;
+    if (requests != g_tick.reset_handled) {
+        g_tick.reset_handled = requests;
+        memset(s, 0, sizeof(*s));
+        tick_hist_clear(&s->compute);
+        tick_hist_clear(&s->latency);
+    }
+    s->ticks++;
+    if (overrun) s->overruns++;
+    s->skipped += skipped;
+    s->period_us = period_us;
+    tick_hist_add(&s->compute, compute_us);
+    tick_hist_add(&s->latency, latency_us);
+    __dmb();
+    g_tick.seq++;
+}
+
+/** Read a consistent copy of the statistics. */
+void tick_stats_get(tick_stats_t *out) {
+    for (;;) {
+        uint32_t seq = g_tick.seq;
+        if (!(seq & 1u)) {
+            __dmb();
+            *out = g_tick.stats;
+            __dmb();
+            if (g_tick.seq == seq) break;
+        }
+        tight_loop_contents();
+    }
+    if (out->compute.count == 0) out->compute.min_us = 0;
+    if (out->latency.count == 0) out->latency.min_us = 0;
+}
+
+/** Ask core1 to clear the statistics on its next tick. */
+void tick_stats_request_reset(void) {
+    g_tick.reset_requests++;
+}
+
+/** Upper bound of the bucket holding the p-quantile, capped at max_us; 0 if empty. */
+uint32_t tick_hist_percentile(const tick_hist_t *h, float p) {
+    if (h->count == 0) return 0;
+    uint64_t rank = (uint64_t)(p * (float)h->count + 0.999f);
+    if (rank < 1) rank = 1;
+    uint64_t seen = 0;
+    for (int i = 0; i < TICK_HIST_BUCKETS; i++) {
+        seen += h->bucket[i];
+        if (seen >= rank) {
+            if (i == TICK_HIST_BUCKETS - 1) return h->max_us;
+            uint32_t high = tick_hist_bucket_low(i + 1) - 1;
+            return (high < h->max_us) ? high : h->max_us;
+        }
+    }
+    return h->max_us;
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <stdint.h>
+
+#define TICK_HIST_BUCKETS 80 // log-linear: exact below 4 us, then 4 buckets per power of two up to ~2 s
+
+/* Distribution of one per-tick duration in microseconds. */
+typedef struct {
+    uint32_t count;
+    uint32_t min_us;
+    uint32_t max_us;
+    uint64_t sum_us;
+    uint32_t bucket[TICK_HIST_BUCKETS];
+} tick_hist_t;
+
+typedef struct {
+    uint32_t ticks;
+    uint32_t overruns; // ticks whose work ended after the next tick was due
+    uint32_t skipped; // tick periods dropped to resynchronize after long overruns
+    uint32_t period_us; // time step of the last tick
+    tick_hist_t compute; // wake-up to end of the tick's work (loop, telemetry, batch)
+    tick_hist_t latency; // scheduled tick time to wake-up
+} tick_stats_t;
+
+/** Clear the statistics (call before core1 starts). */
+void tick_stats_init(void);
+
+/**
+ * Record one tick (core1 only, never blocks). overrun is non-zero if the
+ * work ended after the next tick was due; skipped counts the periods
+ * dropped to catch up.
+ */
+void tick_stats_record(uint32_t latency_us, uint32_t compute_us, int overrun, uint32_t skipped, uint32_t period_us);
+
+/** Read a consistent copy of the statistics. */
+void tick_stats_get(tick_stats_t *out);
+
+/** Ask core1 to clear the statistics on its next tick. */
+void tick_stats_request_reset(void);
+
+/** Lowest value that falls into bucket i. */
+uint32_t tick_hist_bucket_low(int i);
+
+/** Upper bound of the bucket holding the p-quantile (0 < p <= 1), capped at max_us; 0 if empty. */
+uint32_t tick_hist_percentile(const tick_hist_t *h, float p);
@@ -0,0 +1,71 @@
+#include "hardware/sync.h"
+#include "hardware/timer.h"
+#include "pico/stdlib.h"
+
+#include "tick_timer.h"
+
+/* Shared between the alarm IRQ and the core1 thread that owns it. */
+static struct {
+    uint alarm;
+    volatile uint32_t period_us;
+    volatile uint64_t target_us; // tick the alarm is armed for
+    volatile uint64_t due_us; // tick the IRQ signalled last
+    volatile uint32_t fired; // ticks signalled by the IRQ
+    uint32_t taken; // ticks consumed by tick_timer_wait()
+} g_tick_timer;
+
+/** Alarm IRQ: signal the tick and arm the next one; targets already past count as fired. */
+static void __not_in_flash_func(tick_timer_irq)(uint alarm) {
+    uint64_t target = g_tick_timer.target_us;
+    g_tick_timer.due_us = target;
+    g_tick_timer.fired++;
+    target += g_tick_timer.period_us;
+    while (hardware_alarm_set_target(alarm, from_us_since_boot(target))) {
+        g_tick_timer.due_us = target;
+        g_tick_timer.fired++;
+        target += g_tick_timer.period_us;
+    }
+    g_tick_timer.target_us = target;
+    __sev(); // wake a WFE that raced with the flag check
+}
+
+/** Start the tick alarm on the calling core. */
+void tick_timer_start(uint32_t period_us) {
+    g_tick_timer.alarm = (uint)hardware_alarm_claim_unused(true);
+    g_tick_timer.period_us = period_us;
+    g_tick_timer.fired = 0;
+    g_tick_timer.taken = 0;
+    g_tick_timer.target_us = time_us_64() + period_us;
+    hardware_alarm_set_callback(g_tick_timer.alarm, tick_timer_irq);
+    if (hardware_alarm_set_target(g_tick_timer.alarm, from_us_since_boot(g_tick_timer.target_us))) {
+        hardware_alarm_force_irq(g_tick_timer.alarm);
+    }
+}
+
+/** Change the period from the tick after the one already armed. */
+void tick_timer_set_period(uint32_t period_us) {
+    g_tick_timer.period_us = period_us;
+}
+
+/** Sleep until the next tick fires; returns its scheduled time. */
+uint64_t __not_in_flash_func(tick_timer_wait)(uint32_t *skipped) {
+    while (g_tick_timer.fired == g_tick_timer.taken) {
+        __wfe();
+    }
+    /* The IRQ runs on this core, so masking it makes the 64-bit read atomic. */
+    uint32_t irq = save_and_disable_interrupts();
+    uint32_t fired = g_tick_timer.fired;
+    uint64_t due_us = g_tick_timer.due_us;
+    restore_interrupts(irq);
+    *skipped = fired - g_tick_timer.taken - 1;
+    g_tick_timer.taken = fired;
+    return due_us;
+}
+
+/** Time the next tick is scheduled for. */
+uint64_t tick_timer_next_us(void) {
+    uint32_t irq = save_and_disable_interrupts();
+    uint64_t target = g_tick_timer.target_us;
+    restore_interrupts(irq);
+    return target;
+}
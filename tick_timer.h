@@ -0,0 +1,23 @@
+#pragma once
+
+#include <stdint.h>
+
+/**
+ * Start the tick alarm on the calling core (core1): a hardware alarm IRQ
+ * marks each tick every period_us, re-armed from the previous target so
+ * the schedule does not drift with the IRQ latency.
+ */
+void tick_timer_start(uint32_t period_us);
+
+/** Change the period; it applies from the tick after the one already armed. */
+void tick_timer_set_period(uint32_t period_us);
+
+/**
+ * Sleep (WFE) until the next tick fires. Returns the time the tick was
+ * scheduled for; *skipped is set to the ticks that fired while the caller
+ * was still busy and are dropped.
+ */
+uint64_t tick_timer_wait(uint32_t *skipped);
+
+/** Time the next tick is scheduled for (time_us_64() clock). */
+uint64_t tick_timer_next_us(void);
@@ -0,0 +1,234 @@
+#include <math.h>
+#include <string.h>
+
+#include "pico/cyw43_arch.h"
+#include "pico/stdlib.h"
+
+#include "lwip/pbuf.h"
+#include "lwip/timeouts.h"
+#include "lwip/udp.h"
+
+#include "debug.h"
+#include "sim_params.h"
+#include "sim_state.h"
+#include "telemetry.h"
+#include "udp_channel.h"
+
+#define UDP_CHANNEL_READ_CHUNK 64 // telemetry samples read per ring access
+
+typedef struct {
+    udp_samples_msg_t hdr;
+    udp_sample_t sample[UDP_CHANNEL_MAX_BATCH];
+} udp_samples_packet_t;
+
+typedef union {
+    udp_msg_header_t hdr;
+    udp_setpoint_msg_t setpoint;
+    udp_subscribe_msg_t subscribe;
+} udp_rx_msg_t;
+
+/* Channel state; only touched in lwIP context on core0. */
+typedef struct {
+    struct udp_pcb *pcb;
+    udp_channel_stats_t stats;
+    int master_valid; // flag: a setpoint was applied, master_* are set
+    ip_addr_t master_addr;
+    u16_t master_port;
+    uint32_t master_seq; // newest setpoint seq applied
+    int subscribed;
+    ip_addr_t sub_addr;
+    u16_t sub_port;
+    uint32_t lease_ms; // time since the subscriber's last packet
+    uint16_t decimation;
+    uint16_t batch;
+    uint32_t next_seq; // telemetry seq of the next sample to send
+    uint32_t tx_seq;
+    uint32_t dropped;
+    udp_samples_packet_t packet; // batch being filled
+} udp_channel_t;
+
+static udp_channel_t g_udp;
+
+/** Send the samples collected so far. */
+static void udp_channel_flush(udp_channel_t *ch) {
+    udp_samples_msg_t *m = &ch->packet.hdr;
+    if (m->count == 0) return;
+    m->hdr.magic = UDP_CHANNEL_MAGIC;
+    m->hdr.version = UDP_CHANNEL_VERSION;
+    m->hdr.type = UDP_MSG_SAMPLES;
+    m->hdr.seq = ++ch->tx_seq;
+    m->ack = ch->master_seq;
+    m->decimation = ch->decimation;
+    m->dropped = ch->dropped;
+    u16_t len = (u16_t)(sizeof(*m) + m->count * sizeof(udp_sample_t));
+
+    struct pbuf *p = pbuf_alloc(PBUF_TRANSPORT, len, PBUF_RAM);
+    if (!p) {
+        ch->stats.tx_errors++;
+    } else {
+        pbuf_take(p, &ch->packet, len);
+        if (udp_sendto(ch->pcb, p, &ch->sub_addr, ch->sub_port) == ERR_OK) {
+            ch->stats.tx_packets++;
+            ch->stats.samples += m->count;
+        } else {
+            ch->stats.tx_errors++;
+        }
+        pbuf_free(p);
+    }
+    m->count = 0;
+}
+
+/** Move the decimated new telemetry into packets; a full batch is sent at once. */
+static void udp_channel_collect(udp_channel_t *ch) {
+    static telemetry_sample_t chunk[UDP_CHANNEL_READ_CHUNK];
+    udp_samples_msg_t *m = &ch->packet.hdr;
+    for (;;) {
+        /* Decimation skips ahead of the ring; reading from there would look like a reboot. */
+        if ((int32_t)(telemetry_last_seq() - ch->next_seq) < 0) return;
+        uint32_t dropped = 0;
+        size_t n = telemetry_read_since(ch->next_seq - 1u, chunk, UDP_CHANNEL_READ_CHUNK, &dropped);
+        ch->dropped += dropped;
+        for (size_t i = 0; i < n; i++) {
+            const telemetry_sample_t *s = &chunk[i];
+            if ((int32_t)(s->seq - ch->next_seq) < 0) continue;
+            if (s->seq != ch->next_seq) {
+                /* The ring overwrote samples: close the packet so "first + i * decimation" stays exact. */
+                udp_channel_flush(ch);
+                ch->next_seq = s->seq;
+            }
+            if (m->count == 0) m->first = s->seq;
+            memcpy(&ch->packet.sample[m->count++], &s->time_s, sizeof(udp_sample_t));
+            ch->next_seq += ch->decimation;
+            if (m->count >= ch->batch) udp_channel_flush(ch);
+        }
+        if (n < UDP_CHANNEL_READ_CHUNK) return;
+    }
+}
+
+/** lwIP timer: stream to the subscriber and re-arm while its lease lasts. */
+static void udp_channel_tick(void *arg) {
+    udp_channel_t *ch = (udp_channel_t *)arg;
+    if (!ch->subscribed) return;
+    ch->lease_ms += UDP_CHANNEL_PERIOD_MS;
+    if (ch->lease_ms >= UDP_CHANNEL_LEASE_MS) {
+        DLOGI("UDP subscriber lease expired\n");
+        ch->subscribed = 0;
+        return;
+    }
+    udp_channel_collect(ch);
+    sys_timeout(UDP_CHANNEL_PERIOD_MS, udp_channel_tick, ch);
+}
+
+/** Non-zero if addr:port is the current subscriber. */
+static int udp_channel_is_subscriber(const udp_channel_t *ch, const ip_addr_t *addr, u16_t port) {
+    return ch->subscribed && port == ch->sub_port && ip_addr_cmp(addr, &ch->sub_addr);
+}
+
+/** Apply a master setpoint unless it is older than the newest one applied. */
+static void udp_channel_setpoint(udp_channel_t *ch, const udp_setpoint_msg_t *m, const ip_addr_t *addr, u16_t port) {
+    if (!isfinite(m->setpoint)) {
+        ch->stats.rx_malformed++;
+        return;
+    }
+    /* A new master, or a seq far behind the newest, starts a new sequence. */
+    int32_t ahead = (int32_t)(m->hdr.seq - ch->master_seq);
+    int same = ch->master_valid && port == ch->master_port && ip_addr_cmp(addr, &ch->master_addr);
+    if (same && ahead <= 0 && ahead > -UDP_CHANNEL_REORDER_WINDOW) {
+        ch->stats.stale++;
+        return;
+    }
+    if (same && ahead > 1) ch->stats.lost += (uint32_t)(ahead - 1);
+
+    sim_state_config_begin();
+    sim_param_apply(&g_sim.cfg, SIM_PARAM_MASTER_SETPOINT, m->setpoint);
+    if (m->flags & UDP_SETPOINT_USE_MASTER) sim_param_apply(&g_sim.cfg, SIM_PARAM_USE_MASTER, 1.0f);
+    sim_state_config_end();
+
+    ch->master_valid = 1;
+    ch->master_addr = *addr;
+    ch->master_port = port;
+    ch->master_seq = m->hdr.seq;
+    ch->stats.setpoints++;
+}
+
+/** Start (or replace) the subscription of addr:port; subscribers repeat it to renew their lease. */
+static void udp_channel_subscribe(udp_channel_t *ch, const udp_subscribe_msg_t *m, const ip_addr_t *addr, u16_t port) {
+    if (m->decimation < 1 || m->decimation > UDP_CHANNEL_MAX_DECIMATION || m->batch < 1 ||
+        m->batch > UDP_CHANNEL_MAX_BATCH) {
+        ch->stats.rx_malformed++;
+        return;
+    }
+    /* The same subscription again only renews the lease (done by the caller); the stream goes on. */
+    if (udp_channel_is_subscriber(ch, addr, port) && m->decimation == ch->decimation && m->batch == ch->batch) return;
+    int was_subscribed = ch->subscribed;
+    ch->sub_addr = *addr;
+    ch->sub_port = port;
+    ch->decimation = m->decimation;
+    ch->batch = m->batch;
+    ch->next_seq = telemetry_last_seq() + 1u;
+    ch->dropped = 0;
+    ch->packet.hdr.count = 0;
+    ch->lease_ms = 0;
+    ch->subscribed = 1;
+    if (!was_subscribed) sys_timeout(UDP_CHANNEL_PERIOD_MS, udp_channel_tick, ch);
+    DLOGI("UDP subscriber on port %u, decimation %u, batch %u\n", (unsigned)port, (unsigned)m->decimation,
+          (unsigned)m->batch);
+}
+
+/** Handle one datagram. */
+static void udp_channel_recv(void *arg, struct udp_pcb *pcb, struct pbuf *p, const ip_addr_t *addr, u16_t port) {
+    (void)pcb;
+    udp_channel_t *ch = (udp_channel_t *)arg;
+    if (!p) return;
+    ch->stats.rx_packets++;
+    udp_rx_msg_t msg;
+    size_t len = p->tot_len;
+    if (len > sizeof(msg)) len = 0; // no valid message is that long
+    if (len) pbuf_copy_partial(p, &msg, (u16_t)len, 0);
+    pbuf_free(p);
+    if (len < sizeof(msg.hdr) || msg.hdr.magic != UDP_CHANNEL_MAGIC || msg.hdr.version != UDP_CHANNEL_VERSION) {
+        ch->stats.rx_malformed++;
+        return;
+    }
+    if (udp_channel_is_subscriber(ch, addr, port)) ch->lease_ms = 0;
+
+    if (msg.hdr.type == UDP_MSG_SETPOINT && len == sizeof(msg.setpoint)) {
+        udp_channel_setpoint(ch, &msg.setpoint, addr, port);
+    } else if (msg.hdr.type == UDP_MSG_SUBSCRIBE && len == sizeof(msg.subscribe)) {
+        udp_channel_subscribe(ch, &msg.subscribe, addr, port);
+    } else if (msg.hdr.type == UDP_MSG_UNSUBSCRIBE && len == sizeof(msg.hdr)) {
+        if (udp_channel_is_subscriber(ch, addr, port)) {
+            ch->subscribed = 0;
+            sys_untimeout(udp_channel_tick, ch);
+        }
+    } else {
+        ch->stats.rx_malformed++;
+    }
+}
+
+/** Bind the channel to UDP_CHANNEL_PORT. */
+bool udp_channel_start(void) {
+    memset(&g_udp, 0, sizeof(g_udp));
+    cyw43_arch_lwip_begin();
+    struct udp_pcb *pcb = udp_new_ip_type(IPADDR_TYPE_ANY);
+    if (!pcb) {
+        cyw43_arch_lwip_end();
+        return false;
+    }
+    if (udp_bind(pcb, NULL, UDP_CHANNEL_PORT) != ERR_OK) {
+        udp_remove(pcb);
+        cyw43_arch_lwip_end();
+        return false;
+    }
+    udp_recv(pcb, udp_channel_recv, &g_udp);
+    g_udp.pcb = pcb;
+    cyw43_arch_lwip_end();
+    return true;
+}
+
+/** Read the channel counters. */
+udp_channel_stats_t udp_channel_get_stats(void) {
+    udp_channel_stats_t st = g_udp.stats;
+    st.subscribed = (uint32_t)g_udp.subscribed;
+    return st;
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+/*
+ * Low-latency UDP channel for an external master controller. A master
+ * sends setpoint packets that update master_setpoint in the live config; a
+ * subscriber receives runtime samples at a chosen decimation of the core1
+ * tick. All packets start with udp_msg_header_t; fields are little endian
+ * (native on RP2040) and packed without padding.
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define UDP_CHANNEL_PORT 5005
+#define UDP_CHANNEL_MAGIC 0x5550u // "PU" on the wire
+#define UDP_CHANNEL_VERSION 1
+#define UDP_CHANNEL_PERIOD_MS 1 // stream timer period; samples go out as soon as a batch is complete
+#define UDP_CHANNEL_LEASE_MS 5000 // a subscriber that sends nothing for this long is dropped
+#define UDP_CHANNEL_MAX_BATCH 32 // samples per packet
+#define UDP_CHANNEL_MAX_DECIMATION 10000
+#define UDP_CHANNEL_REORDER_WINDOW 1024 // older setpoint seqs are stale; beyond this the master restarted
+
+typedef enum {
+    UDP_MSG_SETPOINT = 1, // master -> device: udp_setpoint_msg_t
+    UDP_MSG_SUBSCRIBE = 2, // subscriber -> device: udp_subscribe_msg_t, repeated within UDP_CHANNEL_LEASE_MS
+    UDP_MSG_UNSUBSCRIBE = 3, // subscriber -> device: header only
+    UDP_MSG_SAMPLES = 4 // device -> subscriber: udp_samples_msg_t + count x udp_sample_t
+} udp_msg_type_t;
+
+typedef struct {
+    uint16_t magic;
+    uint8_t version;
+    uint8_t type; // udp_msg_type_t
+    uint32_t seq; // per sender, incremented by one per packet
+} udp_msg_header_t;
+
+#define UDP_SETPOINT_USE_MASTER 0x1u // also select the master setpoint as the active one
+
+typedef struct {
+    udp_msg_header_t hdr;
+    float setpoint;
+    uint32_t flags; // UDP_SETPOINT_*
+} udp_setpoint_msg_t;
+
+typedef struct {
+    udp_msg_header_t hdr;
+    uint16_t decimation; // ticks per sample, >= 1
+    uint16_t batch; // samples per packet, 1..UDP_CHANNEL_MAX_BATCH
+} udp_subscribe_msg_t;
+
+typedef struct {
+    udp_msg_header_t hdr;
+    uint32_t ack; // seq of the newest setpoint applied
+    uint32_t first; // telemetry seq of the first sample; sample i is first + i * decimation
+    uint16_t count;
+    uint16_t decimation;
+    uint32_t dropped; // ticks overwritten in the telemetry ring before they were read, since subscribing
+} udp_samples_msg_t;
+
+typedef struct {
+    float time_s;
+    float setpoint;
+    float control;
+    float actuator;
+    float output;
+} udp_sample_t;
+
+_Static_assert(sizeof(udp_msg_header_t) == 8, "udp_msg_header_t must be packed");
+_Static_assert(sizeof(udp_setpoint_msg_t) == 16, "udp_setpoint_msg_t must be packed");
+_Static_assert(sizeof(udp_subscribe_msg_t) == 12, "udp_subscribe_msg_t must be packed");
+_Static_assert(sizeof(udp_samples_msg_t) == 24, "udp_samples_msg_t must be packed");
+_Static_assert(sizeof(udp_sample_t) == 20, "udp_sample_t must be packed");
+
+typedef struct {
+    uint32_t rx_packets;
+    uint32_t rx_malformed; // wrong size, magic, version or type
+    uint32_t setpoints; // setpoint updates applied
+    uint32_t stale; // setpoint packets older than the newest applied (reordered or duplicated)
+    uint32_t lost; // setpoint seqs skipped between applied packets
+    uint32_t tx_packets;
+    uint32_t tx_errors;
+    uint32_t samples; // samples sent
+    uint32_t subscribed; // flag: a subscriber is active
+} udp_channel_stats_t;
+
+/** Bind the channel to UDP_CHANNEL_PORT. */
+bool udp_channel_start(void);
+
+/** Read the channel counters. */
+udp_channel_stats_t udp_channel_get_stats(void);
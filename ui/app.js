@@ -0,0 +1,318 @@
+/* Sampling and history buffers for plotting. */
+var dtMs=10;var windowSec=100;var hist=10001;var maxHist=100000;var lastSeq=0;var pollCount=0;var sp=[],y=[],u=[],u1=[];var synced=false;var tfPending=false;var runPending=false;var currentTime=0;var useMasterSetpoint=false;var allowSensSignal=true;
+function q(id){return document.getElementById(id)}
+function api(url,cb){
+var x=new XMLHttpRequest();
+x.onreadystatechange=function(){
+if(x.readyState===4&&x.status===200){
+try{cb(JSON.parse(x.responseText));}catch(e){}}};
+x.open('GET',url,true);x.setRequestHeader('Cache-Control','no-cache');x.send();
+}
+/* Persist UI settings so a refresh keeps the same values. */
+function saveSettings(){
+var s={
+setpoint:q('setpoint').value,
+kp:q('kp').value,ki:q('ki').value,kd:q('kd').value,dt:q('dt').value,
+model:q('model').value,gain:q('gain').value,tau:q('tau').value,
+wn:q('wn').value,zeta:q('zeta').value,dead:q('dead').value,
+act_min:q('act_min').value,act_max:q('act_max').value,
+window:q('window').value,plot_w:q('plot_w').value,plot_h:q('plot_h').value,
+show_sp:q('show_sp').checked,show_u:q('show_u').checked,show_u1:q('show_u1').checked,show_y:q('show_y').checked,
+color_sp:q('color_sp').value,color_u:q('color_u').value,color_u1:q('color_u1').value,color_y:q('color_y').value,
+act_inject:q('act_inject').checked,act_absorb:q('act_absorb').checked
+};
+try{localStorage.setItem('pid_settings',JSON.stringify(s));}catch(e){}
+}
+/* Restore UI settings if they were saved previously. */
+function loadSettings(){
+try{var raw=localStorage.getItem('pid_settings');if(!raw)return false;
+var s=JSON.parse(raw);
+if(s.setpoint!==undefined)q('setpoint').value=s.setpoint;
+if(s.kp!==undefined)q('kp').value=s.kp;
+if(s.ki!==undefined)q('ki').value=s.ki;
+if(s.kd!==undefined)q('kd').value=s.kd;
+if(s.dt!==undefined)q('dt').value=s.dt;
+if(s.model!==undefined)q('model').value=s.model;
+if(s.gain!==undefined)q('gain').value=s.gain;
+if(s.tau!==undefined)q('tau').value=s.tau;
+if(s.wn!==undefined)q('wn').value=s.wn;
+if(s.zeta!==undefined)q('zeta').value=s.zeta;
+if(s.dead!==undefined)q('dead').value=s.dead;
+if(s.act_min!==undefined)q('act_min').value=s.act_min;
+if(s.act_max!==undefined)q('act_max').value=s.act_max;
+if(s.window!==undefined)q('window').value=s.window;
+if(s.plot_w!==undefined)q('plot_w').value=s.plot_w;
+if(s.plot_h!==undefined)q('plot_h').value=s.plot_h;
+if(s.show_sp!==undefined)q('show_sp').checked=!!s.show_sp;
+if(s.show_u!==undefined)q('show_u').checked=!!s.show_u;
+if(s.show_u1!==undefined)q('show_u1').checked=!!s.show_u1;
+if(s.show_y!==undefined)q('show_y').checked=!!s.show_y;
+if(s.color_sp!==undefined)q('color_sp').value=s.color_sp;
+if(s.color_u!==undefined)q('color_u').value=s.color_u;
+if(s.color_u1!==undefined)q('color_u1').value=s.color_u1;
+if(s.color_y!==undefined)q('color_y').value=s.color_y;
+if(s.act_inject!==undefined)q('act_inject').checked=!!s.act_inject;
+if(s.act_absorb!==undefined)q('act_absorb').checked=!!s.act_absorb;
+updateColorPickers();
+updateActuatorModeUI();
+updateModelUI();
+setWindow();setPlotSize();
+return true;}catch(e){return false;}
+}
+/* Parameter ids for binary WebSocket updates (sim_param_t). */
+var P={setpoint:1,kp:2,ki:3,kd:4,dt:5,model:6,gain:7,tau:8,wn:9,zeta:10,dead:11,
+act_min:12,act_max:13,act_inject:14,act_absorb:15,use_master:16,allow_sens:17,run:18,reset:19};
+var ws=null;
+/* Control channel: state replies arrive as text frames after each update. */
+function openWs(){
+if(!window.WebSocket)return;
+ws=new WebSocket('ws://'+location.host+'/ws?period=0');ws.binaryType='arraybuffer';
+ws.onmessage=function(e){if(typeof e.data!=='string')return;try{var d=JSON.parse(e.data);
+if(tfPending){q('tf_text').textContent=transferText(d);tfPending=false;}updateUI(d);}catch(x){}};
+ws.onclose=function(){ws=null;setTimeout(openWs,2000);};
+}
+/* Send [key,value] pairs as one binary frame of {u8 id,f32 value}; false if the socket is not open. */
+function wsSend(pairs){
+if(!ws||ws.readyState!==1)return false;
+var b=new DataView(new ArrayBuffer(pairs.length*5));
+for(var i=0;i<pairs.length;i++){b.setUint8(i*5,P[pairs[i][0]]);b.setFloat32(i*5+1,parseFloat(pairs[i][1])||0,true);}
+ws.send(b.buffer);return true;
+}
+/* Send parameter updates over the WebSocket, or /api/set when it is not connected. */
+function sendParams(pairs,cb){
+if(wsSend(pairs))return;
+var url='/api/set?';
+for(var i=0;i<pairs.length;i++){url+=(i?'&':'')+pairs[i][0]+'='+encodeURIComponent(pairs[i][1]);}
+api(url,cb);
+}
+/* Send configuration changes to the device. */
+function sendConfig(){
+var keys=['setpoint','kp','ki','kd','dt','model','gain','tau','wn','zeta','dead','act_min','act_max'];
+var pairs=[];for(var i=0;i<keys.length;i++){pairs.push([keys[i],q(keys[i]).value]);}
+pairs.push(['act_inject',q('act_inject').checked?1:0]);
+pairs.push(['act_absorb',q('act_absorb').checked?1:0]);
+saveSettings();tfPending=true;runPending=true;sendParams(pairs,function(d){
+if(d&&tfPending){q('tf_text').textContent=transferText(d);tfPending=false;}
+updateUI(d);});}
+/* Recalculate history length when time window changes. */
+function setWindow(){
+var v=parseFloat(q('window').value);
+if(isNaN(v)||v<2)v=2;
+windowSec=v;
+hist=Math.floor((windowSec*1000)/dtMs)+1;
+if(hist<10)hist=10;
+if(hist>maxHist)hist=maxHist;
+while(sp.length>hist){sp.shift();y.shift();u.shift();u1.shift();}
+}
+function setPlotSize(){
+var c=q('plot');
+var w=parseInt(q('plot_w').value,10);
+var h=parseInt(q('plot_h').value,10);
+if(isNaN(w)||w<300)w=300;
+if(isNaN(h)||h<200)h=200;
+c.width=w;c.height=h;draw();
+}
+function startSim(){setRunButtonsState(true);runPending=true;sendParams([['run',1]],updateUI)}
+function stopSim(){setRunButtonsState(false);runPending=true;sendParams([['run',0]],updateUI)}
+function resetSim(){runPending=true;sendParams([['reset',1]],updateUI)}
+/* Clear plotted history without changing configuration. */
+function clearPlot(){sp=[];y=[];u=[];u1=[];draw();}
+function toggleHelp(){
+var p=q('help_panel');
+var open=(p.style.display==='none'||p.style.display==='');
+p.style.display=open?'block':'none';
+setHelpButtonState(open);
+}
+function setHelpButtonState(open){
+var b=q('btn_help');
+if(!b)return;
+if(open)b.classList.add('is-active');else b.classList.remove('is-active');
+}
+function setRunButtonsState(running){
+var bs=q('btn_start');var bp=q('btn_stop');
+if(bs){if(running)bs.classList.add('is-active');else bs.classList.remove('is-active');}
+if(bp){if(running)bp.classList.remove('is-active');else bp.classList.add('is-active');}
+}
+function setSwitchLine(useMaster){
+var line=q('pre_block_line');var block=q('pre_block');
+if(!line||!block)return;
+if(useMaster){
+line.setAttribute('x1','215');line.setAttribute('y1','205');line.setAttribute('x2','250');line.setAttribute('y2','180');
+block.classList.add('switch-disabled');block.classList.remove('switch-active');
+}else{
+line.setAttribute('x1','200');line.setAttribute('y1','180');line.setAttribute('x2','250');line.setAttribute('y2','180');
+block.classList.remove('switch-disabled');block.classList.add('switch-active');
+}
+useMasterSetpoint=useMaster;
+}
+function toggleSetpointSource(){
+var next=!useMasterSetpoint;
+setSwitchLine(next);
+sendParams([['use_master',next?1:0]],updateUI);
+}
+function setFeedbackSwitch(allow){
+var line=q('fb_switch_line');var text=q('fb_switch_text');var block=q('fb_switch');
+if(!line||!text||!block)return;
+if(allow){
+line.style.display='';text.style.display='none';block.classList.remove('switch-disabled');block.classList.add('switch-active');
+}else{
+line.style.display='none';text.style.display='';block.classList.remove('switch-active');block.classList.add('switch-disabled');
+}
+allowSensSignal=allow;
+}
+function toggleFeedbackSwitch(){
+var next=!allowSensSignal;
+setFeedbackSwitch(next);
+sendParams([['allow_sens',next?1:0]],updateUI);
+}
+/* Sync incoming state into UI fields and plotting buffers. */
+function updateUI(d){
+if(!d)return;
+if(runPending){q('running').textContent=d.running?'RUNNING':'STOPPED';runPending=false;}
+setRunButtonsState(!!d.running);
+updateModelUI();
+if(d.dt&&d.dt!==dtMs){dtMs=d.dt;setWindow();}
+if(q('dead_eff'))q('dead_eff').textContent=(d.dead_eff!==undefined&&d.dead_eff<d.dead)?'runs as '+d.dead_eff.toFixed(1)+' ms at this dT':'';
+if(q('master_value'))q('master_value').textContent=d.master_setpoint.toFixed(2);
+useMasterSetpoint=!!d.use_master;
+allowSensSignal=!!d.allow_sens;
+if(!synced){
+if(!loadSettings()){
+q('setpoint').value=d.setpoint_cfg.toFixed(2);
+q('kp').value=d.kp.toFixed(3);
+q('ki').value=d.ki.toFixed(3);
+q('kd').value=d.kd.toFixed(3);
+q('dt').value=d.dt;
+q('model').value=d.model.toString();
+q('gain').value=d.gain.toFixed(2);
+q('tau').value=d.tau.toFixed(2);
+q('wn').value=d.wn.toFixed(2);
+q('zeta').value=d.zeta.toFixed(2);
+q('dead').value=d.dead;
+q('act_min').value=d.act_min.toFixed(2);
+q('act_max').value=d.act_max.toFixed(2);
+q('act_inject').checked=!!d.act_inject;
+q('act_absorb').checked=!!d.act_absorb;
+setWindow();setPlotSize();
+}
+synced=true;
+}
+updateActuatorModeUI();
+setSwitchLine(useMasterSetpoint);
+setFeedbackSwitch(allowSensSignal);
+draw();}
+/* Append full-rate samples from /api/history to the plotting buffers. */
+function pushHistory(h){
+if(!h||!h.samples)return;
+for(var i=0;i<h.samples.length;i++){var s=h.samples[i];
+sp.push(s[1]);u.push(s[2]);u1.push(s[3]);y.push(s[4]);}
+var extra=sp.length-hist;
+if(extra>0){sp.splice(0,extra);y.splice(0,extra);u.splice(0,extra);u1.splice(0,extra);}
+lastSeq=h.last;
+if(h.samples.length>0){var l=h.samples[h.samples.length-1];
+currentTime=l[0];
+q('time').textContent=l[0].toFixed(2);
+q('output').textContent=l[4].toFixed(2);
+q('control').textContent=l[2].toFixed(3);
+q('actuator').textContent=l[3].toFixed(3);}
+draw();
+}
+/* Fetch history every poll; refresh the configuration state every other poll. */
+function poll(){
+api('/api/history?since='+lastSeq,function(h){
+pushHistory(h);
+if(h&&h.more){poll();return;}
+if((pollCount++)%2===0)api('/api/state?t='+(new Date().getTime()),updateUI);
+});
+}
+/* Live telemetry over one Server-Sent Events connection; resume from lastSeq after errors. */
+function startStream(){
+if(!window.EventSource){setInterval(poll,500);return;}
+var es=new EventSource('/api/stream?period=100&since='+lastSeq);
+es.addEventListener('samples',function(e){try{pushHistory(JSON.parse(e.data));}catch(x){}});
+es.addEventListener('state',function(e){try{updateUI(JSON.parse(e.data));}catch(x){}});
+es.onerror=function(){es.close();setTimeout(startStream,1000);};
+}
+/* Build a readable transfer function string. */
+function transferText(d){
+if(d.model===0){
+var eq='Y(s)/U(s) = K/(tau*s+1)';
+eq+=' | K='+d.gain.toFixed(2)+', tau='+d.tau.toFixed(2);
+return eq;
+}
+var eq='Y(s)/U(s) = K*wn^2/(s^2+2*zeta*wn*s+wn^2)';
+eq+=' | K='+d.gain.toFixed(2)+', wn='+d.wn.toFixed(2)+', zeta='+d.zeta.toFixed(2);
+return eq;
+}
+/* Show only the parameters relevant to the selected model. */
+function updateModelUI(){
+var firstOrder=(q('model').value==='0');
+q('row_tau').style.display=firstOrder?'inline-flex':'none';
+q('row_wn').style.display=firstOrder?'none':'inline-flex';
+q('row_zeta').style.display=firstOrder?'none':'inline-flex';
+}
+/* Highlight actuator block based on inject/absorb selection. */
+function updateActuatorModeUI(){
+var inject=q('act_inject').checked;
+var absorb=q('act_absorb').checked;
+var block=q('act_block');
+if(!block)return;
+var fill='#f3ffeeff';
+if(inject&&!absorb)fill='#fffce4ff';
+else if(!inject&&absorb)fill='#f0f8ffff';
+else if(!inject&&!absorb)fill='#ffbabaff';
+block.style.fill=fill;
+}
+/* Keep color pickers filled with their selected color. */
+function updateColorPickers(){
+q('color_sp').style.background=q('color_sp').value;
+q('color_u').style.background=q('color_u').value;
+q('color_u1').style.background=q('color_u1').value;
+q('color_y').style.background=q('color_y').value;
+}
+/* Redraw the plot using the current buffers and toggles. */
+function draw(){
+var c=q('plot');var ctx=c.getContext('2d');
+var padL=36,padR=8,padT=8,padB=22;
+var w=c.width-padL-padR;var h=c.height-padT-padB;
+var inset=0.10*h;
+ctx.clearRect(0,0,c.width,c.height);
+ctx.strokeStyle='#222';ctx.strokeRect(padL,padT,w,h);
+var series=[];
+if(q('show_sp').checked)series.push(sp);
+if(q('show_u').checked)series.push(u);
+if(q('show_u1').checked)series.push(u1);
+if(q('show_y').checked)series.push(y);
+var max=-Infinity,min=Infinity;
+for(var si=0;si<series.length;si++){var a=series[si];
+for(var k=0;k<a.length;k++){if(a[k]>max)max=a[k];if(a[k]<min)min=a[k];}}
+if(min>max){min=0;max=1;}
+var range=(max-min)||1;
+ctx.fillStyle='#222';ctx.font='10px Arial';
+ctx.fillText('Temp',2,padT+10);
+for(var i=0;i<=4;i++){
+var ty=padT+inset+(1-(i/4))*(h-2*inset);
+var val=(min+(i/4)*range).toFixed(0);
+ctx.fillText(val,2,ty+3);
+ctx.strokeStyle='#edededff';ctx.beginPath();ctx.moveTo(padL,ty);ctx.lineTo(padL+w,ty);ctx.stroke();
+}
+var t0=(currentTime-windowSec);if(t0<0)t0=0;
+ctx.fillStyle='#222';
+ctx.fillText('t0='+t0.toFixed(1)+'s',padL,padT+h+14);
+ctx.fillText('t='+currentTime.toFixed(1)+'s',padL+w-46,padT+h+14);
+var stride=Math.max(1,Math.floor(hist/w));
+function plot(arr,color){ctx.strokeStyle=color;ctx.beginPath();
+for(var i=0;i<arr.length;i+=stride){var x=padL+i*(w/(hist-1));
+var ypix=padT+inset+(1-((arr[i]-min)/range))*(h-2*inset);
+if(i===0)ctx.moveTo(x,ypix);else ctx.lineTo(x,ypix);}ctx.stroke();}
+if(q('show_sp').checked)plot(sp,q('color_sp').value||'#000');
+if(q('show_u').checked)plot(u,q('color_u').value||'#9b9b9b');
+if(q('show_u1').checked)plot(u1,q('color_u1').value||'#6abf4b');
+if(q('show_y').checked)plot(y,q('color_y').value||'#b00');}
+setWindow();setPlotSize();
+updateModelUI();
+setSwitchLine(useMasterSetpoint);setFeedbackSwitch(allowSensSignal);
+var switchBlock=q('pre_block');if(switchBlock){switchBlock.addEventListener('click',toggleSetpointSource);}
+var feedbackSwitch=q('fb_switch');if(feedbackSwitch){feedbackSwitch.addEventListener('click',toggleFeedbackSwitch);}
+api('/api/state',updateUI);
+startStream();openWs();
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Gzip-compressed UI files embedded in flash by cmake/embed_web_assets.cmake.
+
+typedef struct {
+    const char *path; // URL path
+    const char *content_type;
+    const char *etag; // quoted strong ETag of the uncompressed content
+    const uint8_t *data; // gzip body, served with Content-Encoding: gzip
+    size_t len;
+} web_asset_t;
+
+extern const web_asset_t g_web_assets[];
+extern const size_t g_web_asset_count;
@@ -1,3 +1,4 @@
+#include <stdarg.h>
 #include <stdio.h>
 #include <string.h>
 #include <stdlib.h>
@@ -6,12 +7,55 @@
 #include "pico/cyw43_arch.h"
 #include "pico/stdlib.h"
 
+#include "lwip/stats.h"
 #include "lwip/tcp.h"
+#include "lwip/timeouts.h"
 
+#include "autotune.h"
+#include "config_store.h"
 #include "debug.h"
+#include "delay_line.h"
+#include "log_ring.h"
+#include "profile.h"
+#include "sim_batch.h"
+#include "sim_loop.h"
+#include "sim_params.h"
+#include "sim_record.h"
+#include "sim_run.h"
 #include "sim_state.h"
+#include "sweep.h"
+#include "telemetry.h"
+#include "tick_stats.h"
+#include "udp_channel.h"
+#include "web_assets.h"
+#include "websocket.h"
+#include "wifi_manager.h"
 
 #define HTTP_PORT 80
+#define HISTORY_CHUNK 32
+
+#define HTTP_MAX_CONNS 3
+#define HTTP_BODY_SIZE 8192 // JSON bodies only; the UI is served from flash
+#define HTTP_POLL_INTERVAL 2 // tcp_poll period in ~500 ms TCP timer ticks
+#define HTTP_SLOT_TIMEOUT_POLLS 5 // ~5 s without send progress
+#define HTTP_MAX_CLIENTS 4 // open connections; the listener holds the fifth lwIP pcb
+#define HTTP_RX_SIZE 1024 // buffered request bytes per connection (pipelined requests wait here)
+#define HTTP_IDLE_TIMEOUT_POLLS 5 // close a keep-alive connection after ~5 s without a request
+#define HTTP_KEEP_ALIVE_TIMEOUT_S 5
+#define HTTP_CHUNK_HEAD 6 // "XXXX\r\n": chunk size in four hex digits (HTTP_BODY_SIZE < 0x10000)
+#define HTTP_BODY_FAILED ((size_t)-1) // body part source went away; the connection is aborted
+
+#define STREAM_MAX_CLIENTS 3
+#define SSE_DEFAULT_PERIOD_MS 100
+#define SSE_MIN_PERIOD_MS 20
+#define SSE_MAX_PERIOD_MS 1000
+#define SSE_STATE_PERIOD_MS 1000
+#define SSE_MIN_SNDBUF 256
+
+#define WS_DEFAULT_PERIOD_MS 50
+#define WS_RX_BUF 256
+#define WS_MAX_SAMPLES 64
+#define WS_MSG_SAMPLES 0x01
 
 /** Decode URL query strings so messages show correctly. */
 static void url_decode(char *dst, size_t dst_len, const char *src) {
@@ -68,103 +112,683 @@ static int get_query_int(const char *path, const char *key, int *out) {
     return 0;
 }
 
+/** Extract an unsigned 32-bit query parameter from the URL. */
+static int get_query_u32(const char *path, const char *key, uint32_t *out) {
+    const char *q = strchr(path, '?');
+    if (!q) return 0;
+    q++;
+    size_t key_len = strlen(key);
+    while (*q) {
+        if (strncmp(q, key, key_len) == 0 && q[key_len] == '=') {
+            *out = (uint32_t)strtoul(q + key_len + 1, NULL, 10);
+            return 1;
+        }
+        q = strchr(q, '&');
+        if (!q) break;
+        q++;
+    }
+    return 0;
+}
+
+/** Extract a string query parameter from the URL (decoded, truncated to out_len). */
+static int get_query_str(const char *path, const char *key, char *out, size_t out_len) {
+    const char *q = strchr(path, '?');
+    if (!q) return 0;
+    q++;
+    size_t key_len = strlen(key);
+    while (*q) {
+        if (strncmp(q, key, key_len) == 0 && q[key_len] == '=') {
+            char raw[64];
+            const char *v = q + key_len + 1;
+            size_t len = strcspn(v, "&");
+            if (len >= sizeof(raw)) len = sizeof(raw) - 1;
+            memcpy(raw, v, len);
+            raw[len] = '\0';
+            url_decode(out, out_len, raw);
+            return 1;
+        }
+        q = strchr(q, '&');
+        if (!q) break;
+        q++;
+    }
+    return 0;
+}
+
+/**
+ * Extract a comma-separated float list query parameter (e.g. den=1,2,5).
+ * Returns the number of values, 0 if the key is absent, -1 if malformed.
+ */
+static int get_query_floats(const char *path, const char *key, float *out, int max) {
+    const char *q = strchr(path, '?');
+    if (!q) return 0;
+    q++;
+    size_t key_len = strlen(key);
+    while (*q) {
+        if (strncmp(q, key, key_len) == 0 && q[key_len] == '=') {
+            char raw[128];
+            char buf[128];
+            const char *v = q + key_len + 1;
+            size_t len = strcspn(v, "&");
+            if (len >= sizeof(raw)) return -1;
+            memcpy(raw, v, len);
+            raw[len] = '\0';
+            url_decode(buf, sizeof(buf), raw);
+
+            int n = 0;
+            char *s = buf;
+            while (*s) {
+                char *end;
+                float f = strtof(s, &end);
+                if (end == s || n == max) return -1;
+                out[n++] = f;
+                s = end;
+                while (*s == ' ') s++;
+                if (*s == ',') {
+                    s++;
+                } else if (*s) {
+                    return -1;
+                }
+            }
+            return n;
+        }
+        q = strchr(q, '&');
+        if (!q) break;
+        q++;
+    }
+    return 0;
+}
+
+/* Transfer function from a query: num=b0,b1,...&den=a0,a1,... (highest power first). */
+typedef struct {
+    float num[PLANT_MAX_ORDER + 1];
+    float den[PLANT_MAX_ORDER + 1];
+    int num_len; // 0 if absent, -1 if malformed
+    int den_len;
+    int model_given; // flag: the query also sets model=
+    int ok; // flag: set by apply_query_to_config() if the coefficients were accepted
+} query_tf_t;
+
+/** Parse the transfer function keys; num defaults to 1 when only den is given. */
+static void get_query_tf(const char *path, query_tf_t *tf) {
+    float value;
+    tf->num_len = get_query_floats(path, "num", tf->num, PLANT_MAX_ORDER + 1);
+    tf->den_len = get_query_floats(path, "den", tf->den, PLANT_MAX_ORDER + 1);
+    if (tf->num_len == 0 && tf->den_len > 0) {
+        tf->num[0] = 1.0f;
+        tf->num_len = 1;
+    }
+    tf->model_given = get_query_float(path, sim_param_key(SIM_PARAM_MODEL), &value);
+    tf->ok = 0;
+}
+
+/**
+ * Apply the /api/set keys of path and the parsed transfer function to cfg.
+ * Returns non-zero if a loop reset was requested.
+ */
+static int apply_query_to_config(sim_config_t *cfg, const char *path, query_tf_t *tf) {
+    float value;
+    int reset_req = 0;
+    for (int id = SIM_PARAM_NONE + 1; id < SIM_PARAM_COUNT; id++) {
+        if (get_query_float(path, sim_param_key((sim_param_t)id), &value)) {
+            reset_req |= sim_param_apply(cfg, (sim_param_t)id, value);
+        }
+    }
+    if (tf->num_len > 0 && tf->den_len > 0) {
+        tf->ok = sim_param_set_tf(cfg, tf->num, tf->num_len, tf->den, tf->den_len);
+        if (tf->ok && !tf->model_given) cfg->plant.model = PLANT_TRANSFER_FUNCTION;
+    }
+    sim_param_finish(cfg);
+    return reset_req;
+}
+
+/** Warn about transfer function coefficients apply_query_to_config() did not accept. */
+static void log_rejected_tf(const query_tf_t *tf) {
+    if ((tf->num_len != 0 || tf->den_len != 0) && !tf->ok) {
+        DLOGW("Rejected transfer function (num %d, den %d coefficients)\n", tf->num_len, tf->den_len);
+    }
+}
+
 /** Apply configuration updates based on query parameters. */
 static void apply_config_from_query(const char *path) {
-    float value;
-    int ivalue;
-
-    const float min_gain = 0.0f;
-    const float max_gain = 10.0f;
-    const float min_tau = 0.1f;
-    const float max_tau = 60.0f;
-    const float min_wn = 0.1f;
-    const float max_wn = 10.0f;
-    const float min_zeta = 0.0f;
-    const float max_zeta = 2.0f;
-    const int min_dead = 0;
-    const int max_dead = 2560;
-    const float min_act = -1000.0f;
-    const float max_act = 1000.0f;
-    const int min_dt = 1;
-    const int max_dt = 1000;
-
-    critical_section_enter_blocking(&g_sim.lock);
-
-    if (get_query_float(path, "setpoint", &value)) g_sim.cfg.setpoint = value;
-    if (get_query_float(path, "kp", &value)) g_sim.cfg.pid.kp = value;
-    if (get_query_float(path, "ki", &value)) g_sim.cfg.pid.ki = value;
-    if (get_query_float(path, "kd", &value)) g_sim.cfg.pid.kd = value;
-    if (get_query_int(path, "dt", &ivalue)) {
-        if (ivalue < min_dt) ivalue = min_dt;
-        if (ivalue > max_dt) ivalue = max_dt;
-        g_sim.cfg.dt_ms = ivalue;
-    }
-    if (get_query_float(path, "gain", &value)) {
-        if (value < min_gain) value = min_gain;
-        if (value > max_gain) value = max_gain;
-        g_sim.cfg.plant.gain = value;
-    }
-    if (get_query_float(path, "tau", &value)) {
-        if (value < min_tau) value = min_tau;
-        if (value > max_tau) value = max_tau;
-        g_sim.cfg.plant.tau = value;
-    }
-    if (get_query_float(path, "wn", &value)) {
-        if (value < min_wn) value = min_wn;
-        if (value > max_wn) value = max_wn;
-        g_sim.cfg.plant.wn = value;
-    }
-    if (get_query_float(path, "zeta", &value)) {
-        if (value < min_zeta) value = min_zeta;
-        if (value > max_zeta) value = max_zeta;
-        g_sim.cfg.plant.zeta = value;
-    }
-    if (get_query_int(path, "dead", &ivalue)) {
-        if (ivalue < min_dead) ivalue = min_dead;
-        if (ivalue > max_dead) ivalue = max_dead;
-        g_sim.cfg.plant.dead_time_ms = ivalue;
-    }
-    if (get_query_float(path, "act_min", &value)) {
-        if (value < min_act) value = min_act;
-        if (value > max_act) value = max_act;
-        g_sim.cfg.act_min = value;
-    }
-    if (get_query_float(path, "act_max", &value)) {
-        if (value < min_act) value = min_act;
-        if (value > max_act) value = max_act;
-        g_sim.cfg.act_max = value;
-    }
-
-    if (get_query_int(path, "model", &ivalue)) {
-        g_sim.cfg.plant.model = (ivalue == 1) ? PLANT_SECOND_ORDER : PLANT_FIRST_ORDER;
-    }
-    if (get_query_int(path, "act_inject", &ivalue)) g_sim.cfg.act_inject = ivalue ? 1 : 0;
-    if (get_query_int(path, "act_absorb", &ivalue)) g_sim.cfg.act_absorb = ivalue ? 1 : 0;
-    if (get_query_int(path, "use_master", &ivalue)) g_sim.cfg.use_master_setpoint = ivalue ? 1 : 0;
-    if (get_query_int(path, "allow_sens", &ivalue)) g_sim.cfg.allow_sens_signal = ivalue ? 1 : 0;
-    if (get_query_int(path, "run", &ivalue)) g_sim.cfg.running = ivalue ? 1 : 0;
-    if (get_query_int(path, "reset", &ivalue) && ivalue) g_sim.reset_requested = 1;
-
-    if (g_sim.cfg.act_min > g_sim.cfg.act_max) {
-        float tmp = g_sim.cfg.act_min;
-        g_sim.cfg.act_min = g_sim.cfg.act_max;
-        g_sim.cfg.act_max = tmp;
-    }
-
-    critical_section_exit(&g_sim.lock);
+    query_tf_t tf;
+    get_query_tf(path, &tf);
+
+    sim_state_config_begin();
+    int reset_req = apply_query_to_config(&g_sim.cfg, path, &tf);
+    sim_state_config_end();
+
+    log_rejected_tf(&tf);
+    if (reset_req) sim_state_request_reset();
 }
 
-/** Build the JSON response for the current simulation state. */
-static void build_state_json(char *out, size_t out_len) {
+#define HTTP_JOB_CHUNK_TICKS 16 // simulated ticks between deadline checks of an offline job
+
+typedef enum {
+    HTTP_JOB_IDLE = 0,
+    HTTP_JOB_QUEUED = 1, // filled in by the handler, not started yet
+    HTTP_JOB_RUNNING = 2
+} http_job_state_t;
+
+struct http_conn;
+
+/*
+ * Offline run of /api/simulate or /api/autotune. A run takes up to
+ * SIM_RUN_MAX_TICKS ticks (autotune: several experiments of up to
+ * AUTOTUNE_MAX_TICKS first), far too long for the lwIP context, so the
+ * handler only fills this in. web_server_poll() runs it in slices from the
+ * core0 main loop and answers the waiting connection once it is done.
+ */
+typedef struct {
+    volatile http_job_state_t state;
+    int autotune; // flag: /api/autotune, else /api/simulate
+    struct http_conn *conn; // connection waiting for the answer, NULL once it is gone
     sim_config_t cfg;
-    sim_runtime_t rt;
-    int reset_req;
+    float duration; // simulated seconds of the step response
+    float band; // settling band, percent of the step
+    autotune_request_t req;
+    int apply; // autotune: store the gains once tuned
+    int tuned; // autotune: identification done, the step response checks the gains
+    int run_ok; // flag: the step response run was started
+    autotune_t tune;
+    sim_run_t run;
+    sim_run_metrics_t m;
+    uint64_t start_us;
+    uint32_t elapsed_us; // wall time from the start to the answer
+} http_job_t;
+
+static http_job_t g_job;
+
+static const char *const k_autotune_rules[] = {"zn", "tl", "cc", "simc"};
 
-    critical_section_enter_blocking(&g_sim.lock);
-    cfg = g_sim.cfg;
-    rt = g_sim.rt;
-    reset_req = g_sim.reset_requested;
-    critical_section_exit(&g_sim.lock);
+/** Read the /api/set keys of the query into a copy of the configuration. */
+static void job_config_from_query(http_job_t *job, const char *path) {
+    query_tf_t tf;
+    get_query_tf(path, &tf);
+    job->cfg = sim_state_get_config();
+    apply_query_to_config(&job->cfg, path, &tf);
+    log_rejected_tf(&tf);
+}
+
+/**
+ * Queue /api/simulate: the current configuration with the /api/set keys of
+ * the query applied to a copy, offline for duration seconds (default 60).
+ * band is the settling band in percent of the step (default 2).
+ */
+static void simulate_job_from_query(http_job_t *job, const char *path) {
+    job_config_from_query(job, path);
+    job->autotune = 0;
+    job->duration = 60.0f;
+    job->band = SIM_RUN_DEFAULT_BAND * 100.0f;
+    get_query_float(path, "duration", &job->duration);
+    get_query_float(path, "band", &job->band);
+}
+
+/** Build the /api/simulate answer from the finished run. */
+static void build_simulate_json(char *out, size_t out_len, const http_job_t *job) {
+    if (!job->run_ok) {
+        snprintf(out, out_len, "{\"error\":\"duration must be positive\"}");
+        return;
+    }
+    const sim_run_metrics_t *m = &job->m;
+    DLOGI("SIM offline run: %u ticks in %u us\n", (unsigned)m->ticks, (unsigned)job->elapsed_us);
+
+    snprintf(out, out_len,
+        "{"
+        "\"duration\":%.3f,"
+        "\"dt\":%g,"
+        "\"dt_us\":%d,"
+        "\"ticks\":%u,"
+        "\"elapsed_us\":%u,"
+        "\"y0\":%.3f,"
+        "\"setpoint\":%.3f,"
+        "\"final\":%.3f,"
+        "\"rise_time\":%.3f,"
+        "\"overshoot\":%.2f,"
+        "\"settling_time\":%.3f,"
+        "\"band\":%.2f,"
+        "\"ss_error\":%.4f,"
+        "\"iae\":%.4g,"
+        "\"ise\":%.4g,"
+        "\"itae\":%.4g,"
+        "\"peak_actuator\":%.3f,"
+        "\"peak_control\":%.3f,"
+        "\"dead_time\":%.1f,"
+        "\"dead_limited\":%d"
+        "}",
+        m->duration_s,
+        sim_loop_dt_us(&job->cfg) / 1000.0,
+        sim_loop_dt_us(&job->cfg),
+        (unsigned)m->ticks,
+        (unsigned)job->elapsed_us,
+        m->y0,
+        m->setpoint,
+        m->final,
+        m->rise_time,
+        m->overshoot,
+        m->settling_time,
+        job->band,
+        m->ss_error,
+        m->iae,
+        m->ise,
+        m->itae,
+        m->peak_actuator,
+        m->peak_control,
+        m->dead_ms,
+        m->dead_limited);
+}
+
+/**
+ * Queue /api/autotune: method=relay|step, rule=zn|tl|cc|simc, pi=1 for a PI
+ * controller, d/eps/step for the experiment sizes, apply=1 to store the
+ * gains through sim_state_set_pid(). /api/set keys in the query are applied
+ * to a copy of the configuration first. The tuned loop is checked with an
+ * offline step response of duration seconds (default 60).
+ */
+static void autotune_job_from_query(http_job_t *job, const char *path) {
+    job_config_from_query(job, path);
+    job->autotune = 1;
+    autotune_default_request(&job->req);
+    char name[16];
+    if (get_query_str(path, "method", name, sizeof(name))) {
+        job->req.method = (strcmp(name, "step") == 0) ? AUTOTUNE_STEP : AUTOTUNE_RELAY;
+    }
+    if (get_query_str(path, "rule", name, sizeof(name))) {
+        for (size_t i = 0; i < sizeof(k_autotune_rules) / sizeof(k_autotune_rules[0]); i++) {
+            if (strcmp(name, k_autotune_rules[i]) == 0) job->req.rule = (autotune_rule_t)i;
+        }
+    }
+    get_query_int(path, "pi", &job->req.pi_only);
+    get_query_float(path, "d", &job->req.relay_amplitude);
+    get_query_float(path, "eps", &job->req.hysteresis);
+    get_query_float(path, "step", &job->req.step_size);
+    job->apply = 0;
+    get_query_int(path, "apply", &job->apply);
+    job->duration = 60.0f;
+    get_query_float(path, "duration", &job->duration);
+}
+
+/** Build the /api/autotune answer from the finished job. */
+static void build_autotune_json(char *out, size_t out_len, const http_job_t *job) {
+    const autotune_result_t *res = &job->tune.res;
+    const sim_run_metrics_t *m = &job->m;
+    DLOGI("SIM autotune %s: %u ticks in %u us\n", res->ok ? "done" : res->error,
+         (unsigned)res->ticks, (unsigned)job->elapsed_us);
+
+    snprintf(out, out_len,
+        "{"
+        "\"ok\":%d,"
+        "\"error\":\"%s\","
+        "\"method\":\"%s\","
+        "\"rule\":\"%s\","
+        "\"k\":%.4g,"
+        "\"t\":%.4g,"
+        "\"l\":%.4g,"
+        "\"ku\":%.4g,"
+        "\"pu\":%.4g,"
+        "\"amplitude\":%.4g,"
+        "\"kp\":%.4g,"
+        "\"ki\":%.4g,"
+        "\"kd\":%.4g,"
+        "\"applied\":%d,"
+        "\"ticks\":%u,"
+        "\"elapsed_us\":%u,"
+        "\"rise_time\":%.3f,"
+        "\"overshoot\":%.2f,"
+        "\"settling_time\":%.3f,"
+        "\"iae\":%.4g"
+        "}",
+        res->ok,
+        res->ok ? "" : res->error,
+        job->req.method == AUTOTUNE_STEP ? "step" : "relay",
+        k_autotune_rules[job->req.rule],
+        res->k,
+        res->t,
+        res->l,
+        res->ku,
+        res->pu,
+        res->amplitude,
+        res->pid.kp,
+        res->pid.ki,
+        res->pid.kd,
+        res->ok && job->apply,
+        (unsigned)res->ticks,
+        (unsigned)job->elapsed_us,
+        m->rise_time,
+        m->overshoot,
+        m->settling_time,
+        m->iae);
+}
+
+/** Start the queued job: the autotune experiments or the step response. */
+static void http_job_begin(http_job_t *job) {
+    job->start_us = time_us_64();
+    job->tuned = 0;
+    job->run_ok = 0;
+    memset(&job->m, 0, sizeof(job->m));
+    if (job->autotune) {
+        autotune_start(&job->tune, &job->cfg, &job->req);
+    } else {
+        job->run_ok = sim_run_start(&job->run, &job->cfg, job->duration, job->band / 100.0f);
+    }
+    job->state = HTTP_JOB_RUNNING;
+}
+
+/** Run the job in HTTP_JOB_CHUNK_TICKS chunks until deadline_us; returns 1 once it is finished. */
+static int http_job_step(http_job_t *job, uint64_t deadline_us) {
+    do {
+        if (job->autotune && !job->tuned) {
+            if (!autotune_advance(&job->tune, HTTP_JOB_CHUNK_TICKS)) continue;
+            job->tuned = 1;
+            if (job->tune.res.ok) {
+                /* Check the tuned loop with an offline step response. */
+                job->cfg.pid = job->tune.res.pid;
+                job->run_ok = sim_run_start(&job->run, &job->cfg, job->duration, SIM_RUN_DEFAULT_BAND);
+            }
+        } else if (!job->run_ok || sim_run_advance(&job->run, HTTP_JOB_CHUNK_TICKS)) {
+            if (job->run_ok) sim_run_metrics(&job->run, &job->m);
+            job->elapsed_us = (uint32_t)(time_us_64() - job->start_us);
+            return 1;
+        }
+    } while (time_us_64() < deadline_us);
+    return 0;
+}
+
+/**
+ * Update batch instances from /api/batch/set. id selects one instance (all
+ * instances if absent), en=0/1 disables or enables it, count=N enables
+ * instances 0..N-1 and disables the rest. The remaining keys are the
+ * per-instance /api/set keys (setpoint, gains, plant, dead, act_min/max, zoh).
+ */
+static void apply_batch_from_query(const char *path) {
+    int id = -1;
+    int id_given = get_query_int(path, "id", &id);
+    if (id_given && (id < 0 || id >= SIM_BATCH_MAX)) {
+        DLOGW("Batch instance %d out of range\n", id);
+        return;
+    }
+    int count = 0;
+    int count_given = get_query_int(path, "count", &count);
+    int en = 0;
+    int en_given = get_query_int(path, "en", &en);
+
+    int rejected = 0;
+    sim_config_t cfg = sim_state_get_config();
+    int dt_us = sim_loop_dt_us(&cfg);
+    int cut_ms = -1;
+    for (int i = 0; i < SIM_BATCH_MAX; i++) {
+        if (id_given && i != id) continue;
+        sim_batch_config_t c = sim_batch_get_config(i);
+        if (count_given) c.enabled = i < count;
+        if (en_given) c.enabled = en ? 1 : 0;
+        for (int p = SIM_PARAM_NONE + 1; p < SIM_PARAM_COUNT; p++) {
+            float value;
+            if (get_query_float(path, sim_param_key((sim_param_t)p), &value) &&
+                !sim_batch_apply_param(&c, (sim_param_t)p, value)) {
+                rejected = p;
+            }
+        }
+        if (c.enabled && sim_batch_dead_ms(c.dead_time_ms, dt_us) < (float)c.dead_time_ms) cut_ms = c.dead_time_ms;
+        sim_batch_set_config(i, &c);
+    }
+    if (rejected) {
+        DLOGW("Batch instances ignore %s=\n", sim_param_key((sim_param_t)rejected));
+    }
+    if (cut_ms >= 0) {
+        DLOGW("Batch dead time %d ms runs as %.1f ms (SIM_BATCH_DELAY ticks)\n", cut_ms,
+              (double)sim_batch_dead_ms(cut_ms, dt_us));
+    }
+}
+
+/**
+ * Read one sweep axis: v fixes the gain, min,max spans it with 5 grid
+ * points, min,max,n sets the grid size. An absent axis keeps the gain.
+ */
+static int get_query_range(const char *path, const char *key, float gain, sweep_range_t *range) {
+    float v[3];
+    int n = get_query_floats(path, key, v, 3);
+    if (n < 0) return 0;
+    range->min = (n > 0) ? v[0] : gain;
+    range->max = (n > 1) ? v[1] : range->min;
+    range->n = (n > 2) ? (int)v[2] : (n == 2 ? 5 : 1);
+    return 1;
+}
+
+/**
+ * Handle /api/sweep/start, /stop and /apply. start takes kp/ki/kd ranges
+ * (see get_query_range()), mode=grid|random with count and seed, duration
+ * seconds per point and w, the overshoot weight of the cost; /api/set keys
+ * are applied to a copy of the configuration the points run against.
+ * apply stores the best gains through sim_state_set_pid().
+ */
+static void apply_sweep_from_query(const char *path) {
+    if (strncmp(path, "/api/sweep/stop", 15) == 0) {
+        sweep_stop();
+        return;
+    }
+    if (strncmp(path, "/api/sweep/apply", 16) == 0) {
+        sweep_status_t st = sweep_get_status();
+        if (st.best >= 0) sim_state_set_pid(&st.best_pid);
+        return;
+    }
+    if (strncmp(path, "/api/sweep/start", 16) != 0) return;
+
+    query_tf_t tf;
+    get_query_tf(path, &tf);
+    sim_config_t cfg = sim_state_get_config();
+    apply_query_to_config(&cfg, path, &tf);
+    log_rejected_tf(&tf);
+
+    sweep_spec_t spec;
+    memset(&spec, 0, sizeof(spec));
+    spec.count = 64;
+    spec.seed = 1;
+    spec.duration_s = SWEEP_DEFAULT_DURATION_S;
+    spec.overshoot_weight = 1.0f;
+    char mode[16];
+    if (get_query_str(path, "mode", mode, sizeof(mode))) spec.random = strcmp(mode, "random") == 0;
+    get_query_int(path, "count", &spec.count);
+    get_query_u32(path, "seed", &spec.seed);
+    get_query_float(path, "duration", &spec.duration_s);
+    get_query_float(path, "w", &spec.overshoot_weight);
+    int total = 0;
+    if (get_query_range(path, "kp", cfg.pid.kp, &spec.kp) &&
+        get_query_range(path, "ki", cfg.pid.ki, &spec.ki) &&
+        get_query_range(path, "kd", cfg.pid.kd, &spec.kd)) {
+        total = sweep_start(&spec, &cfg);
+    }
+    if (total) {
+        DLOGI("SIM sweep started: %d points\n", total);
+    } else {
+        DLOGW("Sweep rejected: 1..%d points\n", SWEEP_MAX_POINTS);
+    }
+}
+
+/**
+ * Build the JSON response for the sweep job: status, the best point and
+ * the evaluated points from index since on as [i, kp, ki, kd, cost, iae,
+ * overshoot, dead_limited]. Points run with a cut dead time are counted in
+ * limited and never chosen as best. Poll again with since=next until next
+ * reaches total.
+ */
+static void build_sweep_json(char *out, size_t out_len, int since) {
+    static const char *const k_states[] = {"idle", "running", "done", "stopped"};
+    static int idx[SWEEP_MAX_POINTS];
+    static sweep_result_t res[SWEEP_MAX_POINTS];
+    sweep_status_t st = sweep_get_status();
+    int next = 0;
+    int n = sweep_read_results(since, idx, res, SWEEP_MAX_POINTS, &next);
+
+    size_t pos = (size_t)snprintf(out, out_len,
+        "{\"state\":\"%s\",\"job\":%u,\"total\":%d,\"done\":%d,\"core0\":%u,\"core1\":%u,"
+        "\"elapsed_us\":%u,\"limited\":%d,\"best\":%d,\"kp\":%.4g,\"ki\":%.4g,\"kd\":%.4g,"
+        "\"cost\":%.4g,\"iae\":%.4g,\"overshoot\":%.2f,\"points\":[",
+        k_states[st.state], (unsigned)st.job, st.total, st.done,
+        (unsigned)st.core_points[0], (unsigned)st.core_points[1], (unsigned)st.elapsed_us,
+        st.limited, st.best, st.best_pid.kp, st.best_pid.ki, st.best_pid.kd,
+        st.best_result.cost, st.best_result.iae, st.best_result.overshoot);
+
+    const size_t tail_room = 24;
+    for (int i = 0; i < n; i++) {
+        pid_params_t pid = sweep_point_gains(idx[i]);
+        char item[112];
+        int len = snprintf(item, sizeof(item), "%s[%d,%.4g,%.4g,%.4g,%.4g,%.4g,%.2f,%d]",
+                           i ? "," : "", idx[i], pid.kp, pid.ki, pid.kd,
+                           res[i].cost, res[i].iae, res[i].overshoot, res[i].dead_limited);
+        if (len < 0 || pos + (size_t)len + tail_room >= out_len) {
+            next = idx[i]; // resume here on the next poll
+            break;
+        }
+        memcpy(out + pos, item, (size_t)len);
+        pos += (size_t)len;
+    }
+    snprintf(out + pos, out_len - pos, "],\"next\":%d}", next);
+}
+
+/**
+ * Handle /api/record/start (every = ticks per telemetry sample), /stop and
+ * /replay. A recording starts on core1's next tick with a loop reset.
+ */
+static void apply_record_from_query(const char *path) {
+    if (strncmp(path, "/api/record/start", 17) == 0) {
+        int every = SIM_RECORD_DEFAULT_EVERY;
+        get_query_int(path, "every", &every);
+        if (sim_record_start(every)) {
+            DLOGI("SIM recording requested, every %d ticks\n", every);
+        } else {
+            DLOGW("Recording rejected: replay or upload in progress\n");
+        }
+    } else if (strncmp(path, "/api/record/stop", 16) == 0) {
+        sim_record_stop();
+    } else if (strncmp(path, "/api/record/replay", 18) == 0) {
+        if (!sim_replay_start()) DLOGW("Replay rejected: no complete recording\n");
+    }
+}
+
+/** Build the JSON response with the recorder and replay status. */
+static void build_record_json(char *out, size_t out_len) {
+    static const char *const k_states[] = {"empty", "recording", "done", "uploading"};
+    static const char *const k_replay[] = {"idle", "running", "match", "mismatch"};
+    sim_record_status_t st;
+    sim_record_get_status(&st);
+    snprintf(out, out_len,
+        "{\"state\":\"%s\",\"gen\":%u,\"ticks\":%u,\"entries\":%u,\"capacity\":%u,\"every\":%u,"
+        "\"bytes\":%u,\"full\":%d,\"replay\":\"%s\",\"replay_tick\":%u,\"mismatch_tick\":%u,"
+        "\"replay_us\":%u}",
+        k_states[st.state], (unsigned)st.gen, (unsigned)st.ticks, (unsigned)st.entries,
+        (unsigned)st.capacity, (unsigned)st.every, (unsigned)st.bytes, st.full, k_replay[st.replay],
+        (unsigned)st.replay_tick, (unsigned)st.mismatch_tick, (unsigned)st.replay_us);
+}
+
+/**
+ * Read segment i of a profile from s<i>=kind,duration_s,a[,b[,c]], e.g.
+ * s0=ramp,10,50. Returns 1 if present and well formed.
+ */
+static int get_query_segment(const char *path, int i, profile_segment_t *seg) {
+    char key[16];
+    char buf[64];
+    snprintf(key, sizeof(key), "s%d", i);
+    if (!get_query_str(path, key, buf, sizeof(buf))) return 0;
+    char *args = strchr(buf, ',');
+    if (!args) return 0;
+    *args++ = '\0';
+    if (!profile_kind_parse(buf, &seg->kind)) return 0;
+    float v[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+    int n = 0;
+    while (*args && n < 4) {
+        char *end;
+        v[n++] = strtof(args, &end);
+        if (end == args || (*end && *end != ',')) return 0;
+        args = *end ? end + 1 : end;
+    }
+    if (n < 2 || *args) return 0;
+    seg->duration_s = v[0];
+    seg->a = v[1];
+    seg->b = v[2];
+    seg->c = v[3];
+    return 1;
+}
+
+/**
+ * Handle /api/profile/start (segments s0, s1, ... and repeat=1) and /stop.
+ * The profile runs on core1 from its next tick and drives the active setpoint.
+ */
+static void apply_profile_from_query(const char *path) {
+    if (strncmp(path, "/api/profile/stop", 17) == 0) {
+        profile_stop();
+        return;
+    }
+    if (strncmp(path, "/api/profile/start", 18) != 0) return;
+    static profile_t p;
+    memset(&p, 0, sizeof(p));
+    while (p.count < PROFILE_MAX_SEGMENTS && get_query_segment(path, p.count, &p.seg[p.count])) {
+        p.count++;
+    }
+    get_query_int(path, "repeat", &p.repeat);
+    if (profile_load(&p)) {
+        DLOGI("SIM profile loaded: %d segments%s\n", p.count, p.repeat ? ", repeating" : "");
+    } else {
+        DLOGW("Profile rejected: invalid segments or previous load pending\n");
+    }
+}
+
+/** Build the JSON response with the profile status and its segments. */
+static void build_profile_json(char *out, size_t out_len) {
+    static const char *const k_states[] = {"idle", "running", "done"};
+    profile_status_t st;
+    profile_get_status(&st);
+    profile_t p = profile_get();
+    size_t pos = (size_t)snprintf(out, out_len,
+        "{\"state\":\"%s\",\"gen\":%u,\"segment\":%d,\"count\":%d,\"repeat\":%d,\"laps\":%u,"
+        "\"elapsed_s\":%.3f,\"value\":%.4f,\"segments\":[",
+        k_states[st.state], (unsigned)st.gen, st.segment, p.count, p.repeat, (unsigned)st.laps,
+        (double)st.elapsed_s, (double)st.value);
+    for (int i = 0; i < p.count && pos < out_len; i++) {
+        const profile_segment_t *seg = &p.seg[i];
+        pos += (size_t)snprintf(out + pos, out_len - pos,
+            "%s{\"kind\":\"%s\",\"duration_s\":%.3f,\"a\":%.4f,\"b\":%.4f,\"c\":%.4f}",
+            i ? "," : "", profile_kind_name(seg->kind), (double)seg->duration_s, (double)seg->a,
+            (double)seg->b, (double)seg->c);
+    }
+    if (pos < out_len) snprintf(out + pos, out_len - pos, "]}");
+}
+
+static uint32_t g_record_download_gen; // recording being downloaded
+
+/**
+ * Body part `part` of /api/record.bin: the recording image, copied as is.
+ * A new recording or upload mid-download fails the body; the bytes already
+ * sent no longer match the Content-Length image.
+ */
+static size_t build_record_part(int part, char *out, size_t out_len) {
+    size_t len = sim_record_read(g_record_download_gen, (size_t)part * out_len, out, out_len);
+    return (len == SIM_RECORD_GONE) ? HTTP_BODY_FAILED : len;
+}
+
+/** Format count floats as a JSON array. */
+static void format_float_array(char *out, size_t out_len, const float *v, int count) {
+    size_t len = 0;
+    out[len++] = '[';
+    for (int i = 0; i < count && len < out_len; i++) {
+        len += (size_t)snprintf(out + len, out_len - len, "%s%g", i ? "," : "", v[i]);
+    }
+    if (len + 2 > out_len) len = out_len - 2;
+    out[len++] = ']';
+    out[len] = '\0';
+}
+
+/** Build the JSON response for the current simulation state. */
+static void build_state_json(char *out, size_t out_len) {
+    sim_config_t cfg = sim_state_get_config();
+    sim_runtime_t rt = sim_state_get_runtime();
+    int reset_req = sim_state_reset_pending();
+    sim_state_stats_t stats = sim_state_get_stats();
+    char tf_num[128];
+    char tf_den[128];
+    format_float_array(tf_num, sizeof(tf_num), cfg.plant.tf_num, cfg.plant.tf_order + 1);
+    format_float_array(tf_den, sizeof(tf_den), cfg.plant.tf_den, cfg.plant.tf_order + 1);
+    /* The live line always gets its reserve, so only DELAY_MAX_BLOCKS can cut the dead time. */
+    float dead_max = delay_line_max_ms(sim_loop_dt_us(&cfg));
+    float dead_eff = (cfg.plant.dead_time_ms > dead_max) ? dead_max : (float)cfg.plant.dead_time_ms;
 
     snprintf(out, out_len,
         "{"
@@ -177,13 +801,18 @@ static void build_state_json(char *out, size_t out_len) {
         "\"kp\":%.3f,"
         "\"ki\":%.3f,"
         "\"kd\":%.3f,"
-        "\"dt\":%d,"
+        "\"dt\":%g,"
+        "\"dt_us\":%d,"
         "\"model\":%d,"
         "\"gain\":%.2f,"
         "\"tau\":%.2f,"
         "\"wn\":%.2f,"
         "\"zeta\":%.2f,"
         "\"dead\":%d,"
+        "\"dead_eff\":%.1f,"
+        "\"zoh\":%d,"
+        "\"tf_num\":%s,"
+        "\"tf_den\":%s,"
         "\"time\":%.2f,"
         "\"control\":%.3f,"
         "\"actuator\":%.3f,"
@@ -192,7 +821,12 @@ static void build_state_json(char *out, size_t out_len) {
         "\"act_inject\":%d,"
         "\"act_absorb\":%d,"
         "\"act_min\":%.2f,"
-        "\"act_max\":%.2f"
+        "\"act_max\":%.2f,"
+        "\"fixed\":%d,"
+        "\"cfg_retries\":%u,"
+        "\"cfg_stale\":%u,"
+        "\"rt_retries\":%u,"
+        "\"lock_max_us\":%u"
         "}",
         cfg.running,
         rt.setpoint,
@@ -203,13 +837,18 @@ static void build_state_json(char *out, size_t out_len) {
         cfg.pid.kp,
         cfg.pid.ki,
         cfg.pid.kd,
-        cfg.dt_ms,
+        cfg.dt_us / 1000.0,
+        cfg.dt_us,
         (int)cfg.plant.model,
         cfg.plant.gain,
         cfg.plant.tau,
         cfg.plant.wn,
         cfg.plant.zeta,
         cfg.plant.dead_time_ms,
+        dead_eff,
+        cfg.plant.method == PLANT_METHOD_ZOH,
+        tf_num,
+        tf_den,
         rt.time_s,
         rt.control,
         rt.actuator,
@@ -218,596 +857,1322 @@ static void build_state_json(char *out, size_t out_len) {
         cfg.act_inject,
         cfg.act_absorb,
         cfg.act_min,
-        cfg.act_max);
+        cfg.act_max,
+        cfg.numeric == SIM_NUMERIC_FIXED,
+        (unsigned)stats.cfg_retries,
+        (unsigned)stats.cfg_stale,
+        (unsigned)stats.rt_retries,
+        (unsigned)stats.lock_max_hold_us);
 }
 
-/** Build the HTML shell (JS is served separately at /app.js). */
-static void build_page(char *out, size_t out_len) {
-    snprintf(out, out_len,
-        "<!doctype html>"
-        "<html><head><meta name='viewport' content='width=device-width,initial-scale=1'>"
-        "<title>Pico W PID Simulator</title>"
-        "<style>"
-        "body{font-family:Verdana,Arial,sans-serif;background:#f5f2e9;margin:20px;}"
-        ".card{background:#fff;border:2px solid #222;padding:12px;margin-bottom:12px;}"
-        ".controls{display:flex;flex-wrap:wrap;gap:8px;align-items:center;margin-top:8px;}"
-        "button{padding:8px 12px;margin:4px;border:2px solid #222;background:#eae2d0;}"
-        "button:active{background:#f5f2e9;}"
-        "button.is-active{background:#f5f2e9;}"
-        "input:not([type='checkbox']),select{padding:6px;border:2px solid #222;margin:4px;width:110px;}"
-        "input[type='checkbox']{width:auto;padding:0;border:0;margin:0;vertical-align:middle;}"
-        "input[type='color']{appearance:none;-webkit-appearance:none;padding:0;border:2px solid #222;margin:0;width:28px;height:20px;background:transparent;}"
-        "canvas{border:2px solid #222;background:#fff;}"
-        ".diag-block{fill:#fff;stroke:#222;stroke-width:2;}"
-        ".diag-line{stroke:#222;stroke-width:2;fill:none;}"
-        ".diag-text{font-size:12px;fill:#222;}"
-        ".diag-title{font-size:12px;fill:#222;font-weight:bold;}"
-        ".switch-active{fill:#f5f2e9;}"
-        ".switch-disabled{fill:#ffbaba;}"
-        ".master-border{fill:#fff;stroke:#777;}"
-        ".master-box{fill:#f0f0f0;stroke:#777;}"
-        ".master-text{fill:#777;}"
-        ".schematic-shift{margin-left:140px;}"
-        "</style></head><body>"
-        "<h2>Pico W PID Simulator</h2>"
-        "<div id='help_panel' style='display:none;border:2px solid #222;background:#fff;padding:12px;margin-bottom:12px;'>"
-"<div style='font-weight:bold;margin-bottom:8px;'>On this page you can see a diagram of an automatic system in a closed-loop feedback.</div>"
-"<div style='font-weight:bold;margin-top:10px;'>Blocks and signals</div>"
-"<div style='margin-top:6px;'><b>Setpoint reg</b>: Here you set the value you want the system to achieve in the process.</div>"
-"<div style='margin-top:4px;'><b>Summing junction (comparator)</b>: Does a simple operation to close the negative feedback loop: e(t) = r(t) - y1(t)</div>"
-"<div style='margin-top:4px;'><b>PID controller</b>: The PID mathematical algorithm with e(t) as the input signal and u(t) as the result (controller output).</div>"
-"<div style='margin-top:6px;'><b>Inputs you can set (tuning parameters)</b>:</div>"
-"<div style='margin-left:14px;'>Kp - proportional gain (how strongly the controller reacts to the current error)</div>"
-"<div style='margin-left:14px;'>Ki - integral gain (how strongly it reacts to accumulated error over time)</div>"
-"<div style='margin-left:14px;'>Kd - derivative gain (how strongly it reacts to how fast the error is changing)</div>"
-"<div style='margin-left:14px;'>dT (ms) - controller time step / sampling period used by the PID calculations</div>"
-"<div style='margin-top:6px;'><b>Actuator / FCE</b>: As we simulate a real system, understand that an actuator can:</div>"
-"<div style='margin-left:14px;'>Inject energy - actuator can only add energy to the system (e.g., heater in an oven)</div>"
-"<div style='margin-left:14px;'>Absorb energy - actuator can only remove energy from the system (e.g., refrigerator)</div>"
-"<div style='margin-left:14px;'>Or both, for example a motor drive which can accelerate and brake the motor.</div>"
-"<div style='margin-top:4px;'>Also, a real actuator cannot inject or absorb infinite energy into/from the system. This is why you can set:</div>"
-"<div style='margin-left:14px;'>Min / Max - clamps the actuator output to a allowed range (you can leave it as it is: -100...100, e.g. %% of power, PWM, Current, etc)</div>"
-"<div style='margin-top:6px;'><b>Plant / Process</b>: This is the system being controlled (the \"process\"). More exactly, it is the mathematical equation that describes it.</div>"
-"<div style='margin-top:4px;'>You can choose the mathematical model: First order or Second order, and set parameters:</div>"
-"<div style='margin-left:14px;'>Gain (K) - overall plant gain</div>"
-"<div style='margin-left:14px;'>Tau (tau) - time constant (first-order model)</div>"
-"<div style='margin-left:14px;'>Wn (wn) - natural frequency (second-order model)</div>"
-"<div style='margin-left:14px;'>Zeta (zeta) - damping ratio (second-order model)</div>"
-"<div style='margin-left:14px;'>Dead (ms) - dead time / input delay before the plant responds (use a multiple of dT for exact timing)</div>"
-"<div style='margin-top:6px;'><b>Sensor</b>: Measures the plant output for feedback (often modeled as gain = 1).</div>"
-"<div style='font-weight:bold;margin-top:10px;'>Controls (buttons)</div>"
-"<div style='margin-left:14px;'>Apply - send/use the current settings (parameters) in the simulation</div>"
-"<div style='margin-left:14px;'>Start - starts running the control loop (run setpoint + PID controller)</div>"
-"<div style='margin-left:14px;'>Stop - stops the control loop (stop setpoint + PID controller only); rest of the system is still simulated, as in real life</div>"
-"<div style='margin-left:14px;'>Reset - resets the PID internal state and disconnects the setpoint from r(t)</div>"
-"<div style='margin-left:14px;'>Clear Plot - clears the plotted history (graph only)</div>"
-"</div>"
-        
-        "<div class='card'><div><b>Status</b>: <span id='running'>STOPPED</span></div></div>"
-        "<div class='card'>"
-        "<svg id='control_diagram' width='1600' height='420' viewBox='0 0 1600 420'>"
-        "<defs>"
-        "<marker id='arrow' markerWidth='10' markerHeight='7' refX='10' refY='3.5' orient='auto'>"
-        "<polygon points='0 0, 10 3.5, 0 7' fill='#222' />"
-        "</marker>"
-        "</defs>"
-        "<rect id='sp_block' class='diag-block' x='20' y='145' width='140' height='75'/>"
-        "<text class='diag-title' x='90' y='165' text-anchor='middle'>Setpoint reg</text>"
-        "<foreignObject x='30' y='172' width='120' height='34'>"
-        "<div xmlns='http://www.w3.org/1999/xhtml' style='display:flex;justify-content:center;'>"
-        "<input id='setpoint' value='200' style='width:80px;'/>"
-        "</div></foreignObject>"
-        "<rect id='master_block' class='diag-block master-border' x='20' y='240' width='140' height='140'/>"
-        "<text class='diag-title master-text' x='90' y='265' text-anchor='middle'>Master app control</text>"
-        "<rect id='master_value_box' class='diag-block master-box' x='40' y='290' width='100' height='30'/>"
-        "<text id='master_value' class='diag-text master-text' x='90' y='310' text-anchor='middle'>0</text>"
-        "<polyline id='line_master_to_switch' class='diag-line' points='160,290 215,290 215,205' marker-end='url(#arrow)'/>"
-        "<text class='diag-text' x='165' y='285'>m_r(t)</text>"
-        "<polyline id='line_master_to_sw1_dash' class='diag-line' points='160,310 230,310 230,205' style='stroke:#777;stroke-dasharray:4 3;'/>"
-        "<polyline id='line_master_to_sw2' class='diag-line' points='160,330 315,330 315,305' style='stroke:#777;stroke-dasharray:4 3;'/>"
-        "<line id='line_r' class='diag-line' x1='160' y1='180' x2='200' y2='180' marker-end='url(#arrow)'/>"
-        "<text class='diag-text' x='168' y='170'>r(t)</text>"
-        "<rect id='pre_block' class='diag-block switch-disabled' x='200' y='155' width='50' height='50'/>"
-        "<text class='diag-text' x='225' y='150' text-anchor='middle'>SW1</text>"
-        "<line id='pre_block_line' class='diag-line' x1='200' y1='180' x2='250' y2='180'></line>"
-        "<g id='diagram_shift' transform='translate(100 0)'>"
-        "<line id='line_r2' class='diag-line' x1='150' y1='180' x2='202' y2='180' marker-end='url(#arrow)'/>"
-        "<circle id='sum_block' class='diag-block' cx='230' cy='180' r='28'/>"
-        "<text class='diag-text' x='222' y='172'>+</text>"
-        "<text class='diag-text' x='222' y='202'>-</text>"
-        "<line id='line_e' class='diag-line' x1='258' y1='180' x2='290' y2='180' marker-end='url(#arrow)'/>"
-        "<text class='diag-text' x='266' y='170'>e(t)</text>"
-        "<rect id='pid_block' class='diag-block' x='290' y='120' width='260' height='120'/>"
-        "<text class='diag-title' x='420' y='148' text-anchor='middle'>PID controller</text>"
-        "<foreignObject x='295' y='160' width='250' height='50'>"
-        "<div xmlns='http://www.w3.org/1999/xhtml' style='display:flex;gap:0px;justify-content:center;align-items:flex-start;font-size:12px;'>"
-        "<div style='display:flex;flex-direction:column;align-items:center;'><div>Kp</div><input id='kp' value='0.000' style='width:45px;padding:6px;margin:2px;'/></div>"
-        "<div style='display:flex;flex-direction:column;align-items:center;'><div>Ki</div><input id='ki' value='0.000' style='width:45px;padding:6px;margin:2px;'/></div>"
-        "<div style='display:flex;flex-direction:column;align-items:center;'><div>Kd</div><input id='kd' value='0.000' style='width:45px;padding:6px;margin:2px;'/></div>"
-        "<div style='display:flex;flex-direction:column;align-items:center;'><div>dT (ms)</div><input id='dt' value='10' style='width:36px;padding:6px;margin:2px;'/></div>"
-        "</div></foreignObject>"
-        "<line id='line_u' class='diag-line' x1='550' y1='180' x2='600' y2='180' marker-end='url(#arrow)'/>"
-        "<text class='diag-text' x='555' y='170'>u(t)</text>"
-        "<rect id='act_block' class='diag-block' x='600' y='115' width='220' height='130'/>"
-        "<text class='diag-title' x='705' y='133' text-anchor='middle'>Actuator / FCE</text>"
-        "<foreignObject x='610' y='140' width='235' height='100'>"
-        "<div xmlns='http://www.w3.org/1999/xhtml' style='font-size:12px;line-height:1.2;'>"
-        "<label style='display:flex;align-items:center;gap:10px;margin:0 px;'>"
-        "<input type='checkbox' id='act_inject' style='width:22px;height:22px;flex:0 0 22px;margin:0;padding:0;border:0;box-sizing:border-box;' onchange='saveSettings();updateActuatorModeUI()'>"
-        "<span style='display:inline-block;line-height:22px;'>Inject energy</span>"
-        "</label>"
-        "<label style='display:flex;align-items:center;gap:8px;margin:6px 0 0 0;'>"
-        "<input type='checkbox' id='act_absorb' style='width:22px;height:22px;flex:0 0 22px;margin:0;padding:0;border:0;box-sizing:border-box;' onchange='saveSettings();updateActuatorModeUI()'>"
-        "<span style='display:inline-block;line-height:22px;'>Absorb energy</span>"
-        "</label>"
-        "<div style='margin-top:8px;display:flex;gap:6px;align-items:center;'>"
-        "<span>Min</span>"
-        "<input id='act_min' value='-100' style='width:50px;padding:6px;margin:2px;'/>"
-        "<span>Max</span>"
-        "<input id='act_max' value='100' style='width:50px;padding:6px;margin:2px;'/>"
-        "</div>"
-        "</div></foreignObject>"
-        "<line id='line_u1' class='diag-line' x1='820' y1='180' x2='870' y2='180' marker-end='url(#arrow)'/>"
-        "<text class='diag-text' x='825' y='170'>u1(t)</text>"
-        "<rect id='plant_block' class='diag-block' x='870' y='110' width='360' height='215'/>"
-        "<text class='diag-title' x='1050' y='128' text-anchor='middle'>Plant / Process</text>"
-        "<foreignObject x='885' y='134' width='330' height='180'>"
-        "<div xmlns='http://www.w3.org/1999/xhtml' style='font-size:12px;'>"
-        "<div style='display:flex;align-items:center;gap:8px;margin-bottom:4px;'><div style='font-weight:bold;'>Model</div><select id='model' style='width:240px;' onchange='updateModelUI();saveSettings()'><option value='0'>First order</option><option value='1' selected>Second order</option></select></div>"
-        "<div style='display:flex;gap:10px;flex-wrap:wrap;'>"
-        "<div id='row_gain' style='display:inline-flex;align-items:center;gap:6px;'>Gain <input id='gain' value='2.0' style='width:50px;padding:6px;margin:2px;'/></div>"
-        "<div id='row_tau' style='display:inline-flex;align-items:center;gap:6px;'>Tau <input id='tau' value='8.0' style='width:50px;padding:6px;margin:2px;'/></div>"
-        "<div id='row_wn' style='display:inline-flex;align-items:center;gap:6px;'>Wn <input id='wn' value='1.2' style='width:50px;padding:6px;margin:2px;'/></div>"
-        "<div id='row_zeta' style='display:inline-flex;align-items:center;gap:6px;'>Zeta <input id='zeta' value='0.7' style='width:50px;padding:6px;margin:2px;'/></div>"
-        "<div id='row_dead' style='display:inline-flex;align-items:center;gap:6px;'>Dead <input id='dead' value='0' style='width:50px;padding:6px;margin:2px;'/> ms</div>"
-        "</div>"
-        "<div style='border:2px solid #222;padding: 6px;margin-top: 6px;font-size: 12px;'><div id='tf_text'>Y(s)/U(s) = K*wn^2/(s^2+2*zeta*wn*s+wn^2) | K=5.00, wn=1.20, zeta=0.70</div></div>"
-        "</div></foreignObject>"
-        "<line id='line_y' class='diag-line' x1='1230' y1='180' x2='1300' y2='180' marker-end='url(#arrow)'/>"
-        "<text class='diag-text' x='1300' y='175'>y(t)</text>"
-        "<rect id='dist_block' class='diag-block' x='600' y='20' width='220' height='70'/>"
-        "<text class='diag-title' x='700' y='45' text-anchor='middle'>External disturbance</text>"
-        "<line id='line_pd1' class='diag-line' x1='820' y1='55' x2='1060' y2='55'/>"
-        "<line id='line_pd2' class='diag-line' x1='1060' y1='55' x2='1060' y2='110' marker-end='url(#arrow)'/>"
-        "<text class='diag-text' x='1070' y='80'>p(t)</text>"
-        "<rect id='sens_block' class='diag-block' x='600' y='320' width='220' height='70'/>"
-        "<text class='diag-title' x='705' y='342' text-anchor='middle'>Sensor</text>"
-        "<rect class='diag-block' x='698' y='352' width='22' height='22'/>"
-        "<text class='diag-text' x='709' y='368' text-anchor='middle'>1</text>"
-        "<line id='fb_down' class='diag-line' x1='1260' y1='180' x2='1260' y2='355'/>"
-        "<line id='fb_into_sensor' class='diag-line' x1='1260' y1='355' x2='820' y2='355' marker-end='url(#arrow)'/>"
-        "<line id='fb_out_sensor' class='diag-line' x1='600' y1='355' x2='230' y2='355'/>"
-        "<rect id='fb_switch' class='diag-block' x='205' y='260' width='50' height='50'/>"
-        "<text class='diag-text' x='275' y='290' text-anchor='middle'>SW2</text>"
-        "<line id='fb_switch_line' class='diag-line' x1='230' y1='260' x2='230' y2='310'/>"
-        "<text id='fb_switch_text' class='diag-text' x='230' y='286' text-anchor='middle' style='display:none;'>0</text>"
-        "<line id='fb_up_to_sw2' class='diag-line' x1='230' y1='260' x2='230' y2='208' marker-end='url(#arrow)'/>"
-        "<text class='diag-text' x='246' y='228'>y1(t)</text>"
-        "<line id='fb_up_to_sum' class='diag-line' x1='230' y1='355' x2='230' y2='310'/>"
-        "</g>"
-        "</svg>"
-        "<div class='controls'>"
-        "<div>Time window (s) <input id='window' type='number' min='10' step='10' value='100' onchange='setWindow();saveSettings()'></div>"
-        "<div>Plot W <input id='plot_w' type='number' min='300' step='10' value='1400' onchange='setPlotSize();saveSettings()'></div>"
-        "<div>Plot H <input id='plot_h' type='number' min='200' step='10' value='700' onchange='setPlotSize();saveSettings()'></div>"
-        "<button onclick='sendConfig()'>Apply</button>"
-        "<button id='btn_start' onclick='startSim()'>Start</button>"
-        "<button id='btn_stop' onclick='stopSim()'>Stop</button>"
-        "<button onclick='resetSim()'>Reset</button>"
-        "<button onclick='clearPlot()'>Clear Plot</button>"
-        "<button id='btn_help' onclick='toggleHelp()'>Help</button>"
-        "</div>"
-        "</div>"
-        "<div class='card'>"
-        "<div style='display:flex;gap:16px;align-items:center;flex-wrap:wrap;'>"
-        "<div><b>Time t</b>: <span id='time'>0</span> s</div>"
-        "<div><b>Output y(t)</b>: <span id='output'>0</span></div>"
-        "<div><b>Control u(t)</b>: <span id='control'>0</span></div>"
-        "<div><b>Actuator u1(t)</b>: <span id='actuator'>0</span></div>"
-        "</div>"
-        "</div>"
-        "<div class='card'>"
-        "<div style='display:flex;gap:20px;align-items:center;flex-wrap:wrap;justify-content:flex-start;'>"
-        "<div style='display:inline-flex;gap:8px;align-items:center;'>"
-        "<label style='display:inline-flex;gap:6px;align-items:center;margin:0;'><input type='checkbox' id='show_sp' checked onchange='saveSettings();draw()' style='margin:0;'>Setpoint</label>"
-        "<input type='color' id='color_sp' value='#000000' onchange='saveSettings();updateColorPickers();draw()' style='margin:0;width:28px;height:20px;'>"
-        "</div>"
-        "<div style='display:inline-flex;gap:8px;align-items:center;'>"
-        "<label style='display:inline-flex;gap:6px;align-items:center;margin:0;'><input type='checkbox' id='show_u' checked onchange='saveSettings();draw()' style='margin:0;'>Control u</label>"
-        "<input type='color' id='color_u' value='#9b9b9b' onchange='saveSettings();updateColorPickers();draw()' style='margin:0;width:28px;height:20px;'>"
-        "</div>"
-        "<div style='display:inline-flex;gap:8px;align-items:center;'>"
-        "<label style='display:inline-flex;gap:6px;align-items:center;margin:0;'><input type='checkbox' id='show_u1' checked onchange='saveSettings();draw()' style='margin:0;'>Actuator u1</label>"
-        "<input type='color' id='color_u1' value='#6abf4b' onchange='saveSettings();updateColorPickers();draw()' style='margin:0;width:28px;height:20px;'>"
-        "</div>"
-        "<div style='display:inline-flex;gap:8px;align-items:center;'>"
-        "<label style='display:inline-flex;gap:6px;align-items:center;margin:0;'><input type='checkbox' id='show_y' checked onchange='saveSettings();draw()' style='margin:0;'>Output y</label>"
-        "<input type='color' id='color_y' value='#b00000' onchange='saveSettings();updateColorPickers();draw()' style='margin:0;width:28px;height:20px;'>"
-        "</div>"
-        "</div>"
-        "<canvas id='plot' width='1400' height='700'></canvas>"
-        "</div>"
-        "<script src='/app.js'></script>"
-        "</body></html>");
-}/** Build the JavaScript application served at /app.js. */
-static void build_app_js(char *out, size_t out_len) {
-    snprintf(out, out_len,
-        "/* Sampling and history buffers for plotting. */"
-        "var sampleMs=200;var windowSec=100;var hist=500;var sp=[],y=[],u=[],u1=[];var synced=false;var tfPending=false;var runPending=false;var currentTime=0;var useMasterSetpoint=false;var allowSensSignal=true;"
-        "function q(id){return document.getElementById(id)}"
-        "function api(url,cb){"
-        "var x=new XMLHttpRequest();"
-        "x.onreadystatechange=function(){"
-        "if(x.readyState===4&&x.status===200){"
-        "try{cb(JSON.parse(x.responseText));}catch(e){}}};"
-        "x.open('GET',url,true);x.setRequestHeader('Cache-Control','no-cache');x.send();"
-        "}"
-        "/* Persist UI settings so a refresh keeps the same values. */"
-        "function saveSettings(){"
-        "var s={"
-        "setpoint:q('setpoint').value,"
-        "kp:q('kp').value,ki:q('ki').value,kd:q('kd').value,dt:q('dt').value,"
-        "model:q('model').value,gain:q('gain').value,tau:q('tau').value,"
-        "wn:q('wn').value,zeta:q('zeta').value,dead:q('dead').value,"
-        "act_min:q('act_min').value,act_max:q('act_max').value,"
-        "window:q('window').value,plot_w:q('plot_w').value,plot_h:q('plot_h').value,"
-        "show_sp:q('show_sp').checked,show_u:q('show_u').checked,show_u1:q('show_u1').checked,show_y:q('show_y').checked,"
-        "color_sp:q('color_sp').value,color_u:q('color_u').value,color_u1:q('color_u1').value,color_y:q('color_y').value,"
-        "act_inject:q('act_inject').checked,act_absorb:q('act_absorb').checked"
-        "};"
-        "try{localStorage.setItem('pid_settings',JSON.stringify(s));}catch(e){}"
-        "}"
-        "/* Restore UI settings if they were saved previously. */"
-        "function loadSettings(){"
-        "try{var raw=localStorage.getItem('pid_settings');if(!raw)return false;"
-        "var s=JSON.parse(raw);"
-        "if(s.setpoint!==undefined)q('setpoint').value=s.setpoint;"
-        "if(s.kp!==undefined)q('kp').value=s.kp;"
-        "if(s.ki!==undefined)q('ki').value=s.ki;"
-        "if(s.kd!==undefined)q('kd').value=s.kd;"
-        "if(s.dt!==undefined)q('dt').value=s.dt;"
-        "if(s.model!==undefined)q('model').value=s.model;"
-        "if(s.gain!==undefined)q('gain').value=s.gain;"
-        "if(s.tau!==undefined)q('tau').value=s.tau;"
-        "if(s.wn!==undefined)q('wn').value=s.wn;"
-        "if(s.zeta!==undefined)q('zeta').value=s.zeta;"
-        "if(s.dead!==undefined)q('dead').value=s.dead;"
-        "if(s.act_min!==undefined)q('act_min').value=s.act_min;"
-        "if(s.act_max!==undefined)q('act_max').value=s.act_max;"
-        "if(s.window!==undefined)q('window').value=s.window;"
-        "if(s.plot_w!==undefined)q('plot_w').value=s.plot_w;"
-        "if(s.plot_h!==undefined)q('plot_h').value=s.plot_h;"
-        "if(s.show_sp!==undefined)q('show_sp').checked=!!s.show_sp;"
-        "if(s.show_u!==undefined)q('show_u').checked=!!s.show_u;"
-        "if(s.show_u1!==undefined)q('show_u1').checked=!!s.show_u1;"
-        "if(s.show_y!==undefined)q('show_y').checked=!!s.show_y;"
-        "if(s.color_sp!==undefined)q('color_sp').value=s.color_sp;"
-        "if(s.color_u!==undefined)q('color_u').value=s.color_u;"
-        "if(s.color_u1!==undefined)q('color_u1').value=s.color_u1;"
-        "if(s.color_y!==undefined)q('color_y').value=s.color_y;"
-        "if(s.act_inject!==undefined)q('act_inject').checked=!!s.act_inject;"
-        "if(s.act_absorb!==undefined)q('act_absorb').checked=!!s.act_absorb;"
-        "updateColorPickers();"
-        "updateActuatorModeUI();"
-        "updateModelUI();"
-        "setWindow();setPlotSize();"
-        "return true;}catch(e){return false;}"
-        "}"
-        "/* Send configuration changes to the device. */"
-        "function sendConfig(){"
-        "var url='/api/set?setpoint='+encodeURIComponent(q('setpoint').value)"
-        "+'&kp='+encodeURIComponent(q('kp').value)"
-        "+'&ki='+encodeURIComponent(q('ki').value)"
-        "+'&kd='+encodeURIComponent(q('kd').value)"
-        "+'&dt='+encodeURIComponent(q('dt').value)"
-        "+'&model='+encodeURIComponent(q('model').value)"
-        "+'&gain='+encodeURIComponent(q('gain').value)"
-        "+'&tau='+encodeURIComponent(q('tau').value)"
-        "+'&wn='+encodeURIComponent(q('wn').value)"
-        "+'&zeta='+encodeURIComponent(q('zeta').value)"
-        "+'&dead='+encodeURIComponent(q('dead').value)"
-        "+'&act_min='+encodeURIComponent(q('act_min').value)"
-        "+'&act_max='+encodeURIComponent(q('act_max').value)"
-        "+'&act_inject='+(q('act_inject').checked?1:0)"
-        "+'&act_absorb='+(q('act_absorb').checked?1:0);"
-        "saveSettings();tfPending=true;runPending=true;api(url,function(d){"
-        "if(d&&tfPending){q('tf_text').textContent=transferText(d);tfPending=false;}"
-        "updateUI(d);});}"
-        "/* Recalculate history length when time window changes. */"
-        "function setWindow(){"
-        "var v=parseFloat(q('window').value);"
-        "if(isNaN(v)||v<2)v=2;"
-        "windowSec=v;"
-        "hist=Math.floor((windowSec*1000)/sampleMs)+1;"
-        "if(hist<10)hist=10;"
-        "while(sp.length>hist){sp.shift();y.shift();u.shift();u1.shift();}"
-        "}"
-        "function setPlotSize(){"
-        "var c=q('plot');"
-        "var w=parseInt(q('plot_w').value,10);"
-        "var h=parseInt(q('plot_h').value,10);"
-        "if(isNaN(w)||w<300)w=300;"
-        "if(isNaN(h)||h<200)h=200;"
-        "c.width=w;c.height=h;draw();"
-        "}"
-        "function startSim(){setRunButtonsState(true);runPending=true;api('/api/set?run=1',updateUI)}"
-        "function stopSim(){setRunButtonsState(false);runPending=true;api('/api/set?run=0',updateUI)}"
-        "function resetSim(){runPending=true;api('/api/set?reset=1',updateUI)}"
-        "/* Clear plotted history without changing configuration. */"
-        "function clearPlot(){sp=[];y=[];u=[];u1=[];draw();}"
-        "function toggleHelp(){"
-        "var p=q('help_panel');"
-        "var open=(p.style.display==='none'||p.style.display==='');"
-        "p.style.display=open?'block':'none';"
-        "setHelpButtonState(open);"
-        "}"
-        "function setHelpButtonState(open){"
-        "var b=q('btn_help');"
-        "if(!b)return;"
-        "if(open)b.classList.add('is-active');else b.classList.remove('is-active');"
-        "}"
-        "function setRunButtonsState(running){"
-        "var bs=q('btn_start');var bp=q('btn_stop');"
-        "if(bs){if(running)bs.classList.add('is-active');else bs.classList.remove('is-active');}"
-        "if(bp){if(running)bp.classList.remove('is-active');else bp.classList.add('is-active');}"
-        "}"
-        "function setSwitchLine(useMaster){"
-        "var line=q('pre_block_line');var block=q('pre_block');"
-        "if(!line||!block)return;"
-        "if(useMaster){"
-        "line.setAttribute('x1','215');line.setAttribute('y1','205');line.setAttribute('x2','250');line.setAttribute('y2','180');"
-        "block.classList.add('switch-disabled');block.classList.remove('switch-active');"
-        "}else{"
-        "line.setAttribute('x1','200');line.setAttribute('y1','180');line.setAttribute('x2','250');line.setAttribute('y2','180');"
-        "block.classList.remove('switch-disabled');block.classList.add('switch-active');"
-        "}"
-        "useMasterSetpoint=useMaster;"
-        "}"
-        "function toggleSetpointSource(){"
-        "var next=!useMasterSetpoint;"
-        "setSwitchLine(next);"
-        "api('/api/set?use_master='+(next?1:0),updateUI);"
-        "}"
-        "function setFeedbackSwitch(allow){"
-        "var line=q('fb_switch_line');var text=q('fb_switch_text');var block=q('fb_switch');"
-        "if(!line||!text||!block)return;"
-        "if(allow){"
-        "line.style.display='';text.style.display='none';block.classList.remove('switch-disabled');block.classList.add('switch-active');"
-        "}else{"
-        "line.style.display='none';text.style.display='';block.classList.remove('switch-active');block.classList.add('switch-disabled');"
-        "}"
-        "allowSensSignal=allow;"
-        "}"
-        "function toggleFeedbackSwitch(){"
-        "var next=!allowSensSignal;"
-        "setFeedbackSwitch(next);"
-        "api('/api/set?allow_sens='+(next?1:0),updateUI);"
-        "}"
-        "/* Sync incoming state into UI fields and plotting buffers. */"
-        "function updateUI(d){"
-        "if(!d)return;"
-        "if(runPending){q('running').textContent=d.running?'RUNNING':'STOPPED';runPending=false;}"
-        "setRunButtonsState(!!d.running);"
-        "updateModelUI();"
-        "currentTime=d.time||0;"
-        "q('time').textContent=d.time.toFixed(2);"
-        "q('output').textContent=d.output.toFixed(2);"
-        "q('control').textContent=d.control.toFixed(3);"
-        "q('actuator').textContent=d.actuator.toFixed(3);"
-        "if(q('master_value'))q('master_value').textContent=d.master_setpoint.toFixed(2);"
-        "useMasterSetpoint=!!d.use_master;"
-        "allowSensSignal=!!d.allow_sens;"
-        "if(!synced){"
-        "if(!loadSettings()){"
-        "q('setpoint').value=d.setpoint_cfg.toFixed(2);"
-        "q('kp').value=d.kp.toFixed(3);"
-        "q('ki').value=d.ki.toFixed(3);"
-        "q('kd').value=d.kd.toFixed(3);"
-        "q('dt').value=d.dt;"
-        "q('model').value=d.model.toString();"
-        "q('gain').value=d.gain.toFixed(2);"
-        "q('tau').value=d.tau.toFixed(2);"
-        "q('wn').value=d.wn.toFixed(2);"
-        "q('zeta').value=d.zeta.toFixed(2);"
-        "q('dead').value=d.dead;"
-        "q('act_min').value=d.act_min.toFixed(2);"
-        "q('act_max').value=d.act_max.toFixed(2);"
-        "q('act_inject').checked=!!d.act_inject;"
-        "q('act_absorb').checked=!!d.act_absorb;"
-        "setWindow();setPlotSize();"
-        "}"
-        "synced=true;"
-        "}"
-        "sp.push(d.setpoint);y.push(d.output);u.push(d.control);u1.push(d.actuator);"
-        "if(sp.length>hist){sp.shift();y.shift();u.shift();u1.shift();}"
-        "updateActuatorModeUI();"
-        "setSwitchLine(useMasterSetpoint);"
-        "setFeedbackSwitch(allowSensSignal);"
-        "draw();}"
-        "/* Build a readable transfer function string. */"
-        "function transferText(d){"
-        "if(d.model===0){"
-        "var eq='Y(s)/U(s) = K/(tau*s+1)';"
-        "eq+=' | K='+d.gain.toFixed(2)+', tau='+d.tau.toFixed(2);"
-        "return eq;"
-        "}"
-        "var eq='Y(s)/U(s) = K*wn^2/(s^2+2*zeta*wn*s+wn^2)';"
-        "eq+=' | K='+d.gain.toFixed(2)+', wn='+d.wn.toFixed(2)+', zeta='+d.zeta.toFixed(2);"
-        "return eq;"
-        "}"
-        "/* Show only the parameters relevant to the selected model. */"
-        "function updateModelUI(){"
-        "var firstOrder=(q('model').value==='0');"
-        "q('row_tau').style.display=firstOrder?'inline-flex':'none';"
-        "q('row_wn').style.display=firstOrder?'none':'inline-flex';"
-        "q('row_zeta').style.display=firstOrder?'none':'inline-flex';"
-        "}"
-        "/* Highlight actuator block based on inject/absorb selection. */"
-        "function updateActuatorModeUI(){"
-        "var inject=q('act_inject').checked;"
-        "var absorb=q('act_absorb').checked;"
-        "var block=q('act_block');"
-        "if(!block)return;"
-        "var fill='#f3ffeeff';"
-        "if(inject&&!absorb)fill='#fffce4ff';"
-        "else if(!inject&&absorb)fill='#f0f8ffff';"
-        "else if(!inject&&!absorb)fill='#ffbabaff';"
-        "block.style.fill=fill;"
-        "}"
-        "/* Keep color pickers filled with their selected color. */"
-        "function updateColorPickers(){"
-        "q('color_sp').style.background=q('color_sp').value;"
-        "q('color_u').style.background=q('color_u').value;"
-        "q('color_u1').style.background=q('color_u1').value;"
-        "q('color_y').style.background=q('color_y').value;"
-        "}"
-        "/* Redraw the plot using the current buffers and toggles. */"
-        "function draw(){"
-        "var c=q('plot');var ctx=c.getContext('2d');"
-        "var padL=36,padR=8,padT=8,padB=22;"
-        "var w=c.width-padL-padR;var h=c.height-padT-padB;"
-        "var inset=0.10*h;"
-        "ctx.clearRect(0,0,c.width,c.height);"
-        "ctx.strokeStyle='#222';ctx.strokeRect(padL,padT,w,h);"
-        "var series=[];"
-        "if(q('show_sp').checked)series.push(sp);"
-        "if(q('show_u').checked)series.push(u);"
-        "if(q('show_u1').checked)series.push(u1);"
-        "if(q('show_y').checked)series.push(y);"
-        "var vals=[];for(var si=0;si<series.length;si++){vals=vals.concat(series[si]);}"
-        "if(vals.length===0){vals=[0,1];}"
-        "var max=Math.max.apply(null,vals);"
-        "var min=Math.min.apply(null,vals);"
-        "var range=(max-min)||1;"
-        "ctx.fillStyle='#222';ctx.font='10px Arial';"
-        "ctx.fillText('Temp',2,padT+10);"
-        "for(var i=0;i<=4;i++){"
-        "var ty=padT+inset+(1-(i/4))*(h-2*inset);"
-        "var val=(min+(i/4)*range).toFixed(0);"
-        "ctx.fillText(val,2,ty+3);"
-        "ctx.strokeStyle='#edededff';ctx.beginPath();ctx.moveTo(padL,ty);ctx.lineTo(padL+w,ty);ctx.stroke();"
-        "}"
-        "var t0=(currentTime-windowSec);if(t0<0)t0=0;"
-        "ctx.fillStyle='#222';"
-        "ctx.fillText('t0='+t0.toFixed(1)+'s',padL,padT+h+14);"
-        "ctx.fillText('t='+currentTime.toFixed(1)+'s',padL+w-46,padT+h+14);"
-        "function plot(arr,color){ctx.strokeStyle=color;ctx.beginPath();"
-        "for(var i=0;i<arr.length;i++){var x=padL+i*(w/(hist-1));"
-        "var ypix=padT+inset+(1-((arr[i]-min)/range))*(h-2*inset);"
-        "if(i===0)ctx.moveTo(x,ypix);else ctx.lineTo(x,ypix);}ctx.stroke();}"
-        "if(q('show_sp').checked)plot(sp,q('color_sp').value||'#000');"
-        "if(q('show_u').checked)plot(u,q('color_u').value||'#9b9b9b');"
-        "if(q('show_u1').checked)plot(u1,q('color_u1').value||'#6abf4b');"
-        "if(q('show_y').checked)plot(y,q('color_y').value||'#b00');}"
-        "setWindow();setPlotSize();"
-        "updateModelUI();"
-        "setSwitchLine(useMasterSetpoint);setFeedbackSwitch(allowSensSignal);"
-        "var switchBlock=q('pre_block');if(switchBlock){switchBlock.addEventListener('click',toggleSetpointSource);}"
-        "var feedbackSwitch=q('fb_switch');if(feedbackSwitch){feedbackSwitch.addEventListener('click',toggleFeedbackSwitch);}"
-        "api('/api/state',updateUI);"
-        "setInterval(function(){api('/api/state?t='+(new Date().getTime()),updateUI);},200);");
+/**
+ * Build the JSON response with all telemetry samples newer than since.
+ * Samples are [t, r, u, u1, y]; "more" is set when the body filled up first.
+ * Returns the sequence number of the newest sample written.
+ */
+static uint32_t build_history_json(char *out, size_t out_len, uint32_t since) {
+    telemetry_sample_t chunk[HISTORY_CHUNK];
+    uint32_t dropped_total = 0;
+    uint32_t last = since;
+    int more = 0;
+    int first = 1;
+
+    /* Reserve room for the closing fields written after the samples. */
+    const size_t tail_room = 64;
+    size_t pos = (size_t)snprintf(out, out_len, "{\"samples\":[");
+
+    while (!more) {
+        uint32_t dropped = 0;
+        size_t n = telemetry_read_since(last, chunk, HISTORY_CHUNK, &dropped);
+        dropped_total += dropped;
+        if (n == 0) break;
+        for (size_t i = 0; i < n; i++) {
+            const telemetry_sample_t *s = &chunk[i];
+            char item[96];
+            int len = snprintf(item, sizeof(item), "%s[%.3f,%.2f,%.3f,%.3f,%.2f]",
+                               first ? "" : ",",
+                               s->time_s, s->setpoint, s->control, s->actuator, s->output);
+            if (len < 0 || pos + (size_t)len + tail_room >= out_len) {
+                more = 1;
+                break;
+            }
+            memcpy(out + pos, item, (size_t)len);
+            pos += (size_t)len;
+            last = s->seq;
+            first = 0;
+        }
+    }
+
+    snprintf(out + pos, out_len - pos, "],\"last\":%u,\"dropped\":%u,\"more\":%d}",
+             (unsigned)last, (unsigned)dropped_total, more);
+    return last;
+}
+
+/**
+ * Build the JSON response for the batch engine. Without an id it lists the
+ * latest tick of every enabled instance as [id, r, u, u1, y]; with an id
+ * it reports that instance's configuration and latest tick. The dead-time
+ * ring holds SIM_BATCH_DELAY - 1 ticks: dead_max is the longest dead time
+ * at the current dt, dead_eff the one an instance runs with, and limited
+ * counts the enabled instances cut short.
+ */
+static void build_batch_json(char *out, size_t out_len, int id) {
+    static sim_batch_runtime_t rt;
+    sim_batch_get_runtime(&rt);
+    sim_config_t cfg = sim_state_get_config();
+    int dt_us = sim_loop_dt_us(&cfg);
+    int limited = 0;
+    for (int i = 0; i < SIM_BATCH_MAX; i++) {
+        sim_batch_config_t c = sim_batch_get_config(i);
+        if (c.enabled && sim_batch_dead_ms(c.dead_time_ms, dt_us) < (float)c.dead_time_ms) limited++;
+    }
+
+    size_t pos = (size_t)snprintf(out, out_len,
+        "{\"max\":%d,\"count\":%d,\"time\":%.2f,\"step_us\":%u,\"step_max_us\":%u,"
+        "\"dead_max\":%.1f,\"limited\":%d,",
+        SIM_BATCH_MAX, rt.count, rt.time_s, (unsigned)rt.step_us, (unsigned)rt.step_max_us,
+        sim_batch_dead_ms(DELAY_MAX_DEAD_MS, dt_us), limited);
+
+    if (id >= 0 && id < SIM_BATCH_MAX) {
+        sim_batch_config_t c = sim_batch_get_config(id);
+        sim_batch_sample_t s = {0};
+        if (c.enabled && id < rt.count) s = rt.loop[id];
+        snprintf(out + pos, out_len - pos,
+            "\"loop\":{\"id\":%d,\"en\":%d,\"setpoint\":%.2f,\"kp\":%.3f,\"ki\":%.3f,\"kd\":%.3f,"
+            "\"model\":%d,\"gain\":%.2f,\"tau\":%.2f,\"wn\":%.2f,\"zeta\":%.2f,\"dead\":%d,"
+            "\"dead_eff\":%.1f,\"zoh\":%d,\"act_min\":%.2f,\"act_max\":%.2f,"
+            "\"r\":%.2f,\"u\":%.3f,\"u1\":%.3f,\"y\":%.2f}}",
+            id, c.enabled, c.setpoint, c.pid.kp, c.pid.ki, c.pid.kd,
+            (int)c.model, c.gain, c.tau, c.wn, c.zeta, c.dead_time_ms,
+            sim_batch_dead_ms(c.dead_time_ms, dt_us), c.method == PLANT_METHOD_ZOH, c.act_min, c.act_max,
+            s.setpoint, s.control, s.actuator, s.output);
+        return;
+    }
+
+    const size_t tail_room = 4;
+    int first = 1;
+    pos += (size_t)snprintf(out + pos, out_len - pos, "\"loops\":[");
+    for (int i = 0; i < rt.count; i++) {
+        if (!sim_batch_get_config(i).enabled) continue;
+        const sim_batch_sample_t *s = &rt.loop[i];
+        char item[96];
+        int len = snprintf(item, sizeof(item), "%s[%d,%.2f,%.3f,%.3f,%.2f]",
+                           first ? "" : ",", i, s->setpoint, s->control, s->actuator, s->output);
+        if (len < 0 || pos + (size_t)len + tail_room >= out_len) break;
+        memcpy(out + pos, item, (size_t)len);
+        pos += (size_t)len;
+        first = 0;
+    }
+    snprintf(out + pos, out_len - pos, "]}");
 }
 
+/** Find the embedded UI file for a path (the page is served for unknown paths). */
+static const web_asset_t *find_asset(const char *path) {
+    size_t len = strcspn(path, "?");
+    for (size_t i = 0; i < g_web_asset_count; i++) {
+        const char *p = g_web_assets[i].path;
+        if (strlen(p) == len && strncmp(path, p, len) == 0) return &g_web_assets[i];
+    }
+    return &g_web_assets[0];
+}
+
+/* Routes as counted by /metrics; the API routes are matched by prefix, in this order. */
+typedef enum {
+    HTTP_ROUTE_NONE = 0, // rejected before the request was read
+    HTTP_ROUTE_ASSET,
+    HTTP_ROUTE_WS,
+    HTTP_ROUTE_STREAM,
+    HTTP_ROUTE_SET,
+    HTTP_ROUTE_HISTORY,
+    HTTP_ROUTE_AUTOTUNE,
+    HTTP_ROUTE_SIMULATE,
+    HTTP_ROUTE_API_METRICS,
+    HTTP_ROUTE_SERVER,
+    HTTP_ROUTE_SWEEP,
+    HTTP_ROUTE_BATCH,
+    HTTP_ROUTE_RECORD,
+    HTTP_ROUTE_PROFILE,
+    HTTP_ROUTE_STATE, // /api/state and any other /api/ path
+    HTTP_ROUTE_METRICS,
+    HTTP_ROUTE_COUNT
+} http_route_t;
+
+static const char *const k_http_routes[HTTP_ROUTE_COUNT] = {
+    [HTTP_ROUTE_NONE] = "none",
+    [HTTP_ROUTE_ASSET] = "asset",
+    [HTTP_ROUTE_WS] = "/ws",
+    [HTTP_ROUTE_STREAM] = "/api/stream",
+    [HTTP_ROUTE_SET] = "/api/set",
+    [HTTP_ROUTE_HISTORY] = "/api/history",
+    [HTTP_ROUTE_AUTOTUNE] = "/api/autotune",
+    [HTTP_ROUTE_SIMULATE] = "/api/simulate",
+    [HTTP_ROUTE_API_METRICS] = "/api/metrics",
+    [HTTP_ROUTE_SERVER] = "/api/server",
+    [HTTP_ROUTE_SWEEP] = "/api/sweep",
+    [HTTP_ROUTE_BATCH] = "/api/batch",
+    [HTTP_ROUTE_RECORD] = "/api/record",
+    [HTTP_ROUTE_PROFILE] = "/api/profile",
+    [HTTP_ROUTE_STATE] = "/api/state",
+    [HTTP_ROUTE_METRICS] = "/metrics",
+};
+
+typedef struct {
+    uint32_t requests;
+    uint32_t responses; // responses queued (including 304) and streams started
+    uint32_t rejected; // answered with 503
+} http_route_stats_t;
+
+static http_route_stats_t g_route_stats[HTTP_ROUTE_COUNT];
+
+/** Route of a request path; ws_upgrade is set for a WebSocket handshake on /ws. */
+static http_route_t http_route_of(const char *path, int ws_upgrade) {
+    if (ws_upgrade) return HTTP_ROUTE_WS;
+    size_t len = strcspn(path, "?");
+    if (len == 8 && strncmp(path, "/metrics", 8) == 0) return HTTP_ROUTE_METRICS;
+    if (strncmp(path, "/api/", 5) != 0) return HTTP_ROUTE_ASSET;
+    for (int r = HTTP_ROUTE_STREAM; r < HTTP_ROUTE_STATE; r++) {
+        if (strncmp(path, k_http_routes[r], strlen(k_http_routes[r])) == 0) return (http_route_t)r;
+    }
+    return HTTP_ROUTE_STATE;
+}
+
+/** Write body part `part` into out; returns its length, 0 after the last part, HTTP_BODY_FAILED to abort. */
+typedef size_t (*http_body_fn)(int part, char *out, size_t out_len);
+
 typedef struct {
     struct tcp_pcb *pcb;
     size_t header_len;
     size_t body_len;
     size_t offset;
     int active;
+    const char *body_src; // body or a const asset in flash (sent without copying)
+    http_body_fn body_fn; // generates the body part by part into body; NULL once complete
+    int part; // next part for body_fn
+    int chunked; // frame the parts with chunked transfer coding
+    int failed; // flag: body_fn failed; http_poll() aborts the connection
     char header[256];
-    char body[16384];
+    char body[HTTP_BODY_SIZE];
 } http_response_t;
 
-static http_response_t g_resp;
+typedef struct http_conn {
+    struct tcp_pcb *pcb;
+    http_response_t *resp; // response being queued, NULL between requests
+    int active;
+    int keep_alive; // keep the connection open once resp is queued
+    int job; // flag: waiting for the offline job in g_job
+    size_t body_left; // bytes of an upload body still to be received
+    int idle_polls; // tcp_poll intervals without receive or send progress
+    uint32_t requests; // requests answered on this connection
+    size_t rx_len;
+    char rx[HTTP_RX_SIZE]; // received bytes not handled yet
+} http_conn_t;
+
+typedef struct {
+    uint32_t in_use; // slots currently sending a response
+    uint32_t peak; // highest in_use seen
+    uint32_t served; // responses queued from a slot
+    uint32_t rejected; // requests answered with 503 (no free slot)
+    uint32_t timeouts; // slots aborted after HTTP_SLOT_TIMEOUT_POLLS without progress
+    uint32_t write_errors; // tcp_write failures other than a full send queue
+    uint32_t write_full; // tcp_write calls refused with ERR_MEM (resumed from tcp_sent)
+    uint64_t bytes_sent; // header and body bytes queued
+    uint32_t reused; // requests answered on an already used connection
+    uint32_t idle_closes; // keep-alive connections closed after HTTP_IDLE_TIMEOUT_POLLS
+    uint32_t evicted; // idle connections closed to make room for a new one
+} http_pool_stats_t;
+
+static http_response_t g_resp_pool[HTTP_MAX_CONNS];
+static http_conn_t g_conn_pool[HTTP_MAX_CLIENTS];
+static http_pool_stats_t g_pool_stats;
 
-/** Send as much as possible; continue via tcp_sent when more buffer is available. */
+/** Claim a free response slot for the connection; NULL if the pool is exhausted. */
+static http_response_t *http_slot_alloc(struct tcp_pcb *pcb) {
+    for (int i = 0; i < HTTP_MAX_CONNS; i++) {
+        http_response_t *r = &g_resp_pool[i];
+        if (!r->active) {
+            r->pcb = pcb;
+            r->offset = 0;
+            r->body_fn = NULL;
+            r->failed = 0;
+            r->active = 1;
+            g_pool_stats.in_use++;
+            if (g_pool_stats.in_use > g_pool_stats.peak) g_pool_stats.peak = g_pool_stats.in_use;
+            return r;
+        }
+    }
+    return NULL;
+}
+
+/** Return a slot to the pool. */
+static void http_slot_free(http_response_t *r) {
+    if (!r->active) return;
+    r->active = 0;
+    r->pcb = NULL;
+    g_pool_stats.in_use--;
+}
+
+/**
+ * Generate the next body part into r->body once the previous one is queued
+ * (tcp_write copied it). With chunked coding each part is one chunk and the
+ * end is marked by the zero-length chunk.
+ */
+static void http_next_part(http_response_t *r) {
+    size_t head = r->chunked ? HTTP_CHUNK_HEAD : 0;
+    size_t len = r->body_fn(r->part++, r->body + head, sizeof(r->body) - head - 2);
+    if (len == HTTP_BODY_FAILED) {
+        r->body_fn = NULL;
+        r->failed = 1;
+        len = 0;
+    } else if (len == 0) {
+        r->body_fn = NULL;
+        len = r->chunked ? (size_t)snprintf(r->body, sizeof(r->body), "0\r\n\r\n") : 0;
+    } else if (r->chunked) {
+        char size[HTTP_CHUNK_HEAD + 1];
+        snprintf(size, sizeof(size), "%04x\r\n", (unsigned)len);
+        memcpy(r->body, size, HTTP_CHUNK_HEAD);
+        memcpy(r->body + head + len, "\r\n", 2);
+        len += head + 2;
+    }
+    r->body_len = len;
+    r->offset = r->header_len;
+}
+
+/**
+ * Queue as much of the response as the send buffer takes, in MSS-sized
+ * writes; continue via tcp_sent when more buffer is available. The caller
+ * flushes with a single tcp_output(). Returns 1 once everything is queued.
+ */
 static int http_send_more(http_response_t *r) {
-    while (r->offset < r->header_len + r->body_len) {
-        u16_t snd = tcp_sndbuf(r->pcb);
-        if (snd == 0) {
-            return 0;
-        }
-        size_t to_write = r->header_len + r->body_len - r->offset;
-        if (to_write > snd) to_write = snd;
-        if (to_write > 256) to_write = 256;
-
-        const char *src;
-        size_t src_off;
-        if (r->offset < r->header_len) {
-            src = r->header;
-            src_off = r->offset;
-        } else {
-            src = r->body;
-            src_off = r->offset - r->header_len;
+    u16_t mss = tcp_mss(r->pcb);
+    if (mss == 0) mss = TCP_MSS;
+
+    for (;;) {
+        size_t total = r->header_len + r->body_len;
+        while (r->offset < total) {
+            u16_t snd = tcp_sndbuf(r->pcb);
+            if (snd == 0 || tcp_sndqueuelen(r->pcb) >= TCP_SND_QUEUELEN) {
+                return 0;
+            }
+
+            const char *src;
+            size_t avail;
+            if (r->offset < r->header_len) {
+                src = r->header + r->offset;
+                avail = r->header_len - r->offset;
+            } else {
+                src = r->body_src + (r->offset - r->header_len);
+                avail = total - r->offset;
+            }
+            size_t to_write = avail;
+            if (to_write > snd) to_write = snd;
+            if (to_write > mss) to_write = mss;
+
+            /* Flash-resident assets stay valid, so lwIP can reference them in place. */
+            u8_t flags = (r->offset >= r->header_len && r->body_src != r->body) ? 0 : TCP_WRITE_FLAG_COPY;
+            if (r->offset + to_write < total || r->body_fn) flags |= TCP_WRITE_FLAG_MORE;
+
+            err_t err = tcp_write(r->pcb, src, (u16_t)to_write, flags);
+            if (err == ERR_MEM) {
+                g_pool_stats.write_full++;
+                return 0; // queue full; resume from http_sent
+            }
+            if (err != ERR_OK) {
+                DLOGW("tcp_write failed: %d (offset=%u)\n", err, (unsigned)r->offset);
+                g_pool_stats.write_errors++;
+                return 0;
+            }
+            r->offset += to_write;
+            g_pool_stats.bytes_sent += to_write;
         }
-        size_t avail = (src == r->header) ? (r->header_len - src_off) : (r->body_len - src_off);
-        if (to_write > avail) to_write = avail;
+        if (r->failed) return 0; // never complete: a short body must not look like a whole one
+        if (!r->body_fn) return 1;
+        http_next_part(r);
+    }
+}
 
-        err_t err = tcp_write(r->pcb, src + src_off, to_write, TCP_WRITE_FLAG_COPY);
-        if (err != ERR_OK) {
-            LOGW("tcp_write failed: %d (offset=%u)\n", err, (unsigned)r->offset);
-            return 0;
+/** Claim connection state, closing the longest idle keep-alive connection if all are taken. */
+static http_conn_t *http_conn_alloc(struct tcp_pcb *pcb) {
+    http_conn_t *c = NULL;
+    http_conn_t *idle = NULL;
+    for (int i = 0; i < HTTP_MAX_CLIENTS && !c; i++) {
+        http_conn_t *k = &g_conn_pool[i];
+        if (!k->active) {
+            c = k;
+        } else if (!k->resp && k->rx_len == 0 && (!idle || k->idle_polls > idle->idle_polls)) {
+            idle = k;
         }
-        r->offset += to_write;
     }
-    return 1;
+    if (!c && idle) {
+        LOGD("HTTP evicting idle connection\n");
+        g_pool_stats.evicted++;
+        struct tcp_pcb *old = idle->pcb;
+        tcp_arg(old, NULL);
+        tcp_recv(old, NULL);
+        tcp_sent(old, NULL);
+        tcp_poll(old, NULL, 0);
+        idle->active = 0;
+        tcp_close(old);
+        c = idle;
+    }
+    if (!c) return NULL;
+
+    c->pcb = pcb;
+    c->resp = NULL;
+    c->keep_alive = 0;
+    c->idle_polls = 0;
+    c->requests = 0;
+    c->rx_len = 0;
+    c->body_left = 0;
+    c->active = 1;
+    return c;
+}
+
+/** Free what the connection holds: an upload in progress, a pending job and the response slot. */
+static void http_conn_free(http_conn_t *c) {
+    if (c->body_left) {
+        /* Dropped mid-upload: the short image is rejected and the recorder freed. */
+        sim_record_upload_end();
+        c->body_left = 0;
+    }
+    if (c->job) {
+        /* The job runs to its end (returning its pooled storage); nobody is answered. */
+        g_job.conn = NULL;
+        c->job = 0;
+    }
+    if (c->resp) {
+        http_slot_free(c->resp);
+        c->resp = NULL;
+    }
+}
+
+/** Drop the connection state and detach the HTTP callbacks from its pcb. */
+static void http_conn_release(http_conn_t *c) {
+    http_conn_free(c);
+    tcp_arg(c->pcb, NULL);
+    tcp_sent(c->pcb, NULL);
+    tcp_poll(c->pcb, NULL, 0);
+    c->pcb = NULL;
+    c->active = 0;
+}
+
+/** Close gracefully; data already queued is still delivered. */
+static void http_conn_close(http_conn_t *c) {
+    struct tcp_pcb *pcb = c->pcb;
+    http_conn_release(c);
+    tcp_recv(pcb, NULL);
+    tcp_close(pcb);
+}
+
+static void http_process(http_conn_t *c);
+
+/** The response is fully queued: free its slot, then close or wait for the next request. */
+static void http_response_done(http_conn_t *c) {
+    http_slot_free(c->resp);
+    c->resp = NULL;
+    c->idle_polls = 0;
+    if (!c->keep_alive) {
+        http_conn_close(c);
+    }
 }
 
 static err_t http_sent(void *arg, struct tcp_pcb *tpcb, u16_t len) {
     (void)len;
-    http_response_t *r = (http_response_t *)arg;
-    if (!r || r->pcb != tpcb) {
+    http_conn_t *c = (http_conn_t *)arg;
+    if (!c || c->pcb != tpcb) {
         return ERR_OK;
     }
-    if (http_send_more(r)) {
+    c->idle_polls = 0;
+    if (c->resp && http_send_more(c->resp)) {
         tcp_output(tpcb);
+        http_response_done(c);
+        if (c->active) {
+            http_process(c); // answer requests pipelined behind this one
+        }
+    }
+    return ERR_OK;
+}
+
+static void http_err(void *arg, err_t err) {
+    (void)err;
+    http_conn_t *c = (http_conn_t *)arg;
+    if (c) {
+        http_conn_free(c); // lwIP already freed the pcb
+        c->pcb = NULL;
+        c->active = 0;
     }
-    if (r->offset >= r->header_len + r->body_len) {
+}
+
+/**
+ * Abort a connection whose response body failed, or made no progress for
+ * HTTP_SLOT_TIMEOUT_POLLS intervals; close an idle keep-alive connection
+ * after HTTP_IDLE_TIMEOUT_POLLS.
+ */
+static err_t http_poll(void *arg, struct tcp_pcb *tpcb) {
+    http_conn_t *c = (http_conn_t *)arg;
+    if (!c || c->pcb != tpcb) {
+        return ERR_OK;
+    }
+    c->idle_polls++;
+    if (c->resp) {
+        if (c->resp->failed) {
+            DLOGW("HTTP body source gone (offset=%u), aborting\n", (unsigned)c->resp->offset);
+        } else if (c->idle_polls < HTTP_SLOT_TIMEOUT_POLLS) {
+            return ERR_OK;
+        } else {
+            DLOGW("HTTP slot timeout (offset=%u)\n", (unsigned)c->resp->offset);
+            g_pool_stats.timeouts++;
+        }
+        http_conn_release(c);
+        tcp_abort(tpcb);
+        return ERR_ABRT;
+    }
+    if (c->idle_polls >= HTTP_IDLE_TIMEOUT_POLLS && !c->job) {
+        LOGD("HTTP keep-alive idle, closing\n");
+        g_pool_stats.idle_closes++;
+        http_conn_close(c);
+    }
+    return ERR_OK;
+}
+
+typedef enum {
+    STREAM_SSE = 0,
+    STREAM_WS = 1
+} stream_kind_t;
+
+typedef struct {
+    struct tcp_pcb *pcb;
+    stream_kind_t kind;
+    uint32_t last_seq; // newest telemetry sample already sent
+    uint32_t period_ms; // push period, 0 = no telemetry (WebSocket control only)
+    uint32_t state_elapsed_ms; // time since the last state event
+    int active;
+    size_t rx_len; // buffered WebSocket bytes
+    uint8_t rx[WS_RX_BUF];
+} stream_client_t;
+
+static stream_client_t g_stream[STREAM_MAX_CLIENTS];
+static char g_stream_buf[TCP_MSS]; // one whole SSE event or WebSocket frame, framing included
+
+#define WS_HEAD_ROOM 4 // longest frame header we send (payload < 64 KiB)
+
+static void stream_tick(void *arg);
+
+/** Detach and close a long-lived (SSE or WebSocket) connection. */
+static err_t stream_close(stream_client_t *c) {
+    err_t ret = ERR_OK;
+    sys_untimeout(stream_tick, c);
+    if (c->pcb) {
+        tcp_arg(c->pcb, NULL);
+        tcp_recv(c->pcb, NULL);
+        tcp_err(c->pcb, NULL);
+        if (tcp_close(c->pcb) != ERR_OK) {
+            tcp_abort(c->pcb);
+            ret = ERR_ABRT;
+        }
+    }
+    c->pcb = NULL;
+    c->active = 0;
+    return ret;
+}
+
+/**
+ * Queue a whole event or frame with one tcp_write(), or nothing: a write
+ * split over several calls could fail halfway and leave a fragment that
+ * corrupts the stream for the client.
+ */
+static int stream_write(stream_client_t *c, const void *data, size_t len) {
+    if (tcp_sndbuf(c->pcb) < len || tcp_sndqueuelen(c->pcb) >= TCP_SND_QUEUELEN) return 0;
+    return tcp_write(c->pcb, data, (u16_t)len, TCP_WRITE_FLAG_COPY) == ERR_OK;
+}
+
+/** Start an SSE event in g_stream_buf; the payload goes at the returned offset. */
+static size_t sse_event_head(const char *name) {
+    return (size_t)snprintf(g_stream_buf, sizeof(g_stream_buf), "event: %s\ndata: ", name);
+}
+
+/** Room for the payload of an event started with sse_event_head(). */
+static size_t sse_event_room(size_t head) {
+    return sizeof(g_stream_buf) - head - 2;
+}
+
+/** Close the event in g_stream_buf (head + payload bytes) with "\n\n" and queue it. */
+static int sse_send_event(stream_client_t *c, size_t len) {
+    memcpy(g_stream_buf + len, "\n\n", 2);
+    return stream_write(c, g_stream_buf, len + 2);
+}
+
+/** Payload area of a WebSocket frame built in place in g_stream_buf. */
+static uint8_t *ws_frame_payload(void) {
+    return (uint8_t *)g_stream_buf + WS_HEAD_ROOM;
+}
+
+/** Queue one unmasked WebSocket frame; payload may already be at ws_frame_payload(). */
+static int ws_write_frame(stream_client_t *c, uint8_t opcode, const void *payload, size_t payload_len) {
+    uint8_t *frame = ws_frame_payload();
+    if (payload_len > sizeof(g_stream_buf) - WS_HEAD_ROOM) return 0;
+    if (payload != frame) memmove(frame, payload, payload_len);
+    uint8_t head[WS_HEAD_ROOM];
+    size_t head_len = ws_frame_header(head, opcode, payload_len);
+    frame -= head_len;
+    memcpy(frame, head, head_len);
+    return stream_write(c, frame, head_len + payload_len);
+}
+
+/** Send the state JSON as a WebSocket text frame. */
+static void ws_send_state(stream_client_t *c) {
+    char *json = (char *)ws_frame_payload();
+    build_state_json(json, sizeof(g_stream_buf) - WS_HEAD_ROOM);
+    ws_write_frame(c, WS_OP_TEXT, json, strlen(json));
+}
+
+/**
+ * Pack contiguous new samples into a binary telemetry message:
+ * u8 type (WS_MSG_SAMPLES), u8 count, u32 first seq, then count x
+ * {t, r, u, u1, y} as float32. All fields little-endian (native on RP2040).
+ */
+static void ws_push_samples(stream_client_t *c) {
+    telemetry_sample_t chunk[WS_MAX_SAMPLES];
+    uint32_t dropped = 0;
+    size_t room = tcp_sndbuf(c->pcb);
+    if (room > sizeof(g_stream_buf)) room = sizeof(g_stream_buf);
+    if (room < WS_HEAD_ROOM + 6 + 20) return;
+    size_t max = (room - WS_HEAD_ROOM - 6) / 20;
+    if (max > WS_MAX_SAMPLES) max = WS_MAX_SAMPLES;
+
+    size_t n = telemetry_read_since(c->last_seq, chunk, max, &dropped);
+    if (n == 0) return;
+    /* Stop at the first gap so "first seq + index" stays exact. */
+    size_t count = 1;
+    while (count < n && chunk[count].seq == chunk[0].seq + count) count++;
+
+    uint8_t *out = ws_frame_payload();
+    out[0] = WS_MSG_SAMPLES;
+    out[1] = (uint8_t)count;
+    memcpy(out + 2, &chunk[0].seq, 4);
+    size_t pos = 6;
+    for (size_t i = 0; i < count; i++) {
+        memcpy(out + pos, &chunk[i].time_s, 20);
+        pos += 20;
+    }
+    if (ws_write_frame(c, WS_OP_BINARY, out, pos)) {
+        c->last_seq = chunk[count - 1].seq;
+    }
+}
+
+/** Push new telemetry (and periodically the full state) to one stream client. */
+static void stream_push(stream_client_t *c) {
+    c->state_elapsed_ms += c->period_ms;
+    int send_state = c->state_elapsed_ms >= SSE_STATE_PERIOD_MS &&
+                     tcp_sndbuf(c->pcb) >= sizeof(g_stream_buf);
+
+    if (c->kind == STREAM_WS) {
+        if (send_state) {
+            ws_send_state(c);
+            c->state_elapsed_ms = 0;
+        }
+        ws_push_samples(c);
+        tcp_output(c->pcb);
+        return;
+    }
+
+    if (send_state) {
+        size_t head = sse_event_head("state");
+        build_state_json(g_stream_buf + head, sse_event_room(head));
+        if (sse_send_event(c, head + strlen(g_stream_buf + head))) {
+            c->state_elapsed_ms = 0;
+        }
+    }
+
+    if (telemetry_last_seq() != c->last_seq) {
+        /* Only format what the send buffer can take now; the rest goes next tick. */
+        size_t room = tcp_sndbuf(c->pcb);
+        if (room >= SSE_MIN_SNDBUF) {
+            if (room > sizeof(g_stream_buf)) room = sizeof(g_stream_buf);
+            size_t head = sse_event_head("samples");
+            uint32_t last = build_history_json(g_stream_buf + head, room - head - 2, c->last_seq);
+            if (sse_send_event(c, head + strlen(g_stream_buf + head))) {
+                c->last_seq = last;
+            }
+        }
+    }
+    tcp_output(c->pcb);
+}
+
+/** lwIP timer callback: push to the client and re-arm at its period. */
+static void stream_tick(void *arg) {
+    stream_client_t *c = (stream_client_t *)arg;
+    if (!c->active) return;
+    stream_push(c);
+    sys_timeout(c->period_ms, stream_tick, c);
+}
+
+/**
+ * Apply a binary parameter update: a sequence of 5-byte records
+ * {u8 sim_param_t id, float32 value}, validated like /api/set.
+ */
+static void ws_apply_params(const uint8_t *payload, size_t len) {
+    int reset_req = 0;
+    sim_state_config_begin();
+    for (size_t off = 0; off + 5 <= len; off += 5) {
+        float value;
+        memcpy(&value, payload + off + 1, sizeof(value));
+        reset_req |= sim_param_apply(&g_sim.cfg, (sim_param_t)payload[off], value);
+    }
+    sim_param_finish(&g_sim.cfg);
+    sim_state_config_end();
+    if (reset_req) sim_state_request_reset();
+}
+
+/** Send a close frame with status and close the connection. */
+static err_t ws_close_with(stream_client_t *c, uint16_t status) {
+    uint8_t payload[2] = {(uint8_t)(status >> 8), (uint8_t)status};
+    ws_write_frame(c, WS_OP_CLOSE, payload, sizeof(payload));
+    tcp_output(c->pcb);
+    return stream_close(c);
+}
+
+/** Handle complete frames in the client's receive buffer. Returns ERR_ABRT if the pcb was aborted. */
+static err_t ws_process(stream_client_t *c) {
+    for (;;) {
+        ws_frame_t f;
+        int r = ws_parse_frame(c->rx, c->rx_len, &f);
+        if (r == 0) {
+            if (c->rx_len < sizeof(c->rx)) return ERR_OK;
+            r = -1; // frame larger than our buffer
+        }
+        if (r < 0) {
+            DLOGW("WS protocol error, closing\n");
+            return stream_close(c);
+        }
+
+        /*
+         * Parameter messages fit one frame and are applied as a whole, so a
+         * fragmented message is refused rather than applied in part.
+         */
+        if (f.opcode == WS_OP_CONT) {
+            DLOGW("WS continuation without a fragmented message, closing\n");
+            return ws_close_with(c, WS_CLOSE_PROTOCOL_ERROR);
+        }
+        if (!f.fin) {
+            DLOGW("WS fragmented message, closing\n");
+            return ws_close_with(c, (f.opcode & 0x08) ? WS_CLOSE_PROTOCOL_ERROR : WS_CLOSE_UNSUPPORTED);
+        }
+
+        const uint8_t *payload = c->rx + f.header_len;
+        switch (f.opcode) {
+        case WS_OP_BINARY:
+            ws_apply_params(payload, f.payload_len);
+            ws_send_state(c);
+            break;
+        case WS_OP_PING:
+            ws_write_frame(c, WS_OP_PONG, payload, f.payload_len);
+            break;
+        case WS_OP_CLOSE:
+            ws_write_frame(c, WS_OP_CLOSE, payload, f.payload_len < 2 ? f.payload_len : 2);
+            tcp_output(c->pcb);
+            return stream_close(c);
+        default:
+            break; // text frames are ignored
+        }
+        tcp_output(c->pcb);
+
+        size_t used = f.header_len + f.payload_len;
+        memmove(c->rx, c->rx + used, c->rx_len - used);
+        c->rx_len -= used;
+    }
+}
+
+/** Receive on a long-lived connection: WebSocket frames are parsed, SSE input is drained. */
+static err_t stream_recv(void *arg, struct tcp_pcb *tpcb, struct pbuf *p, err_t err) {
+    (void)err;
+    stream_client_t *c = (stream_client_t *)arg;
+    if (!p) {
+        if (c) return stream_close(c);
         tcp_close(tpcb);
-        r->active = 0;
+        return ERR_OK;
     }
+    tcp_recved(tpcb, p->tot_len);
+    if (!c || c->kind != STREAM_WS) {
+        pbuf_free(p);
+        return ERR_OK;
+    }
+
+    u16_t off = 0;
+    while (off < p->tot_len) {
+        size_t space = sizeof(c->rx) - c->rx_len;
+        u16_t n = pbuf_copy_partial(p, c->rx + c->rx_len, (u16_t)space, off);
+        c->rx_len += n;
+        off += n;
+        err_t ret = ws_process(c);
+        if (ret != ERR_OK || !c->active) {
+            pbuf_free(p);
+            return ret;
+        }
+        if (n == 0) break;
+    }
+    pbuf_free(p);
     return ERR_OK;
 }
 
-static void http_err(void *arg, err_t err) {
+static void stream_err(void *arg, err_t err) {
     (void)err;
-    http_response_t *r = (http_response_t *)arg;
-    if (r) {
-        r->active = 0;
+    stream_client_t *c = (stream_client_t *)arg;
+    if (c) {
+        sys_untimeout(stream_tick, c);
+        c->pcb = NULL;
+        c->active = 0;
+    }
+}
+
+/** Claim a free stream slot and attach it to the connection; NULL if all are in use. */
+static stream_client_t *stream_open(struct tcp_pcb *tpcb, stream_kind_t kind, const char *path,
+                                    int default_period) {
+    stream_client_t *c = NULL;
+    for (int i = 0; i < STREAM_MAX_CLIENTS; i++) {
+        if (!g_stream[i].active) {
+            c = &g_stream[i];
+            break;
+        }
+    }
+    if (!c) return NULL;
+
+    int period = default_period;
+    get_query_int(path, "period", &period);
+    if (period != 0 || kind == STREAM_SSE) {
+        if (period < SSE_MIN_PERIOD_MS) period = SSE_MIN_PERIOD_MS;
+        if (period > SSE_MAX_PERIOD_MS) period = SSE_MAX_PERIOD_MS;
+    }
+
+    uint32_t since = telemetry_last_seq();
+    get_query_u32(path, "since", &since);
+
+    c->pcb = tpcb;
+    c->kind = kind;
+    c->last_seq = since;
+    c->period_ms = (uint32_t)period;
+    c->state_elapsed_ms = SSE_STATE_PERIOD_MS; // send the state with the first push
+    c->rx_len = 0;
+    c->active = 1;
+    tcp_arg(tpcb, c);
+    tcp_recv(tpcb, stream_recv);
+    tcp_err(tpcb, stream_err);
+    return c;
+}
+
+/**
+ * Turn the connection into a text/event-stream. Query: period (ms between
+ * pushes) and since (resume after this telemetry sequence number).
+ * Returns 0 if all stream slots are in use.
+ */
+static int sse_start(struct tcp_pcb *tpcb, const char *path) {
+    stream_client_t *c = stream_open(tpcb, STREAM_SSE, path, SSE_DEFAULT_PERIOD_MS);
+    if (!c) return 0;
+
+    const char *hdr =
+        "HTTP/1.1 200 OK\r\n"
+        "Content-Type: text/event-stream\r\n"
+        "Cache-Control: no-cache\r\n"
+        "Connection: keep-alive\r\n\r\n"
+        "retry: 1000\n\n";
+    tcp_write(tpcb, hdr, strlen(hdr), TCP_WRITE_FLAG_COPY);
+    stream_push(c);
+    sys_timeout(c->period_ms, stream_tick, c);
+    DLOGI("SSE client started, period=%u ms\n", (unsigned)c->period_ms);
+    return 1;
+}
+
+/**
+ * Complete the RFC 6455 upgrade. Query: period (ms between binary telemetry
+ * pushes, 0 = control only) and since. Returns 0 if all stream slots are in use.
+ */
+static int ws_start(struct tcp_pcb *tpcb, const char *path, const char *key) {
+    stream_client_t *c = stream_open(tpcb, STREAM_WS, path, WS_DEFAULT_PERIOD_MS);
+    if (!c) return 0;
+
+    char accept[WS_ACCEPT_LEN];
+    ws_accept_key(key, strlen(key), accept);
+    char hdr[160];
+    int hdr_len = snprintf(hdr, sizeof(hdr),
+        "HTTP/1.1 101 Switching Protocols\r\n"
+        "Upgrade: websocket\r\n"
+        "Connection: Upgrade\r\n"
+        "Sec-WebSocket-Accept: %s\r\n\r\n", accept);
+    tcp_write(tpcb, hdr, (u16_t)hdr_len, TCP_WRITE_FLAG_COPY);
+    ws_send_state(c);
+    tcp_output(tpcb);
+    c->state_elapsed_ms = 0;
+    if (c->period_ms > 0) {
+        sys_timeout(c->period_ms, stream_tick, c);
+    }
+    DLOGI("WS client started, period=%u ms\n", (unsigned)c->period_ms);
+    return 1;
+}
+
+/** Copy the value of a request header (name matched case-insensitively) into out. */
+static int get_header(const char *req, const char *name, char *out, size_t out_len) {
+    size_t name_len = strlen(name);
+    const char *line = strstr(req, "\r\n");
+    while (line) {
+        line += 2;
+        if (line[0] == '\r' || line[0] == '\0') break; // end of headers
+        size_t i = 0;
+        while (i < name_len && line[i] &&
+               tolower((unsigned char)line[i]) == tolower((unsigned char)name[i])) {
+            i++;
+        }
+        if (i == name_len && line[i] == ':') {
+            const char *v = line + i + 1;
+            while (*v == ' ') v++;
+            size_t n = 0;
+            while (v[n] && v[n] != '\r' && n + 1 < out_len) {
+                out[n] = v[n];
+                n++;
+            }
+            out[n] = '\0';
+            return 1;
+        }
+        line = strstr(line, "\r\n");
+    }
+    return 0;
+}
+
+/** Build the JSON response with response-slot usage counters. */
+static void build_server_json(char *out, size_t out_len) {
+    int streams = 0;
+    for (int i = 0; i < STREAM_MAX_CLIENTS; i++) {
+        if (g_stream[i].active) streams++;
+    }
+    int conns = 0;
+    for (int i = 0; i < HTTP_MAX_CLIENTS; i++) {
+        if (g_conn_pool[i].active) conns++;
+    }
+    snprintf(out, out_len,
+        "{"
+        "\"slots\":%d,"
+        "\"in_use\":%u,"
+        "\"peak\":%u,"
+        "\"served\":%u,"
+        "\"rejected\":%u,"
+        "\"timeouts\":%u,"
+        "\"write_errors\":%u,"
+        "\"conn_slots\":%d,"
+        "\"conns\":%d,"
+        "\"reused\":%u,"
+        "\"idle_closes\":%u,"
+        "\"evicted\":%u,"
+        "\"stream_slots\":%d,"
+        "\"streams\":%d,"
+        "\"delay_pool\":%d,"
+        "\"delay_blocks\":%d"
+        "}",
+        HTTP_MAX_CONNS,
+        (unsigned)g_pool_stats.in_use,
+        (unsigned)g_pool_stats.peak,
+        (unsigned)g_pool_stats.served,
+        (unsigned)g_pool_stats.rejected,
+        (unsigned)g_pool_stats.timeouts,
+        (unsigned)g_pool_stats.write_errors,
+        HTTP_MAX_CLIENTS,
+        conns,
+        (unsigned)g_pool_stats.reused,
+        (unsigned)g_pool_stats.idle_closes,
+        (unsigned)g_pool_stats.evicted,
+        STREAM_MAX_CLIENTS,
+        streams,
+        DELAY_POOL_BLOCKS,
+        delay_pool_used());
+}
+
+/** Append one histogram as min/mean/max/p50/p99 and its non-empty buckets as [low_us, count]. */
+static size_t format_tick_hist(char *out, size_t out_len, const char *name, const tick_hist_t *h) {
+    size_t pos = (size_t)snprintf(out, out_len,
+        "\"%s\":{\"min\":%u,\"mean\":%.1f,\"max\":%u,\"p50\":%u,\"p99\":%u,\"hist\":[",
+        name, (unsigned)h->min_us, h->count ? (double)h->sum_us / h->count : 0.0, (unsigned)h->max_us,
+        (unsigned)tick_hist_percentile(h, 0.5f), (unsigned)tick_hist_percentile(h, 0.99f));
+    int first = 1;
+    for (int i = 0; i < TICK_HIST_BUCKETS && pos < out_len; i++) {
+        if (!h->bucket[i]) continue;
+        pos += (size_t)snprintf(out + pos, out_len - pos, "%s[%u,%u]", first ? "" : ",",
+                                (unsigned)tick_hist_bucket_low(i), (unsigned)h->bucket[i]);
+        first = 0;
+    }
+    if (pos < out_len) pos += (size_t)snprintf(out + pos, out_len - pos, "]}");
+    return pos;
+}
+
+/**
+ * Build /api/metrics: core1 tick timing (compute time and wake-up latency
+ * histograms, overruns) next to the seqlock contention and HTTP load
+ * counters, so jitter can be matched against them. reset=1 clears the
+ * tick statistics from the next tick on.
+ */
+static void build_metrics_json(char *out, size_t out_len) {
+    static tick_stats_t ts;
+    tick_stats_get(&ts);
+    sim_state_stats_t ss = sim_state_get_stats();
+    int streams = 0;
+    for (int i = 0; i < STREAM_MAX_CLIENTS; i++) {
+        if (g_stream[i].active) streams++;
+    }
+
+    size_t pos = (size_t)snprintf(out, out_len,
+        "{\"ticks\":%u,\"overruns\":%u,\"skipped\":%u,\"period_us\":%u,",
+        (unsigned)ts.ticks, (unsigned)ts.overruns, (unsigned)ts.skipped, (unsigned)ts.period_us);
+    if (pos < out_len) pos += format_tick_hist(out + pos, out_len - pos, "compute_us", &ts.compute);
+    if (pos < out_len) pos += (size_t)snprintf(out + pos, out_len - pos, ",");
+    if (pos < out_len) pos += format_tick_hist(out + pos, out_len - pos, "latency_us", &ts.latency);
+    if (pos < out_len) {
+        snprintf(out + pos, out_len - pos,
+            ",\"cfg_retries\":%u,\"cfg_stale\":%u,\"rt_retries\":%u,\"lock_max_hold_us\":%u,"
+            "\"http_served\":%u,\"http_in_use\":%u,\"http_rejected\":%u,\"streams\":%d}",
+            (unsigned)ss.cfg_retries, (unsigned)ss.cfg_stale, (unsigned)ss.rt_retries,
+            (unsigned)ss.lock_max_hold_us, (unsigned)g_pool_stats.served,
+            (unsigned)g_pool_stats.in_use, (unsigned)g_pool_stats.rejected, streams);
+    }
+}
+
+/** Append printf-style text to out at *pos; output past out_len is dropped. */
+static void prom_printf(char *out, size_t out_len, size_t *pos, const char *fmt, ...) {
+    if (*pos >= out_len) return;
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(out + *pos, out_len - *pos, fmt, ap);
+    va_end(ap);
+    if (n > 0) *pos = (*pos + (size_t)n < out_len) ? *pos + (size_t)n : out_len - 1;
+}
+
+/** HELP and TYPE lines of one metric family. */
+static void prom_family(char *out, size_t out_len, size_t *pos, const char *name, const char *type,
+                        const char *help) {
+    prom_printf(out, out_len, pos, "# HELP %s %s\n# TYPE %s %s\n", name, help, name, type);
+}
+
+/** One tick histogram in seconds; every bucket is listed so the series set stays fixed. */
+static void prom_tick_hist(char *out, size_t out_len, size_t *pos, const char *name, const char *help,
+                           const tick_hist_t *h) {
+    prom_family(out, out_len, pos, name, "histogram", help);
+    uint32_t cum = 0;
+    for (int i = 0; i < TICK_HIST_BUCKETS - 1; i++) {
+        cum += h->bucket[i];
+        uint32_t le = tick_hist_bucket_low(i + 1) - 1; // durations are whole microseconds
+        prom_printf(out, out_len, pos, "%s_bucket{le=\"%u.%06u\"} %u\n", name, (unsigned)(le / 1000000u),
+                    (unsigned)(le % 1000000u), (unsigned)cum);
+    }
+    prom_printf(out, out_len, pos, "%s_bucket{le=\"+Inf\"} %u\n%s_sum %.6f\n%s_count %u\n", name,
+                (unsigned)h->count, name, (double)h->sum_us / 1e6, name, (unsigned)h->count);
+}
+
+/**
+ * Build part `part` of the Prometheus text exposition for /metrics. The
+ * parts are sent one at a time through the response body, so the whole
+ * payload never has to fit in one buffer; each is read when it is built.
+ * Returns the part length, 0 after the last part.
+ */
+static size_t build_prometheus_part(int part, char *out, size_t out_len) {
+    static tick_stats_t ts;
+    size_t pos = 0;
+    out[0] = '\0';
+    switch (part) {
+    case 0:
+        prom_family(out, out_len, &pos, "pico_http_requests_total", "counter", "HTTP requests by route.");
+        for (int r = 0; r < HTTP_ROUTE_COUNT; r++) {
+            prom_printf(out, out_len, &pos, "pico_http_requests_total{route=\"%s\"} %u\n", k_http_routes[r],
+                        (unsigned)g_route_stats[r].requests);
+        }
+        prom_family(out, out_len, &pos, "pico_http_responses_total", "counter",
+                    "HTTP responses queued and streams started, by route.");
+        for (int r = 0; r < HTTP_ROUTE_COUNT; r++) {
+            prom_printf(out, out_len, &pos, "pico_http_responses_total{route=\"%s\"} %u\n", k_http_routes[r],
+                        (unsigned)g_route_stats[r].responses);
+        }
+        prom_family(out, out_len, &pos, "pico_http_rejected_total", "counter",
+                    "HTTP requests answered with 503, by route.");
+        for (int r = 0; r < HTTP_ROUTE_COUNT; r++) {
+            prom_printf(out, out_len, &pos, "pico_http_rejected_total{route=\"%s\"} %u\n", k_http_routes[r],
+                        (unsigned)g_route_stats[r].rejected);
+        }
+        prom_family(out, out_len, &pos, "pico_http_sent_bytes_total", "counter",
+                    "HTTP response bytes queued to TCP.");
+        prom_printf(out, out_len, &pos, "pico_http_sent_bytes_total %llu\n",
+                    (unsigned long long)g_pool_stats.bytes_sent);
+        prom_family(out, out_len, &pos, "pico_http_tcp_write_failures_total", "counter",
+                    "tcp_write calls refused while sending a response (mem: send queue full, resumed).");
+        prom_printf(out, out_len, &pos, "pico_http_tcp_write_failures_total{reason=\"mem\"} %u\n",
+                    (unsigned)g_pool_stats.write_full);
+        prom_printf(out, out_len, &pos, "pico_http_tcp_write_failures_total{reason=\"error\"} %u\n",
+                    (unsigned)g_pool_stats.write_errors);
+        prom_family(out, out_len, &pos, "pico_http_timeouts_total", "counter",
+                    "Responses aborted without send progress.");
+        prom_printf(out, out_len, &pos, "pico_http_timeouts_total %u\n", (unsigned)g_pool_stats.timeouts);
+        prom_family(out, out_len, &pos, "pico_http_slots_in_use", "gauge", "Response slots sending.");
+        prom_printf(out, out_len, &pos, "pico_http_slots_in_use %u\n", (unsigned)g_pool_stats.in_use);
+        break;
+    case 1: {
+        int conns = 0;
+        for (int i = 0; i < HTTP_MAX_CLIENTS; i++) {
+            if (g_conn_pool[i].active) conns++;
+        }
+        int streams = 0;
+        for (int i = 0; i < STREAM_MAX_CLIENTS; i++) {
+            if (g_stream[i].active) streams++;
+        }
+        prom_family(out, out_len, &pos, "pico_http_connections", "gauge", "Open HTTP connections.");
+        prom_printf(out, out_len, &pos, "pico_http_connections %d\n", conns);
+        prom_family(out, out_len, &pos, "pico_streams", "gauge", "Open SSE and WebSocket streams.");
+        prom_printf(out, out_len, &pos, "pico_streams %d\n", streams);
+#if MEM_STATS
+        prom_family(out, out_len, &pos, "pico_lwip_heap_bytes", "gauge", "lwIP heap: size, used and peak.");
+        prom_printf(out, out_len, &pos, "pico_lwip_heap_bytes{kind=\"size\"} %u\n",
+                    (unsigned)lwip_stats.mem.avail);
+        prom_printf(out, out_len, &pos, "pico_lwip_heap_bytes{kind=\"used\"} %u\n",
+                    (unsigned)lwip_stats.mem.used);
+        prom_printf(out, out_len, &pos, "pico_lwip_heap_bytes{kind=\"max\"} %u\n",
+                    (unsigned)lwip_stats.mem.max);
+        prom_family(out, out_len, &pos, "pico_lwip_heap_errors_total", "counter", "Failed lwIP heap allocations.");
+        prom_printf(out, out_len, &pos, "pico_lwip_heap_errors_total %u\n", (unsigned)lwip_stats.mem.err);
+#endif
+#if MEMP_STATS
+        static const struct {
+            int id;
+            const char *name;
+        } pools[] = {
+            {MEMP_PBUF_POOL, "pbuf_pool"}, {MEMP_TCP_PCB, "tcp_pcb"}, {MEMP_TCP_SEG, "tcp_seg"},
+        };
+        prom_family(out, out_len, &pos, "pico_lwip_pool", "gauge", "lwIP pool elements: size, used and peak.");
+        for (size_t i = 0; i < sizeof(pools) / sizeof(pools[0]); i++) {
+            const struct stats_mem *m = lwip_stats.memp[pools[i].id];
+            prom_printf(out, out_len, &pos,
+                        "pico_lwip_pool{pool=\"%s\",kind=\"size\"} %u\n"
+                        "pico_lwip_pool{pool=\"%s\",kind=\"used\"} %u\n"
+                        "pico_lwip_pool{pool=\"%s\",kind=\"max\"} %u\n",
+                        pools[i].name, (unsigned)m->avail, pools[i].name, (unsigned)m->used, pools[i].name,
+                        (unsigned)m->max);
+        }
+        prom_family(out, out_len, &pos, "pico_lwip_pool_errors_total", "counter", "Failed lwIP pool allocations.");
+        for (size_t i = 0; i < sizeof(pools) / sizeof(pools[0]); i++) {
+            prom_printf(out, out_len, &pos, "pico_lwip_pool_errors_total{pool=\"%s\"} %u\n", pools[i].name,
+                        (unsigned)lwip_stats.memp[pools[i].id]->err);
+        }
+#endif
+        int32_t rssi;
+        prom_family(out, out_len, &pos, "pico_wifi_info", "gauge", "Wi-Fi mode (sta or ap).");
+        prom_printf(out, out_len, &pos, "pico_wifi_info{mode=\"%s\"} 1\n",
+                    wifi_get_mode() == WIFI_MODE_AP ? "ap" : "sta");
+        if (wifi_get_rssi(&rssi)) {
+            prom_family(out, out_len, &pos, "pico_wifi_rssi_dbm", "gauge", "Station RSSI.");
+            prom_printf(out, out_len, &pos, "pico_wifi_rssi_dbm %d\n", (int)rssi);
+        }
+        prom_family(out, out_len, &pos, "pico_log_dropped_total", "counter",
+                    "Deferred log entries dropped on a full ring.");
+        prom_printf(out, out_len, &pos, "pico_log_dropped_total %u\n", (unsigned)log_ring_dropped());
+        config_store_stats_t cs = config_store_get_stats();
+        prom_family(out, out_len, &pos, "pico_config_writes_total", "counter", "Config records written to flash.");
+        prom_printf(out, out_len, &pos, "pico_config_writes_total %u\n", (unsigned)cs.writes);
+        prom_family(out, out_len, &pos, "pico_config_erases_total", "counter", "Config store sectors erased.");
+        prom_printf(out, out_len, &pos, "pico_config_erases_total %u\n", (unsigned)cs.erases);
+        prom_family(out, out_len, &pos, "pico_config_coalesced_total", "counter",
+                    "Config changes folded into a later flash write.");
+        prom_printf(out, out_len, &pos, "pico_config_coalesced_total %u\n", (unsigned)cs.coalesced);
+        prom_family(out, out_len, &pos, "pico_config_write_failures_total", "counter",
+                    "Config flash writes that failed or did not verify.");
+        prom_printf(out, out_len, &pos, "pico_config_write_failures_total %u\n", (unsigned)cs.failures);
+        prom_family(out, out_len, &pos, "pico_config_restore_seconds", "gauge",
+                    "Boot time spent restoring the stored config.");
+        prom_printf(out, out_len, &pos, "pico_config_restore_seconds{restored=\"%d\"} %u.%06u\n", cs.restored != 0,
+                    (unsigned)(cs.restore_us / 1000000u), (unsigned)(cs.restore_us % 1000000u));
+        udp_channel_stats_t us = udp_channel_get_stats();
+        prom_family(out, out_len, &pos, "pico_udp_packets_total", "counter", "UDP channel datagrams.");
+        prom_printf(out, out_len, &pos, "pico_udp_packets_total{direction=\"rx\"} %u\n", (unsigned)us.rx_packets);
+        prom_printf(out, out_len, &pos, "pico_udp_packets_total{direction=\"tx\"} %u\n", (unsigned)us.tx_packets);
+        prom_family(out, out_len, &pos, "pico_udp_errors_total", "counter",
+                    "UDP channel datagrams rejected on receive or not sent.");
+        prom_printf(out, out_len, &pos, "pico_udp_errors_total{direction=\"rx\"} %u\n", (unsigned)us.rx_malformed);
+        prom_printf(out, out_len, &pos, "pico_udp_errors_total{direction=\"tx\"} %u\n", (unsigned)us.tx_errors);
+        prom_family(out, out_len, &pos, "pico_udp_setpoints_total", "counter",
+                    "Master setpoint packets by outcome; lost counts sequence numbers never received.");
+        prom_printf(out, out_len, &pos, "pico_udp_setpoints_total{outcome=\"applied\"} %u\n", (unsigned)us.setpoints);
+        prom_printf(out, out_len, &pos, "pico_udp_setpoints_total{outcome=\"stale\"} %u\n", (unsigned)us.stale);
+        prom_printf(out, out_len, &pos, "pico_udp_setpoints_total{outcome=\"lost\"} %u\n", (unsigned)us.lost);
+        prom_family(out, out_len, &pos, "pico_udp_samples_total", "counter", "Runtime samples streamed over UDP.");
+        prom_printf(out, out_len, &pos, "pico_udp_samples_total %u\n", (unsigned)us.samples);
+        prom_family(out, out_len, &pos, "pico_udp_subscribed", "gauge", "1 while a UDP sample subscriber holds a lease.");
+        prom_printf(out, out_len, &pos, "pico_udp_subscribed %u\n", (unsigned)us.subscribed);
+        prom_family(out, out_len, &pos, "pico_uptime_seconds", "gauge", "Time since boot.");
+        prom_printf(out, out_len, &pos, "pico_uptime_seconds %.3f\n", (double)time_us_64() / 1e6);
+        break;
+    }
+    case 2:
+        tick_stats_get(&ts);
+        prom_family(out, out_len, &pos, "pico_tick_total", "counter", "core1 simulation ticks.");
+        prom_printf(out, out_len, &pos, "pico_tick_total %u\n", (unsigned)ts.ticks);
+        prom_family(out, out_len, &pos, "pico_tick_overruns_total", "counter",
+                    "Ticks whose work ended after the next tick was due.");
+        prom_printf(out, out_len, &pos, "pico_tick_overruns_total %u\n", (unsigned)ts.overruns);
+        prom_family(out, out_len, &pos, "pico_tick_skipped_total", "counter",
+                    "Tick periods dropped after overruns.");
+        prom_printf(out, out_len, &pos, "pico_tick_skipped_total %u\n", (unsigned)ts.skipped);
+        prom_family(out, out_len, &pos, "pico_tick_period_seconds", "gauge", "Current tick period.");
+        prom_printf(out, out_len, &pos, "pico_tick_period_seconds %.6f\n", (double)ts.period_us / 1e6);
+        prom_tick_hist(out, out_len, &pos, "pico_tick_compute_seconds",
+                       "Tick wake-up to end of the tick's work.", &ts.compute);
+        break;
+    case 3:
+        /* Parts are built from separate tcp_sent callbacks, so read the statistics again. */
+        tick_stats_get(&ts);
+        prom_tick_hist(out, out_len, &pos, "pico_tick_latency_seconds",
+                       "Scheduled tick time to core1 wake-up.", &ts.latency);
+        break;
+    default:
+        return 0;
+    }
+    if (pos >= out_len - 1) {
+        DLOGW("/metrics part %d truncated\n", part);
     }
+    return pos;
 }
 
 /** Send a small 503 response if the server is busy. */
-static void http_send_busy(struct tcp_pcb *tpcb) {
+static void http_send_busy(struct tcp_pcb *tpcb, http_route_t route) {
     const char *msg =
         "HTTP/1.1 503 Busy\r\n"
         "Content-Type: text/plain\r\n"
         "Content-Length: 12\r\n"
         "Connection: close\r\n\r\n"
         "Server busy";
+    g_pool_stats.rejected++;
+    g_route_stats[route].rejected++;
     tcp_write(tpcb, msg, strlen(msg), TCP_WRITE_FLAG_COPY);
     tcp_output(tpcb);
+    tcp_recv(tpcb, NULL);
     tcp_close(tpcb);
 }
 
-/** Handle an incoming TCP packet and return the HTML or JSON response. */
-static err_t http_recv(void *arg, struct tcp_pcb *tpcb, struct pbuf *p, err_t err) {
-    (void)arg;
-    (void)err;
-    if (!p) {
-        tcp_close(tpcb);
-        return ERR_OK;
+/** Non-zero if the request line ends in HTTP/1.1. */
+static int http_is_11(const char *req) {
+    const char *eol = strstr(req, "\r\n");
+    return eol && eol - req >= 8 && strncmp(eol - 8, "HTTP/1.1", 8) == 0;
+}
+
+/**
+ * HTTP/1.1 keeps the connection unless the client sends "Connection: close";
+ * HTTP/1.0 only keeps it on "Connection: keep-alive".
+ */
+static int http_wants_keep_alive(const char *req) {
+    int http11 = http_is_11(req);
+    char conn[32];
+    if (!get_header(req, "Connection", conn, sizeof(conn))) {
+        return http11;
     }
+    for (char *s = conn; *s; s++) *s = (char)tolower((unsigned char)*s);
+    if (strstr(conn, "close")) return 0;
+    return http11 || strstr(conn, "keep-alive") != NULL;
+}
 
-    static char req[512];
+/** Connection header lines of a response on c. */
+static void http_conn_header(const http_conn_t *c, char *out, size_t out_len) {
+    if (c->keep_alive) {
+        snprintf(out, out_len, "Connection: keep-alive\r\nKeep-Alive: timeout=%d\r\n", HTTP_KEEP_ALIVE_TIMEOUT_S);
+    } else {
+        snprintf(out, out_len, "Connection: close\r\n");
+    }
+}
 
-    size_t len = pbuf_copy_partial(p, req, sizeof(req) - 1, 0);
-    tcp_recved(tpcb, p->tot_len);
-    req[len] = '\0';
-    pbuf_free(p);
+/** Count a prepared response and start sending it; the rest follows from http_sent(). */
+static void http_queue_response(http_conn_t *c, http_response_t *r, http_route_t route) {
+    struct tcp_pcb *tpcb = c->pcb;
+    g_pool_stats.served++;
+    g_route_stats[route].responses++;
+    if (c->requests++ > 0) {
+        g_pool_stats.reused++;
+    }
+    c->resp = r;
+    if (http_send_more(r)) {
+        tcp_output(tpcb);
+        http_response_done(c);
+    } else {
+        tcp_output(tpcb);
+        LOGD("HTTP send pending (sndbuf full)\n");
+    }
+}
+
+/** The upload body is complete: keep the recording if it is valid and answer with the status. */
+static void http_upload_done(http_conn_t *c) {
+    int ok = sim_record_upload_end();
+    DLOGI("HTTP recording upload %s\n", ok ? "stored" : "rejected");
+    http_response_t *r = http_slot_alloc(c->pcb);
+    if (!r) {
+        struct tcp_pcb *tpcb = c->pcb;
+        http_conn_release(c);
+        http_send_busy(tpcb, HTTP_ROUTE_RECORD);
+        return;
+    }
+    char conn_hdr[64];
+    http_conn_header(c, conn_hdr, sizeof(conn_hdr));
+    r->body_src = r->body;
+    build_record_json(r->body, sizeof(r->body));
+    r->body_len = strlen(r->body);
+    r->header_len = (size_t)snprintf(r->header, sizeof(r->header),
+             "HTTP/1.1 %s\r\n"
+             "Content-Type: application/json\r\n"
+             "Content-Length: %d\r\n"
+             "%s\r\n",
+             ok ? "200 OK" : "400 Bad Request", (int)r->body_len, conn_hdr);
+    http_queue_response(c, r, HTTP_ROUTE_RECORD);
+}
+
+/** The offline job is finished: answer the connection waiting for it. */
+static void http_job_done(http_conn_t *c, const http_job_t *job) {
+    http_route_t route = job->autotune ? HTTP_ROUTE_AUTOTUNE : HTTP_ROUTE_SIMULATE;
+    c->job = 0;
+    http_response_t *r = http_slot_alloc(c->pcb);
+    if (!r) {
+        struct tcp_pcb *tpcb = c->pcb;
+        http_conn_release(c);
+        http_send_busy(tpcb, route);
+        return;
+    }
+    char conn_hdr[64];
+    http_conn_header(c, conn_hdr, sizeof(conn_hdr));
+    r->body_src = r->body;
+    if (job->autotune) {
+        build_autotune_json(r->body, sizeof(r->body), job);
+    } else {
+        build_simulate_json(r->body, sizeof(r->body), job);
+    }
+    r->body_len = strlen(r->body);
+    r->header_len = (size_t)snprintf(r->header, sizeof(r->header),
+             "HTTP/1.1 200 OK\r\n"
+             "Content-Type: application/json\r\n"
+             "Content-Length: %d\r\n"
+             "%s\r\n",
+             (int)r->body_len, conn_hdr);
+    http_queue_response(c, r, route);
+}
+
+/**
+ * Answer one request. Only PUT /api/record.bin has a body: it is streamed
+ * into the recorder by http_process() and answered once complete.
+ */
+static void http_handle_request(http_conn_t *c, char *req) {
+    struct tcp_pcb *tpcb = c->pcb;
+
+    /* Read headers before the path is cut out of the request. */
+    char ws_key[64];
+    int ws_upgrade = strncmp(req, "GET /ws", 7) == 0 &&
+                     get_header(req, "Sec-WebSocket-Key", ws_key, sizeof(ws_key));
+    char if_none_match[40];
+    if (!get_header(req, "If-None-Match", if_none_match, sizeof(if_none_match))) {
+        if_none_match[0] = '\0';
+    }
+    c->keep_alive = http_wants_keep_alive(req);
+    int http11 = http_is_11(req);
+    char content_length[16];
+    long body_len = get_header(req, "Content-Length", content_length, sizeof(content_length))
+                        ? strtol(content_length, NULL, 10) : 0;
 
     const char *path = "/";
-    if (strncmp(req, "GET ", 4) == 0) {
+    int put = strncmp(req, "PUT ", 4) == 0;
+    if (strncmp(req, "GET ", 4) == 0 || put) {
         char *start = req + 4;
         char *space = strchr(start, ' ');
         if (space) {
@@ -816,64 +2181,294 @@ static err_t http_recv(void *arg, struct tcp_pcb *tpcb, struct pbuf *p, err_t er
         }
     }
 
-    LOGI("HTTP GET %s\n", path);
-    if (strncmp(path, "/api/", 5) == 0) {
-        LOGD("HTTP API request\n");
+    DLOGI("HTTP %s %s\n", put ? "PUT" : "GET", path);
+    http_route_t route = http_route_of(path, ws_upgrade);
+    g_route_stats[route].requests++;
+
+    int record_bin = route == HTTP_ROUTE_RECORD && strncmp(path, "/api/record.bin", 15) == 0;
+    if (put && record_bin && body_len > 0 && sim_record_upload_begin((size_t)body_len)) {
+        c->body_left = (size_t)body_len;
+        return;
+    }
+    if (put && body_len > 0) {
+        /* A rejected body is not read; close instead of parsing it as requests. */
+        c->keep_alive = 0;
     }
 
-    const char *content_type = "text/html";
+    /* Streams take the connection over; requests pipelined behind them are dropped. */
+    if (route == HTTP_ROUTE_WS) {
+        http_conn_release(c);
+        if (!ws_start(tpcb, path, ws_key)) {
+            DLOGW("Stream slots full, rejecting WebSocket\n");
+            http_send_busy(tpcb, route);
+        } else {
+            g_route_stats[route].responses++;
+        }
+        return;
+    }
 
-    if (g_resp.active) {
-        LOGW("HTTP busy, rejecting request\n");
-        http_send_busy(tpcb);
-        return ERR_OK;
+    if (route == HTTP_ROUTE_STREAM) {
+        http_conn_release(c);
+        if (!sse_start(tpcb, path)) {
+            DLOGW("Stream slots full, rejecting SSE\n");
+            http_send_busy(tpcb, route);
+        } else {
+            g_route_stats[route].responses++;
+        }
+        return;
     }
 
-    if (strncmp(path, "/api/set", 8) == 0) {
-        apply_config_from_query(path);
-        build_state_json(g_resp.body, sizeof(g_resp.body));
-        content_type = "application/json";
-    } else if (strncmp(path, "/api/state", 10) == 0) {
-        build_state_json(g_resp.body, sizeof(g_resp.body));
-        content_type = "application/json";
-    } else if (strncmp(path, "/app.js", 7) == 0) {
-        build_app_js(g_resp.body, sizeof(g_resp.body));
-        content_type = "application/javascript";
-    } else {
-        build_page(g_resp.body, sizeof(g_resp.body));
+    /* Offline runs take too long for the lwIP context: web_server_poll() answers them. */
+    if (route == HTTP_ROUTE_SIMULATE || route == HTTP_ROUTE_AUTOTUNE) {
+        if (g_job.state != HTTP_JOB_IDLE) {
+            DLOGW("HTTP offline job running, rejecting request\n");
+            http_conn_release(c);
+            http_send_busy(tpcb, route);
+            return;
+        }
+        if (route == HTTP_ROUTE_AUTOTUNE) {
+            autotune_job_from_query(&g_job, path);
+        } else {
+            simulate_job_from_query(&g_job, path);
+        }
+        g_job.conn = c;
+        c->job = 1;
+        c->idle_polls = 0;
+        g_job.state = HTTP_JOB_QUEUED;
+        return;
     }
 
-    g_resp.body_len = strlen(g_resp.body);
-    if (g_resp.body_len >= sizeof(g_resp.body) - 1) {
-        LOGW("HTTP response truncated: %d bytes\n", (int)g_resp.body_len);
+    http_response_t *r = http_slot_alloc(tpcb);
+    if (!r) {
+        DLOGW("HTTP busy, rejecting request\n");
+        http_conn_release(c);
+        http_send_busy(tpcb, route);
+        return;
     }
-    g_resp.header_len = (size_t)snprintf(g_resp.header, sizeof(g_resp.header),
-             "HTTP/1.1 200 OK\r\n"
-             "Content-Type: %s\r\n"
-             "Content-Length: %d\r\n"
-             "Connection: close\r\n\r\n",
-             content_type, (int)g_resp.body_len);
 
-    g_resp.pcb = tpcb;
-    g_resp.offset = 0;
-    g_resp.active = 1;
-    tcp_arg(tpcb, &g_resp);
-    tcp_sent(tpcb, http_sent);
-    tcp_err(tpcb, http_err);
+    sim_record_status_t rec;
+    if (record_bin && !put) {
+        sim_record_get_status(&rec);
+        /* Closed after the body, so a recording replaced mid-download shows up as a short body. */
+        if (rec.state == SIM_RECORD_DONE) c->keep_alive = 0;
+    }
+    char conn_hdr[64];
+    http_conn_header(c, conn_hdr, sizeof(conn_hdr));
 
-    if (http_send_more(&g_resp)) {
-        tcp_output(tpcb);
+    r->body_src = r->body;
+    if (route == HTTP_ROUTE_METRICS) {
+        /* Built part by part while sending; HTTP/1.0 clients get a close-delimited body. */
+        r->body_fn = build_prometheus_part;
+        r->part = 0;
+        r->chunked = http11;
+        r->body_len = 0;
+        if (!http11) {
+            c->keep_alive = 0;
+            snprintf(conn_hdr, sizeof(conn_hdr), "Connection: close\r\n");
+        }
+        r->header_len = (size_t)snprintf(r->header, sizeof(r->header),
+                 "HTTP/1.1 200 OK\r\n"
+                 "Content-Type: text/plain; version=0.0.4; charset=utf-8\r\n"
+                 "%s"
+                 "%s\r\n",
+                 http11 ? "Transfer-Encoding: chunked\r\n" : "", conn_hdr);
+    } else if (record_bin && !put && rec.state == SIM_RECORD_DONE) {
+        g_record_download_gen = rec.gen;
+        r->body_fn = build_record_part;
+        r->part = 0;
+        r->chunked = 0;
+        r->body_len = 0;
+        r->header_len = (size_t)snprintf(r->header, sizeof(r->header),
+                 "HTTP/1.1 200 OK\r\n"
+                 "Content-Type: application/octet-stream\r\n"
+                 "Content-Disposition: attachment; filename=\"recording.bin\"\r\n"
+                 "Content-Length: %u\r\n"
+                 "%s\r\n",
+                 (unsigned)rec.bytes, conn_hdr);
+    } else if (route != HTTP_ROUTE_ASSET) {
+        switch (route) {
+        case HTTP_ROUTE_SET:
+            apply_config_from_query(path);
+            build_state_json(r->body, sizeof(r->body));
+            break;
+        case HTTP_ROUTE_HISTORY: {
+            uint32_t since = 0;
+            get_query_u32(path, "since", &since);
+            build_history_json(r->body, sizeof(r->body), since);
+            break;
+        }
+        case HTTP_ROUTE_API_METRICS: {
+            int reset = 0;
+            get_query_int(path, "reset", &reset);
+            if (reset) tick_stats_request_reset();
+            build_metrics_json(r->body, sizeof(r->body));
+            break;
+        }
+        case HTTP_ROUTE_SERVER:
+            build_server_json(r->body, sizeof(r->body));
+            break;
+        case HTTP_ROUTE_SWEEP: {
+            int since = 0;
+            get_query_int(path, "since", &since);
+            apply_sweep_from_query(path);
+            build_sweep_json(r->body, sizeof(r->body), since);
+            break;
+        }
+        case HTTP_ROUTE_RECORD:
+            apply_record_from_query(path);
+            build_record_json(r->body, sizeof(r->body));
+            break;
+        case HTTP_ROUTE_PROFILE:
+            apply_profile_from_query(path);
+            build_profile_json(r->body, sizeof(r->body));
+            break;
+        case HTTP_ROUTE_BATCH: {
+            int id = -1;
+            get_query_int(path, "id", &id);
+            if (strncmp(path, "/api/batch/set", 14) == 0) {
+                apply_batch_from_query(path);
+            }
+            build_batch_json(r->body, sizeof(r->body), id);
+            break;
+        }
+        default:
+            build_state_json(r->body, sizeof(r->body));
+            break;
+        }
+
+        r->body_len = strlen(r->body);
+        if (r->body_len >= sizeof(r->body) - 1) {
+            DLOGW("HTTP response truncated: %d bytes\n", (int)r->body_len);
+        }
+        r->header_len = (size_t)snprintf(r->header, sizeof(r->header),
+                 "HTTP/1.1 200 OK\r\n"
+                 "Content-Type: application/json\r\n"
+                 "Content-Length: %d\r\n"
+                 "%s\r\n",
+                 (int)r->body_len, conn_hdr);
     } else {
-        LOGW("HTTP send pending (sndbuf empty)\n");
+        const web_asset_t *asset = find_asset(path);
+        if (if_none_match[0] && strstr(if_none_match, asset->etag)) {
+            r->body_len = 0;
+            r->header_len = (size_t)snprintf(r->header, sizeof(r->header),
+                     "HTTP/1.1 304 Not Modified\r\n"
+                     "ETag: %s\r\n"
+                     "Cache-Control: no-cache\r\n"
+                     "%s\r\n",
+                     asset->etag, conn_hdr);
+        } else {
+            r->body_src = (const char *)asset->data;
+            r->body_len = asset->len;
+            r->header_len = (size_t)snprintf(r->header, sizeof(r->header),
+                     "HTTP/1.1 200 OK\r\n"
+                     "Content-Type: %s\r\n"
+                     "Content-Encoding: gzip\r\n"
+                     "Content-Length: %d\r\n"
+                     "ETag: %s\r\n"
+                     "Cache-Control: no-cache\r\n"
+                     "%s\r\n",
+                     asset->content_type, (int)r->body_len, asset->etag, conn_hdr);
+        }
+    }
+
+    http_queue_response(c, r, route);
+}
+
+/**
+ * Answer the complete requests buffered on the connection, in order. A
+ * pipelined request waits in rx until the response before it is queued.
+ */
+static void http_process(http_conn_t *c) {
+    static char req[HTTP_RX_SIZE + 1];
+
+    while (c->active && !c->resp && !c->job) {
+        if (c->body_left) {
+            size_t n = (c->rx_len < c->body_left) ? c->rx_len : c->body_left;
+            sim_record_upload_write(c->rx, n);
+            c->rx_len -= n;
+            memmove(c->rx, c->rx + n, c->rx_len);
+            c->body_left -= n;
+            if (c->body_left) return;
+            http_upload_done(c);
+            continue;
+        }
+        size_t req_len = 0;
+        for (size_t i = 0; i + 3 < c->rx_len; i++) {
+            if (memcmp(c->rx + i, "\r\n\r\n", 4) == 0) {
+                req_len = i + 4;
+                break;
+            }
+        }
+        if (req_len == 0) {
+            if (c->rx_len == sizeof(c->rx)) {
+                DLOGW("HTTP request headers too large\n");
+                http_conn_close(c);
+            }
+            return;
+        }
+        memcpy(req, c->rx, req_len);
+        req[req_len] = '\0';
+        c->rx_len -= req_len;
+        memmove(c->rx, c->rx + req_len, c->rx_len);
+        http_handle_request(c, req);
     }
+}
+
+/** Buffer incoming request bytes and answer every complete request. */
+static err_t http_recv(void *arg, struct tcp_pcb *tpcb, struct pbuf *p, err_t err) {
+    (void)err;
+    http_conn_t *c = (http_conn_t *)arg;
+    if (!p) {
+        if (c) {
+            http_conn_close(c);
+        } else {
+            tcp_recv(tpcb, NULL);
+            tcp_close(tpcb);
+        }
+        return ERR_OK;
+    }
+    tcp_recved(tpcb, p->tot_len);
+    if (!c) {
+        /* No connection state was free at accept time. */
+        pbuf_free(p);
+        g_route_stats[HTTP_ROUTE_NONE].requests++;
+        http_send_busy(tpcb, HTTP_ROUTE_NONE);
+        return ERR_OK;
+    }
+
+    c->idle_polls = 0;
+    u16_t off = 0;
+    while (c->active && off < p->tot_len) {
+        size_t space = sizeof(c->rx) - c->rx_len;
+        u16_t n = pbuf_copy_partial(p, c->rx + c->rx_len, (u16_t)space, off);
+        c->rx_len += n;
+        off += n;
+        http_process(c);
+        if (n == 0 && c->active) {
+            /* rx is full behind a response still being queued: finish it, drop the rest. */
+            DLOGW("HTTP pipeline overflow, closing after current response\n");
+            c->keep_alive = 0;
+            c->rx_len = 0;
+            break;
+        }
+    }
+    pbuf_free(p);
     return ERR_OK;
 }
 
-/** Accept a new TCP connection and install the receive callback. */
+/** Accept a new TCP connection and install the HTTP callbacks. */
 static err_t http_accept(void *arg, struct tcp_pcb *newpcb, err_t err) {
     (void)arg;
     (void)err;
+    http_conn_t *c = http_conn_alloc(newpcb);
+    if (!c) {
+        DLOGW("HTTP connection slots full\n");
+    }
+    tcp_arg(newpcb, c);
     tcp_recv(newpcb, http_recv);
+    tcp_sent(newpcb, http_sent);
+    tcp_err(newpcb, http_err);
+    tcp_poll(newpcb, http_poll, HTTP_POLL_INTERVAL);
     return ERR_OK;
 }
 
@@ -906,3 +2501,28 @@ bool start_http_server(void) {
 
 
 
+
+/**
+ * Run the queued /api/simulate or /api/autotune job until deadline_us, from
+ * the core0 main loop. Returns non-zero while a job needs more time.
+ */
+int web_server_poll(uint64_t deadline_us) {
+    http_job_t *job = &g_job;
+    if (job->state == HTTP_JOB_IDLE) return 0;
+    if (job->state == HTTP_JOB_QUEUED) http_job_begin(job);
+    if (!http_job_step(job, deadline_us)) return 1;
+
+    cyw43_arch_lwip_begin();
+    if (job->autotune && job->apply && job->tune.res.ok) sim_state_set_pid(&job->tune.res.pid);
+    http_conn_t *c = (http_conn_t *)job->conn;
+    job->conn = NULL;
+    job->state = HTTP_JOB_IDLE;
+    if (c) {
+        http_job_done(c, job);
+        if (c->active) {
+            http_process(c); // answer requests pipelined behind this one
+        }
+    }
+    cyw43_arch_lwip_end();
+    return 0;
+}
@@ -1,6 +1,14 @@
 #pragma once
 
 #include <stdbool.h>
+#include <stdint.h>
 
 /* Start the simple HTTP server for the Pico W web UI. */
 bool start_http_server(void);
+
+/*
+ * Run the offline job of /api/simulate or /api/autotune until deadline_us
+ * and answer it once finished; call from the main loop. Returns non-zero
+ * while the job needs more time.
+ */
+int web_server_poll(uint64_t deadline_us);
@@ -0,0 +1,155 @@
+#include <string.h>
+
+#include "websocket.h"
+
+static const char k_ws_guid[] = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+
+static uint32_t rol32(uint32_t v, int n) {
+    return (v << n) | (v >> (32 - n));
+}
+
+/** Process one 64-byte SHA-1 block. */
+static void sha1_block(uint32_t h[5], const uint8_t block[64]) {
+    uint32_t w[80];
+    for (int i = 0; i < 16; i++) {
+        w[i] = ((uint32_t)block[i * 4] << 24) | ((uint32_t)block[i * 4 + 1] << 16) |
+               ((uint32_t)block[i * 4 + 2] << 8) | (uint32_t)block[i * 4 + 3];
+    }
+    for (int i = 16; i < 80; i++) {
+        w[i] = rol32(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+    }
+
+    uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+    for (int i = 0; i < 80; i++) {
+        uint32_t f, k;
+        if (i < 20) {
+            f = (b & c) | (~b & d);
+            k = 0x5A827999u;
+        } else if (i < 40) {
+            f = b ^ c ^ d;
+            k = 0x6ED9EBA1u;
+        } else if (i < 60) {
+            f = (b & c) | (b & d) | (c & d);
+            k = 0x8F1BBCDCu;
+        } else {
+            f = b ^ c ^ d;
+            k = 0xCA62C1D6u;
+        }
+        uint32_t t = rol32(a, 5) + f + e + k + w[i];
+        e = d;
+        d = c;
+        c = rol32(b, 30);
+        b = a;
+        a = t;
+    }
+    h[0] += a;
+    h[1] += b;
+    h[2] += c;
+    h[3] += d;
+    h[4] += e;
+}
+
+/** SHA-1 of a short message (the handshake input is < 128 bytes). */
+static void sha1(const uint8_t *msg, size_t len, uint8_t digest[20]) {
+    uint32_t h[5] = {0x67452301u, 0xEFCDAB89u, 0x98BADCFEu, 0x10325476u, 0xC3D2E1F0u};
+    uint8_t block[64];
+    size_t off = 0;
+
+    while (len - off >= 64) {
+        sha1_block(h, msg + off);
+        off += 64;
+    }
+
+    size_t rem = len - off;
+    memset(block, 0, sizeof(block));
+    memcpy(block, msg + off, rem);
+    block[rem] = 0x80;
+    if (rem >= 56) {
+        sha1_block(h, block);
+        memset(block, 0, sizeof(block));
+    }
+    uint64_t bits = (uint64_t)len * 8u;
+    for (int i = 0; i < 8; i++) {
+        block[63 - i] = (uint8_t)(bits >> (8 * i));
+    }
+    sha1_block(h, block);
+
+    for (int i = 0; i < 5; i++) {
+        digest[i * 4] = (uint8_t)(h[i] >> 24);
+        digest[i * 4 + 1] = (uint8_t)(h[i] >> 16);
+        digest[i * 4 + 2] = (uint8_t)(h[i] >> 8);
+        digest[i * 4 + 3] = (uint8_t)h[i];
+    }
+}
+
+/** Base64-encode len bytes into out (NUL terminated). */
+static void base64_encode(const uint8_t *in, size_t len, char *out) {
+    static const char tbl[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    size_t o = 0;
+    for (size_t i = 0; i < len; i += 3) {
+        uint32_t v = (uint32_t)in[i] << 16;
+        if (i + 1 < len) v |= (uint32_t)in[i + 1] << 8;
+        if (i + 2 < len) v |= in[i + 2];
+        out[o++] = tbl[(v >> 18) & 0x3F];
+        out[o++] = tbl[(v >> 12) & 0x3F];
+        out[o++] = (i + 1 < len) ? tbl[(v >> 6) & 0x3F] : '=';
+        out[o++] = (i + 2 < len) ? tbl[v & 0x3F] : '=';
+    }
+    out[o] = '\0';
+}
+
+/** Compute Sec-WebSocket-Accept for the client's Sec-WebSocket-Key. */
+void ws_accept_key(const char *client_key, size_t key_len, char out[WS_ACCEPT_LEN]) {
+    uint8_t msg[128];
+    uint8_t digest[20];
+    if (key_len > sizeof(msg) - (sizeof(k_ws_guid) - 1)) {
+        key_len = sizeof(msg) - (sizeof(k_ws_guid) - 1);
+    }
+    memcpy(msg, client_key, key_len);
+    memcpy(msg + key_len, k_ws_guid, sizeof(k_ws_guid) - 1);
+    sha1(msg, key_len + sizeof(k_ws_guid) - 1, digest);
+    base64_encode(digest, sizeof(digest), out);
+}
+
+/** Parse (and unmask) one client frame from buf. */
+int ws_parse_frame(uint8_t *buf, size_t len, ws_frame_t *frame) {
+    if (len < 2) return 0;
+    frame->fin = (buf[0] & 0x80) ? 1 : 0;
+    frame->opcode = buf[0] & 0x0F;
+    int masked = (buf[1] & 0x80) != 0;
+    size_t plen = buf[1] & 0x7F;
+    size_t hdr = 2;
+
+    if (!masked) return -1; // RFC 6455 5.1: clients must mask
+    if (plen == 127) return -1;
+    if (plen == 126) {
+        if (len < 4) return 0;
+        plen = ((size_t)buf[2] << 8) | buf[3];
+        hdr = 4;
+    }
+    if (len < hdr + 4 + plen) return 0;
+
+    const uint8_t *mask = buf + hdr;
+    hdr += 4;
+    uint8_t *payload = buf + hdr;
+    for (size_t i = 0; i < plen; i++) {
+        payload[i] ^= mask[i & 3];
+    }
+
+    frame->header_len = hdr;
+    frame->payload_len = plen;
+    return 1;
+}
+
+/** Write an unmasked server frame header. */
+size_t ws_frame_header(uint8_t *out, uint8_t opcode, size_t payload_len) {
+    out[0] = (uint8_t)(0x80 | (opcode & 0x0F));
+    if (payload_len < 126) {
+        out[1] = (uint8_t)payload_len;
+        return 2;
+    }
+    out[1] = 126;
+    out[2] = (uint8_t)(payload_len >> 8);
+    out[3] = (uint8_t)payload_len;
+    return 4;
+}
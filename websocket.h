@@ -0,0 +1,41 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// RFC 6455 helpers for the raw-lwIP server: handshake key and frame coding.
+
+#define WS_OP_CONT 0x0
+#define WS_OP_TEXT 0x1
+#define WS_OP_BINARY 0x2
+#define WS_OP_CLOSE 0x8
+#define WS_OP_PING 0x9
+#define WS_OP_PONG 0xA
+
+// Close status codes (RFC 6455 7.4.1).
+#define WS_CLOSE_PROTOCOL_ERROR 1002
+#define WS_CLOSE_UNSUPPORTED 1003
+
+// Sec-WebSocket-Accept is base64(SHA-1) = 28 chars + NUL.
+#define WS_ACCEPT_LEN 29
+
+typedef struct {
+    uint8_t opcode;
+    uint8_t fin;
+    size_t header_len; // bytes before the payload
+    size_t payload_len;
+} ws_frame_t;
+
+/** Compute Sec-WebSocket-Accept for the client's Sec-WebSocket-Key. */
+void ws_accept_key(const char *client_key, size_t key_len, char out[WS_ACCEPT_LEN]);
+
+/**
+ * Parse a frame header from buf. Returns 1 when a complete frame is present
+ * (header and payload), 0 if more bytes are needed, -1 for frames we reject
+ * (unmasked client frames or 64-bit lengths).
+ * A complete frame's payload is unmasked in place.
+ */
+int ws_parse_frame(uint8_t *buf, size_t len, ws_frame_t *frame);
+
+/** Write an unmasked server frame header; returns its length (2 or 4 bytes). */
+size_t ws_frame_header(uint8_t *out, uint8_t opcode, size_t payload_len);
@@ -5,6 +5,13 @@
 #include "debug.h"
 #include "wifi_manager.h"
 
+#define WIFI_RSSI_PERIOD_MS 2000
+
+static wifi_mode_t g_wifi_mode;
+static int32_t g_wifi_rssi;
+static int g_wifi_rssi_valid;
+static absolute_time_t g_wifi_next_rssi;
+
 /* Connect to Wi-Fi as a station, or fall back to AP mode with the same SSID. */
 wifi_mode_t wifi_connect_or_start_ap(const char *ssid, const char *password) {
     cyw43_arch_enable_sta_mode();
@@ -12,6 +19,7 @@ wifi_mode_t wifi_connect_or_start_ap(const char *ssid, const char *password) {
     if (cyw43_arch_wifi_connect_timeout_ms(ssid, password,
                                            CYW43_AUTH_WPA2_AES_PSK, 30000) == 0) {
         LOGI("Wi-Fi station connected\n");
+        g_wifi_mode = WIFI_MODE_STA;
         return WIFI_MODE_STA;
     }
 
@@ -19,6 +27,7 @@ wifi_mode_t wifi_connect_or_start_ap(const char *ssid, const char *password) {
     cyw43_arch_enable_ap_mode(ssid, password, CYW43_AUTH_WPA2_AES_PSK);
     LOGW("AP mode started. DHCP server not available in this SDK install.\n");
     LOGW("Set phone IP manually: 192.168.4.2/24, gateway: 192.168.4.1\n");
+    g_wifi_mode = WIFI_MODE_AP;
     return WIFI_MODE_AP;
 }
 
@@ -31,3 +40,27 @@ const struct netif *wifi_get_netif(wifi_mode_t mode) {
     LOGD("wifi_get_netif: STA\n");
     return &cyw43_state.netif[CYW43_ITF_STA];
 }
+
+/* Mode chosen by wifi_connect_or_start_ap(). */
+wifi_mode_t wifi_get_mode(void) {
+    return g_wifi_mode;
+}
+
+/* Read the RSSI every WIFI_RSSI_PERIOD_MS; the ioctl is too slow for a request handler. */
+void wifi_poll(void) {
+    if (g_wifi_mode != WIFI_MODE_STA) return;
+    if (absolute_time_diff_us(get_absolute_time(), g_wifi_next_rssi) > 0) return;
+    g_wifi_next_rssi = make_timeout_time_ms(WIFI_RSSI_PERIOD_MS);
+    int32_t rssi;
+    if (cyw43_wifi_get_rssi(&cyw43_state, &rssi) == 0) {
+        g_wifi_rssi = rssi;
+        g_wifi_rssi_valid = 1;
+    }
+}
+
+/* Last station RSSI in dBm; returns 0 if none was read. */
+int wifi_get_rssi(int32_t *rssi) {
+    if (!g_wifi_rssi_valid) return 0;
+    *rssi = g_wifi_rssi;
+    return 1;
+}
@@ -1,5 +1,7 @@
 #pragma once
 
+#include <stdint.h>
+
 #include "lwip/netif.h"
 
 typedef enum {
@@ -12,3 +14,12 @@ wifi_mode_t wifi_connect_or_start_ap(const char *ssid, const char *password);
 
 /* Return the lwIP netif for the current mode (STA or AP). */
 const struct netif *wifi_get_netif(wifi_mode_t mode);
+
+/* Mode chosen by wifi_connect_or_start_ap(). */
+wifi_mode_t wifi_get_mode(void);
+
+/* Refresh the cached link readings (call from the core0 main loop, not from lwIP callbacks). */
+void wifi_poll(void);
+
+/* Last station RSSI in dBm; returns 0 if none was read (AP mode or not yet polled). */
+int wifi_get_rssi(int32_t *rssi);